@@ -63,7 +63,7 @@ BcmAclStage AclTable::P4PipelineToBcmAclStage(
 ::util::StatusOr<int> AclTable::BcmAclId(
     const ::p4::v1::TableEntry& entry) const {
   // Search for the entry.
-  const auto iter = bcm_acl_id_map_.find(entry);
+  const auto iter = bcm_acl_id_map_.find(TableEntryKey(entry));
   if (iter != bcm_acl_id_map_.end()) {
     return iter->second;
   }
@@ -80,16 +80,20 @@ BcmAclStage AclTable::P4PipelineToBcmAclStage(
          << entry.ShortDebugString() << ".";
 }
 
+size_t AclTable::MemoryUsage() const {
+  size_t bytes = BcmFlowTable::MemoryUsage() +
+                 bcm_acl_id_map_.capacity() *
+                     (sizeof(decltype(bcm_acl_id_map_)::value_type) + 1);
+  for (const auto& pair : bcm_acl_id_map_) {
+    bytes += pair.first.bytes().capacity();
+  }
+  return bytes;
+}
+
 ::util::Status AclTable::DryRunInsertEntry(
     const ::p4::v1::TableEntry& entry) const {
-  const auto result = entries_.find(entry);
   // Duplicate entry check.
-  if (result != entries_.end()) {
-    return MAKE_ERROR(ERR_ENTRY_EXISTS)
-           << TableStr()
-           << " contains duplicate of TableEntry: " << entry.ShortDebugString()
-           << ". Matching TableEntry: " << result->ShortDebugString() << ".";
-  }
+  RETURN_IF_ERROR(BcmFlowTable::DryRunInsertEntry(entry));
   // Table capacity check.
   if (EntryCount() == max_entries_) {
     return MAKE_ERROR(ERR_TABLE_FULL) << TableStr() << " is full.";
@@ -107,7 +111,7 @@ BcmAclStage AclTable::P4PipelineToBcmAclStage(
              << "> from TableEntry: " << entry.ShortDebugString() << ".";
     }
   }
-  return BcmFlowTable::DryRunInsertEntry(entry);
+  return ::util::OkStatus();
 }
 
 ::util::Status AclTable::InsertEntry(const ::p4::v1::TableEntry& entry,
@@ -125,14 +129,13 @@ BcmAclStage AclTable::P4PipelineToBcmAclStage(
            << " does not contain TableEntry: " << entry.ShortDebugString()
            << ".";
   }
-  auto iter = bcm_acl_id_map_.find(entry);
-  if (iter != bcm_acl_id_map_.end()) {
+  auto result = bcm_acl_id_map_.emplace(TableEntryKey(entry), bcm_acl_id);
+  if (!result.second) {
     return MAKE_ERROR(ERR_INTERNAL)
            << "Unexpected scenario in " << TableStr()
-           << ": Leftover Bcm ACL ID <" << iter->second
+           << ": Leftover Bcm ACL ID <" << result.first->second
            << "> found for TableEntry: " << entry.ShortDebugString() << ".";
   }
-  bcm_acl_id_map_[entry] = bcm_acl_id;
   return ::util::OkStatus();
 }
 
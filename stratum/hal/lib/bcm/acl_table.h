@@ -133,6 +133,10 @@ class AclTable : public BcmFlowTable {
   // Returns ERR_NOT_INITIALIZED if the entry exists but no mapping is found.
   util::StatusOr<int> BcmAclId(const ::p4::v1::TableEntry& entry) const;
 
+  // Returns the approximate number of bytes of memory used by this table,
+  // including the Bcm ACL ID mapping.
+  size_t MemoryUsage() const override;
+
   //***************************************************************************
   //  Table Entry Management
   //***************************************************************************
@@ -162,11 +166,8 @@ class AclTable : public BcmFlowTable {
   // Returns an error if the entry cannot be added.
   util::StatusOr<p4::v1::TableEntry> ModifyEntry(
       const ::p4::v1::TableEntry& entry) override {
-    // Remove the entry, but don't remove the record in bcm_acl_id_map_.
-    ASSIGN_OR_RETURN(p4::v1::TableEntry old_entry,
-                     BcmFlowTable::DeleteEntry(entry));
-    entries_.insert(entry);
-    return old_entry;
+    // The record in bcm_acl_id_map_ is kept, as the entry key is unchanged.
+    return BcmFlowTable::ModifyEntry(entry);
   }
 
   // Attempts to set the Bcm ACL ID for an entry in this table.
@@ -179,7 +180,7 @@ class AclTable : public BcmFlowTable {
       const ::p4::v1::TableEntry& entry) override {
     // We aren't interested in the return for erase since it's possible nobody
     // ever set the associated Bcm ACL ID.
-    bcm_acl_id_map_.erase(entry);
+    bcm_acl_id_map_.erase(TableEntryKey(entry));
     return BcmFlowTable::DeleteEntry(entry);
   }
 
@@ -206,9 +207,7 @@ class AclTable : public BcmFlowTable {
   // match_fields_.
   absl::flat_hash_set<uint32> udf_match_fields_;
   // Mapping from entries to their respective Bcm ACL IDs.
-  absl::flat_hash_map<::p4::v1::TableEntry, uint32,
-  TableEntryHash, TableEntryEqual>
-      bcm_acl_id_map_;
+  absl::flat_hash_map<TableEntryKey, uint32> bcm_acl_id_map_;
   // Stores const conditions
   absl::flat_hash_map<P4HeaderType, bool,
   EnumHash<P4HeaderType>> const_conditions_;
@@ -440,10 +440,10 @@ BcmAclManager::GeneratePhysicalAclTables(
   physical_acl_table.stage = stage;
   for (const PipelineTable& pipeline_table : physical_table) {
     uint32 table_id = pipeline_table.table.table_id();
-    ::p4::config::v1::Table p4_table;
-    RETURN_IF_ERROR(p4_table_mapper_->LookupTable(table_id, &p4_table));
+    ASSIGN_OR_RETURN(const ::p4::config::v1::Table* p4_table,
+                     p4_table_mapper_->FindTable(table_id));
     physical_acl_table.logical_tables.emplace_back(
-        p4_table, stage, pipeline_table.priority,
+        *p4_table, stage, pipeline_table.priority,
         pipeline_table.valid_conditions);
   }
   return physical_acl_table;
@@ -550,8 +550,8 @@ class BcmAclManagerTest : public ::testing::Test {
   }
 
   // Looks up tables from mock_tables_ by table id. This should be used in lieu
-  // of P4TableMapper::LookupTable.
-  ::util::Status LookupTable(int id, ::p4::config::v1::Table* table);
+  // of P4TableMapper::FindTable.
+  ::util::StatusOr<const ::p4::config::v1::Table*> FindTable(int id);
 
   // Fill a mapped_field field_type based on a table match_field. Fail if
   // table_id/match_id pair is unknown. This should be used in lieu of
@@ -580,9 +580,9 @@ void BcmAclManagerTest::SetUp() {
 }
 
 void BcmAclManagerTest::SetUpP4TableMapperMock() {
-  ON_CALL(*p4_table_mapper_mock_, LookupTable(_, _))
-      .WillByDefault(Invoke(this, &BcmAclManagerTest::LookupTable));
-  EXPECT_CALL(*p4_table_mapper_mock_, LookupTable(_, _)).Times(AnyNumber());
+  ON_CALL(*p4_table_mapper_mock_, FindTable(_))
+      .WillByDefault(Invoke(this, &BcmAclManagerTest::FindTable));
+  EXPECT_CALL(*p4_table_mapper_mock_, FindTable(_)).Times(AnyNumber());
 
   ON_CALL(*p4_table_mapper_mock_, MapMatchField(_, _, _))
       .WillByDefault(Invoke(this, &BcmAclManagerTest::MapMatchField));
@@ -642,21 +642,19 @@ void BcmAclManagerTest::SetUpBcmSdkMock() {
       .WillByDefault(Return(::util::OkStatus()));
 }
 
-::util::Status BcmAclManagerTest::LookupTable(int id,
-                                              ::p4::config::v1::Table* table) {
+::util::StatusOr<const ::p4::config::v1::Table*> BcmAclManagerTest::FindTable(
+    int id) {
   auto result = gtl::FindOrNull(mock_tables_, id);
   if (result == nullptr) {
     return MAKE_ERROR(ERR_ENTRY_NOT_FOUND) << "Table " << id << " not found.";
   }
-  *table = *result;
-  return ::util::OkStatus();
+  return result;
 }
 
 ::util::Status BcmAclManagerTest::MapMatchField(int table_id, int match_id,
                                                 MappedField* mapped_field) {
-  ::p4::config::v1::Table table;
-  RETURN_IF_ERROR(LookupTable(table_id, &table));
-  for (const auto& match : table.match_fields()) {
+  ASSIGN_OR_RETURN(const ::p4::config::v1::Table* table, FindTable(table_id));
+  for (const auto& match : table->match_fields()) {
     if (match.id() == match_id) {
       P4FieldType field_type = P4_FIELD_TYPE_UNKNOWN;
       CHECK(P4FieldType_Parse(match.name(), &field_type))
@@ -27,7 +27,9 @@
 #include "stratum/glue/integral_types.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
 #include "stratum/glue/logging.h"
 #include "stratum/hal/lib/bcm/utils.h"
 #include "stratum/hal/lib/common/common.pb.h"
@@ -55,6 +57,15 @@ DEFINE_string(bcm_sdk_shell_log_file, "/tmp/stratum/bcm.log",
 DEFINE_string(bcm_sdk_checkpoint_dir, "",
               "The dir used by SDK to save checkpoints. Default is empty and "
               "it is expected to be explicitly given by flags.");
+DEFINE_int32(bcm_port_counters_poll_interval_ms, 1000,
+             "The interval at which the counters of all the singleton ports "
+             "are polled from the SDK by a background thread and cached. Set "
+             "to 0 to disable the cache and always read the port counters "
+             "from the SDK.");
+DEFINE_int32(bcm_port_counters_max_staleness_ms, 3000,
+             "The maximum age of the cached port counters returned by "
+             "GetPortCounters(). Counters older than this are read from the "
+             "SDK.");
 
 namespace stratum {
 namespace hal {
@@ -80,6 +91,7 @@ BcmChassisManager::BcmChassisManager(OperationMode mode,
       xcvr_event_writer_id_(kInvalidWriterId),
       base_bcm_chassis_map_(nullptr),
       applied_bcm_chassis_map_(nullptr),
+      applied_config_(nullptr),
       unit_to_bcm_chip_(),
       singleton_port_key_to_bcm_port_(),
       port_group_key_to_flex_bcm_ports_(),
@@ -88,20 +100,22 @@ BcmChassisManager::BcmChassisManager(OperationMode mode,
       unit_to_node_id_(),
       node_id_to_port_ids_(),
       node_id_to_trunk_ids_(),
-      node_id_to_port_id_to_singleton_port_key_(),
-      node_id_to_port_id_to_sdk_port_(),
+      port_records_(),
+      node_id_and_port_id_to_port_handle_(),
+      sdk_port_to_port_handle_(),
+      chassis_state_snapshot_(nullptr),
+      chassis_config_state_(nullptr),
+      chassis_state_version_(0),
       node_id_to_trunk_id_to_sdk_trunk_(),
-      node_id_to_sdk_port_to_port_id_(),
       node_id_to_sdk_trunk_to_trunk_id_(),
       xcvr_port_key_to_xcvr_state_(),
-      node_id_to_port_id_to_port_state_(),
       node_id_to_trunk_id_to_trunk_state_(),
       node_id_to_trunk_id_to_members_(),
-      node_id_to_port_id_to_trunk_membership_info_(),
-      node_id_to_port_id_to_admin_state_(),
-      node_id_to_port_id_to_health_state_(),
       xcvr_event_channel_(nullptr),
       linkscan_event_channel_(nullptr),
+      node_id_to_port_id_to_port_counters_(),
+      port_counters_poller_tid_(),
+      port_counters_poller_running_(false),
       phal_interface_(ABSL_DIE_IF_NULL(phal_interface)),
       bcm_sdk_interface_(ABSL_DIE_IF_NULL(bcm_sdk_interface)),
       bcm_serdes_db_manager_(ABSL_DIE_IF_NULL(bcm_serdes_db_manager)) {}
@@ -114,6 +128,7 @@ BcmChassisManager::BcmChassisManager()
       xcvr_event_writer_id_(kInvalidWriterId),
       base_bcm_chassis_map_(nullptr),
       applied_bcm_chassis_map_(nullptr),
+      applied_config_(nullptr),
       unit_to_bcm_chip_(),
       singleton_port_key_to_bcm_port_(),
       port_group_key_to_flex_bcm_ports_(),
@@ -122,20 +137,22 @@ BcmChassisManager::BcmChassisManager()
       unit_to_node_id_(),
       node_id_to_port_ids_(),
       node_id_to_trunk_ids_(),
-      node_id_to_port_id_to_singleton_port_key_(),
-      node_id_to_port_id_to_sdk_port_(),
+      port_records_(),
+      node_id_and_port_id_to_port_handle_(),
+      sdk_port_to_port_handle_(),
+      chassis_state_snapshot_(nullptr),
+      chassis_config_state_(nullptr),
+      chassis_state_version_(0),
       node_id_to_trunk_id_to_sdk_trunk_(),
-      node_id_to_sdk_port_to_port_id_(),
       node_id_to_sdk_trunk_to_trunk_id_(),
       xcvr_port_key_to_xcvr_state_(),
-      node_id_to_port_id_to_port_state_(),
       node_id_to_trunk_id_to_trunk_state_(),
       node_id_to_trunk_id_to_members_(),
-      node_id_to_port_id_to_trunk_membership_info_(),
-      node_id_to_port_id_to_admin_state_(),
-      node_id_to_port_id_to_health_state_(),
       xcvr_event_channel_(nullptr),
       linkscan_event_channel_(nullptr),
+      node_id_to_port_id_to_port_counters_(),
+      port_counters_poller_tid_(),
+      port_counters_poller_running_(false),
       phal_interface_(nullptr),
       bcm_sdk_interface_(nullptr),
       bcm_serdes_db_manager_(nullptr) {}
@@ -150,11 +167,23 @@ BcmChassisManager::~BcmChassisManager() {
                << "true. You did not call Shutdown() before deleting the class "
                << "instance. This can lead to unexpected behavior.";
   }
+  StopPortCountersPoller();
   CleanupInternalState();
 }
 
 ::util::Status BcmChassisManager::PushChassisConfig(
     const ChassisConfig& config) {
+  ::util::Status status = DoPushChassisConfig(config);
+  // Even a failed push may have changed part of the internal state.
+  PublishChassisStateSnapshot(true);
+
+  return status;
+}
+
+::util::Status BcmChassisManager::DoPushChassisConfig(
+    const ChassisConfig& config) {
+  absl::Time start = absl::Now();
+  std::string push_type;
   if (!initialized_) {
     // If the class is not initialized. Perform an end-to-end coldboot
     // initialization sequence.
@@ -171,13 +200,36 @@ BcmChassisManager::~BcmChassisManager() {
     RETURN_IF_ERROR(SyncInternalState(config));
     RETURN_IF_ERROR(ConfigurePortGroups());
     RETURN_IF_ERROR(RegisterEventWriters());
+    RETURN_IF_ERROR(StartPortCountersPoller());
     initialized_ = true;
+    push_type = "initial";
   } else {
-    // If already initialized, sync the internal state and (re-)configure the
-    // the flex and non-flex port groups.
-    RETURN_IF_ERROR(SyncInternalState(config));
-    RETURN_IF_ERROR(ConfigurePortGroups());
+    // If already initialized, only apply what changed since the last push.
+    // Anything beyond the config params of the existing singleton ports
+    // requires to sync the internal state and (re-)configure the flex and
+    // non-flex port groups.
+    ChassisConfigDiff diff;
+    if (applied_config_ == nullptr) {
+      diff.full_sync_required = true;
+    } else {
+      diff = DiffChassisConfig(*applied_config_, config);
+    }
+    if (diff.full_sync_required) {
+      RETURN_IF_ERROR(SyncInternalState(config));
+      RETURN_IF_ERROR(ConfigurePortGroups());
+      push_type = "full sync";
+    } else {
+      RETURN_IF_ERROR(UpdateSingletonPorts(diff.updated_singleton_ports));
+      RETURN_IF_ERROR(ConfigurePendingPortGroups());
+      push_type = absl::StrCat("incremental, ",
+                               diff.changed_singleton_ports.size(),
+                               " singleton port(s) changed");
+    }
   }
+  applied_config_ = absl::make_unique<ChassisConfig>(config);
+  LOG(INFO) << "Chassis config pushed in "
+            << absl::FormatDuration(absl::Now() - start) << " (" << push_type
+            << ").";
 
   return ::util::OkStatus();
 }
@@ -222,6 +274,7 @@ BcmChassisManager::~BcmChassisManager() {
 
 ::util::Status BcmChassisManager::Shutdown() {
   ::util::Status status = ::util::OkStatus();
+  StopPortCountersPoller();
   APPEND_STATUS_IF_ERROR(status, UnregisterEventWriters());
   APPEND_STATUS_IF_ERROR(status, bcm_sdk_interface_->ShutdownAllUnits());
   initialized_ = false;  // Set to false even if there is an error
@@ -233,6 +286,7 @@ BcmChassisManager::~BcmChassisManager() {
 void BcmChassisManager::SetUnitToBcmNodeMap(
     const std::map<int, BcmNode*>& unit_to_bcm_node) {
   absl::WriterMutexLock l(&chassis_lock);
+  absl::MutexLock failover_lock(&link_down_failover_lock_);
   unit_to_bcm_node_ = unit_to_bcm_node;
 }
 
@@ -262,180 +316,113 @@ void BcmChassisManager::SetUnitToBcmNodeMap(
 
 ::util::StatusOr<BcmPort> BcmChassisManager::GetBcmPort(uint64 node_id,
                                                         uint32 port_id) const {
-  if (!initialized_) {
+  auto snapshot = GetChassisStateSnapshot();
+  if (snapshot == nullptr) {
     return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
   }
-  const auto* port_id_to_port_key =
-      gtl::FindOrNull(node_id_to_port_id_to_singleton_port_key_, node_id);
-  CHECK_RETURN_IF_FALSE(port_id_to_port_key != nullptr)
-      << "Unknown node " << node_id << ".";
-  const auto* port_key = gtl::FindOrNull(*port_id_to_port_key, port_id);
-  CHECK_RETURN_IF_FALSE(port_key != nullptr)
-      << "Unknown port " << port_id << " on node " << node_id << ".";
-  const auto* bcm_port =
-      gtl::FindPtrOrNull(singleton_port_key_to_bcm_port_, *port_key);
-  CHECK_RETURN_IF_FALSE(bcm_port != nullptr)
-      << "Unknown singleton port key: " << port_key->ToString() << ".";
-  return *bcm_port;
+
+  return snapshot->GetBcmPort(node_id, port_id);
 }
 
 ::util::StatusOr<std::map<uint64, int>> BcmChassisManager::GetNodeIdToUnitMap()
     const {
-  if (!initialized_) {
+  auto snapshot = GetChassisStateSnapshot();
+  if (snapshot == nullptr) {
     return MAKE_ERROR(ERR_NOT_INITIALIZED).without_logging()
         << "Not initialized!";
   }
 
-  return node_id_to_unit_;
+  return snapshot->node_id_to_unit;
 }
 
 ::util::StatusOr<int> BcmChassisManager::GetUnitFromNodeId(
     uint64 node_id) const {
-  if (!initialized_) {
+  auto snapshot = GetChassisStateSnapshot();
+  if (snapshot == nullptr) {
     return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
   }
-  const int* unit = gtl::FindOrNull(node_id_to_unit_, node_id);
-  CHECK_RETURN_IF_FALSE(unit != nullptr)
-      << "Node " << node_id << " is not configured or not known.";
 
-  return *unit;
+  return snapshot->GetUnitFromNodeId(node_id);
 }
 
 ::util::StatusOr<std::map<uint32, SdkPort>>
 BcmChassisManager::GetPortIdToSdkPortMap(uint64 node_id) const {
-  if (!initialized_) {
+  auto snapshot = GetChassisStateSnapshot();
+  if (snapshot == nullptr) {
     return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
   }
-  const std::map<uint32, SdkPort>* port_id_to_sdk_port =
-      gtl::FindOrNull(node_id_to_port_id_to_sdk_port_, node_id);
-  CHECK_RETURN_IF_FALSE(port_id_to_sdk_port != nullptr)
-      << "Node " << node_id << " is not configured or not known.";
 
-  return *port_id_to_sdk_port;
+  return snapshot->GetPortIdToSdkPortMap(node_id);
 }
 
 ::util::StatusOr<std::map<uint32, SdkTrunk>>
 BcmChassisManager::GetTrunkIdToSdkTrunkMap(uint64 node_id) const {
-  if (!initialized_) {
+  auto snapshot = GetChassisStateSnapshot();
+  if (snapshot == nullptr) {
     return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
   }
-  const std::map<uint32, SdkTrunk>* trunk_id_to_sdk_trunk =
-      gtl::FindOrNull(node_id_to_trunk_id_to_sdk_trunk_, node_id);
-  CHECK_RETURN_IF_FALSE(trunk_id_to_sdk_trunk != nullptr)
-      << "Node " << node_id << " is not configured or not known.";
 
-  return *trunk_id_to_sdk_trunk;
+  return snapshot->GetTrunkIdToSdkTrunkMap(node_id);
 }
 
 ::util::StatusOr<PortState> BcmChassisManager::GetPortState(
     uint64 node_id, uint32 port_id) const {
-  if (!initialized_) {
+  auto snapshot = GetChassisStateSnapshot();
+  if (snapshot == nullptr) {
     return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
   }
-  const std::map<uint32, PortState>* port_id_to_port_state =
-      gtl::FindOrNull(node_id_to_port_id_to_port_state_, node_id);
-  CHECK_RETURN_IF_FALSE(port_id_to_port_state != nullptr)
-      << "Node " << node_id << " is not configured or not known.";
-  const PortState* port_state =
-      gtl::FindOrNull(*port_id_to_port_state, port_id);
-  CHECK_RETURN_IF_FALSE(port_state != nullptr)
-      << "Port " << port_id << " is not known on node " << node_id << ".";
 
-  return *port_state;
+  return snapshot->GetPortState(node_id, port_id);
 }
 
 ::util::StatusOr<PortState> BcmChassisManager::GetPortState(
     const SdkPort& sdk_port) const {
-  if (!initialized_) {
+  auto snapshot = GetChassisStateSnapshot();
+  if (snapshot == nullptr) {
     return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
   }
 
-  auto* node_id = gtl::FindOrNull(unit_to_node_id_, sdk_port.unit);
-  CHECK_RETURN_IF_FALSE(node_id != nullptr)
-      << "Attempting to query state of port on unknown unit " << sdk_port.unit
-      << ".";
-  auto* sdk_port_to_port_id =
-      gtl::FindOrNull(node_id_to_sdk_port_to_port_id_, *node_id);
-  CHECK_RETURN_IF_FALSE(sdk_port_to_port_id != nullptr)
-      << "Inconsistent state! No sdk_port_to_port_id map for unit "
-      << sdk_port.unit << ", node " << *node_id << ".";
-  auto* port_id = gtl::FindOrNull(*sdk_port_to_port_id, sdk_port);
-  CHECK_RETURN_IF_FALSE(port_id != nullptr)
-      << "Attempting to retrieve state of unknown SDK port "
-      << sdk_port.ToString() << ".";
-  return GetPortState(*node_id, *port_id);
+  return snapshot->GetPortState(sdk_port);
 }
 
 ::util::StatusOr<TrunkState> BcmChassisManager::GetTrunkState(
     uint64 node_id, uint32 trunk_id) const {
-  if (!initialized_) {
+  auto snapshot = GetChassisStateSnapshot();
+  if (snapshot == nullptr) {
     return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
   }
-  const std::map<uint32, TrunkState>* trunk_id_to_trunk_state =
-      gtl::FindOrNull(node_id_to_trunk_id_to_trunk_state_, node_id);
-  CHECK_RETURN_IF_FALSE(trunk_id_to_trunk_state != nullptr)
-      << "Node " << node_id << " is not configured or not known.";
-  const TrunkState* trunk_state =
-      gtl::FindOrNull(*trunk_id_to_trunk_state, trunk_id);
-  CHECK_RETURN_IF_FALSE(trunk_state != nullptr)
-      << "Trunk " << trunk_id << " is not known on node " << node_id << ".";
 
-  return *trunk_state;
+  return snapshot->GetTrunkState(node_id, trunk_id);
 }
 
 ::util::StatusOr<std::set<uint32>> BcmChassisManager::GetTrunkMembers(
     uint64 node_id, uint32 trunk_id) const {
-  if (!initialized_) {
+  auto snapshot = GetChassisStateSnapshot();
+  if (snapshot == nullptr) {
     return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
   }
-  const std::map<uint32, std::set<uint32>>* trunk_id_to_members =
-      gtl::FindOrNull(node_id_to_trunk_id_to_members_, node_id);
-  CHECK_RETURN_IF_FALSE(trunk_id_to_members != nullptr)
-      << "Node " << node_id << " is not configured or not known.";
-  const std::set<uint32>* members =
-      gtl::FindOrNull(*trunk_id_to_members, trunk_id);
-  CHECK_RETURN_IF_FALSE(members != nullptr)
-      << "Trunk " << trunk_id << " is not known on node " << node_id << ".";
 
-  return *members;
+  return snapshot->GetTrunkMembers(node_id, trunk_id);
 }
 
 ::util::StatusOr<uint32> BcmChassisManager::GetParentTrunkId(
     uint64 node_id, uint32 port_id) const {
-  if (!initialized_) {
+  auto snapshot = GetChassisStateSnapshot();
+  if (snapshot == nullptr) {
     return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
   }
-  const std::map<uint32, TrunkMembershipInfo>*
-      port_id_to_trunk_membership_info = gtl::FindOrNull(
-          node_id_to_port_id_to_trunk_membership_info_, node_id);
-  CHECK_RETURN_IF_FALSE(port_id_to_trunk_membership_info != nullptr)
-      << "Node " << node_id << " is not configured or not known.";
-  const TrunkMembershipInfo* membership_info =
-      gtl::FindOrNull(*port_id_to_trunk_membership_info, port_id);
-  // We can't use CHECK_RETURN_IF_FALSE here, because we want without_logging()
-  if (membership_info == nullptr) {
-    return MAKE_ERROR(ERR_INVALID_PARAM).without_logging()
-      << "Port " << port_id
-      << " is not known or does not belong to any trunk on node " << node_id
-      << ".";
-  }
 
-  return membership_info->parent_trunk_id;
+  return snapshot->GetParentTrunkId(node_id, port_id);
 }
 
 ::util::StatusOr<AdminState> BcmChassisManager::GetPortAdminState(
     uint64 node_id, uint32 port_id) const {
-  if (!initialized_) {
+  auto snapshot = GetChassisStateSnapshot();
+  if (snapshot == nullptr) {
     return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
   }
-  const auto* port_id_to_admin_state =
-      gtl::FindOrNull(node_id_to_port_id_to_admin_state_, node_id);
-  CHECK_RETURN_IF_FALSE(port_id_to_admin_state != nullptr)
-      << "Unknown node " << node_id << ".";
-  const auto* admin_state = gtl::FindOrNull(*port_id_to_admin_state, port_id);
-  CHECK_RETURN_IF_FALSE(admin_state != nullptr)
-      << "Unknown port " << port_id << " on node " << node_id << ".";
-  return *admin_state;
+
+  return snapshot->GetPortAdminState(node_id, port_id);
 }
 
 ::util::Status BcmChassisManager::GetPortCounters(uint64 node_id,
@@ -444,11 +431,47 @@ BcmChassisManager::GetTrunkIdToSdkTrunkMap(uint64 node_id) const {
   if (!initialized_) {
     return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
   }
+  {
+    absl::MutexLock l(&port_counters_lock_);
+    const auto* port_id_to_port_counters =
+        gtl::FindOrNull(node_id_to_port_id_to_port_counters_, node_id);
+    const auto* entry = port_id_to_port_counters != nullptr
+                            ? gtl::FindOrNull(*port_id_to_port_counters,
+                                              port_id)
+                            : nullptr;
+    if (entry != nullptr &&
+        absl::Now() - entry->timestamp <=
+            absl::Milliseconds(FLAGS_bcm_port_counters_max_staleness_ms)) {
+      *pc = entry->counters;
+      return ::util::OkStatus();
+    }
+  }
   ASSIGN_OR_RETURN(auto unit, GetUnitFromNodeId(node_id));
   ASSIGN_OR_RETURN(auto bcm_port, GetBcmPort(node_id, port_id));
   return bcm_sdk_interface_->GetPortCounters(unit, bcm_port.logical_port(), pc);
 }
 
+::util::Status BcmChassisManager::GetPortCounterRates(
+    uint64 node_id, uint32 port_id, PortCounters* rates) const {
+  if (!initialized_) {
+    return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
+  }
+  absl::MutexLock l(&port_counters_lock_);
+  const auto* port_id_to_port_counters =
+      gtl::FindOrNull(node_id_to_port_id_to_port_counters_, node_id);
+  const auto* entry =
+      port_id_to_port_counters != nullptr
+          ? gtl::FindOrNull(*port_id_to_port_counters, port_id)
+          : nullptr;
+  if (entry == nullptr || !entry->has_rates) {
+    return MAKE_ERROR(ERR_ENTRY_NOT_FOUND).without_logging()
+           << "No counter rates for port " << port_id << " on node "
+           << node_id << ".";
+  }
+  *rates = entry->rates;
+  return ::util::OkStatus();
+}
+
 ::util::Status BcmChassisManager::SetTrunkMemberBlockState(
     uint64 node_id, uint32 trunk_id, uint32 port_id,
     TrunkMemberBlockState state) {
@@ -469,6 +492,184 @@ BcmChassisManager::GetTrunkIdToSdkTrunkMap(uint64 node_id) const {
   return ::util::OkStatus();
 }
 
+std::shared_ptr<const BcmChassisManager::ChassisStateSnapshot>
+BcmChassisManager::GetChassisStateSnapshot() const {
+  return std::atomic_load(&chassis_state_snapshot_);
+}
+
+const int* BcmChassisManager::ChassisStateSnapshot::FindPortHandleOrNull(
+    uint64 node_id, uint32 port_id) const {
+  return gtl::FindOrNull(config->node_id_and_port_id_to_port_handle,
+                         std::make_pair(node_id, port_id));
+}
+
+const int* BcmChassisManager::ChassisStateSnapshot::FindPortHandleOrNull(
+    const SdkPort& sdk_port) const {
+  return gtl::FindOrNull(config->sdk_port_to_port_handle, sdk_port);
+}
+
+::util::StatusOr<BcmPort>
+BcmChassisManager::ChassisStateSnapshot::GetBcmPort(uint64 node_id,
+                                                    uint32 port_id) const {
+  const int* handle = FindPortHandleOrNull(node_id, port_id);
+  if (handle == nullptr) {
+    CHECK_RETURN_IF_FALSE(config->node_id_to_port_ids.count(node_id))
+        << "Unknown node " << node_id << ".";
+  }
+  CHECK_RETURN_IF_FALSE(handle != nullptr)
+      << "Unknown port " << port_id << " on node " << node_id << ".";
+
+  return config->ports[*handle].bcm_port;
+}
+
+::util::StatusOr<int>
+BcmChassisManager::ChassisStateSnapshot::GetUnitFromNodeId(
+    uint64 node_id) const {
+  const int* unit = gtl::FindOrNull(config->node_id_to_unit, node_id);
+  CHECK_RETURN_IF_FALSE(unit != nullptr)
+      << "Node " << node_id << " is not configured or not known.";
+
+  return *unit;
+}
+
+::util::StatusOr<std::map<uint32, SdkPort>>
+BcmChassisManager::ChassisStateSnapshot::GetPortIdToSdkPortMap(
+    uint64 node_id) const {
+  const std::set<uint32>* port_ids =
+      gtl::FindOrNull(config->node_id_to_port_ids, node_id);
+  CHECK_RETURN_IF_FALSE(port_ids != nullptr)
+      << "Node " << node_id << " is not configured or not known.";
+  std::map<uint32, SdkPort> port_id_to_sdk_port;
+  for (uint32 port_id : *port_ids) {
+    const int* handle = FindPortHandleOrNull(node_id, port_id);
+    if (handle != nullptr) {
+      port_id_to_sdk_port[port_id] = config->ports[*handle].sdk_port;
+    }
+  }
+
+  return port_id_to_sdk_port;
+}
+
+::util::StatusOr<std::map<uint32, SdkTrunk>>
+BcmChassisManager::ChassisStateSnapshot::GetTrunkIdToSdkTrunkMap(
+    uint64 node_id) const {
+  const std::map<uint32, SdkTrunk>* trunk_id_to_sdk_trunk =
+      gtl::FindOrNull(config->node_id_to_trunk_id_to_sdk_trunk, node_id);
+  CHECK_RETURN_IF_FALSE(trunk_id_to_sdk_trunk != nullptr)
+      << "Node " << node_id << " is not configured or not known.";
+
+  return *trunk_id_to_sdk_trunk;
+}
+
+::util::StatusOr<PortState>
+BcmChassisManager::ChassisStateSnapshot::GetPortState(uint64 node_id,
+                                                      uint32 port_id) const {
+  const int* handle = FindPortHandleOrNull(node_id, port_id);
+  if (handle == nullptr) {
+    CHECK_RETURN_IF_FALSE(config->node_id_to_port_ids.count(node_id))
+        << "Node " << node_id << " is not configured or not known.";
+  }
+  CHECK_RETURN_IF_FALSE(handle != nullptr)
+      << "Port " << port_id << " is not known on node " << node_id << ".";
+
+  return port_states[*handle];
+}
+
+::util::StatusOr<PortState>
+BcmChassisManager::ChassisStateSnapshot::GetPortState(
+    const SdkPort& sdk_port) const {
+  const int* handle = FindPortHandleOrNull(sdk_port);
+  if (handle == nullptr) {
+    CHECK_RETURN_IF_FALSE(config->unit_to_node_id.count(sdk_port.unit))
+        << "Attempting to query state of port on unknown unit "
+        << sdk_port.unit << ".";
+  }
+  CHECK_RETURN_IF_FALSE(handle != nullptr)
+      << "Attempting to retrieve state of unknown SDK port "
+      << sdk_port.ToString() << ".";
+
+  return port_states[*handle];
+}
+
+::util::StatusOr<TrunkState>
+BcmChassisManager::ChassisStateSnapshot::GetTrunkState(uint64 node_id,
+                                                       uint32 trunk_id) const {
+  const std::map<uint32, TrunkState>* trunk_id_to_trunk_state =
+      gtl::FindOrNull(config->node_id_to_trunk_id_to_trunk_state, node_id);
+  CHECK_RETURN_IF_FALSE(trunk_id_to_trunk_state != nullptr)
+      << "Node " << node_id << " is not configured or not known.";
+  const TrunkState* trunk_state =
+      gtl::FindOrNull(*trunk_id_to_trunk_state, trunk_id);
+  CHECK_RETURN_IF_FALSE(trunk_state != nullptr)
+      << "Trunk " << trunk_id << " is not known on node " << node_id << ".";
+
+  return *trunk_state;
+}
+
+::util::StatusOr<std::set<uint32>>
+BcmChassisManager::ChassisStateSnapshot::GetTrunkMembers(
+    uint64 node_id, uint32 trunk_id) const {
+  const std::map<uint32, std::set<uint32>>* trunk_id_to_members =
+      gtl::FindOrNull(config->node_id_to_trunk_id_to_members, node_id);
+  CHECK_RETURN_IF_FALSE(trunk_id_to_members != nullptr)
+      << "Node " << node_id << " is not configured or not known.";
+  const std::set<uint32>* members =
+      gtl::FindOrNull(*trunk_id_to_members, trunk_id);
+  CHECK_RETURN_IF_FALSE(members != nullptr)
+      << "Trunk " << trunk_id << " is not known on node " << node_id << ".";
+
+  return *members;
+}
+
+::util::StatusOr<uint32>
+BcmChassisManager::ChassisStateSnapshot::GetParentTrunkId(
+    uint64 node_id, uint32 port_id) const {
+  const int* handle = FindPortHandleOrNull(node_id, port_id);
+  if (handle == nullptr) {
+    CHECK_RETURN_IF_FALSE(config->node_id_to_port_ids.count(node_id))
+        << "Node " << node_id << " is not configured or not known.";
+  }
+  // We can't use CHECK_RETURN_IF_FALSE here, because we want without_logging()
+  if (handle == nullptr || !config->ports[*handle].has_parent_trunk) {
+    return MAKE_ERROR(ERR_INVALID_PARAM).without_logging()
+      << "Port " << port_id
+      << " is not known or does not belong to any trunk on node " << node_id
+      << ".";
+  }
+
+  return config->ports[*handle].parent_trunk_id;
+}
+
+::util::StatusOr<AdminState>
+BcmChassisManager::ChassisStateSnapshot::GetPortAdminState(
+    uint64 node_id, uint32 port_id) const {
+  const int* handle = FindPortHandleOrNull(node_id, port_id);
+  if (handle == nullptr) {
+    CHECK_RETURN_IF_FALSE(config->node_id_to_port_ids.count(node_id))
+        << "Unknown node " << node_id << ".";
+  }
+  CHECK_RETURN_IF_FALSE(handle != nullptr)
+      << "Unknown port " << port_id << " on node " << node_id << ".";
+
+  return admin_states[*handle];
+}
+
+std::string BcmChassisManager::LinkDownFailoverStats::ToString() const {
+  return absl::StrCat(
+      "events: ", events, ", failures: ", failures,
+      ", max latency: ", absl::FormatDuration(max_latency), ", avg latency: ",
+      absl::FormatDuration(events
+                               ? total_latency / static_cast<int64>(events)
+                               : absl::ZeroDuration()),
+      ", last latency: ", absl::FormatDuration(last_latency));
+}
+
+BcmChassisManager::LinkDownFailoverStats
+BcmChassisManager::GetLinkDownFailoverStats() const {
+  absl::MutexLock l(&link_down_failover_lock_);
+  return link_down_failover_stats_;
+}
+
 std::unique_ptr<BcmChassisManager> BcmChassisManager::CreateInstance(
     OperationMode mode, PhalInterface* phal_interface,
     BcmSdkInterface* bcm_sdk_interface,
@@ -479,6 +680,29 @@ std::unique_ptr<BcmChassisManager> BcmChassisManager::CreateInstance(
 
 namespace {
 
+// Sets every counter in 'rates' to its per-second rate of change from 'prev'
+// to 'cur', which were read 'seconds' apart. A counter that went backwards
+// (e.g. because it was cleared) gets a rate of 0.
+void ComputePortCounterRates(const PortCounters& prev, const PortCounters& cur,
+                             double seconds, PortCounters* rates) {
+  using ::google::protobuf::FieldDescriptor;
+  const auto* descriptor = cur.GetDescriptor();
+  const auto* reflection = cur.GetReflection();
+  for (int i = 0; i < descriptor->field_count(); ++i) {
+    const FieldDescriptor* field = descriptor->field(i);
+    if (field->is_repeated() ||
+        field->cpp_type() != FieldDescriptor::CPPTYPE_UINT64) {
+      continue;
+    }
+    uint64 prev_value = reflection->GetUInt64(prev, field);
+    uint64 cur_value = reflection->GetUInt64(cur, field);
+    uint64 rate = cur_value >= prev_value
+                      ? static_cast<uint64>((cur_value - prev_value) / seconds)
+                      : 0;
+    reflection->SetUInt64(rates, field, rate);
+  }
+}
+
 // A helper method that checks whether a given BcmPort belong to a BcmChip of
 // type TRIDENT_PLUS and is a GE port.
 bool IsGePortOnTridentPlus(const BcmPort& bcm_port,
@@ -1032,23 +1256,45 @@ bool IsGePortOnTridentPlus(const BcmPort& bcm_port,
       FLAGS_bcm_sdk_config_file, FLAGS_bcm_sdk_config_flush_file,
       FLAGS_bcm_sdk_shell_log_file));
 
-  // Attach all the units. Note that we keep the things simple. We will move
-  // forward iff all the units are attched successfully.
+  // Attach all the units and initialize all their ports (flex or not). The
+  // units do not depend on each other at this point, so they are brought up in
+  // parallel and the cold boot takes as long as the slowest unit. Note that we
+  // keep the things simple. We will move forward iff all the units are
+  // attached and all the ports are initialized successfully.
+  std::map<int, const BcmChip*> unit_to_bcm_chip;
+  std::map<int, std::vector<int>> unit_to_logical_ports;
   for (const auto& bcm_chip : target_bcm_chassis_map.bcm_chips()) {
-    RETURN_IF_ERROR(
-        bcm_sdk_interface_->FindUnit(bcm_chip.unit(), bcm_chip.pci_bus(),
-                                     bcm_chip.pci_slot(), bcm_chip.type()));
-    RETURN_IF_ERROR(bcm_sdk_interface_->InitializeUnit(bcm_chip.unit(),
-                                                       /*warm_boot=*/false));
-    RETURN_IF_ERROR(
-        bcm_sdk_interface_->SetModuleId(bcm_chip.unit(), bcm_chip.module()));
+    unit_to_bcm_chip[bcm_chip.unit()] = &bcm_chip;
+    unit_to_logical_ports[bcm_chip.unit()];
   }
-
-  // Initialize all the ports (flex or not).
   for (const auto& bcm_port : target_bcm_chassis_map.bcm_ports()) {
-    RETURN_IF_ERROR(bcm_sdk_interface_->InitializePort(
-        bcm_port.unit(), bcm_port.logical_port()));
-  }
+    unit_to_logical_ports[bcm_port.unit()].push_back(bcm_port.logical_port());
+  }
+  std::vector<int> units;
+  for (const auto& e : unit_to_logical_ports) units.push_back(e.first);
+  // The workers are not annotated as holding chassis_lock, but the caller of
+  // InitializeBcmChips() holds it until RunForEachUnit() returns, i.e. until
+  // all the workers are done.
+  RETURN_IF_ERROR(RunForEachUnit(
+      "Unit initialization", units,
+      [this, &unit_to_bcm_chip, &unit_to_logical_ports](int unit)
+          NO_THREAD_SAFETY_ANALYSIS -> ::util::Status {
+        const BcmChip* bcm_chip = gtl::FindPtrOrNull(unit_to_bcm_chip, unit);
+        if (bcm_chip != nullptr) {
+          RETURN_IF_ERROR(bcm_sdk_interface_->FindUnit(
+              unit, bcm_chip->pci_bus(), bcm_chip->pci_slot(),
+              bcm_chip->type()));
+          RETURN_IF_ERROR(
+              bcm_sdk_interface_->InitializeUnit(unit, /*warm_boot=*/false));
+          RETURN_IF_ERROR(
+              bcm_sdk_interface_->SetModuleId(unit, bcm_chip->module()));
+        }
+        for (int logical_port : unit_to_logical_ports.at(unit)) {
+          RETURN_IF_ERROR(
+              bcm_sdk_interface_->InitializePort(unit, logical_port));
+        }
+        return ::util::OkStatus();
+      }));
 
   // Start the diag thread.
   RETURN_IF_ERROR(bcm_sdk_interface_->StartDiagShellServer());
@@ -1112,14 +1358,10 @@ bool IsGePortOnTridentPlus(const BcmPort& bcm_port,
   unit_to_node_id_.clear();
   node_id_to_port_ids_.clear();
   node_id_to_trunk_ids_.clear();
-  node_id_to_port_id_to_singleton_port_key_.clear();
-  node_id_to_port_id_to_sdk_port_.clear();
   node_id_to_trunk_id_to_sdk_trunk_.clear();
-  node_id_to_sdk_port_to_port_id_.clear();
   node_id_to_sdk_trunk_to_trunk_id_.clear();
   node_id_to_trunk_id_to_trunk_state_.clear();
   node_id_to_trunk_id_to_members_.clear();
-  node_id_to_port_id_to_trunk_membership_info_.clear();
 
   // Initialize the maps that have node ID as key, i.e. node_id_to_unit_,
   // node_id_to_port_ids_, node_id_to_trunk_ids_, etc.
@@ -1127,14 +1369,10 @@ bool IsGePortOnTridentPlus(const BcmPort& bcm_port,
     node_id_to_unit_[node.id()] = -1;
     node_id_to_port_ids_[node.id()] = {};
     node_id_to_trunk_ids_[node.id()] = {};
-    node_id_to_port_id_to_singleton_port_key_[node.id()] = {};
-    node_id_to_port_id_to_sdk_port_[node.id()] = {};
     node_id_to_trunk_id_to_sdk_trunk_[node.id()] = {};
-    node_id_to_sdk_port_to_port_id_[node.id()] = {};
     node_id_to_sdk_trunk_to_trunk_id_[node.id()] = {};
     node_id_to_trunk_id_to_trunk_state_[node.id()] = {};
     node_id_to_trunk_id_to_members_[node.id()] = {};
-    node_id_to_port_id_to_trunk_membership_info_[node.id()] = {};
   }
 
   // Now populate unit_to_bcm_chip_. The nodes are already in
@@ -1147,13 +1385,10 @@ bool IsGePortOnTridentPlus(const BcmPort& bcm_port,
 
   // Now populate port-related maps.
 
-  // Temporary maps to hold the port state, admin state, and health state.
-  std::map<uint64, std::map<uint32, PortState>>
-      tmp_node_id_to_port_id_to_port_state;
-  std::map<uint64, std::map<uint32, AdminState>>
-      tmp_node_id_to_port_id_to_admin_state;
-  std::map<uint64, std::map<uint32, HealthState>>
-      tmp_node_id_to_port_id_to_health_state;
+  // The new port records. The old ones are kept until all the ports are
+  // processed, to carry over the state of the ports already known.
+  std::vector<PortRecord> port_records;
+  port_records.reserve(config.singleton_ports_size());
   ::util::Status error = ::util::OkStatus();  // errors to keep track of.
   for (const auto& singleton_port : config.singleton_ports()) {
     for (const auto& bcm_port : base_bcm_chassis_map_->bcm_ports()) {
@@ -1192,11 +1427,12 @@ bool IsGePortOnTridentPlus(const BcmPort& bcm_port,
         node_id_to_unit_[node_id] = p->unit();
         unit_to_node_id_[p->unit()] = node_id;
         node_id_to_port_ids_[node_id].insert(port_id);
-        node_id_to_port_id_to_singleton_port_key_[node_id][port_id] =
-            singleton_port_key;
         SdkPort sdk_port(p->unit(), p->logical_port());
-        node_id_to_port_id_to_sdk_port_[node_id][port_id] = sdk_port;
-        node_id_to_sdk_port_to_port_id_[node_id][sdk_port] = port_id;
+        PortRecord record;
+        record.node_id = node_id;
+        record.port_id = port_id;
+        record.singleton_port_key = singleton_port_key;
+        record.sdk_port = sdk_port;
         PortKey xcvr_port_key(singleton_port.slot(), singleton_port.port());
         CHECK_RETURN_IF_FALSE(xcvr_port_key_to_xcvr_state_.count(xcvr_port_key))
             << "Something is wrong. ChassisConfig contains a (slot, port) "
@@ -1208,48 +1444,30 @@ bool IsGePortOnTridentPlus(const BcmPort& bcm_port,
         } else {
           port_group_key_to_non_flex_bcm_ports_[xcvr_port_key].push_back(p);
         }
-        // If (node_id, port_id) already exists as a key in any of
-        // node_id_to_port_id_to_{port,health}_state_, we keep the state as is.
-        // Otherwise, we assume this is the first time we are seeing this port
-        // and set the state to unknown.
-        const PortState* port_state = gtl::FindOrNull(
-            node_id_to_port_id_to_port_state_[node_id], port_id);
-        if (port_state != nullptr) {
-          tmp_node_id_to_port_id_to_port_state[node_id][port_id] = *port_state;
-        } else {
-          tmp_node_id_to_port_id_to_port_state[node_id][port_id] =
-              PORT_STATE_UNKNOWN;
-        }
-        const HealthState* health_state = gtl::FindOrNull(
-            node_id_to_port_id_to_health_state_[node_id], port_id);
-        if (health_state != nullptr) {
-          tmp_node_id_to_port_id_to_health_state[node_id][port_id] =
-              *health_state;
-        } else {
-          tmp_node_id_to_port_id_to_health_state[node_id][port_id] =
-              HEALTH_STATE_UNKNOWN;
+        // If (node_id, port_id) is already known, we keep its port state and
+        // health state as is. Otherwise, we assume this is the first time we
+        // are seeing this port and keep the states unknown.
+        const PortRecord* old_record = FindPortRecordOrNull(node_id, port_id);
+        if (old_record != nullptr) {
+          record.port_state = old_record->port_state;
+          record.health_state = old_record->health_state;
         }
         // For the admin state, the admin state specified in the config
         // overrides the previous admin state. But if there is no valid admin
-        // state specified for the port in the confing and there is already an
-        // admin state for the port in node_id_to_port_id_to_admin_state_, we
-        // keep the state as is.
+        // state specified for the port in the confing and the port is already
+        // known, we keep the state as is.
         AdminState new_admin_state =
             singleton_port.config_params().admin_state();
-        const AdminState* old_admin_state = gtl::FindOrNull(
-            node_id_to_port_id_to_admin_state_[node_id], port_id);
-        if (old_admin_state != nullptr) {
-          // The port already exists as a key in the map. If the new config
-          // does not have a valid admin state, keep the old state. Otherwise,
-          // save the new state and if there is a change in the state (old vs
-          // new), enable/disable the port accordingly.
+        if (old_record != nullptr) {
+          // The port is already known. If the new config does not have a
+          // valid admin state, keep the old state. Otherwise, save the new
+          // state and if there is a change in the state (old vs new),
+          // enable/disable the port accordingly.
           if (new_admin_state == ADMIN_STATE_UNKNOWN) {
-            tmp_node_id_to_port_id_to_admin_state[node_id][port_id] =
-                *old_admin_state;
+            record.admin_state = old_record->admin_state;
           } else {
-            tmp_node_id_to_port_id_to_admin_state[node_id][port_id] =
-                new_admin_state;
-            if (new_admin_state != *old_admin_state) {
+            record.admin_state = new_admin_state;
+            if (new_admin_state != old_record->admin_state) {
               APPEND_STATUS_IF_ERROR(
                   error,
                   EnablePort(sdk_port, new_admin_state == ADMIN_STATE_ENABLED));
@@ -1258,21 +1476,19 @@ bool IsGePortOnTridentPlus(const BcmPort& bcm_port,
         } else {
           // First time we are seeing the port. Need to honor the state
           // specified in the config and enbale/disable the port accordingly.
-          tmp_node_id_to_port_id_to_admin_state[node_id][port_id] =
-              new_admin_state;
+          record.admin_state = new_admin_state;
           if (new_admin_state != ADMIN_STATE_UNKNOWN) {
             APPEND_STATUS_IF_ERROR(
                 error,
                 EnablePort(sdk_port, new_admin_state == ADMIN_STATE_ENABLED));
           }
         }
+        port_records.push_back(record);
         break;
       }
     }
   }
-  node_id_to_port_id_to_port_state_ = tmp_node_id_to_port_id_to_port_state;
-  node_id_to_port_id_to_admin_state_ = tmp_node_id_to_port_id_to_admin_state;
-  node_id_to_port_id_to_health_state_ = tmp_node_id_to_port_id_to_health_state;
+  SetPortRecords(std::move(port_records));
 
   // Finally populate trunk-related maps.
   for (const auto& trunk_port : config.trunk_ports()) {
@@ -1431,6 +1647,13 @@ bool IsGePortOnTridentPlus(const BcmPort& bcm_port,
     }
   }
   // Then continue with port options.
+  APPEND_STATUS_IF_ERROR(status, ConfigurePendingPortGroups());
+
+  return status;
+}
+
+::util::Status BcmChassisManager::ConfigurePendingPortGroups() {
+  ::util::Status status = ::util::OkStatus();
   for (auto& e : xcvr_port_key_to_xcvr_state_) {
     if (e.second != HW_STATE_READY) {
       BcmPortOptions options;
@@ -1453,6 +1676,115 @@ bool IsGePortOnTridentPlus(const BcmPort& bcm_port,
   return status;
 }
 
+BcmChassisManager::ChassisConfigDiff BcmChassisManager::DiffChassisConfig(
+    const ChassisConfig& old_config, const ChassisConfig& new_config) {
+  ChassisConfigDiff diff;
+
+  // Nodes.
+  std::map<uint64, const Node*> old_nodes;
+  for (const auto& node : old_config.nodes()) old_nodes[node.id()] = &node;
+  for (const auto& node : new_config.nodes()) {
+    auto it = old_nodes.find(node.id());
+    if (it == old_nodes.end() || !ProtoEqual(*it->second, node)) {
+      diff.changed_node_ids.insert(node.id());
+    }
+    if (it != old_nodes.end()) old_nodes.erase(it);
+  }
+  for (const auto& e : old_nodes) diff.changed_node_ids.insert(e.first);
+
+  // Singleton ports. A port is identified by (node ID, port ID). The changes
+  // in the config params, the flow params or the name of a port do not affect
+  // the port maps or the port groups.
+  std::map<std::pair<uint64, uint32>, const SingletonPort*> old_ports;
+  for (const auto& singleton_port : old_config.singleton_ports()) {
+    old_ports[std::make_pair(singleton_port.node(), singleton_port.id())] =
+        &singleton_port;
+  }
+  for (const auto& singleton_port : new_config.singleton_ports()) {
+    auto key = std::make_pair(singleton_port.node(), singleton_port.id());
+    auto it = old_ports.find(key);
+    if (it == old_ports.end()) {
+      diff.changed_singleton_ports.insert(key);
+      diff.full_sync_required = true;
+      continue;
+    }
+    const SingletonPort& old_port = *it->second;
+    old_ports.erase(it);
+    if (ProtoEqual(old_port, singleton_port)) continue;
+    diff.changed_singleton_ports.insert(key);
+    if (old_port.slot() != singleton_port.slot() ||
+        old_port.port() != singleton_port.port() ||
+        old_port.channel() != singleton_port.channel() ||
+        old_port.speed_bps() != singleton_port.speed_bps()) {
+      diff.full_sync_required = true;
+    } else if (!ProtoEqual(old_port.config_params(),
+                           singleton_port.config_params())) {
+      diff.updated_singleton_ports.push_back(&singleton_port);
+    }
+  }
+  for (const auto& e : old_ports) {
+    diff.changed_singleton_ports.insert(e.first);
+    diff.full_sync_required = true;
+  }
+
+  // Trunk ports.
+  std::map<std::pair<uint64, uint32>, const TrunkPort*> old_trunks;
+  for (const auto& trunk_port : old_config.trunk_ports()) {
+    old_trunks[std::make_pair(trunk_port.node(), trunk_port.id())] =
+        &trunk_port;
+  }
+  for (const auto& trunk_port : new_config.trunk_ports()) {
+    auto key = std::make_pair(trunk_port.node(), trunk_port.id());
+    auto it = old_trunks.find(key);
+    if (it == old_trunks.end() || !ProtoEqual(*it->second, trunk_port)) {
+      diff.changed_trunk_ports.insert(key);
+    }
+    if (it != old_trunks.end()) old_trunks.erase(it);
+  }
+  for (const auto& e : old_trunks) diff.changed_trunk_ports.insert(e.first);
+
+  if (!diff.changed_node_ids.empty() || !diff.changed_trunk_ports.empty()) {
+    diff.full_sync_required = true;
+  }
+  if (!diff.full_sync_required) {
+    // Everything else in the config (chassis, vendor config, etc.).
+    ChassisConfig old_rest = old_config, new_rest = new_config;
+    for (auto* rest : {&old_rest, &new_rest}) {
+      rest->clear_nodes();
+      rest->clear_singleton_ports();
+      rest->clear_trunk_ports();
+    }
+    diff.full_sync_required = !ProtoEqual(old_rest, new_rest);
+  }
+
+  return diff;
+}
+
+::util::Status BcmChassisManager::UpdateSingletonPorts(
+    const std::vector<const SingletonPort*>& singleton_ports) {
+  ::util::Status error = ::util::OkStatus();  // errors to keep track of.
+  for (const auto* singleton_port : singleton_ports) {
+    PortRecord* record =
+        FindPortRecordOrNull(singleton_port->node(), singleton_port->id());
+    CHECK_RETURN_IF_FALSE(record != nullptr)
+        << "Inconsistent state. Unknown SingletonPort "
+        << PrintSingletonPort(*singleton_port) << ".";
+    // Same as in SyncInternalState(), the admin state specified in the config
+    // overrides the previous admin state, unless it is not valid.
+    AdminState new_admin_state = singleton_port->config_params().admin_state();
+    if (new_admin_state == ADMIN_STATE_UNKNOWN) continue;
+    if (record->admin_state == new_admin_state) continue;
+    // The admin state is only recorded once it is applied, so that the next
+    // push retries the ports that failed.
+    ::util::Status status =
+        EnablePort(record->sdk_port, new_admin_state == ADMIN_STATE_ENABLED);
+    if (status.ok()) record->admin_state = new_admin_state;
+    APPEND_STATUS_IF_ERROR(error, status);
+  }
+
+  return error;
+}
+
 void BcmChassisManager::CleanupInternalState() {
   gtl::STLDeleteValues(&unit_to_bcm_chip_);
   gtl::STLDeleteValues(&singleton_port_key_to_bcm_port_);
@@ -1462,20 +1794,119 @@ void BcmChassisManager::CleanupInternalState() {
   unit_to_node_id_.clear();
   node_id_to_port_ids_.clear();
   node_id_to_trunk_ids_.clear();
-  node_id_to_port_id_to_singleton_port_key_.clear();
-  node_id_to_port_id_to_sdk_port_.clear();
+  SetPortRecords({});
   node_id_to_trunk_id_to_sdk_trunk_.clear();
-  node_id_to_sdk_port_to_port_id_.clear();
   node_id_to_sdk_trunk_to_trunk_id_.clear();
   xcvr_port_key_to_xcvr_state_.clear();
-  node_id_to_port_id_to_port_state_.clear();
   node_id_to_trunk_id_to_trunk_state_.clear();
   node_id_to_trunk_id_to_members_.clear();
-  node_id_to_port_id_to_trunk_membership_info_.clear();
-  node_id_to_port_id_to_admin_state_.clear();
-  node_id_to_port_id_to_health_state_.clear();
   base_bcm_chassis_map_ = nullptr;
   applied_bcm_chassis_map_ = nullptr;
+  applied_config_ = nullptr;
+  {
+    absl::MutexLock l(&port_counters_lock_);
+    node_id_to_port_id_to_port_counters_.clear();
+  }
+  std::atomic_store(&chassis_state_snapshot_,
+                    std::shared_ptr<const ChassisStateSnapshot>());
+  chassis_config_state_ = nullptr;
+}
+
+const BcmChassisManager::PortRecord* BcmChassisManager::FindPortRecordOrNull(
+    uint64 node_id, uint32 port_id) const {
+  const int* handle = gtl::FindOrNull(node_id_and_port_id_to_port_handle_,
+                                      std::make_pair(node_id, port_id));
+  return handle != nullptr ? &port_records_[*handle] : nullptr;
+}
+
+BcmChassisManager::PortRecord* BcmChassisManager::FindPortRecordOrNull(
+    uint64 node_id, uint32 port_id) {
+  const int* handle = gtl::FindOrNull(node_id_and_port_id_to_port_handle_,
+                                      std::make_pair(node_id, port_id));
+  return handle != nullptr ? &port_records_[*handle] : nullptr;
+}
+
+const BcmChassisManager::PortRecord* BcmChassisManager::FindPortRecordOrNull(
+    const SdkPort& sdk_port) const {
+  const int* handle = gtl::FindOrNull(sdk_port_to_port_handle_, sdk_port);
+  return handle != nullptr ? &port_records_[*handle] : nullptr;
+}
+
+BcmChassisManager::PortRecord* BcmChassisManager::FindPortRecordOrNull(
+    const SdkPort& sdk_port) {
+  const int* handle = gtl::FindOrNull(sdk_port_to_port_handle_, sdk_port);
+  return handle != nullptr ? &port_records_[*handle] : nullptr;
+}
+
+void BcmChassisManager::SetPortRecords(std::vector<PortRecord> port_records) {
+  port_records_ = std::move(port_records);
+  node_id_and_port_id_to_port_handle_.clear();
+  sdk_port_to_port_handle_.clear();
+  node_id_and_port_id_to_port_handle_.reserve(port_records_.size());
+  sdk_port_to_port_handle_.reserve(port_records_.size());
+  for (int handle = 0; handle < static_cast<int>(port_records_.size());
+       ++handle) {
+    const PortRecord& record = port_records_[handle];
+    node_id_and_port_id_to_port_handle_[std::make_pair(record.node_id,
+                                                       record.port_id)] =
+        handle;
+    sdk_port_to_port_handle_[record.sdk_port] = handle;
+  }
+}
+
+void BcmChassisManager::PublishChassisStateSnapshot(bool config_changed) {
+  std::shared_ptr<const ChassisStateSnapshot> published;
+  if (!initialized_) {
+    chassis_config_state_ = nullptr;
+  } else {
+    if (config_changed || chassis_config_state_ == nullptr) {
+      auto config = std::make_shared<ChassisStateSnapshot::ConfigState>();
+      config->node_id_to_unit = node_id_to_unit_;
+      config->unit_to_node_id = unit_to_node_id_;
+      config->node_id_to_port_ids = node_id_to_port_ids_;
+      config->ports.resize(port_records_.size());
+      for (size_t handle = 0; handle < port_records_.size(); ++handle) {
+        const PortRecord& record = port_records_[handle];
+        ChassisStateSnapshot::Port& port = config->ports[handle];
+        port.node_id = record.node_id;
+        port.port_id = record.port_id;
+        const BcmPort* bcm_port = gtl::FindPtrOrNull(
+            singleton_port_key_to_bcm_port_, record.singleton_port_key);
+        if (bcm_port != nullptr) {
+          port.bcm_port = *bcm_port;
+        } else {
+          LOG(ERROR) << "Inconsistent state. "
+                     << record.singleton_port_key.ToString()
+                     << " is not found as key in "
+                     << "singleton_port_key_to_bcm_port_!";
+        }
+        port.sdk_port = record.sdk_port;
+        port.has_parent_trunk = record.has_trunk_membership_info;
+        port.parent_trunk_id = record.trunk_membership_info.parent_trunk_id;
+      }
+      // The handles are the same as in port_records_.
+      config->node_id_and_port_id_to_port_handle =
+          node_id_and_port_id_to_port_handle_;
+      config->sdk_port_to_port_handle = sdk_port_to_port_handle_;
+      config->node_id_to_trunk_id_to_sdk_trunk =
+          node_id_to_trunk_id_to_sdk_trunk_;
+      config->node_id_to_trunk_id_to_trunk_state =
+          node_id_to_trunk_id_to_trunk_state_;
+      config->node_id_to_trunk_id_to_members = node_id_to_trunk_id_to_members_;
+      chassis_config_state_ = std::move(config);
+    }
+    auto snapshot = std::make_shared<ChassisStateSnapshot>();
+    snapshot->version = ++chassis_state_version_;
+    snapshot->config = chassis_config_state_;
+    snapshot->port_states.reserve(port_records_.size());
+    snapshot->admin_states.reserve(port_records_.size());
+    for (const PortRecord& record : port_records_) {
+      snapshot->port_states.push_back(record.port_state);
+      snapshot->admin_states.push_back(record.admin_state);
+    }
+    published = std::move(snapshot);
+  }
+  std::atomic_store(&chassis_state_snapshot_, published);
 }
 
 ::util::Status BcmChassisManager::ReadBaseBcmChassisMapFromFile(
@@ -1671,92 +2102,139 @@ void* BcmChassisManager::ReadLinkscanEvents(
       LOG(ERROR) << "Read with infinite timeout failed with ENTRY_NOT_FOUND.";
       continue;
     }
-    // Handle received message.
-    LinkscanEventHandler(event.unit, event.port, event.state);
+    // Handle the received message together with whatever else got queued
+    // meanwhile, e.g. during a link flap.
+    std::vector<LinkscanEvent> events = {event};
+    std::vector<LinkscanEvent> queued_events;
+    if (reader->ReadAll(&queued_events).ok()) {
+      events.insert(events.end(), queued_events.begin(), queued_events.end());
+    }
+    HandleLinkscanEvents(events);
   } while (true);
   return nullptr;
 }
 
+void BcmChassisManager::PruneDownPortFromMultipathGroups(
+    int unit, int logical_port, absl::Time event_time) {
+  BcmNode* bcm_node = nullptr;
+  {
+    absl::MutexLock l(&link_down_failover_lock_);
+    bcm_node = gtl::FindPtrOrNull(unit_to_bcm_node_, unit);
+  }
+  if (bcm_node == nullptr) return;
+  ::util::Status status = bcm_node->PrunePortFromMultipathGroups(logical_port);
+  absl::Duration latency = absl::Now() - event_time;
+  if (!status.ok()) {
+    LOG(ERROR) << "Failed to prune logical port " << logical_port
+               << " on unit " << unit
+               << " from the multipath groups: " << status << ".";
+  } else {
+    VLOG(1) << "Pruned logical port " << logical_port << " on unit " << unit
+            << " from the multipath groups "
+            << absl::FormatDuration(latency) << " after it went down.";
+  }
+  absl::MutexLock l(&link_down_failover_lock_);
+  LinkDownFailoverStats& stats = link_down_failover_stats_;
+  ++stats.events;
+  if (!status.ok()) ++stats.failures;
+  stats.total_latency += latency;
+  stats.max_latency = std::max(stats.max_latency, latency);
+  stats.last_latency = latency;
+}
+
 void BcmChassisManager::LinkscanEventHandler(int unit, int logical_port,
-                                             PortState new_state) {
+                                             PortState new_state,
+                                             absl::Time event_time) {
+  LinkscanEvent event;
+  event.unit = unit;
+  event.port = logical_port;
+  event.state = new_state;
+  event.timestamp = event_time;
+  HandleLinkscanEvents({event});
+}
+
+void BcmChassisManager::HandleLinkscanEvents(
+    const std::vector<LinkscanEvent>& events) {
+  // Failover first. The multipath groups are reconciled with the state of the
+  // node in UpdatePortState() below, once chassis_lock is acquired.
+  for (const auto& event : events) {
+    if (event.state != PORT_STATE_UP) {
+      PruneDownPortFromMultipathGroups(event.unit, event.port,
+                                       event.timestamp);
+    }
+  }
+
   absl::WriterMutexLock l(&chassis_lock);
   if (shutdown) {
     VLOG(1) << "The class is already shutdown. Exiting.";
     return;
   }
 
-  // Update the state.
-  const uint64* node_id = gtl::FindOrNull(unit_to_node_id_, unit);
-  if (node_id == nullptr) {
-    LOG(ERROR) << "Inconsistent state. Unit " << unit << " is not known!";
-    return;
-  }
-  const std::map<SdkPort, uint32>* sdk_port_to_port_id =
-      gtl::FindOrNull(node_id_to_sdk_port_to_port_id_, *node_id);
-  if (sdk_port_to_port_id == nullptr) {
-    LOG(ERROR) << "Inconsistent state. Node " << *node_id
-               << " is not found as key in node_id_to_sdk_port_to_port_id_!";
-    return;
-  }
-  SdkPort sdk_port(unit, logical_port);
-  const uint32* port_id = gtl::FindOrNull(*sdk_port_to_port_id, sdk_port);
-  if (port_id == nullptr) {
-    LOG(WARNING)
-        << "Ignored an unknown SdkPort " << sdk_port.ToString() << " on node "
-        << *node_id
-        << ". Most probably this is a non-configured channel of a flex port.";
-    return;
-  }
-  node_id_to_port_id_to_port_state_[*node_id][*port_id] = new_state;
+  // Update the state of all the ports first, and publish it once, so that
+  // the managers notified below already see the new state of the ports.
+  std::vector<std::pair<const LinkscanEvent*, int>> updated_ports;
+  for (const auto& event : events) {
+    SdkPort sdk_port(event.unit, event.port);
+    PortRecord* record = FindPortRecordOrNull(sdk_port);
+    if (record == nullptr) {
+      const uint64* node_id = gtl::FindOrNull(unit_to_node_id_, event.unit);
+      if (node_id == nullptr) {
+        LOG(ERROR) << "Inconsistent state. Unit " << event.unit
+                   << " is not known!";
+        continue;
+      }
+      LOG(WARNING)
+          << "Ignored an unknown SdkPort " << sdk_port.ToString()
+          << " on node " << *node_id
+          << ". Most probably this is a non-configured channel of a flex port.";
+      continue;
+    }
+    record->port_state = event.state;
+    updated_ports.emplace_back(&event, record - port_records_.data());
+  }
+  if (updated_ports.empty()) return;
+  PublishChassisStateSnapshot(false);
+
+  for (const auto& entry : updated_ports) {
+    const LinkscanEvent& event = *entry.first;
+    const PortRecord& record = port_records_[entry.second];
+    const uint64 node_id = record.node_id;
+    const uint32 port_id = record.port_id;
+
+    // Notify the managers about the change of port state.
+    BcmNode* bcm_node = gtl::FindPtrOrNull(unit_to_bcm_node_, event.unit);
+    if (!bcm_node) {
+      LOG(ERROR) << "Inconsistent state. BcmNode* for unit " << event.unit
+                 << " does not exist!";
+      continue;
+    }
+    auto status = bcm_node->UpdatePortState(port_id);
+    if (!status.ok()) {
+      LOG(ERROR) << "Failed to update managers on node " << node_id
+                 << " on port " << port_id << " state change to "
+                 << PortState_Name(event.state) << " with error: " << status
+                 << ".";
+    }
+    // Notify gNMI about the change of logical port state.
+    SendPortOperStateGnmiEvent(node_id, port_id, event.state);
+
+    // Log details about the port state change for debugging purposes.
+    const BcmPort* bcm_port = gtl::FindPtrOrNull(
+        singleton_port_key_to_bcm_port_, record.singleton_port_key);
+    if (bcm_port == nullptr) {
+      LOG(ERROR) << "Inconsistent state. "
+                 << record.singleton_port_key.ToString()
+                 << " is not found as key in singleton_port_key_to_bcm_port_!";
+      continue;
+    }
 
-  // Notify the managers about the change of port state.
-  BcmNode* bcm_node = gtl::FindPtrOrNull(unit_to_bcm_node_, unit);
-  if (!bcm_node) {
-    LOG(ERROR) << "Inconsistent state. BcmNode* for unit " << unit
-               << " does not exist!";
-    return;
-  }
-  auto status = bcm_node->UpdatePortState(*port_id);
-  if (!status.ok()) {
-    LOG(ERROR) << "Failed to update managers on node " << *node_id
-               << " on port " << *port_id << " state change to "
-               << PortState_Name(new_state) << " with error: " << status << ".";
-  }
-  // Notify gNMI about the change of logical port state.
-  SendPortOperStateGnmiEvent(*node_id, *port_id, new_state);
-
-  // Log details about the port state change for debugging purposes.
-  // TODO: The extra map lookups here are only for debugging and
-  // pretty printing the ports. We may not need them. If not, simplify the
-  // state reporting.
-  const std::map<uint32, PortKey>* port_id_to_singleton_port_key =
-      gtl::FindOrNull(node_id_to_port_id_to_singleton_port_key_, *node_id);
-  if (port_id_to_singleton_port_key == nullptr) {
-    LOG(ERROR)
-        << "Inconsistent state. Node " << *node_id
-        << " is not found as key in node_id_to_port_id_to_singleton_port_key_!";
-    return;
-  }
-  const PortKey* singleton_port_key =
-      gtl::FindOrNull(*port_id_to_singleton_port_key, *port_id);
-  if (singleton_port_key == nullptr) {
-    LOG(ERROR) << "Inconsistent state. No PortKey for port " << *port_id
-               << " on node " << *node_id << ".";
-    return;
-  }
-  const BcmPort* bcm_port =
-      gtl::FindPtrOrNull(singleton_port_key_to_bcm_port_, *singleton_port_key);
-  if (bcm_port == nullptr) {
-    LOG(ERROR) << "Inconsistent state. " << singleton_port_key->ToString()
-               << " is not found as key in singleton_port_key_to_bcm_port_!";
-    return;
+    LOG(INFO) << "State of SingletonPort "
+              << PrintPortProperties(node_id, port_id, bcm_port->slot(),
+                                     bcm_port->port(), bcm_port->channel(),
+                                     event.unit, event.port,
+                                     bcm_port->speed_bps())
+              << ": " << PrintPortState(event.state);
   }
-
-  LOG(INFO) << "State of SingletonPort "
-            << PrintPortProperties(*node_id, *port_id, bcm_port->slot(),
-                                   bcm_port->port(), bcm_port->channel(), unit,
-                                   logical_port, bcm_port->speed_bps())
-            << ": " << PrintPortState(new_state);
 }
 
 void BcmChassisManager::SendPortOperStateGnmiEvent(uint64 node_id,
@@ -1882,6 +2360,109 @@ void BcmChassisManager::TransceiverEventHandler(int slot, int port,
   }
 }
 
+::util::Status BcmChassisManager::StartPortCountersPoller() {
+  if (FLAGS_bcm_port_counters_poll_interval_ms <= 0) {
+    LOG(INFO) << "Port counters poller is disabled. Port counters are read "
+              << "from the SDK on every request.";
+    return ::util::OkStatus();
+  }
+  absl::MutexLock l(&port_counters_lock_);
+  if (port_counters_poller_running_) return ::util::OkStatus();
+  port_counters_poller_running_ = true;
+  int ret = pthread_create(&port_counters_poller_tid_, nullptr,
+                           PortCountersPollerThreadFunc, this);
+  if (ret != 0) {
+    port_counters_poller_running_ = false;
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "Failed to create port counters poller thread. Err: " << ret
+           << ".";
+  }
+  return ::util::OkStatus();
+}
+
+void BcmChassisManager::StopPortCountersPoller() {
+  bool running = false;
+  {
+    absl::MutexLock l(&port_counters_lock_);
+    std::swap(running, port_counters_poller_running_);
+    port_counters_condvar_.Signal();
+  }
+  if (running) pthread_join(port_counters_poller_tid_, nullptr);
+}
+
+void* BcmChassisManager::PortCountersPollerThreadFunc(void* arg) {
+  CHECK(arg != nullptr);
+  auto* manager = static_cast<BcmChassisManager*>(arg);
+  const absl::Duration interval =
+      absl::Milliseconds(FLAGS_bcm_port_counters_poll_interval_ms);
+  absl::Time next_poll = absl::Now();
+  while (true) {
+    {
+      absl::MutexLock l(&manager->port_counters_lock_);
+      while (manager->port_counters_poller_running_ &&
+             !manager->port_counters_condvar_.WaitWithDeadline(
+                 &manager->port_counters_lock_, next_poll)) {
+      }
+      if (!manager->port_counters_poller_running_) break;
+    }
+    manager->PollPortCounters(absl::Now());
+    // Keep a fixed polling period, but do not try to catch up if a poll took
+    // longer than the interval.
+    next_poll = std::max(next_poll + interval, absl::Now());
+  }
+  return nullptr;
+}
+
+void BcmChassisManager::PollPortCounters(absl::Time now) {
+  // Take a snapshot of the ports, so that the SDK is not called with
+  // chassis_lock held.
+  std::vector<std::tuple<uint64, uint32, SdkPort>> ports;
+  {
+    absl::ReaderMutexLock l(&chassis_lock);
+    if (shutdown || !initialized_) return;
+    ports.reserve(port_records_.size());
+    for (const auto& record : port_records_) {
+      ports.emplace_back(record.node_id, record.port_id, record.sdk_port);
+    }
+  }
+
+  std::map<uint64, std::map<uint32, PortCountersCacheEntry>>
+      node_id_to_port_id_to_port_counters;
+  for (const auto& port : ports) {
+    const SdkPort& sdk_port = std::get<2>(port);
+    PortCounters counters;
+    ::util::Status status = bcm_sdk_interface_->GetPortCounters(
+        sdk_port.unit, sdk_port.logical_port, &counters);
+    if (!status.ok()) {
+      VLOG(1) << "Failed to poll counters of " << sdk_port.ToString() << ": "
+              << status;
+      continue;
+    }
+    auto& entry = node_id_to_port_id_to_port_counters[std::get<0>(port)]
+                                                     [std::get<1>(port)];
+    entry.counters = counters;
+    entry.timestamp = now;
+  }
+
+  absl::MutexLock l(&port_counters_lock_);
+  for (auto& e : node_id_to_port_id_to_port_counters) {
+    const auto* port_id_to_prev_port_counters =
+        gtl::FindOrNull(node_id_to_port_id_to_port_counters_, e.first);
+    if (port_id_to_prev_port_counters == nullptr) continue;
+    for (auto& f : e.second) {
+      const auto* prev =
+          gtl::FindOrNull(*port_id_to_prev_port_counters, f.first);
+      if (prev == nullptr || prev->timestamp >= now) continue;
+      ComputePortCounterRates(prev->counters, f.second.counters,
+                              absl::ToDoubleSeconds(now - prev->timestamp),
+                              &f.second.rates);
+      f.second.has_rates = true;
+    }
+  }
+  node_id_to_port_id_to_port_counters_ =
+      std::move(node_id_to_port_id_to_port_counters);
+}
+
 ::util::StatusOr<bool> BcmChassisManager::SetSpeedForFlexPortGroup(
     const PortKey& port_group_key) const {
   // First check to see if this is a flex port group.
@@ -19,6 +19,8 @@
 #ifndef STRATUM_HAL_LIB_BCM_BCM_CHASSIS_MANAGER_H_
 #define STRATUM_HAL_LIB_BCM_BCM_CHASSIS_MANAGER_H_
 
+#include <pthread.h>
+
 #include <functional>
 #include <map>
 #include <memory>
@@ -43,7 +45,9 @@
 #include "stratum/hal/lib/common/writer_interface.h"
 #include "stratum/lib/channel/channel.h"
 #include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
 
 namespace stratum {
 namespace hal {
@@ -56,7 +60,10 @@ namespace bcm {
 // NOTE: The maps in this class may be accessed in such a way where the order of
 // the keys are important. That is why we chose to use std::map as opposed to
 // std::unordered_map or absl::flat_hash_map and accept a little bit of
-// performance hit when doing lookup.
+// performance hit when doing lookup. The exception is the per-port state of
+// the singleton ports, which is looked up on every port state query and
+// linkscan event. It is kept in a flat table of PortRecords, indexed by hash
+// maps (see port_records_).
 class BcmChassisManager : public BcmChassisRoInterface {
  public:
   // Encapsulates trunk membership info of a singleton port that are part of a
@@ -70,6 +77,112 @@ class BcmChassisManager : public BcmChassisRoInterface {
     TrunkMemberBlockState block_state;
   };
 
+  // Statistics of the link-down failover, i.e. of the pruning of the ports
+  // going down from the multipath groups.
+  struct LinkDownFailoverStats {
+    LinkDownFailoverStats()
+        : events(0),
+          failures(0),
+          max_latency(absl::ZeroDuration()),
+          total_latency(absl::ZeroDuration()),
+          last_latency(absl::ZeroDuration()) {}
+    // Num of link-down events handled, and how many of them failed to prune
+    // the port.
+    uint64 events;
+    uint64 failures;
+    // Max, total and last latency between the time a link-down event was
+    // received from the SDK and the time the port was pruned.
+    absl::Duration max_latency;
+    absl::Duration total_latency;
+    absl::Duration last_latency;
+    std::string ToString() const;
+  };
+
+  // An immutable copy of the node, singleton port and trunk state of the
+  // chassis. A new snapshot is published every time this state changes, i.e.
+  // as part of each config push and once per batch of linkscan events, and
+  // atomically replaces the previous one. A reader keeps a consistent view of
+  // the state for as long as it holds on to a snapshot, without chassis_lock.
+  struct ChassisStateSnapshot {
+    // The config of a singleton port.
+    struct Port {
+      Port()
+          : node_id(0),
+            port_id(0),
+            bcm_port(),
+            sdk_port(),
+            has_parent_trunk(false),
+            parent_trunk_id(0) {}
+      uint64 node_id;
+      uint32 port_id;
+      BcmPort bcm_port;
+      SdkPort sdk_port;
+      // The ID of the trunk the port is part of, valid only if
+      // has_parent_trunk is true.
+      bool has_parent_trunk;
+      uint32 parent_trunk_id;
+    };
+
+    // The part of the snapshot which only changes on config push, i.e. all
+    // but the per-port state. Built once per config push and shared by all
+    // the snapshots published until the next one, so that a linkscan event
+    // only copies the per-port state.
+    struct ConfigState {
+      std::map<uint64, int> node_id_to_unit;
+      std::map<int, uint64> unit_to_node_id;
+      std::map<uint64, std::set<uint32>> node_id_to_port_ids;
+      // The singleton ports, indexed by their port handle as in
+      // port_records_.
+      std::vector<Port> ports;
+      absl::flat_hash_map<std::pair<uint64, uint32>, int>
+          node_id_and_port_id_to_port_handle;
+      absl::flat_hash_map<SdkPort, int> sdk_port_to_port_handle;
+      std::map<uint64, std::map<uint32, SdkTrunk>>
+          node_id_to_trunk_id_to_sdk_trunk;
+      std::map<uint64, std::map<uint32, TrunkState>>
+          node_id_to_trunk_id_to_trunk_state;
+      std::map<uint64, std::map<uint32, std::set<uint32>>>
+          node_id_to_trunk_id_to_members;
+    };
+
+    ChassisStateSnapshot() : version(0), config(nullptr) {}
+
+    // Same as the BcmChassisManager methods of the same name, as of the time
+    // the snapshot was published.
+    ::util::StatusOr<BcmPort> GetBcmPort(uint64 node_id, uint32 port_id) const;
+    ::util::StatusOr<int> GetUnitFromNodeId(uint64 node_id) const;
+    ::util::StatusOr<std::map<uint32, SdkPort>> GetPortIdToSdkPortMap(
+        uint64 node_id) const;
+    ::util::StatusOr<std::map<uint32, SdkTrunk>> GetTrunkIdToSdkTrunkMap(
+        uint64 node_id) const;
+    ::util::StatusOr<PortState> GetPortState(uint64 node_id,
+                                             uint32 port_id) const;
+    ::util::StatusOr<PortState> GetPortState(const SdkPort& sdk_port) const;
+    ::util::StatusOr<TrunkState> GetTrunkState(uint64 node_id,
+                                               uint32 trunk_id) const;
+    ::util::StatusOr<std::set<uint32>> GetTrunkMembers(uint64 node_id,
+                                                       uint32 trunk_id) const;
+    ::util::StatusOr<uint32> GetParentTrunkId(uint64 node_id,
+                                              uint32 port_id) const;
+    ::util::StatusOr<AdminState> GetPortAdminState(uint64 node_id,
+                                                   uint32 port_id) const;
+
+    // Returns the handle of the port uniquely identified by (node_id,
+    // port_id) or by sdk_port, or nullptr if the port is not known.
+    const int* FindPortHandleOrNull(uint64 node_id, uint32 port_id) const;
+    const int* FindPortHandleOrNull(const SdkPort& sdk_port) const;
+
+    // Incremented by every publication, so that two snapshots can be told
+    // apart.
+    uint64 version;
+    // Never nullptr in a published snapshot.
+    std::shared_ptr<const ConfigState> config;
+    // The state of the singleton ports, indexed by their port handle as
+    // config->ports.
+    std::vector<PortState> port_states;
+    std::vector<AdminState> admin_states;
+  };
+
   virtual ~BcmChassisManager();
 
   // Pushes the chassis config. If the class is not initialized, this function
@@ -82,6 +195,7 @@ class BcmChassisManager : public BcmChassisRoInterface {
   // 4- Sets up the port options for the flex and non-flex ports.
   // 5- Saves or updates an internal copy of the ChassisConfig proto which has
   //    the most updated configuration of all the chassis/nodes/ports.
+  // 6- Publishes a new ChassisStateSnapshot, even if any of the above fails.
   virtual ::util::Status PushChassisConfig(const ChassisConfig& config)
       EXCLUSIVE_LOCKS_REQUIRED(chassis_lock);
 
@@ -117,43 +231,53 @@ class BcmChassisManager : public BcmChassisRoInterface {
   virtual ::util::Status UnregisterEventNotifyWriter()
       LOCKS_EXCLUDED(gnmi_event_lock_);
 
+  // Returns the last published ChassisStateSnapshot, or nullptr if the class
+  // is not initialized. Does not need chassis_lock.
+  virtual std::shared_ptr<const ChassisStateSnapshot> GetChassisStateSnapshot()
+      const;
+
   // BcmChassisRoInterface functions.
   ::util::StatusOr<BcmChip> GetBcmChip(int unit) const override
       SHARED_LOCKS_REQUIRED(chassis_lock);
   ::util::StatusOr<BcmPort> GetBcmPort(int slot, int port,
                                        int channel) const override
       SHARED_LOCKS_REQUIRED(chassis_lock);
+  // The node, port and trunk state below is served from the last published
+  // ChassisStateSnapshot, and does not need chassis_lock.
   ::util::StatusOr<BcmPort> GetBcmPort(uint64 node_id,
-                                       uint32 port_id) const override
-      SHARED_LOCKS_REQUIRED(chassis_lock);
-  ::util::StatusOr<std::map<uint64, int>> GetNodeIdToUnitMap() const override
-      SHARED_LOCKS_REQUIRED(chassis_lock);
-  ::util::StatusOr<int> GetUnitFromNodeId(uint64 node_id) const override
-      SHARED_LOCKS_REQUIRED(chassis_lock);
+                                       uint32 port_id) const override;
+  ::util::StatusOr<std::map<uint64, int>> GetNodeIdToUnitMap() const override;
+  ::util::StatusOr<int> GetUnitFromNodeId(uint64 node_id) const override;
   ::util::StatusOr<std::map<uint32, SdkPort>> GetPortIdToSdkPortMap(
-      uint64 node_id) const override SHARED_LOCKS_REQUIRED(chassis_lock);
+      uint64 node_id) const override;
   ::util::StatusOr<std::map<uint32, SdkTrunk>> GetTrunkIdToSdkTrunkMap(
-      uint64 node_id) const override SHARED_LOCKS_REQUIRED(chassis_lock);
+      uint64 node_id) const override;
   ::util::StatusOr<PortState> GetPortState(uint64 node_id,
-                                           uint32 port_id) const override
-      SHARED_LOCKS_REQUIRED(chassis_lock);
+                                           uint32 port_id) const override;
   ::util::StatusOr<PortState> GetPortState(const SdkPort& sdk_port)
-      const override SHARED_LOCKS_REQUIRED(chassis_lock);
+      const override;
   ::util::StatusOr<TrunkState> GetTrunkState(uint64 node_id,
-                                             uint32 trunk_id) const override
-      SHARED_LOCKS_REQUIRED(chassis_lock);
+                                             uint32 trunk_id) const override;
   ::util::StatusOr<std::set<uint32>> GetTrunkMembers(
-      uint64 node_id, uint32 trunk_id) const override
-      SHARED_LOCKS_REQUIRED(chassis_lock);
+      uint64 node_id, uint32 trunk_id) const override;
   ::util::StatusOr<uint32> GetParentTrunkId(uint64 node_id,
-                                            uint32 port_id) const override
-      SHARED_LOCKS_REQUIRED(chassis_lock);
-  ::util::StatusOr<AdminState> GetPortAdminState(uint64 node_id,
-                                                 uint32 port_id) const override
-      SHARED_LOCKS_REQUIRED(chassis_lock);
+                                            uint32 port_id) const override;
+  ::util::StatusOr<AdminState> GetPortAdminState(
+      uint64 node_id, uint32 port_id) const override;
+  // Served from the port counters cache if the counters of the port were
+  // polled less than FLAGS_bcm_port_counters_max_staleness_ms ago, otherwise
+  // read from the SDK.
   ::util::Status GetPortCounters(uint64 node_id, uint32 port_id,
                                  PortCounters* pc) const override
-      SHARED_LOCKS_REQUIRED(chassis_lock);
+      SHARED_LOCKS_REQUIRED(chassis_lock) LOCKS_EXCLUDED(port_counters_lock_);
+
+  // Returns the per-second rate of each of the counters of a port, computed
+  // from the last two polls of the port counters poller. Returns
+  // ERR_ENTRY_NOT_FOUND if the port has not been polled twice yet, which is
+  // always the case if the poller is disabled.
+  virtual ::util::Status GetPortCounterRates(uint64 node_id, uint32 port_id,
+                                             PortCounters* rates) const
+      SHARED_LOCKS_REQUIRED(chassis_lock) LOCKS_EXCLUDED(port_counters_lock_);
 
   // Sets the block state of a trunk member on a node specified by node_id. The
   // id of the member is given by port_id. The ID of the trunk which the port is
@@ -162,14 +286,14 @@ class BcmChassisManager : public BcmChassisRoInterface {
   // given port_id matches value. The function:
   // 1- Sends a request to SDK to (un)block the given port, if and only if it
   //    is part of a trunk.
-  // 2- Mutates node_id_to_port_id_to_trunk_membership_info_ for the given pair
+  // 2- Mutates the trunk membership info of the PortRecord for the given pair
   //    of (node_id, port_id) and adjust the blocking state of the trunk member,
   //    only if step 1 is successful.
   // This function is expected to return error in the following cases:
-  // 1- If (node_id, port_id) is not found as a key in
-  //    node_id_to_port_id_to_trunk_membership_info_.
+  // 1- If (node_id, port_id) is not known or the port has no trunk
+  //    membership info.
   // 2- If the given trunk_id does not match the parent trunk ID found in
-  //    node_id_to_port_id_to_trunk_membership_info_ for the port.
+  //    the trunk membership info of the port.
   // 3- If SDK operation fails.
   virtual ::util::Status SetTrunkMemberBlockState(uint64 node_id,
                                                   uint32 trunk_id,
@@ -180,7 +304,7 @@ class BcmChassisManager : public BcmChassisRoInterface {
   // Sets the admin state of a port, as requested by the SDN controller. This
   // method:
   // 1- Sends a request to SDK to enable/disable the port.
-  // 2- Mutates node_id_to_port_id_to_admin_state_ for the given pair of
+  // 2- Mutates the admin state of the PortRecord for the given pair of
   //    (node_id, port_id), only if step 1 is successful.
   virtual ::util::Status SetPortAdminState(uint64 node_id, uint32 port_id,
                                            AdminState state)
@@ -188,7 +312,7 @@ class BcmChassisManager : public BcmChassisRoInterface {
 
   // Sets the health state of a port, as requested by the SDN controller. This
   // method:
-  // 1- Mutates node_id_to_port_id_to_health_state_ for the given pair of
+  // 1- Mutates the health state of the PortRecord for the given pair of
   //    (node_id, port_id).
   // 2- Translates the requested health state to a (LED color, LED state)
   //    for the corresponding (slot, port, channel) and sends it to PHAL to
@@ -198,6 +322,10 @@ class BcmChassisManager : public BcmChassisRoInterface {
                                             HealthState state)
       EXCLUSIVE_LOCKS_REQUIRED(chassis_lock);
 
+  // Returns the statistics of the link-down failover.
+  virtual LinkDownFailoverStats GetLinkDownFailoverStats() const
+      LOCKS_EXCLUDED(link_down_failover_lock_);
+
   // Factory function for creating the instance of the class.
   static std::unique_ptr<BcmChassisManager> CreateInstance(
       OperationMode mode, PhalInterface* phal_interface,
@@ -213,6 +341,99 @@ class BcmChassisManager : public BcmChassisRoInterface {
   BcmChassisManager();
 
  private:
+  // The cached counters of a singleton port, as polled by the port counters
+  // poller.
+  struct PortCountersCacheEntry {
+    PortCountersCacheEntry() : has_rates(false) {}
+    // The counters as read from the SDK.
+    PortCounters counters;
+    // The per-second rate of each counter since the previous poll. Only valid
+    // if has_rates is true.
+    PortCounters rates;
+    bool has_rates;
+    // The time 'counters' were read.
+    absl::Time timestamp;
+  };
+
+  // The difference between the last applied ChassisConfig and a newly pushed
+  // one, as far as this class is concerned.
+  struct ChassisConfigDiff {
+    ChassisConfigDiff() : full_sync_required(false) {}
+    // True if the internal state needs to be synced with the whole new config,
+    // i.e. if anything other than the config params of some of the existing
+    // singleton ports changed.
+    bool full_sync_required;
+    // The IDs of the nodes, and the (node ID, port ID) of the singleton and
+    // trunk ports, which were added, removed or modified.
+    std::set<uint64> changed_node_ids;
+    std::set<std::pair<uint64, uint32>> changed_singleton_ports;
+    std::set<std::pair<uint64, uint32>> changed_trunk_ports;
+    // The singleton ports of the new config, out of changed_singleton_ports,
+    // whose changes can be applied without a full sync. Point to the new
+    // config.
+    std::vector<const SingletonPort*> updated_singleton_ports;
+  };
+
+  // A singleton port known to the class, with all its per-port state. The
+  // records are kept in port_records_ and identified by their index in that
+  // vector, the port handle.
+  struct PortRecord {
+    PortRecord()
+        : node_id(0),
+          port_id(0),
+          singleton_port_key(),
+          sdk_port(),
+          port_state(PORT_STATE_UNKNOWN),
+          admin_state(ADMIN_STATE_UNKNOWN),
+          health_state(HEALTH_STATE_UNKNOWN),
+          has_trunk_membership_info(false),
+          trunk_membership_info() {}
+    // (node ID, port ID) of the singleton port.
+    uint64 node_id;
+    uint32 port_id;
+    // PortKey representing (slot, port, channel) of the singleton port.
+    PortKey singleton_port_key;
+    // SdkPort encapsulating (unit, logical_port) of the singleton port.
+    SdkPort sdk_port;
+    // The state of the port. After chassis config push, if there is already a
+    // state for the port, we keep the state, otherwise we initialize the state
+    // to PORT_STATE_UNKNOWN and let the next linkscan event update the state.
+    PortState port_state;
+    // The admin state of the port as set by the SDN controller or the config.
+    // After each chassis config push, we honor the valid admin state of the
+    // port specified in the config. If no admin state is specified for the port
+    // in the config, we either keep the state (if the port was already known),
+    // or initialize the state to ADMIN_STATE_UNKNOWN. A port with admin state
+    // ADMIN_STATE_UNKNOWN will use the default admin state and will not be
+    // forcefully diasbled in HW. That means the port can later come up (i.e.,
+    // its oper state can be up).
+    AdminState admin_state;
+    // The health state of the port, usually updated by a remote SDN
+    // controller. Any change to the health state will be translated to a
+    // change into the color/state of the frontpanel port LED corresponding to
+    // the (slot, port, channel) of the port. Please note the following:
+    // 1- Not all platforms support frontpanel port LEDs. If a chassis does
+    //    not support port LEDs, a change in the health state will not trigger
+    //    an LED color/state update.
+    // 2- Some platforms do not have per-channel LEDs on each transceiver port.
+    //    We assume the lower-level software will aggregate the per-channel
+    //    LED colors/states into one LED color/state for that trasceiver.
+    // After each chassis config push, if the port was already known we keep
+    // its health state as is, otherwise we initialize the state to
+    // HEALTH_STATE_UNKNOWN, update the LEDs accordingly, and let a function
+    // call to SetPortHealthState() update the health state by the SDN
+    // controller later.
+    HealthState health_state;
+    // The trunk membership info of the port, valid only if
+    // has_trunk_membership_info is true, i.e. when the port is part of a
+    // trunk. Trunk membership of the ports is updated as part of each "trunk
+    // event".
+    // TODO: The assumption here is that each port can be part of one
+    // trunk only. If this assumption is not correct, change the record.
+    bool has_trunk_membership_info;
+    TrunkMembershipInfo trunk_membership_info;
+  };
+
   // ReaderArgs encapsulates the arguments for a Channel reader thread.
   template <typename T>
   struct ReaderArgs {
@@ -255,8 +476,14 @@ class BcmChassisManager : public BcmChassisRoInterface {
       const ChassisConfig& config, BcmChassisMap* base_bcm_chassis_map,
       BcmChassisMap* target_bcm_chassis_map) const;
 
+  // Implements PushChassisConfig(). PushChassisConfig() publishes the state
+  // this method leaves behind, whether it succeeds or not.
+  ::util::Status DoPushChassisConfig(const ChassisConfig& config)
+      EXCLUSIVE_LOCKS_REQUIRED(chassis_lock);
+
   // One time coldboot initialization of all BCM chips. Initializes the SDK
-  // and attaches to all the units.
+  // and attaches to all the units. The units and their ports can be brought up
+  // in parallel, see FLAGS_bcm_max_parallel_units.
   ::util::Status InitializeBcmChips(
       const BcmChassisMap& base_bcm_chassis_map,
       const BcmChassisMap& target_bcm_chassis_map);
@@ -283,10 +510,47 @@ class BcmChassisManager : public BcmChassisRoInterface {
   //    the pushed chassis config.
   ::util::Status ConfigurePortGroups();
 
+  // Sets the port options for the flex and non-flex port groups which are not
+  // HW_STATE_READY yet. Called by ConfigurePortGroups(), and on its own for
+  // the config pushes which do not change the port groups.
+  ::util::Status ConfigurePendingPortGroups();
+
+  // Computes the difference between old_config and new_config. Both configs
+  // are expected to have been verified.
+  static ChassisConfigDiff DiffChassisConfig(const ChassisConfig& old_config,
+                                             const ChassisConfig& new_config);
+
+  // Applies the changes of the given singleton ports on an initialized class,
+  // without syncing the rest of the internal state. Only the config params of
+  // the ports are expected to have changed since the last config push.
+  ::util::Status UpdateSingletonPorts(
+      const std::vector<const SingletonPort*>& singleton_ports);
+
   // Cleans up the internal state. Resets all the internal port maps and
   // deletes the pointers.
   void CleanupInternalState();
 
+  // Returns the PortRecord of the singleton port uniquely identified by
+  // (node_id, port_id), or nullptr if the port is not known.
+  const PortRecord* FindPortRecordOrNull(uint64 node_id, uint32 port_id) const;
+  PortRecord* FindPortRecordOrNull(uint64 node_id, uint32 port_id);
+
+  // Returns the PortRecord of the singleton port whose (unit, logical_port)
+  // is given by sdk_port, or nullptr if the port is not known.
+  const PortRecord* FindPortRecordOrNull(const SdkPort& sdk_port) const;
+  PortRecord* FindPortRecordOrNull(const SdkPort& sdk_port);
+
+  // Replaces all the PortRecords and rebuilds the indices from them.
+  void SetPortRecords(std::vector<PortRecord> port_records);
+
+  // Builds a new ChassisStateSnapshot from the internal state and publishes
+  // it, or publishes nullptr if the class is not initialized. To be called
+  // once the writer holding chassis_lock is done with a batch of changes. The
+  // ConfigState of the snapshot is only rebuilt if 'config_changed' is true,
+  // otherwise the one of the previous snapshot is shared and only the per-port
+  // state is copied.
+  void PublishChassisStateSnapshot(bool config_changed);
+
   // Loads the base_bcm_chassis_map from a file. We read the list of supported
   // profiles from a file, picks the one whose ID matches bcm_chassis_map_id
   // or the first profile if bcm_chassis_map_id is empty.
@@ -315,12 +579,28 @@ class BcmChassisManager : public BcmChassisRoInterface {
 
   // Linkscan event handler. This method is executed by a ChannelReader thread
   // which processes SDK linkscan events. Port is the logical port number used
-  // by the SDK.
+  // by the SDK, and event_time the time the event was received from the SDK.
+  // A port going down is first pruned from the multipath groups, before
+  // chassis_lock is acquired.
   // NOTE: This method should never be executed directly from a context which
   // first accesses the internal structures of a class below BcmChassisManager
   // as this may result in deadlock.
-  void LinkscanEventHandler(int unit, int logical_port, PortState new_state)
-      LOCKS_EXCLUDED(chassis_lock);
+  void LinkscanEventHandler(int unit, int logical_port, PortState new_state,
+                            absl::Time event_time)
+      LOCKS_EXCLUDED(chassis_lock, link_down_failover_lock_);
+
+  // Same as LinkscanEventHandler() for a batch of linkscan events, e.g. all
+  // the events queued during a link flap. chassis_lock is acquired once and
+  // one ChassisStateSnapshot is published for the whole batch.
+  void HandleLinkscanEvents(
+      const std::vector<BcmSdkInterface::LinkscanEvent>& events)
+      LOCKS_EXCLUDED(chassis_lock, link_down_failover_lock_);
+
+  // Prunes a port which went down from the multipath groups of its unit and
+  // updates the link-down failover stats. Does not need chassis_lock.
+  void PruneDownPortFromMultipathGroups(int unit, int logical_port,
+                                        absl::Time event_time)
+      LOCKS_EXCLUDED(link_down_failover_lock_);
 
   // Transceiver module insert/removal event handler. This method is executed by
   // a ChannelReader thread which processes transceiver module insert/removal
@@ -353,6 +633,28 @@ class BcmChassisManager : public BcmChassisRoInterface {
       const std::unique_ptr<ChannelReader<BcmSdkInterface::LinkscanEvent>>&
           reader) LOCKS_EXCLUDED(chassis_lock);
 
+  // Starts the port counters poller thread, unless it is disabled by
+  // FLAGS_bcm_port_counters_poll_interval_ms or already running.
+  ::util::Status StartPortCountersPoller() LOCKS_EXCLUDED(port_counters_lock_);
+
+  // If the port counters poller thread is running, stops it and waits for it
+  // to exit.
+  void StopPortCountersPoller()
+      LOCKS_EXCLUDED(chassis_lock, port_counters_lock_);
+
+  // Thread function of the port counters poller. Calls PollPortCounters()
+  // every FLAGS_bcm_port_counters_poll_interval_ms until
+  // port_counters_poller_running_ is set to false. Invoked with "this" as the
+  // argument in pthread_create.
+  static void* PortCountersPollerThreadFunc(void* arg)
+      LOCKS_EXCLUDED(chassis_lock, port_counters_lock_);
+
+  // Reads the counters of all the singleton ports from the SDK and replaces
+  // the port counters cache with them, computing the counter rates from the
+  // previous cache entries. 'now' is the time the poll is recorded with.
+  void PollPortCounters(absl::Time now)
+      LOCKS_EXCLUDED(chassis_lock, port_counters_lock_);
+
   // Forward PortStatus changed events through the appropriate node's registered
   // ChannelWriter<GnmiEventPtr> object. Called by LinkscanEventHandler and
   // expects chassis_lock to be held.
@@ -418,6 +720,10 @@ class BcmChassisManager : public BcmChassisRoInterface {
   // applied_bcm_chassis_map_ or we report "reboot required".
   std::unique_ptr<BcmChassisMap> applied_bcm_chassis_map_;
 
+  // The last ChassisConfig successfully pushed. Used to find out which parts
+  // of the internal state a new config push needs to update.
+  std::unique_ptr<ChassisConfig> applied_config_;
+
   // Map from 0-based unit to a pointer to its corresponding BcmChip.
   std::map<int, BcmChip*> unit_to_bcm_chip_;
 
@@ -460,16 +766,32 @@ class BcmChassisManager : public BcmChassisRoInterface {
   // belong to that node. This map is updated as part of each config push.
   std::map<uint64, std::set<uint32>> node_id_to_trunk_ids_;
 
-  // Map from node ID to another map from port ID to PortKey corresponding
-  // to the singleton port uniquely identified by (node ID, port ID). This map
-  // is updated as part of each config push.
-  std::map<uint64, std::map<uint32, PortKey>>
-      node_id_to_port_id_to_singleton_port_key_;
-
-  // Map from node ID to another map from port ID to SdkPort encapsulating the
-  // (unit, logical_port) of the singleton port uniquely identified by
-  // (node ID, port ID). This map is updated as part of each config push.
-  std::map<uint64, std::map<uint32, SdkPort>> node_id_to_port_id_to_sdk_port_;
+  // The records of all the singleton ports, i.e. their PortKey, SdkPort and
+  // per-port state. Rebuilt as part of each config push, when the handles of
+  // the ports may change. The records are looked up through the two indices
+  // below, which map (node ID, port ID) and SdkPort of a port to its handle,
+  // i.e. the index of its record in port_records_.
+  std::vector<PortRecord> port_records_;
+  absl::flat_hash_map<std::pair<uint64, uint32>, int>
+      node_id_and_port_id_to_port_handle_;
+  absl::flat_hash_map<SdkPort, int> sdk_port_to_port_handle_;
+
+  // The last published ChassisStateSnapshot. Written by the holder of
+  // chassis_lock as a writer, but read without any lock: only ever accessed
+  // through std::atomic_load() and std::atomic_store(), so that a reader gets
+  // either the previous or the new snapshot. A snapshot is freed when its last
+  // reader drops it.
+  std::shared_ptr<const ChassisStateSnapshot> chassis_state_snapshot_;
+
+  // The ConfigState of the last published ChassisStateSnapshot, rebuilt as
+  // part of each config push. Only accessed by the holder of chassis_lock as
+  // a writer.
+  std::shared_ptr<const ChassisStateSnapshot::ConfigState>
+      chassis_config_state_;
+
+  // The version of the last published ChassisStateSnapshot. Not reset on
+  // shutdown, so that versions are never reused.
+  uint64 chassis_state_version_;
 
   // Map from node ID to another map from trunk ID to SdkTrunk representing
   // (unit, trunk_port) of the trunk uniquely identified by (node ID, trunk ID).
@@ -478,12 +800,6 @@ class BcmChassisManager : public BcmChassisRoInterface {
   std::map<uint64, std::map<uint32, SdkTrunk>>
       node_id_to_trunk_id_to_sdk_trunk_;
 
-  // Map from node ID to another map from SdkPort to port ID, with
-  // SdkPort representing (unit, logical_port) of the singleton port
-  // uniquely identified by (node ID, port ID). This map is updated as part of
-  // each config push.
-  std::map<uint64, std::map<SdkPort, uint32>> node_id_to_sdk_port_to_port_id_;
-
   // Map from node ID to another map from SdkTrunk to trunk ID, with
   // SdkTrunk representing (unit, trunk_port) of the trunk uniquely
   // identified by (node ID, trunk ID). This map is updated as part of
@@ -495,14 +811,6 @@ class BcmChassisManager : public BcmChassisRoInterface {
   // state of the transceiver module plugged into that (slot, port).
   std::map<PortKey, HwState> xcvr_port_key_to_xcvr_state_;
 
-  // Map from node ID to another map from port ID to PortState representing
-  // the state of the singleton port uniquely identified by (node ID, port ID).
-  // After chassis config push, if there is already a state for a port in this
-  // map, we keep the state, otherwise we initialize the state to
-  // PORT_STATE_UNKNOWN and let the next linkscan event update the state.
-  std::map<uint64, std::map<uint32, PortState>>
-      node_id_to_port_id_to_port_state_;
-
   // Map from node ID to another map from trunk ID to TrunkState representing
   // the state of the trunk port uniquely identified by (node ID, trunk ID).
   // This map is updated as part of any "trunk event". After each config push
@@ -518,48 +826,6 @@ class BcmChassisManager : public BcmChassisRoInterface {
   std::map<uint64, std::map<uint32, std::set<uint32>>>
       node_id_to_trunk_id_to_members_;
 
-  // Map from node ID to another map from port ID to its trunk membership info,
-  // when the port is part of a trunk. Trunk membership of the ports is updated
-  // as part of each "trunk event".
-  // TODO: The assumption here is that each port can be part of one
-  // trunk only. If this assumption is not correct, change the map.
-  std::map<uint64, std::map<uint32, TrunkMembershipInfo>>
-      node_id_to_port_id_to_trunk_membership_info_;
-
-  // Map from node ID to another map from port ID to AdminState representing
-  // the admin state of the port as set by the SDN controller or the config.
-  // This map is updated as part of each config push or per request from the
-  // SDN controller by calling SetPortAdminState(). After each chassis config
-  // push, we honor the valid admin state of the ports specified in the config.
-  // If no admin state is specified for a port in the config, we either keep the
-  // state (if there is already a state for the port in this map), or initialize
-  // the state to ADMIN_STATE_UNKNOWN (if the port is not found as a key in the
-  // map). A port with admin state ADMIN_STATE_UNKNOWN will use the default
-  // admin state and will not be forcefully diasbled in HW. That means the port
-  // can later come up (i.e., its oper state can be up).
-  std::map<uint64, std::map<uint32, AdminState>>
-      node_id_to_port_id_to_admin_state_;
-
-  // Map from node ID to another map from port ID to the health state of the
-  // port, encoded by an enum of type HealthState. The health state of a port
-  // is usually updated by a remote SDN controller. Any change to this map will
-  // be translated to a change into the color/state of the frontpanel port LED
-  // corresponding to the (slot, port, channel) that this port ID points to.
-  // Please note the following:
-  // 1- Not all platforms support frontpanel port LEDs. If a chassis does
-  //    not support port LEDs, a change in this map will not trigger an LED
-  //    color/state update.
-  // 2- Some platforms do not have per-channel LEDs on each transceiver port.
-  //    We assume the lower-level software will aggregate the per-channel
-  //    LED colors/states into one LED color/state for that trasceiver.
-  // After each chassis config push, if there is already a health state for a
-  // port in this map, we keep it as is, otherwise we initialize the state to
-  // HEALTH_STATE_UNKNOWN, update the LEDs accordingly, and let a function call
-  // to SetPortHealthState() update the health state by the SDN controller
-  // later.
-  std::map<uint64, std::map<uint32, HealthState>>
-      node_id_to_port_id_to_health_state_;
-
   // Channel for receiving transceiver events from the Phal.
   std::shared_ptr<Channel<PhalInterface::TransceiverEvent>> xcvr_event_channel_;
 
@@ -572,6 +838,24 @@ class BcmChassisManager : public BcmChassisRoInterface {
   std::shared_ptr<WriterInterface<GnmiEventPtr>> gnmi_event_writer_
       GUARDED_BY(gnmi_event_lock_);
 
+  // Protects the port counters cache and the state of its poller thread.
+  mutable absl::Mutex port_counters_lock_;
+
+  // Signalled to wake up the port counters poller thread when it is stopped.
+  absl::CondVar port_counters_condvar_;
+
+  // Map from node ID to another map from port ID to the last polled counters
+  // of the singleton port uniquely identified by (node ID, port ID). The whole
+  // map is replaced by every poll, so it only contains the ports that were
+  // successfully polled last time.
+  std::map<uint64, std::map<uint32, PortCountersCacheEntry>>
+      node_id_to_port_id_to_port_counters_ GUARDED_BY(port_counters_lock_);
+
+  // The port counters poller thread and whether it is running. The thread
+  // keeps polling until port_counters_poller_running_ is set to false.
+  pthread_t port_counters_poller_tid_;
+  bool port_counters_poller_running_ GUARDED_BY(port_counters_lock_);
+
   // Pointer to a PhalInterface implementation.
   PhalInterface* phal_interface_;  // not owned by this class.
 
@@ -581,9 +865,18 @@ class BcmChassisManager : public BcmChassisRoInterface {
   // Pointer to an instance of BcmSerdesDbManager for accessing serdes database.
   BcmSerdesDbManager* bcm_serdes_db_manager_;  // not owned by this class.
 
-  // Map from unit to BcmNode instance.
+  // Map from unit to BcmNode instance. Written while holding both
+  // chassis_lock and link_down_failover_lock_, so that the link-down failover
+  // path can read it with link_down_failover_lock_ only.
   std::map<int, BcmNode*> unit_to_bcm_node_;  // not owned by this class.
 
+  // Protects the link-down failover stats and unit_to_bcm_node_ when accessed
+  // without chassis_lock.
+  mutable absl::Mutex link_down_failover_lock_;
+  LinkDownFailoverStats link_down_failover_stats_
+      GUARDED_BY(link_down_failover_lock_);
+
+  friend class BcmChassisManagerBenchmark;
   friend class BcmChassisManagerTest;
 };
 
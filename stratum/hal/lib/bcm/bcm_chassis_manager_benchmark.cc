@@ -0,0 +1,370 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Measures the cost of the per-port lookups of BcmChassisManager, e.g.
+// GetPortState(), for a chassis with many singleton ports. The internal state
+// of the class is populated directly, as a config push would do, and every
+// port is looked up by (node ID, port ID) and by SdkPort. The same lookups on
+// nested std::maps, which the class used to keep the per-port state in, are
+// measured as a reference.
+//
+// Then measures the same lookup from several reader threads, e.g. gNMI
+// polling, while a writer thread keeps flipping the state of the ports as the
+// linkscan event handler does: once with the readers holding chassis_lock, as
+// they used to, and once served from the ChassisStateSnapshot only.
+//
+// Example:
+//   bcm_chassis_manager_benchmark --bcm_chassis_manager_benchmark_num_ports=256
+//       --bcm_chassis_manager_benchmark_num_readers=8
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "stratum/glue/init_google.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/logging.h"
+#include "stratum/hal/lib/bcm/bcm_chassis_manager.h"
+#include "stratum/hal/lib/bcm/bcm_sdk_mock.h"
+#include "stratum/hal/lib/bcm/bcm_serdes_db_manager_mock.h"
+#include "stratum/hal/lib/common/phal_mock.h"
+#include "absl/strings/str_format.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+DEFINE_int32(bcm_chassis_manager_benchmark_num_ports, 256,
+             "Num of singleton ports in the chassis.");
+DEFINE_int32(bcm_chassis_manager_benchmark_num_units, 2,
+             "Num of units the ports are spread over, one node per unit.");
+DEFINE_int32(bcm_chassis_manager_benchmark_num_iterations, 10000,
+             "Num of times every port is looked up.");
+DEFINE_int32(bcm_chassis_manager_benchmark_num_readers, 4,
+             "Num of reader threads looking up the ports concurrently with "
+             "the writer thread.");
+DEFINE_int32(bcm_chassis_manager_benchmark_duration_ms, 2000,
+             "Duration of each concurrent run in milliseconds.");
+DEFINE_int32(bcm_chassis_manager_benchmark_writer_hold_us, 100,
+             "Time the writer thread holds chassis_lock for each port state "
+             "change, standing for the SDK calls of the linkscan event "
+             "handler.");
+DEFINE_int32(bcm_chassis_manager_benchmark_writer_interval_us, 1000,
+             "Time between two port state changes of the writer thread.");
+
+namespace stratum {
+namespace hal {
+namespace bcm {
+
+// Populates and cleans up the internal state of a BcmChassisManager.
+class BcmChassisManagerBenchmark {
+ public:
+  struct Port {
+    uint64 node_id;
+    uint32 port_id;
+    SdkPort sdk_port;
+  };
+
+  // Populates the internal state with 'num_ports' singleton ports spread over
+  // 'num_units' units. Returns the ports.
+  static std::vector<Port> Populate(BcmChassisManager* manager, int num_ports,
+                                    int num_units) {
+    std::vector<Port> ports;
+    std::vector<BcmChassisManager::PortRecord> records;
+    for (int unit = 0; unit < num_units; ++unit) {
+      uint64 node_id = unit + 1;
+      manager->node_id_to_unit_[node_id] = unit;
+      manager->unit_to_node_id_[unit] = node_id;
+      manager->node_id_to_port_ids_[node_id] = {};
+    }
+    for (int i = 0; i < num_ports; ++i) {
+      int unit = i % num_units;
+      uint64 node_id = unit + 1;
+      uint32 port_id = i + 1;
+      PortKey singleton_port_key(1, i + 1, 0);
+      auto* bcm_port = new BcmPort();
+      bcm_port->set_unit(unit);
+      bcm_port->set_logical_port(i / num_units + 1);
+      bcm_port->set_slot(singleton_port_key.slot);
+      bcm_port->set_port(singleton_port_key.port);
+      manager->singleton_port_key_to_bcm_port_[singleton_port_key] = bcm_port;
+      manager->node_id_to_port_ids_[node_id].insert(port_id);
+      BcmChassisManager::PortRecord record;
+      record.node_id = node_id;
+      record.port_id = port_id;
+      record.singleton_port_key = singleton_port_key;
+      record.sdk_port = SdkPort(unit, bcm_port->logical_port());
+      record.port_state = PORT_STATE_UP;
+      record.admin_state = ADMIN_STATE_ENABLED;
+      records.push_back(record);
+      ports.push_back({node_id, port_id, record.sdk_port});
+    }
+    manager->SetPortRecords(std::move(records));
+    manager->initialized_ = true;
+    manager->PublishChassisStateSnapshot(true);
+
+    return ports;
+  }
+
+  // Flips the state of the given port and publishes it, holding chassis_lock
+  // for 'hold' in total, as the linkscan event handler does.
+  static void FlipPortState(BcmChassisManager* manager, const Port& port,
+                            absl::Duration hold) {
+    absl::WriterMutexLock l(&chassis_lock);
+    absl::Time start = absl::Now();
+    auto* record = manager->FindPortRecordOrNull(port.sdk_port);
+    CHECK(record != nullptr);
+    record->port_state = record->port_state == PORT_STATE_UP ? PORT_STATE_DOWN
+                                                             : PORT_STATE_UP;
+    manager->PublishChassisStateSnapshot(false);
+    absl::SleepFor(hold - (absl::Now() - start));
+  }
+
+  static void Cleanup(BcmChassisManager* manager) {
+    manager->CleanupInternalState();
+    manager->initialized_ = false;
+  }
+};
+
+namespace {
+
+// Looks up every port 'num_iterations' times and returns the average time of
+// a lookup.
+absl::Duration MeasureLookup(
+    const std::vector<BcmChassisManagerBenchmark::Port>& ports,
+    int num_iterations,
+    const std::function<void(const BcmChassisManagerBenchmark::Port&)>&
+        lookup) {
+  absl::Time start = absl::Now();
+  for (int i = 0; i < num_iterations; ++i) {
+    for (const auto& port : ports) lookup(port);
+  }
+  return (absl::Now() - start) /
+         static_cast<int64>(ports.size() * num_iterations);
+}
+
+void PrintResult(const std::string& name, absl::Duration duration) {
+  std::cout << absl::StrFormat("%-45s %10.1f ns", name,
+                               absl::ToDoubleNanoseconds(duration))
+            << std::endl;
+}
+
+// The results of a concurrent run.
+struct ContentionResult {
+  ContentionResult()
+      : reads(0),
+        writes(0),
+        max_latency(absl::ZeroDuration()),
+        total_latency(absl::ZeroDuration()) {}
+  uint64 reads;
+  uint64 writes;
+  absl::Duration max_latency;
+  absl::Duration total_latency;
+};
+
+// Looks up the ports with GetPortState() from 'num_readers' threads for
+// 'duration', while another thread flips the state of the ports one after the
+// other. If 'take_chassis_lock' is true, the readers hold chassis_lock for
+// each lookup.
+ContentionResult MeasureContention(
+    BcmChassisManager* manager,
+    const std::vector<BcmChassisManagerBenchmark::Port>& ports,
+    int num_readers, absl::Duration duration, absl::Duration writer_hold,
+    absl::Duration writer_interval, bool take_chassis_lock) {
+  std::atomic<bool> done(false);
+  absl::Mutex result_lock;
+  ContentionResult result;
+  std::vector<std::thread> threads;
+  for (int r = 0; r < num_readers; ++r) {
+    threads.emplace_back([&, r]() {
+      ContentionResult reader_result;
+      for (size_t i = r; !done; ++i) {
+        const auto& port = ports[i % ports.size()];
+        absl::Time start = absl::Now();
+        if (take_chassis_lock) {
+          absl::ReaderMutexLock l(&chassis_lock);
+          CHECK(manager->GetPortState(port.node_id, port.port_id).ok());
+        } else {
+          CHECK(manager->GetPortState(port.node_id, port.port_id).ok());
+        }
+        absl::Duration latency = absl::Now() - start;
+        ++reader_result.reads;
+        reader_result.total_latency += latency;
+        reader_result.max_latency = std::max(reader_result.max_latency,
+                                             latency);
+      }
+      absl::MutexLock l(&result_lock);
+      result.reads += reader_result.reads;
+      result.total_latency += reader_result.total_latency;
+      result.max_latency = std::max(result.max_latency,
+                                    reader_result.max_latency);
+    });
+  }
+  threads.emplace_back([&]() {
+    uint64 writes = 0;
+    for (size_t i = 0; !done; ++i) {
+      BcmChassisManagerBenchmark::FlipPortState(
+          manager, ports[i % ports.size()], writer_hold);
+      ++writes;
+      absl::SleepFor(writer_interval);
+    }
+    absl::MutexLock l(&result_lock);
+    result.writes = writes;
+  });
+  absl::SleepFor(duration);
+  done = true;
+  for (auto& thread : threads) thread.join();
+
+  return result;
+}
+
+void PrintContentionResult(const std::string& name, absl::Duration duration,
+                           const ContentionResult& result) {
+  absl::Duration avg_latency =
+      result.reads ? result.total_latency / static_cast<int64>(result.reads)
+                   : absl::ZeroDuration();
+  std::cout << absl::StrFormat(
+                   "%-45s %10.1f Mreads/s  avg %8.1f ns  max %10.1f us  "
+                   "%d writes",
+                   name, result.reads / absl::ToDoubleMicroseconds(duration),
+                   absl::ToDoubleNanoseconds(avg_latency),
+                   absl::ToDoubleMicroseconds(result.max_latency),
+                   result.writes)
+            << std::endl;
+}
+
+}  // namespace
+
+int Main(int argc, char** argv) {
+  InitGoogle(argv[0], &argc, &argv, true);
+  const int num_ports =
+      std::max(FLAGS_bcm_chassis_manager_benchmark_num_ports, 1);
+  const int num_units = std::max(FLAGS_bcm_chassis_manager_benchmark_num_units,
+                                 1);
+  const int num_iterations = FLAGS_bcm_chassis_manager_benchmark_num_iterations;
+  const int num_readers = FLAGS_bcm_chassis_manager_benchmark_num_readers;
+  const absl::Duration duration =
+      absl::Milliseconds(FLAGS_bcm_chassis_manager_benchmark_duration_ms);
+  const absl::Duration writer_hold =
+      absl::Microseconds(FLAGS_bcm_chassis_manager_benchmark_writer_hold_us);
+  const absl::Duration writer_interval = absl::Microseconds(
+      FLAGS_bcm_chassis_manager_benchmark_writer_interval_us);
+
+  ::testing::NiceMock<PhalMock> phal_mock;
+  ::testing::NiceMock<BcmSdkMock> bcm_sdk_mock;
+  ::testing::NiceMock<BcmSerdesDbManagerMock> bcm_serdes_db_manager_mock;
+  auto manager = BcmChassisManager::CreateInstance(
+      OPERATION_MODE_STANDALONE, &phal_mock, &bcm_sdk_mock,
+      &bcm_serdes_db_manager_mock);
+
+  std::vector<BcmChassisManagerBenchmark::Port> ports;
+  absl::Duration populate;
+  {
+    absl::WriterMutexLock l(&chassis_lock);
+    absl::Time start = absl::Now();
+    ports = BcmChassisManagerBenchmark::Populate(manager.get(), num_ports,
+                                                 num_units);
+    populate = absl::Now() - start;
+  }
+  std::cout << num_ports << " ports on " << num_units << " unit(s), "
+            << num_iterations << " iterations." << std::endl;
+  PrintResult("populate (total)", populate);
+  PrintResult(
+      "GetPortState(node_id, port_id)",
+      MeasureLookup(ports, num_iterations,
+                    [&manager](const BcmChassisManagerBenchmark::Port& p) {
+                      CHECK(manager->GetPortState(p.node_id, p.port_id).ok());
+                    }));
+  PrintResult("GetPortState(sdk_port)",
+              MeasureLookup(
+                  ports, num_iterations,
+                  [&manager](const BcmChassisManagerBenchmark::Port& p) {
+                    CHECK(manager->GetPortState(p.sdk_port).ok());
+                  }));
+  PrintResult(
+      "GetPortAdminState(node_id, port_id)",
+      MeasureLookup(ports, num_iterations,
+                    [&manager](const BcmChassisManagerBenchmark::Port& p) {
+                      CHECK(manager->GetPortAdminState(p.node_id, p.port_id)
+                                .ok());
+                    }));
+  PrintResult(
+      "GetBcmPort(node_id, port_id)",
+      MeasureLookup(ports, num_iterations,
+                    [&manager](const BcmChassisManagerBenchmark::Port& p) {
+                      CHECK(manager->GetBcmPort(p.node_id, p.port_id).ok());
+                    }));
+
+  // The same lookups on nested std::maps, for reference.
+  std::map<uint64, std::map<uint32, PortState>> node_id_to_port_id_to_state;
+  std::map<uint64, std::map<SdkPort, uint32>> node_id_to_sdk_port_to_port_id;
+  std::map<int, uint64> unit_to_node_id;
+  for (const auto& p : ports) {
+    node_id_to_port_id_to_state[p.node_id][p.port_id] = PORT_STATE_UP;
+    node_id_to_sdk_port_to_port_id[p.node_id][p.sdk_port] = p.port_id;
+    unit_to_node_id[p.sdk_port.unit] = p.node_id;
+  }
+  PrintResult(
+      "nested std::map (node_id, port_id)",
+      MeasureLookup(ports, num_iterations,
+                    [&](const BcmChassisManagerBenchmark::Port& p) {
+                      CHECK(node_id_to_port_id_to_state.at(p.node_id).count(
+                          p.port_id));
+                    }));
+  PrintResult(
+      "nested std::map (sdk_port)",
+      MeasureLookup(ports, num_iterations,
+                    [&](const BcmChassisManagerBenchmark::Port& p) {
+                      uint64 node_id = unit_to_node_id.at(p.sdk_port.unit);
+                      uint32 port_id = node_id_to_sdk_port_to_port_id
+                                           .at(node_id)
+                                           .at(p.sdk_port);
+                      CHECK(node_id_to_port_id_to_state.at(node_id).count(
+                          port_id));
+                    }));
+
+  // Concurrent lookups.
+  std::cout << num_readers << " reader(s), a writer holding chassis_lock for "
+            << absl::FormatDuration(writer_hold) << " every "
+            << absl::FormatDuration(writer_interval) << "." << std::endl;
+  PrintContentionResult(
+      "GetPortState() under chassis_lock", duration,
+      MeasureContention(manager.get(), ports, num_readers, duration,
+                        writer_hold, writer_interval, true));
+  PrintContentionResult(
+      "GetPortState() from the snapshot", duration,
+      MeasureContention(manager.get(), ports, num_readers, duration,
+                        writer_hold, writer_interval, false));
+
+  {
+    absl::WriterMutexLock l(&chassis_lock);
+    BcmChassisManagerBenchmark::Cleanup(manager.get());
+  }
+
+  return 0;
+}
+
+}  // namespace bcm
+}  // namespace hal
+}  // namespace stratum
+
+int main(int argc, char** argv) { return stratum::hal::bcm::Main(argc, argv); }
@@ -42,6 +42,8 @@
 #include "absl/strings/match.h"
 #include "absl/strings/str_cat.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 
 DECLARE_string(base_bcm_chassis_map_file);
 DECLARE_string(applied_bcm_chassis_map_file);
@@ -50,12 +52,15 @@ DECLARE_string(bcm_sdk_config_flush_file);
 DECLARE_string(bcm_sdk_shell_log_file);
 DECLARE_string(bcm_sdk_checkpoint_dir);
 DECLARE_string(test_tmpdir);
+DECLARE_int32(bcm_port_counters_poll_interval_ms);
 
 using ::testing::_;
+using ::testing::DoAll;
 using ::testing::HasSubstr;
 using ::testing::Matcher;
 using ::testing::Mock;
 using ::testing::Return;
+using ::testing::SetArgPointee;
 
 namespace stratum {
 namespace hal {
@@ -91,6 +96,8 @@ class BcmChassisManagerTest : public ::testing::TestWithParam<OperationMode> {
     FLAGS_bcm_sdk_config_flush_file = FLAGS_test_tmpdir + "/config.bcm.tmp";
     FLAGS_bcm_sdk_shell_log_file = FLAGS_test_tmpdir + "/bcm.log";
     FLAGS_bcm_sdk_checkpoint_dir = FLAGS_test_tmpdir + "/sdk_checkpoint/";
+    // Tests poll the port counters explicitly using PollPortCounters().
+    FLAGS_bcm_port_counters_poll_interval_ms = 0;
   }
 
   void SetUp() override {
@@ -118,7 +125,8 @@ class BcmChassisManagerTest : public ::testing::TestWithParam<OperationMode> {
   }
 
   void TriggerLinkscanEvent(int unit, int logical_port, PortState state) {
-    bcm_chassis_manager_->LinkscanEventHandler(unit, logical_port, state);
+    bcm_chassis_manager_->LinkscanEventHandler(unit, logical_port, state,
+                                               absl::Now());
   }
 
   ::util::Status CheckCleanInternalState() {
@@ -133,33 +141,22 @@ class BcmChassisManagerTest : public ::testing::TestWithParam<OperationMode> {
     CHECK_RETURN_IF_FALSE(bcm_chassis_manager_->unit_to_node_id_.empty());
     CHECK_RETURN_IF_FALSE(bcm_chassis_manager_->node_id_to_port_ids_.empty());
     CHECK_RETURN_IF_FALSE(bcm_chassis_manager_->node_id_to_trunk_ids_.empty());
+    CHECK_RETURN_IF_FALSE(bcm_chassis_manager_->port_records_.empty());
     CHECK_RETURN_IF_FALSE(
-        bcm_chassis_manager_->node_id_to_port_id_to_singleton_port_key_
-            .empty());
+        bcm_chassis_manager_->node_id_and_port_id_to_port_handle_.empty());
     CHECK_RETURN_IF_FALSE(
-        bcm_chassis_manager_->node_id_to_port_id_to_sdk_port_.empty());
+        bcm_chassis_manager_->sdk_port_to_port_handle_.empty());
     CHECK_RETURN_IF_FALSE(
         bcm_chassis_manager_->node_id_to_trunk_id_to_sdk_trunk_.empty());
-    CHECK_RETURN_IF_FALSE(
-        bcm_chassis_manager_->node_id_to_sdk_port_to_port_id_.empty());
     CHECK_RETURN_IF_FALSE(
         bcm_chassis_manager_->node_id_to_sdk_trunk_to_trunk_id_.empty());
     CHECK_RETURN_IF_FALSE(
         bcm_chassis_manager_->xcvr_port_key_to_xcvr_state_.empty());
 
-    CHECK_RETURN_IF_FALSE(
-        bcm_chassis_manager_->node_id_to_port_id_to_port_state_.empty());
     CHECK_RETURN_IF_FALSE(
         bcm_chassis_manager_->node_id_to_trunk_id_to_trunk_state_.empty());
     CHECK_RETURN_IF_FALSE(
         bcm_chassis_manager_->node_id_to_trunk_id_to_members_.empty());
-    CHECK_RETURN_IF_FALSE(
-        bcm_chassis_manager_->node_id_to_port_id_to_trunk_membership_info_
-            .empty());
-    CHECK_RETURN_IF_FALSE(
-        bcm_chassis_manager_->node_id_to_port_id_to_admin_state_.empty());
-    CHECK_RETURN_IF_FALSE(
-        bcm_chassis_manager_->node_id_to_port_id_to_health_state_.empty());
     CHECK_RETURN_IF_FALSE(bcm_chassis_manager_->base_bcm_chassis_map_ ==
                           nullptr);
     CHECK_RETURN_IF_FALSE(bcm_chassis_manager_->applied_bcm_chassis_map_ ==
@@ -167,6 +164,13 @@ class BcmChassisManagerTest : public ::testing::TestWithParam<OperationMode> {
     CHECK_RETURN_IF_FALSE(bcm_chassis_manager_->xcvr_event_channel_ == nullptr);
     CHECK_RETURN_IF_FALSE(bcm_chassis_manager_->linkscan_event_channel_ ==
                           nullptr);
+    CHECK_RETURN_IF_FALSE(bcm_chassis_manager_->GetChassisStateSnapshot() ==
+                          nullptr);
+    {
+      absl::MutexLock l(&bcm_chassis_manager_->port_counters_lock_);
+      CHECK_RETURN_IF_FALSE(
+          bcm_chassis_manager_->node_id_to_port_id_to_port_counters_.empty());
+    }
 
     return ::util::OkStatus();
   }
@@ -182,6 +186,11 @@ class BcmChassisManagerTest : public ::testing::TestWithParam<OperationMode> {
     return bcm_chassis_manager_->VerifyChassisConfig(config);
   }
 
+  BcmChassisManager::ChassisConfigDiff DiffChassisConfig(
+      const ChassisConfig& old_config, const ChassisConfig& new_config) {
+    return BcmChassisManager::DiffChassisConfig(old_config, new_config);
+  }
+
   ::util::Status Shutdown() {
     {
       absl::WriterMutexLock l(&chassis_lock);
@@ -271,6 +280,22 @@ class BcmChassisManagerTest : public ::testing::TestWithParam<OperationMode> {
     return bcm_chassis_manager_->GetPortAdminState(node_id, port_id);
   }
 
+  ::util::Status GetPortCounters(uint64 node_id, uint32 port_id,
+                                 PortCounters* pc) const {
+    absl::ReaderMutexLock l(&chassis_lock);
+    return bcm_chassis_manager_->GetPortCounters(node_id, port_id, pc);
+  }
+
+  ::util::Status GetPortCounterRates(uint64 node_id, uint32 port_id,
+                                     PortCounters* rates) const {
+    absl::ReaderMutexLock l(&chassis_lock);
+    return bcm_chassis_manager_->GetPortCounterRates(node_id, port_id, rates);
+  }
+
+  void PollPortCounters(absl::Time now) {
+    bcm_chassis_manager_->PollPortCounters(now);
+  }
+
   ::util::Status SetTrunkMemberBlockState(uint64 node_id, uint32 trunk_id,
                                           uint32 port_id,
                                           TrunkMemberBlockState state) {
@@ -4533,6 +4558,9 @@ TEST_P(BcmChassisManagerTest, GetPortStateAfterConfigPushAndLinkEvent) {
   EXPECT_CALL(*bcm_node_mocks_[0], UpdatePortState(kPortId))
       .WillOnce(Return(::util::OkStatus()))
       .WillOnce(Return(::util::UnknownErrorBuilder(GTL_LOC) << "error"));
+  // Only the port going down is pruned from the multipath groups.
+  EXPECT_CALL(*bcm_node_mocks_[0], PrunePortFromMultipathGroups(34))
+      .WillOnce(Return(::util::OkStatus()));
   EXPECT_CALL(*gnmi_event_writer,
               Write(Matcher<const GnmiEventPtr&>(GnmiEventEq(link_down))))
       .WillOnce(Return(true));
@@ -4561,6 +4589,15 @@ TEST_P(BcmChassisManagerTest, GetPortStateAfterConfigPushAndLinkEvent) {
   ASSERT_OK(PushChassisConfig(config));
   ASSERT_TRUE(Initialized());
 
+  // The config push publishes a snapshot of the chassis state.
+  auto snapshot = bcm_chassis_manager_->GetChassisStateSnapshot();
+  ASSERT_NE(nullptr, snapshot);
+  {
+    auto ret = snapshot->GetPortState(kNodeId, kPortId);
+    ASSERT_TRUE(ret.ok());
+    EXPECT_EQ(PORT_STATE_UNKNOWN, ret.ValueOrDie());
+  }
+
   // Register gNMI event writer.
   EXPECT_OK(RegisterEventNotifyWriter(gnmi_event_writer));
 
@@ -4573,12 +4610,33 @@ TEST_P(BcmChassisManagerTest, GetPortStateAfterConfigPushAndLinkEvent) {
     ASSERT_TRUE(ret.ok());
     EXPECT_EQ(PORT_STATE_DOWN, ret.ValueOrDie());
   }
+  {
+    // Only the event of the known port published a new snapshot. The old
+    // snapshot is left unchanged.
+    auto new_snapshot = bcm_chassis_manager_->GetChassisStateSnapshot();
+    ASSERT_NE(nullptr, new_snapshot);
+    EXPECT_EQ(snapshot->version + 1, new_snapshot->version);
+    // A linkscan event does not change the config, which is shared.
+    EXPECT_EQ(snapshot->config, new_snapshot->config);
+    auto ret = new_snapshot->GetPortState(SdkPort(0, 34));
+    ASSERT_TRUE(ret.ok());
+    EXPECT_EQ(PORT_STATE_DOWN, ret.ValueOrDie());
+    ret = snapshot->GetPortState(SdkPort(0, 34));
+    ASSERT_TRUE(ret.ok());
+    EXPECT_EQ(PORT_STATE_UNKNOWN, ret.ValueOrDie());
+  }
   TriggerLinkscanEvent(0, 34, PORT_STATE_UP);
   {
     auto ret = GetPortState(kNodeId, kPortId);
     ASSERT_TRUE(ret.ok());
     EXPECT_EQ(PORT_STATE_UP, ret.ValueOrDie());
   }
+  {
+    auto stats = bcm_chassis_manager_->GetLinkDownFailoverStats();
+    EXPECT_EQ(1U, stats.events);
+    EXPECT_EQ(0U, stats.failures);
+    EXPECT_EQ(stats.last_latency, stats.max_latency);
+  }
 
   // Push config again. The state of the port will not change.
   ASSERT_OK(PushChassisConfig(config));
@@ -4587,6 +4645,10 @@ TEST_P(BcmChassisManagerTest, GetPortStateAfterConfigPushAndLinkEvent) {
     auto ret = GetPortState(kNodeId, kPortId);
     ASSERT_TRUE(ret.ok());
     EXPECT_EQ(PORT_STATE_UP, ret.ValueOrDie());
+    // A config push rebuilds the config part of the snapshot.
+    auto new_snapshot = bcm_chassis_manager_->GetChassisStateSnapshot();
+    ASSERT_NE(nullptr, new_snapshot);
+    EXPECT_NE(snapshot->config, new_snapshot->config);
   }
 
   // Now shutdown and verify things are all reset after shutdown.
@@ -4597,6 +4659,13 @@ TEST_P(BcmChassisManagerTest, GetPortStateAfterConfigPushAndLinkEvent) {
     ASSERT_FALSE(ret.ok());
     EXPECT_THAT(ret.status().error_message(), HasSubstr("Not initialized"));
   }
+  EXPECT_EQ(nullptr, bcm_chassis_manager_->GetChassisStateSnapshot());
+  // The snapshots still held by the readers stay valid.
+  {
+    auto ret = snapshot->GetPortState(kNodeId, kPortId);
+    ASSERT_TRUE(ret.ok());
+    EXPECT_EQ(PORT_STATE_UNKNOWN, ret.ValueOrDie());
+  }
 }
 
 TEST_P(BcmChassisManagerTest, InitializeBcmChipsSuccess) {
@@ -5235,6 +5304,148 @@ TEST_P(BcmChassisManagerTest, TestSetPortAdminStateViaConfigPush) {
   ASSERT_OK(ShutdownAndTestCleanState());
 }
 
+TEST_P(BcmChassisManagerTest, TestSetPortAdminStateRetriedAfterFailedPush) {
+  ChassisConfig config;
+  ASSERT_OK(PushTestConfig(&config));
+  for (auto& singleton_port : *config.mutable_singleton_ports()) {
+    singleton_port.mutable_config_params()->set_admin_state(
+        ADMIN_STATE_DISABLED);
+  }
+
+  // The SDK fails to disable the port. The push fails and the port is still
+  // enabled.
+  ::util::Status error(StratumErrorSpace(), ERR_UNKNOWN, "Test");
+  EXPECT_CALL(*bcm_sdk_mock_, SetPortOptions(0, 34, _))
+      .Times(2)
+      .WillRepeatedly(Return(error));
+  ASSERT_OK(VerifyChassisConfig(config));
+  EXPECT_FALSE(PushChassisConfig(config).ok());
+  auto admin_state = GetPortAdminState(kNodeId, kPortId);
+  ASSERT_TRUE(admin_state.ok());
+  EXPECT_EQ(ADMIN_STATE_ENABLED, admin_state.ValueOrDie());
+
+  // The same config is pushed again. The port is disabled this time.
+  EXPECT_CALL(*bcm_sdk_mock_, SetPortOptions(0, 34, _))
+      .Times(2)
+      .WillRepeatedly(Return(::util::OkStatus()));
+  ASSERT_OK(PushChassisConfig(config));
+  admin_state = GetPortAdminState(kNodeId, kPortId);
+  ASSERT_TRUE(admin_state.ok());
+  EXPECT_EQ(ADMIN_STATE_DISABLED, admin_state.ValueOrDie());
+
+  ASSERT_OK(ShutdownAndTestCleanState());
+}
+
+TEST_P(BcmChassisManagerTest, TestDiffChassisConfig) {
+  const std::string kConfigText = R"(
+      chassis {
+        platform: PLT_GENERIC_TOMAHAWK
+        name: "standalone"
+      }
+      nodes {
+        id: 7654321
+        slot: 1
+      }
+      singleton_ports {
+        id: 12345
+        slot: 1
+        port: 1
+        speed_bps: 100000000000
+        node: 7654321
+        config_params {
+          admin_state: ADMIN_STATE_ENABLED
+        }
+      }
+      singleton_ports {
+        id: 12346
+        slot: 1
+        port: 2
+        speed_bps: 100000000000
+        node: 7654321
+      }
+      trunk_ports {
+        id: 222
+        node: 7654321
+        type: STATIC_TRUNK
+        members: 12345
+      }
+  )";
+  ChassisConfig old_config;
+  ASSERT_OK(ParseProtoFromString(kConfigText, &old_config));
+
+  // No change at all.
+  {
+    auto diff = DiffChassisConfig(old_config, old_config);
+    EXPECT_FALSE(diff.full_sync_required);
+    EXPECT_TRUE(diff.changed_node_ids.empty());
+    EXPECT_TRUE(diff.changed_singleton_ports.empty());
+    EXPECT_TRUE(diff.changed_trunk_ports.empty());
+    EXPECT_TRUE(diff.updated_singleton_ports.empty());
+  }
+
+  // Only the config params of one port changed. The order of the ports does
+  // not matter.
+  {
+    ChassisConfig new_config = old_config;
+    new_config.mutable_singleton_ports()->SwapElements(0, 1);
+    new_config.mutable_singleton_ports(1)
+        ->mutable_config_params()
+        ->set_admin_state(ADMIN_STATE_DISABLED);
+    new_config.mutable_singleton_ports(0)->set_name("port-2");
+    auto diff = DiffChassisConfig(old_config, new_config);
+    EXPECT_FALSE(diff.full_sync_required);
+    EXPECT_EQ(2U, diff.changed_singleton_ports.size());
+    ASSERT_EQ(1U, diff.updated_singleton_ports.size());
+    EXPECT_EQ(kPortId, diff.updated_singleton_ports[0]->id());
+    EXPECT_EQ(&new_config.singleton_ports(1), diff.updated_singleton_ports[0]);
+  }
+
+  // The speed of a port changed.
+  {
+    ChassisConfig new_config = old_config;
+    new_config.mutable_singleton_ports(0)->set_speed_bps(40000000000);
+    auto diff = DiffChassisConfig(old_config, new_config);
+    EXPECT_TRUE(diff.full_sync_required);
+    EXPECT_EQ(1U, diff.changed_singleton_ports.count(
+                      std::make_pair(kNodeId, kPortId)));
+  }
+
+  // A port was removed.
+  {
+    ChassisConfig new_config = old_config;
+    new_config.mutable_singleton_ports()->RemoveLast();
+    auto diff = DiffChassisConfig(old_config, new_config);
+    EXPECT_TRUE(diff.full_sync_required);
+    EXPECT_EQ(1U, diff.changed_singleton_ports.size());
+  }
+
+  // A trunk changed.
+  {
+    ChassisConfig new_config = old_config;
+    new_config.mutable_trunk_ports(0)->set_type(TrunkPort::LACP_TRUNK);
+    auto diff = DiffChassisConfig(old_config, new_config);
+    EXPECT_TRUE(diff.full_sync_required);
+    EXPECT_EQ(1U, diff.changed_trunk_ports.size());
+  }
+
+  // A node changed.
+  {
+    ChassisConfig new_config = old_config;
+    new_config.mutable_nodes(0)->set_name("node-1");
+    auto diff = DiffChassisConfig(old_config, new_config);
+    EXPECT_TRUE(diff.full_sync_required);
+    EXPECT_EQ(1U, diff.changed_node_ids.count(kNodeId));
+  }
+
+  // Something else changed.
+  {
+    ChassisConfig new_config = old_config;
+    new_config.set_description("new");
+    auto diff = DiffChassisConfig(old_config, new_config);
+    EXPECT_TRUE(diff.full_sync_required);
+  }
+}
+
 TEST_P(BcmChassisManagerTest, TestSetPortAdminStateByController) {
   ASSERT_OK(PushTestConfig());
 
@@ -5255,6 +5466,39 @@ TEST_P(BcmChassisManagerTest, TestSetPortHealthStateByController) {
   ASSERT_OK(ShutdownAndTestCleanState());
 }
 
+TEST_P(BcmChassisManagerTest, TestGetPortCountersFromCache) {
+  ASSERT_OK(PushTestConfig());
+
+  PortCounters first_counters, second_counters;
+  first_counters.set_in_octets(1000);
+  first_counters.set_out_octets(500);
+  second_counters.set_in_octets(3000);
+  second_counters.set_out_octets(100);  // cleared
+  // Port kPortId on node kNodeId is logical port 34 on unit 0.
+  EXPECT_CALL(*bcm_sdk_mock_, GetPortCounters(0, 34, _))
+      .WillOnce(DoAll(SetArgPointee<2>(first_counters),
+                      Return(::util::OkStatus())))
+      .WillOnce(DoAll(SetArgPointee<2>(second_counters),
+                      Return(::util::OkStatus())));
+
+  const absl::Time now = absl::Now();
+  PortCounters rates;
+  PollPortCounters(now - absl::Seconds(2));
+  EXPECT_EQ(ERR_ENTRY_NOT_FOUND,
+            GetPortCounterRates(kNodeId, kPortId, &rates).error_code());
+  PollPortCounters(now);
+
+  // Both are served from the cache, without calling the SDK.
+  PortCounters counters;
+  ASSERT_OK(GetPortCounters(kNodeId, kPortId, &counters));
+  EXPECT_THAT(counters, EqualsProto(second_counters));
+  ASSERT_OK(GetPortCounterRates(kNodeId, kPortId, &rates));
+  EXPECT_EQ(1000U, rates.in_octets());
+  EXPECT_EQ(0U, rates.out_octets());
+
+  ASSERT_OK(ShutdownAndTestCleanState());
+}
+
 INSTANTIATE_TEST_SUITE_P(BcmChassisManagerTestWithMode, BcmChassisManagerTest,
                         ::testing::Values(OPERATION_MODE_STANDALONE));
 
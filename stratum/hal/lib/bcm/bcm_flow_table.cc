@@ -0,0 +1,347 @@
+// Copyright 2018 Google LLC
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "stratum/hal/lib/bcm/bcm_flow_table.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "google/protobuf/wire_format.h"
+#include "stratum/glue/logging.h"
+#include "absl/container/inlined_vector.h"
+
+namespace stratum {
+namespace hal {
+namespace bcm {
+
+namespace {
+
+// Appends the raw bytes of a fixed-size value to the key. The key is never
+// persisted, so the host byte order is fine.
+template <typename T>
+void AppendFixed(T value, std::string* bytes) {
+  char buf[sizeof(T)];
+  std::memcpy(buf, &value, sizeof(T));
+  bytes->append(buf, sizeof(T));
+}
+
+// Appends a length-prefixed byte string to the key, so that the boundaries
+// between consecutive values are unambiguous.
+void AppendBytes(const std::string& value, std::string* bytes) {
+  AppendFixed<uint32>(value.size(), bytes);
+  bytes->append(value);
+}
+
+// Reads back a value written by AppendFixed(). Returns false if the key is
+// too short.
+template <typename T>
+bool ReadFixed(absl::string_view* bytes, T* value) {
+  if (bytes->size() < sizeof(T)) return false;
+  std::memcpy(value, bytes->data(), sizeof(T));
+  bytes->remove_prefix(sizeof(T));
+  return true;
+}
+
+// Reads back a value written by AppendBytes(). Returns false if the key is
+// too short.
+bool ReadBytes(absl::string_view* bytes, std::string* value) {
+  uint32 size = 0;
+  if (!ReadFixed(bytes, &size) || bytes->size() < size) return false;
+  value->assign(bytes->data(), size);
+  bytes->remove_prefix(size);
+  return true;
+}
+
+// Returns the number of bytes AppendMatch() appends for the given match.
+size_t MatchSize(const ::p4::v1::FieldMatch& match) {
+  // field_id + match type + one length prefix per value.
+  size_t size = sizeof(uint32) + sizeof(uint8);
+  switch (match.field_match_type_case()) {
+    case ::p4::v1::FieldMatch::kExact:
+      return size + sizeof(uint32) + match.exact().value().size();
+    case ::p4::v1::FieldMatch::kTernary:
+      return size + 2 * sizeof(uint32) + match.ternary().value().size() +
+             match.ternary().mask().size();
+    case ::p4::v1::FieldMatch::kLpm:
+      return size + sizeof(uint32) + match.lpm().value().size() +
+             sizeof(int32);
+    case ::p4::v1::FieldMatch::kRange:
+      return size + 2 * sizeof(uint32) + match.range().low().size() +
+             match.range().high().size();
+    default:
+      return size;  // only a hint, rare match types are serialized.
+  }
+}
+
+void AppendMatch(const ::p4::v1::FieldMatch& match, std::string* bytes) {
+  AppendFixed<uint32>(match.field_id(), bytes);
+  AppendFixed<uint8>(match.field_match_type_case(), bytes);
+  switch (match.field_match_type_case()) {
+    case ::p4::v1::FieldMatch::kExact:
+      AppendBytes(match.exact().value(), bytes);
+      break;
+    case ::p4::v1::FieldMatch::kTernary:
+      AppendBytes(match.ternary().value(), bytes);
+      AppendBytes(match.ternary().mask(), bytes);
+      break;
+    case ::p4::v1::FieldMatch::kLpm:
+      AppendBytes(match.lpm().value(), bytes);
+      AppendFixed<int32>(match.lpm().prefix_len(), bytes);
+      break;
+    case ::p4::v1::FieldMatch::kRange:
+      AppendBytes(match.range().low(), bytes);
+      AppendBytes(match.range().high(), bytes);
+      break;
+    default:
+      // Match types we do not program on BCM. Fall back to the serialized
+      // proto, which is still a deterministic function of the match.
+      AppendBytes(ProtoSerialize(match), bytes);
+      break;
+  }
+}
+
+// Reads back a match written by AppendMatch(). Returns false if the key is
+// malformed.
+bool ReadMatch(absl::string_view* bytes, ::p4::v1::FieldMatch* match) {
+  uint32 field_id = 0;
+  uint8 match_type = 0;
+  if (!ReadFixed(bytes, &field_id) || !ReadFixed(bytes, &match_type)) {
+    return false;
+  }
+  match->set_field_id(field_id);
+  switch (match_type) {
+    case ::p4::v1::FieldMatch::kExact:
+      return ReadBytes(bytes, match->mutable_exact()->mutable_value());
+    case ::p4::v1::FieldMatch::kTernary:
+      return ReadBytes(bytes, match->mutable_ternary()->mutable_value()) &&
+             ReadBytes(bytes, match->mutable_ternary()->mutable_mask());
+    case ::p4::v1::FieldMatch::kLpm: {
+      int32 prefix_len = 0;
+      if (!ReadBytes(bytes, match->mutable_lpm()->mutable_value()) ||
+          !ReadFixed(bytes, &prefix_len)) {
+        return false;
+      }
+      match->mutable_lpm()->set_prefix_len(prefix_len);
+      return true;
+    }
+    case ::p4::v1::FieldMatch::kRange:
+      return ReadBytes(bytes, match->mutable_range()->mutable_low()) &&
+             ReadBytes(bytes, match->mutable_range()->mutable_high());
+    default: {
+      std::string serialized;
+      return ReadBytes(bytes, &serialized) &&
+             match->ParseFromString(serialized);
+    }
+  }
+}
+
+// Orders match fields by field_id. P4Runtime does not allow repeated field
+// IDs, but we still break ties on the encoded match to keep the key canonical.
+bool MatchLess(const ::p4::v1::FieldMatch* l, const ::p4::v1::FieldMatch* r) {
+  if (l->field_id() != r->field_id()) return l->field_id() < r->field_id();
+  std::string lb, rb;
+  AppendMatch(*l, &lb);
+  AppendMatch(*r, &rb);
+  return lb < rb;
+}
+
+// Returns true if the TableEntry field is covered by the TableEntryKey.
+bool IsKeyField(const ::google::protobuf::FieldDescriptor* field) {
+  switch (field->number()) {
+    case ::p4::v1::TableEntry::kMatchFieldNumber:
+    case ::p4::v1::TableEntry::kPriorityFieldNumber:
+    case ::p4::v1::TableEntry::kIsDefaultActionFieldNumber:
+    case ::p4::v1::TableEntry::kIdleTimeoutNsFieldNumber:
+      return true;
+    default:
+      return false;
+  }
+}
+
+}  // namespace
+
+TableEntryKey::TableEntryKey(const ::p4::v1::TableEntry& entry) : bytes_() {
+  // Sort pointers to the match fields, not the fields themselves, so the proto
+  // is never copied. Most tables have only a handful of match fields.
+  absl::InlinedVector<const ::p4::v1::FieldMatch*, 8> matches;
+  size_t size = sizeof(int32) + sizeof(uint8) + sizeof(int64);
+  for (const auto& match : entry.match()) {
+    matches.push_back(&match);
+    size += MatchSize(match);
+  }
+  std::sort(matches.begin(), matches.end(), MatchLess);
+  bytes_.reserve(size);
+  AppendFixed<int32>(entry.priority(), &bytes_);
+  AppendFixed<uint8>(entry.is_default_action(), &bytes_);
+  AppendFixed<int64>(entry.idle_timeout_ns(), &bytes_);
+  for (const auto* match : matches) AppendMatch(*match, &bytes_);
+}
+
+PackedTableEntry::PackedTableEntry(const ::p4::v1::TableEntry& entry)
+    : data_(), key_size_(0), size_(0) {
+  using ::google::protobuf::internal::WireFormat;
+  TableEntryKey key(entry);
+  // Everything not covered by the key goes into the payload, including any
+  // field we do not know about. The fields are serialized straight from the
+  // entry into the heap block, in field number order, so the payload parses
+  // back as a TableEntry with only the non-key fields set.
+  const auto* reflection = entry.GetReflection();
+  std::vector<const ::google::protobuf::FieldDescriptor*> fields;
+  reflection->ListFields(entry, &fields);
+  fields.erase(std::remove_if(fields.begin(), fields.end(), IsKeyField),
+               fields.end());
+  const auto& unknown_fields = reflection->GetUnknownFields(entry);
+  // FieldByteSize() also caches the sizes of the sub-messages, as needed by
+  // SerializeFieldWithCachedSizes() below.
+  size_t payload_size = WireFormat::ComputeUnknownFieldsSize(unknown_fields);
+  for (const auto* field : fields) {
+    payload_size += WireFormat::FieldByteSize(field, entry);
+  }
+  key_size_ = key.bytes().size();
+  size_ = key_size_ + payload_size;
+  data_.reset(new char[size_]);
+  std::memcpy(data_.get(), key.bytes().data(), key_size_);
+  ::google::protobuf::io::ArrayOutputStream array_out_stream(
+      data_.get() + key_size_, static_cast<int>(payload_size));
+  ::google::protobuf::io::CodedOutputStream coded_out_stream(&array_out_stream);
+  for (const auto* field : fields) {
+    WireFormat::SerializeFieldWithCachedSizes(field, entry, &coded_out_stream);
+  }
+  WireFormat::SerializeUnknownFields(unknown_fields, &coded_out_stream);
+}
+
+PackedTableEntry::PackedTableEntry(const PackedTableEntry& other)
+    : data_(new char[other.size_]),
+      key_size_(other.key_size_),
+      size_(other.size_) {
+  std::memcpy(data_.get(), other.data_.get(), size_);
+}
+
+PackedTableEntry& PackedTableEntry::operator=(const PackedTableEntry& other) {
+  if (this != &other) *this = PackedTableEntry(other);
+  return *this;
+}
+
+::util::StatusOr<::p4::v1::TableEntry> PackedTableEntry::Unpack() const {
+  ::p4::v1::TableEntry entry;
+  absl::string_view rest = payload();
+  absl::string_view key = this->key();
+  int32 priority = 0;
+  uint8 is_default_action = 0;
+  int64 idle_timeout_ns = 0;
+  bool ok = entry.ParseFromArray(rest.data(), rest.size()) &&
+            ReadFixed(&key, &priority) && ReadFixed(&key, &is_default_action) &&
+            ReadFixed(&key, &idle_timeout_ns);
+  while (ok && !key.empty()) ok = ReadMatch(&key, entry.add_match());
+  if (!ok) {
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "Corrupted packed TableEntry for table " << entry.table_id()
+           << ".";
+  }
+  entry.set_priority(priority);
+  entry.set_is_default_action(is_default_action);
+  entry.set_idle_timeout_ns(idle_timeout_ns);
+  return entry;
+}
+
+const ::p4::v1::TableEntry& TableEntryConstIterator::operator*() const {
+  if (!unpacked_) {
+    // Unpack() logs the error, if any. A corrupted entry reads as empty.
+    ::util::StatusOr<::p4::v1::TableEntry> entry = it_->Unpack();
+    if (entry.ok()) {
+      entry_ = entry.ConsumeValueOrDie();
+    } else {
+      entry_.Clear();
+    }
+    unpacked_ = true;
+  }
+  return entry_;
+}
+
+::util::StatusOr<::p4::v1::TableEntry> BcmFlowTable::Lookup(
+    const ::p4::v1::TableEntry& key) const {
+  auto lookup = entries_.find(TableEntryKey(key).bytes());
+  if (lookup == entries_.end()) {
+    return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+           << TableStr()
+           << " does not contain TableEntry: " << key.ShortDebugString();
+  }
+  return lookup->Unpack();
+}
+
+::util::Status BcmFlowTable::InsertEntry(const ::p4::v1::TableEntry& entry) {
+  auto result = entries_.insert(PackedTableEntry(entry));
+  if (!result.second) {
+    ASSIGN_OR_RETURN(::p4::v1::TableEntry existing, result.first->Unpack());
+    return MAKE_ERROR(ERR_ENTRY_EXISTS)
+           << TableStr() << " contains duplicate of TableEntry: "
+           << entry.ShortDebugString() << ". Matching TableEntry: "
+           << existing.ShortDebugString() << ".";
+  }
+  entry_bytes_ += result.first->size();
+  return ::util::OkStatus();
+}
+
+::util::Status BcmFlowTable::DryRunInsertEntry(
+    const ::p4::v1::TableEntry& entry) const {
+  const auto result = entries_.find(TableEntryKey(entry).bytes());
+  if (result != entries_.end()) {
+    ASSIGN_OR_RETURN(::p4::v1::TableEntry existing, result->Unpack());
+    return MAKE_ERROR(ERR_ENTRY_EXISTS)
+           << TableStr() << " contains duplicate of TableEntry: "
+           << entry.ShortDebugString() << ". Matching TableEntry: "
+           << existing.ShortDebugString() << ".";
+  }
+  return ::util::OkStatus();
+}
+
+::util::StatusOr<::p4::v1::TableEntry> BcmFlowTable::ModifyEntry(
+    const ::p4::v1::TableEntry& entry) {
+  PackedTableEntry packed(entry);
+  auto lookup = entries_.find(packed.key());
+  if (lookup == entries_.end()) {
+    return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+           << TableStr()
+           << " does not contain TableEntry: " << entry.ShortDebugString()
+           << ".";
+  }
+  ASSIGN_OR_RETURN(::p4::v1::TableEntry old_entry, lookup->Unpack());
+  entry_bytes_ -= lookup->size();
+  entries_.erase(lookup);
+  entry_bytes_ += packed.size();
+  entries_.insert(std::move(packed));
+  return old_entry;
+}
+
+::util::StatusOr<::p4::v1::TableEntry> BcmFlowTable::DeleteEntry(
+    const ::p4::v1::TableEntry& key) {
+  const auto lookup = entries_.find(TableEntryKey(key).bytes());
+  if (lookup == entries_.end()) {
+    return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+           << TableStr()
+           << " does not contain TableEntry: " << key.ShortDebugString()
+           << ".";
+  }
+  ASSIGN_OR_RETURN(::p4::v1::TableEntry entry, lookup->Unpack());
+  entry_bytes_ -= lookup->size();
+  entries_.erase(lookup);
+  return entry;
+}
+
+}  // namespace bcm
+}  // namespace hal
+}  // namespace stratum
@@ -19,15 +19,19 @@
 #ifndef STRATUM_HAL_LIB_BCM_BCM_FLOW_TABLE_H_
 #define STRATUM_HAL_LIB_BCM_BCM_FLOW_TABLE_H_
 
-#include <utility>
+#include <cstddef>
+#include <iterator>
+#include <memory>
 #include <string>
-#include <algorithm>
+#include <utility>
+#include <vector>
 
 #include "stratum/glue/status/status_macros.h"
 #include "stratum/lib/utils.h"
 #include "stratum/public/lib/error.h"
 #include "stratum/glue/integral_types.h"
-#include "absl/container/node_hash_set.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/hash/hash.h"
 #include "p4/v1/p4runtime.pb.h"
 #include "stratum/glue/status/status.h"
 #include "stratum/glue/status/statusor.h"
@@ -39,81 +43,185 @@ namespace stratum {
 namespace hal {
 namespace bcm {
 
-// Custom hash and equal function for P4 TableEntry protos. We need a way
-// to differeniate flows in the following way: If we have 2 flows f1 and f2
-// with f2 being the modified version of f1 as intended by the controller, f1
-// = f2. In any other case they should not.
+// Canonical binary form of the fields which identify a P4 TableEntry. We need
+// a way to differeniate flows in the following way: If we have 2 flows f1 and
+// f2 with f2 being the modified version of f1 as intended by the controller,
+// f1 = f2. In any other case they should not. The key therefore covers the
+// match fields (as a set, sorted by field_id), priority, is_default_action and
+// idle_timeout_ns, and ignores table_id, action, controller_metadata,
+// meter_config and counter_data. The key is built once per entry without
+// copying or serializing the proto, so hashing and equality are a plain hash
+// and memcmp over a compact byte string.
+class TableEntryKey {
+ public:
+  TableEntryKey() : bytes_() {}
+  explicit TableEntryKey(const ::p4::v1::TableEntry& entry);
+
+  const std::string& bytes() const { return bytes_; }
+
+  bool operator==(const TableEntryKey& other) const {
+    return bytes_ == other.bytes_;
+  }
+  bool operator!=(const TableEntryKey& other) const {
+    return !(*this == other);
+  }
+
+  template <typename H>
+  friend H AbslHashValue(H h, const TableEntryKey& key) {
+    return H::combine(std::move(h), key.bytes_);
+  }
+
+ private:
+  std::string bytes_;
+};
+
+// Custom hash and equal function for P4 TableEntry protos, for containers
+// keyed directly by the proto. Both compute the TableEntryKey of their inputs.
+// Prefer keying containers by TableEntryKey to compute the key only once.
 struct TableEntryHash {
   size_t operator()(const ::p4::v1::TableEntry& x) const {
-    // Save a copy of the input proto, clear actions/metadata/counter/meter,
-    // and hash the rest.
-    ::p4::v1::TableEntry a = x;
-    a.clear_table_id();
-    a.clear_action();
-    a.clear_controller_metadata();
-    a.clear_meter_config();
-    a.clear_counter_data();
-    // Hash on match field combination, not on permutation.
-    std::sort(a.mutable_match()->begin(), a.mutable_match()->end(),
-              [](const ::p4::v1::FieldMatch& l, const ::p4::v1::FieldMatch& r) {
-                return ProtoSerialize(l) < ProtoSerialize(r);
-              });
-    return std::hash<std::string>()(ProtoSerialize(a));
+    return absl::Hash<TableEntryKey>()(TableEntryKey(x));
   }
 };
 
 struct TableEntryEqual {
   bool operator()(const ::p4::v1::TableEntry& x,
                   const ::p4::v1::TableEntry& y) const {
-    // Save copies of the input protos, clear actions/metadata/counter/meter
-    // and compare the rest.
-    ::p4::v1::TableEntry a = x, b = y;
-    a.clear_table_id();
-    a.clear_action();
-    a.clear_controller_metadata();
-    a.clear_meter_config();
-    a.clear_counter_data();
-    b.clear_table_id();
-    b.clear_action();
-    b.clear_controller_metadata();
-    b.clear_meter_config();
-    b.clear_counter_data();
-    // The order of the match fields are not important.
-    if (a.match_size() != b.match_size() ||
-        !std::is_permutation(
-            a.match().begin(), a.match().end(), b.match().begin(),
-            [](const ::p4::v1::FieldMatch& l, const ::p4::v1::FieldMatch& r) {
-              return ProtoSerialize(l) == ProtoSerialize(r);
-            })) {
-      return false;
-    }
-    a.clear_match();
-    b.clear_match();
-    return ProtoSerialize(a) == ProtoSerialize(b);
+    return TableEntryKey(x) == TableEntryKey(y);
   }
 };
 
+// A TableEntry packed into a single heap block: the TableEntryKey bytes
+// followed by the serialized non-key fields (action, controller_metadata,
+// meter_config, etc.). This is a fraction of the footprint of the full proto
+// with its sub-message allocations. The TableEntry is only materialized when it
+// is read. Note that the match fields of a materialized entry are sorted by
+// field_id, which P4Runtime allows as their order is not significant.
+class PackedTableEntry {
+ public:
+  explicit PackedTableEntry(const ::p4::v1::TableEntry& entry);
+  PackedTableEntry(const PackedTableEntry& other);
+  PackedTableEntry& operator=(const PackedTableEntry& other);
+  PackedTableEntry(PackedTableEntry&& other) = default;
+  PackedTableEntry& operator=(PackedTableEntry&& other) = default;
+
+  // Returns the TableEntryKey bytes of the entry.
+  absl::string_view key() const {
+    return absl::string_view(data_.get(), key_size_);
+  }
+
+  // Returns the number of bytes in the heap block.
+  size_t size() const { return size_; }
+
+  // Rebuilds the full TableEntry proto. Returns ERR_INTERNAL if the packed
+  // bytes are corrupted.
+  ::util::StatusOr<::p4::v1::TableEntry> Unpack() const;
+
+ private:
+  absl::string_view payload() const {
+    return absl::string_view(data_.get() + key_size_, size_ - key_size_);
+  }
+
+  std::unique_ptr<char[]> data_;
+  uint32 key_size_;
+  uint32 size_;
+};
+
+// Hash and equal functions for PackedTableEntry. Both are transparent, so a
+// table can be searched with the TableEntryKey bytes of a TableEntry without
+// packing the entry.
+struct PackedTableEntryHash {
+  using is_transparent = void;
+  size_t operator()(absl::string_view key) const {
+    return absl::Hash<absl::string_view>()(key);
+  }
+  size_t operator()(const PackedTableEntry& x) const {
+    return (*this)(x.key());
+  }
+};
+
+struct PackedTableEntryEqual {
+  using is_transparent = void;
+  static absl::string_view Key(absl::string_view key) { return key; }
+  static absl::string_view Key(const PackedTableEntry& x) { return x.key(); }
+  template <typename T, typename U>
+  bool operator()(const T& x, const U& y) const {
+    return Key(x) == Key(y);
+  }
+};
+
+// Storage for the entries of a BcmFlowTable.
 using TableEntrySet =
-    absl::node_hash_set<::p4::v1::TableEntry, TableEntryHash, TableEntryEqual>;
+    absl::flat_hash_set<PackedTableEntry, PackedTableEntryHash,
+                        PackedTableEntryEqual>;
+
+// Iterator over the entries of a TableEntrySet. Dereferencing it materializes
+// the TableEntry proto, which the iterator keeps until it is advanced.
+class TableEntryConstIterator {
+ public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = ::p4::v1::TableEntry;
+  using difference_type = std::ptrdiff_t;
+  using pointer = const ::p4::v1::TableEntry*;
+  using reference = const ::p4::v1::TableEntry&;
+
+  TableEntryConstIterator() : it_(), entry_(), unpacked_(false) {}
+  explicit TableEntryConstIterator(TableEntrySet::const_iterator it)
+      : it_(it), entry_(), unpacked_(false) {}
+
+  reference operator*() const;
+  pointer operator->() const { return &**this; }
+  TableEntryConstIterator& operator++() {
+    ++it_;
+    unpacked_ = false;
+    return *this;
+  }
+  TableEntryConstIterator operator++(int) {
+    TableEntryConstIterator tmp = *this;
+    ++*this;
+    return tmp;
+  }
+  bool operator==(const TableEntryConstIterator& other) const {
+    return it_ == other.it_;
+  }
+  bool operator!=(const TableEntryConstIterator& other) const {
+    return it_ != other.it_;
+  }
+
+ private:
+  TableEntrySet::const_iterator it_;
+  // The entry pointed to by it_, once unpacked.
+  mutable ::p4::v1::TableEntry entry_;
+  mutable bool unpacked_;
+};
 
 // Class for managing a BCM table.
 class BcmFlowTable {
  public:
   // STL-style types that allow table traversal.
-  using const_iterator = TableEntrySet::const_iterator;
-  using value_type = TableEntrySet::value_type;
+  using const_iterator = TableEntryConstIterator;
+  using value_type = ::p4::v1::TableEntry;
 
   // Constructors.
   explicit BcmFlowTable(uint32 p4_table_id)
-      : id_(p4_table_id), name_(), entries_(), is_const_(false) {}
+      : id_(p4_table_id),
+        name_(),
+        entries_(),
+        entry_bytes_(0),
+        is_const_(false) {}
 
   BcmFlowTable(uint32 p4_table_id, absl::string_view name)
-      : id_(p4_table_id), name_(name), entries_(), is_const_(false) {}
+      : id_(p4_table_id),
+        name_(name),
+        entries_(),
+        entry_bytes_(0),
+        is_const_(false) {}
 
   explicit BcmFlowTable(const ::p4::config::v1::Table& table)
       : id_(table.preamble().id()),
         name_(table.preamble().name()),
         entries_(),
+        entry_bytes_(0),
         is_const_(table.is_const_table()) {}
 
   // Copy Constructor.
@@ -121,6 +229,7 @@ class BcmFlowTable {
       : id_(other.id_),
         name_(other.name_),
         entries_(other.entries_),
+        entry_bytes_(other.entry_bytes_),
         is_const_(other.is_const_) {}
 
   // Move Constructor.
@@ -128,6 +237,7 @@ class BcmFlowTable {
       : id_(other.id_),
         name_(std::move(other.name_)),
         entries_(std::move(other.entries_)),
+        entry_bytes_(other.entry_bytes_),
         is_const_(other.is_const_) {}
 
   // Copy assignment operator.
@@ -148,7 +258,7 @@ class BcmFlowTable {
 
   // Returns true if this table already has this entry.
   virtual bool HasEntry(const ::p4::v1::TableEntry& entry) const {
-    return entries_.count(entry) > 0;
+    return entries_.count(TableEntryKey(entry).bytes()) > 0;
   }
 
   // Returns the number of entries in this table.
@@ -157,22 +267,31 @@ class BcmFlowTable {
   // Returns true if this table has no entries.
   virtual bool Empty() const { return entries_.empty(); }
 
+  // Returns the approximate number of bytes of memory used by this table,
+  // including the hash table itself and the packed entries.
+  virtual size_t MemoryUsage() const {
+    return sizeof(*this) + name_.capacity() +
+           entries_.capacity() * (sizeof(TableEntrySet::value_type) + 1) +
+           entry_bytes_;
+  }
+
   // Returns the P4 TableEntry that matches a given entry key.
   // Returns ERR_ENTRY_NOT_FOUND if a matching entry is not found.
   virtual ::util::StatusOr<::p4::v1::TableEntry> Lookup(
-      const ::p4::v1::TableEntry& key) const {
-    auto lookup = entries_.find(key);
-    if (lookup == entries_.end()) {
-      return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
-             << TableStr()
-             << " does not contain TableEntry: " << key.ShortDebugString();
-    }
-    return *lookup;
+      const ::p4::v1::TableEntry& key) const;
+
+  const_iterator begin() const { return const_iterator(entries_.begin()); }
+  const_iterator end() const { return const_iterator(entries_.end()); }
+
+  // Appends a copy of all the entries of this table, still in packed form, to
+  // the given vector. This is much cheaper than materializing the entries, so
+  // callers can take a snapshot while holding a lock and materialize it later
+  // without holding the lock.
+  void Snapshot(std::vector<PackedTableEntry>* entries) const {
+    entries->reserve(entries->size() + entries_.size());
+    for (const auto& entry : entries_) entries->push_back(entry);
   }
 
-  TableEntrySet::const_iterator begin() const { return entries_.begin(); }
-  TableEntrySet::const_iterator end() const { return entries_.end(); }
-
   // Returns true if this is a const table.
   virtual bool IsConst() const { return is_const_; }
 
@@ -189,60 +308,26 @@ class BcmFlowTable {
   // 2) TableEntry.priority
   // 3) is_default_action
   //
-  // See TableEntryEqual below.
-  virtual ::util::Status InsertEntry(const ::p4::v1::TableEntry& entry) {
-    auto result = entries_.insert(entry);
-    if (!result.second) {
-      return MAKE_ERROR(ERR_ENTRY_EXISTS)
-             << TableStr() << " contains duplicate of TableEntry: "
-             << entry.ShortDebugString()
-             << ". Matching TableEntry: " << result.first->ShortDebugString()
-             << ".";
-    }
-    return ::util::OkStatus();
-  }
+  // See TableEntryKey above.
+  virtual ::util::Status InsertEntry(const ::p4::v1::TableEntry& entry);
 
   // Performs a dry-run of InsertEntry. Returns errors if the entry cannot be
   // inserted. If the entry can be inserted, returns ::util::OkStatus().
   virtual ::util::Status DryRunInsertEntry(
-      const ::p4::v1::TableEntry& entry) const {
-    const auto result = entries_.find(entry);
-    if (result != entries_.end()) {
-      return MAKE_ERROR(ERR_ENTRY_EXISTS)
-             << TableStr() << " contains duplicate of TableEntry: "
-             << entry.ShortDebugString()
-             << ". Matching TableEntry: " << result->ShortDebugString() << ".";
-    }
-    return ::util::OkStatus();
-  }
+      const ::p4::v1::TableEntry& entry) const;
 
   // Attempts to modify an existing entry in this table. Returns the original
   // entry on success.
   // Returns ERR_ENTRY_NOT_FOUND if a matching entry does not already exist.
   // Returns an error if the entry cannot be added.
   virtual ::util::StatusOr<::p4::v1::TableEntry> ModifyEntry(
-      const ::p4::v1::TableEntry& entry) {
-    ASSIGN_OR_RETURN(::p4::v1::TableEntry old_entry, DeleteEntry(entry));
-    entries_.insert(entry);
-    return old_entry;
-  }
+      const ::p4::v1::TableEntry& entry);
 
   // Attempts to delete an existing entry in this table. Returns the deleted
   // entry on success.
   // Returns ERR_ENTRY_NOT_FOUND if a matching entry does not already exist.
   virtual ::util::StatusOr<::p4::v1::TableEntry> DeleteEntry(
-      const ::p4::v1::TableEntry& key) {
-    const auto lookup = entries_.find(key);
-    if (lookup == entries_.end()) {
-      return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
-             << TableStr()
-             << " does not contain TableEntry: " << key.ShortDebugString()
-             << ".";
-    }
-    ::p4::v1::TableEntry entry = *lookup;
-    entries_.erase(lookup);
-    return entry;
-  }
+      const ::p4::v1::TableEntry& key);
 
  protected:
   // Returns the standard Table ID string.
@@ -257,6 +342,8 @@ class BcmFlowTable {
   std::string name_;
   // Keeps track of all entries currently in the table.
   TableEntrySet entries_;
+  // Total size of the heap blocks of all the entries in entries_.
+  size_t entry_bytes_;
   // True is this is a const table. Const tables can only be modified during
   // SetForwardingPipelineConfig().
   bool is_const_;
@@ -13,13 +13,18 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <string>
 #include <vector>
 
 #include "stratum/hal/lib/bcm/bcm_flow_table.h"
+#include "stratum/glue/logging.h"
 #include "stratum/glue/status/status_test_util.h"
 #include "stratum/lib/test_utils/matchers.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "absl/container/node_hash_set.h"
+#include "absl/time/clock.h"
 #include "p4/config/v1/p4info.pb.h"
 
 namespace stratum {
@@ -313,6 +318,171 @@ TEST(BcmFlowTableTest, DeleteMissingEntryFailure) {
   ASSERT_EQ(table.DeleteEntry(mod).status().error_code(), ERR_ENTRY_NOT_FOUND);
 }
 
+// Verify that the order of the match fields does not matter.
+TEST(BcmFlowTableTest, LookupPermutedMatchSuccess) {
+  ::p4::v1::TableEntry mod = MockTableEntry();
+  std::reverse(mod.mutable_match()->begin(), mod.mutable_match()->end());
+
+  BcmFlowTable table(1);
+  ASSERT_OK(table.InsertEntry(MockTableEntry()));
+  EXPECT_TRUE(table.HasEntry(mod));
+  EXPECT_EQ(TableEntryKey(MockTableEntry()), TableEntryKey(mod));
+  EXPECT_EQ(table.InsertEntry(mod).error_code(), ERR_ENTRY_EXISTS);
+}
+
+// Verify that the key keeps the boundaries between match values.
+TEST(BcmFlowTableTest, TableEntryKeyDistinguishesValueBoundaries) {
+  ::p4::v1::TableEntry a = MockTableEntry();
+  ::p4::v1::TableEntry b = MockTableEntry();
+  a.mutable_match(1)->mutable_ternary()->set_value("ab");
+  a.mutable_match(1)->mutable_ternary()->set_mask("c");
+  b.mutable_match(1)->mutable_ternary()->set_value("a");
+  b.mutable_match(1)->mutable_ternary()->set_mask("bc");
+  EXPECT_NE(TableEntryKey(a), TableEntryKey(b));
+  EXPECT_FALSE(TableEntryEqual()(a, b));
+  EXPECT_TRUE(TableEntryEqual()(a, a));
+  EXPECT_EQ(TableEntryHash()(a), TableEntryHash()(a));
+}
+
+// Verify that the table can be traversed as a collection of TableEntry protos.
+TEST(BcmFlowTableTest, IterateEntries) {
+  constexpr int kNumEntries = 4;
+  BcmFlowTable table(1);
+  for (int i = 0; i < kNumEntries; ++i) {
+    ::p4::v1::TableEntry entry = MockTableEntry();
+    entry.set_priority(i + 1);
+    ASSERT_OK(table.InsertEntry(entry));
+  }
+  std::vector<int> priorities;
+  for (const auto& entry : table) priorities.push_back(entry.priority());
+  std::sort(priorities.begin(), priorities.end());
+  EXPECT_EQ(std::vector<int>({1, 2, 3, 4}), priorities);
+  // Members can also be accessed through the iterator.
+  priorities.clear();
+  for (auto it = table.begin(); it != table.end(); ++it) {
+    EXPECT_EQ(1U, it->table_id());
+    priorities.push_back(it->priority());
+  }
+  std::sort(priorities.begin(), priorities.end());
+  EXPECT_EQ(std::vector<int>({1, 2, 3, 4}), priorities);
+}
+
+// Verify that a packed entry is materialized back to the same TableEntry.
+TEST(BcmFlowTableTest, PackedTableEntryRoundTrip) {
+  ::p4::v1::TableEntry entry = MockTableEntry();
+  auto* range = entry.add_match();
+  range->set_field_id(4);
+  range->mutable_range()->set_low("7");
+  range->mutable_range()->set_high("8");
+  entry.add_match()->set_field_id(5);  // no match type
+  entry.set_controller_metadata(12);
+  entry.set_idle_timeout_ns(13);
+  entry.mutable_meter_config()->set_cir(14);
+  entry.mutable_counter_data()->set_packet_count(15);
+
+  PackedTableEntry packed(entry);
+  EXPECT_EQ(TableEntryKey(entry).bytes(), packed.key());
+  EXPECT_THAT(packed.Unpack(), IsOkAndHolds(EqualsProto(entry)));
+  PackedTableEntry copy(packed);
+  EXPECT_THAT(copy.Unpack(), IsOkAndHolds(EqualsProto(entry)));
+}
+
+// Verify that the memory usage of a table follows its entries.
+TEST(BcmFlowTableTest, MemoryUsage) {
+  const size_t packed_bytes = PackedTableEntry(MockTableEntry()).size();
+  // The packed entry is much smaller than the proto it replaces.
+  EXPECT_LT(packed_bytes, MockTableEntry().SpaceUsedLong());
+
+  BcmFlowTable table(1);
+  const size_t empty_bytes = table.MemoryUsage();
+  ASSERT_OK(table.InsertEntry(MockTableEntry()));
+  const size_t one_entry_bytes = table.MemoryUsage();
+  EXPECT_GT(one_entry_bytes, empty_bytes + packed_bytes);
+  ASSERT_OK(table.DeleteEntry(MockTableEntry()).status());
+  // The hash table keeps its capacity, but the entry itself is released.
+  EXPECT_EQ(one_entry_bytes - packed_bytes, table.MemoryUsage());
+}
+
+// The hash and equal functions previously used for TableEntry storage. They
+// copy and serialize the protos on every call. Only kept here as a baseline
+// for the benchmark below.
+struct SerializedTableEntryHash {
+  size_t operator()(const ::p4::v1::TableEntry& x) const {
+    ::p4::v1::TableEntry a = x;
+    a.clear_table_id();
+    a.clear_action();
+    a.clear_controller_metadata();
+    a.clear_meter_config();
+    a.clear_counter_data();
+    std::sort(a.mutable_match()->begin(), a.mutable_match()->end(),
+              [](const ::p4::v1::FieldMatch& l, const ::p4::v1::FieldMatch& r) {
+                return ProtoSerialize(l) < ProtoSerialize(r);
+              });
+    return std::hash<std::string>()(ProtoSerialize(a));
+  }
+};
+
+struct SerializedTableEntryEqual {
+  bool operator()(const ::p4::v1::TableEntry& x,
+                  const ::p4::v1::TableEntry& y) const {
+    ::p4::v1::TableEntry a = x, b = y;
+    for (auto* e : {&a, &b}) {
+      e->clear_table_id();
+      e->clear_action();
+      e->clear_controller_metadata();
+      e->clear_meter_config();
+      e->clear_counter_data();
+    }
+    if (a.match_size() != b.match_size() ||
+        !std::is_permutation(
+            a.match().begin(), a.match().end(), b.match().begin(),
+            [](const ::p4::v1::FieldMatch& l, const ::p4::v1::FieldMatch& r) {
+              return ProtoSerialize(l) == ProtoSerialize(r);
+            })) {
+      return false;
+    }
+    a.clear_match();
+    b.clear_match();
+    return ProtoSerialize(a) == ProtoSerialize(b);
+  }
+};
+
+// Compares insert + lookup + delete of 1M entries between the serialized
+// hashing scheme and BcmFlowTable. Disabled by default as it takes a while.
+// Run with --gtest_also_run_disabled_tests.
+TEST(BcmFlowTableTest, DISABLED_BenchmarkTableEntryKey) {
+  constexpr int kNumEntries = 1000000;
+  std::vector<::p4::v1::TableEntry> entries(kNumEntries, MockTableEntry());
+  for (int i = 0; i < kNumEntries; ++i) {
+    entries[i].mutable_match(0)->mutable_exact()->set_value(
+        std::string(reinterpret_cast<const char*>(&i), sizeof(i)));
+  }
+
+  uint64 start = absl::GetCurrentTimeNanos();
+  {
+    absl::node_hash_set<::p4::v1::TableEntry, SerializedTableEntryHash,
+                        SerializedTableEntryEqual>
+        set;
+    for (const auto& entry : entries) set.insert(entry);
+    for (const auto& entry : entries) ASSERT_EQ(1U, set.count(entry));
+    for (const auto& entry : entries) set.erase(entry);
+  }
+  uint64 serialized_ns = absl::GetCurrentTimeNanos() - start;
+
+  start = absl::GetCurrentTimeNanos();
+  {
+    BcmFlowTable table(1);
+    for (const auto& entry : entries) ASSERT_OK(table.InsertEntry(entry));
+    for (const auto& entry : entries) ASSERT_TRUE(table.HasEntry(entry));
+    for (const auto& entry : entries) ASSERT_OK(table.DeleteEntry(entry));
+  }
+  uint64 key_ns = absl::GetCurrentTimeNanos() - start;
+
+  LOG(INFO) << "Insert/lookup/delete of " << kNumEntries
+            << " entries: serialized hash " << serialized_ns / 1000000
+            << " ms, TableEntryKey " << key_ns / 1000000 << " ms.";
+}
+
 // Verify the properties a BcmFlowTable inherits from a source
 // P4 config Table.
 TEST(BcmFlowTableTest, ConstructFromP4ConfigTable) {
@@ -22,7 +22,7 @@ namespace hal {
 namespace bcm {
 
 ABSL_CONST_INIT absl::Mutex chassis_lock(absl::kConstInit);
-bool shutdown = false;
+std::atomic<bool> shutdown(false);
 
 }  // namespace bcm
 }  // namespace hal
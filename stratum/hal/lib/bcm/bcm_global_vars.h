@@ -18,6 +18,8 @@
 #ifndef STRATUM_HAL_LIB_BCM_BCM_GLOBAL_VARS_H_
 #define STRATUM_HAL_LIB_BCM_BCM_GLOBAL_VARS_H_
 
+#include <atomic>
+
 #include "absl/synchronization/mutex.h"
 
 namespace stratum {
@@ -28,8 +30,10 @@ namespace bcm {
 // Lock which governs chassis state (ports, etc.) across the entire switch.
 extern absl::Mutex chassis_lock;
 
-// Flag indicating if the switch has been shut down. Initialized to false.
-extern bool shutdown;
+// Flag indicating if the switch has been shut down. Initialized to false. It
+// is set while holding chassis_lock, but is also read by the paths which do
+// not take chassis_lock, e.g. the port state queries and the RX threads.
+extern std::atomic<bool> shutdown;
 
 }  // namespace bcm
 }  // namespace hal
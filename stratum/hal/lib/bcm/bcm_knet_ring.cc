@@ -0,0 +1,221 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "stratum/hal/lib/bcm/bcm_knet_ring.h"
+
+#include <errno.h>
+#include <linux/if_packet.h>
+#include <net/ethernet.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstring>
+
+#include "stratum/glue/logging.h"
+#include "stratum/glue/status/status_macros.h"
+#include "stratum/lib/macros.h"
+#include "stratum/public/lib/error.h"
+
+namespace stratum {
+namespace hal {
+namespace bcm {
+
+constexpr uint32 BcmKnetRing::kDefaultFrameSize;
+
+namespace {
+
+// Offset of the frame data from the start of a TX slot. The kernel expects the
+// data right after the (aligned) tpacket3_hdr.
+constexpr size_t kTxDataOffset =
+    TPACKET3_HDRLEN - sizeof(struct sockaddr_ll);
+
+// Offset of the sockaddr_ll which the kernel fills in after the tpacket3_hdr
+// of every RX frame.
+constexpr size_t kRxAddrOffset = TPACKET_ALIGN(sizeof(struct tpacket3_hdr));
+
+}  // namespace
+
+::util::StatusOr<std::unique_ptr<BcmKnetRing>> BcmKnetRing::Create(
+    int sock, Direction direction, const Config& config) {
+  CHECK_RETURN_IF_FALSE(sock >= 0) << "Invalid socket " << sock << ".";
+  const uint32 page_size = sysconf(_SC_PAGESIZE);
+  CHECK_RETURN_IF_FALSE(config.num_blocks > 0 && config.block_size > 0 &&
+                        config.block_size % page_size == 0)
+      << "Invalid ring block size " << config.block_size << " or num of "
+      << "blocks " << config.num_blocks << ".";
+  CHECK_RETURN_IF_FALSE(config.frame_size > TPACKET3_HDRLEN &&
+                        config.frame_size % TPACKET_ALIGNMENT == 0 &&
+                        config.block_size % config.frame_size == 0)
+      << "Invalid ring frame size " << config.frame_size << " for block size "
+      << config.block_size << ".";
+
+  int version = TPACKET_V3;
+  if (setsockopt(sock, SOL_PACKET, PACKET_VERSION, &version,
+                 sizeof(version)) < 0) {
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "Couldn't call setsockopt(PACKET_VERSION) on socket " << sock
+           << ". errno: " << errno << ".";
+  }
+  if (direction == TX) {
+    // Have the kernel skip malformed frames instead of stalling the ring.
+    int loss = 1;
+    if (setsockopt(sock, SOL_PACKET, PACKET_LOSS, &loss, sizeof(loss)) < 0) {
+      return MAKE_ERROR(ERR_INTERNAL)
+             << "Couldn't call setsockopt(PACKET_LOSS) on socket " << sock
+             << ". errno: " << errno << ".";
+    }
+  }
+  struct tpacket_req3 req;
+  memset(&req, 0, sizeof(req));
+  req.tp_block_size = config.block_size;
+  req.tp_block_nr = config.num_blocks;
+  req.tp_frame_size = config.frame_size;
+  req.tp_frame_nr =
+      (config.block_size / config.frame_size) * config.num_blocks;
+  // The kernel rejects the RX only options on a TX ring.
+  if (direction == RX) req.tp_retire_blk_tov = config.block_timeout_ms;
+  if (setsockopt(sock, SOL_PACKET,
+                 direction == RX ? PACKET_RX_RING : PACKET_TX_RING, &req,
+                 sizeof(req)) < 0) {
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "Couldn't set up the " << (direction == RX ? "RX" : "TX")
+           << " ring on socket " << sock << ". errno: " << errno << ".";
+  }
+  size_t ring_size = static_cast<size_t>(config.block_size) * config.num_blocks;
+  void* ring = mmap(nullptr, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                    sock, 0);
+  if (ring == MAP_FAILED) {
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "Couldn't mmap the ring of socket " << sock
+           << ". errno: " << errno << ".";
+  }
+
+  return std::unique_ptr<BcmKnetRing>(new BcmKnetRing(
+      sock, direction, config, static_cast<char*>(ring), ring_size));
+}
+
+BcmKnetRing::BcmKnetRing(int sock, Direction direction, const Config& config,
+                         char* ring, size_t ring_size)
+    : sock_(sock),
+      direction_(direction),
+      config_(config),
+      ring_(ring),
+      ring_size_(ring_size),
+      next_block_(0),
+      next_frame_(0) {}
+
+BcmKnetRing::~BcmKnetRing() {
+  if (munmap(ring_, ring_size_) != 0) {
+    LOG(ERROR) << "Couldn't munmap the ring of socket " << sock_
+               << ". errno: " << errno << ".";
+  }
+}
+
+int BcmKnetRing::ReadBlock(const FrameHandler& handler) {
+  if (direction_ != RX) return 0;
+  auto* block =
+      reinterpret_cast<struct tpacket_block_desc*>(Block(next_block_));
+  if (!(block->hdr.bh1.block_status & TP_STATUS_USER)) return 0;
+  // Do not read the frames before the kernel is done writing them.
+  std::atomic_thread_fence(std::memory_order_acquire);
+  const uint32 num_frames = block->hdr.bh1.num_pkts;
+  char* frame = reinterpret_cast<char*>(block) +
+                block->hdr.bh1.offset_to_first_pkt;
+  for (uint32 i = 0; i < num_frames; ++i) {
+    const auto* hdr = reinterpret_cast<const struct tpacket3_hdr*>(frame);
+    const auto* sa =
+        reinterpret_cast<const struct sockaddr_ll*>(frame + kRxAddrOffset);
+    handler(frame + hdr->tp_mac, hdr->tp_snaplen,
+            hdr->tp_snaplen < hdr->tp_len, *sa);
+    frame += hdr->tp_next_offset;
+  }
+  // Give the block back to the kernel once we are done reading it.
+  std::atomic_thread_fence(std::memory_order_release);
+  block->hdr.bh1.block_status = TP_STATUS_KERNEL;
+  next_block_ = (next_block_ + 1) % config_.num_blocks;
+
+  return num_frames;
+}
+
+::util::Status BcmKnetRing::Send(absl::string_view header,
+                                 absl::string_view payload, int ifindex) {
+  CHECK_RETURN_IF_FALSE(direction_ == TX)
+      << "Cannot send packets on the RX ring of socket " << sock_ << ".";
+  const size_t size = header.size() + payload.size();
+  if (size > config_.frame_size - kTxDataOffset) {
+    return MAKE_ERROR(ERR_INVALID_PARAM)
+           << "Packet of " << size << " bytes does not fit in a TX ring frame "
+           << "of " << config_.frame_size << " bytes.";
+  }
+
+  absl::MutexLock l(&tx_lock_);
+  auto* hdr = reinterpret_cast<struct tpacket3_hdr*>(Frame(next_frame_));
+  if (hdr->tp_status & (TP_STATUS_SEND_REQUEST | TP_STATUS_SENDING)) {
+    return MAKE_ERROR(ERR_NO_RESOURCE)
+           << "TX ring of socket " << sock_ << " is full.";
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+  char* data = reinterpret_cast<char*>(hdr) + kTxDataOffset;
+  memcpy(data, header.data(), header.size());
+  memcpy(data + header.size(), payload.data(), payload.size());
+  hdr->tp_len = size;
+  hdr->tp_next_offset = 0;
+  // Hand the frame over to the kernel only after it is fully written.
+  std::atomic_thread_fence(std::memory_order_release);
+  hdr->tp_status = TP_STATUS_SEND_REQUEST;
+  next_frame_ = (next_frame_ + 1) %
+                ((config_.block_size / config_.frame_size) * config_.num_blocks);
+
+  // Here sa.sll_addr is left zeroed out, same as for the non-ring TX.
+  struct sockaddr_ll sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sll_family = AF_PACKET;
+  sa.sll_ifindex = ifindex;
+  sa.sll_halen = ETH_ALEN;
+  // The kernel sends all the frames pending in the ring, so a frame left
+  // behind by a failed call goes out with the next one.
+  while (sendto(sock_, nullptr, 0, MSG_DONTWAIT,
+                reinterpret_cast<struct sockaddr*>(&sa), sizeof(sa)) < 0) {
+    switch (errno) {
+      case EINTR:
+        // signal received before we could transmit anything. Need to retry.
+        continue;
+      case EAGAIN:
+      case ENOBUFS:
+        // The kernel is busy. The frame stays in the ring.
+        return ::util::OkStatus();
+      default:
+        return MAKE_ERROR(ERR_INTERNAL)
+               << "Error when flushing the TX ring of socket " << sock_
+               << " to netif " << ifindex << ": " << errno;
+    }
+  }
+
+  return ::util::OkStatus();
+}
+
+char* BcmKnetRing::Block(uint32 index) const {
+  return ring_ + static_cast<size_t>(index) * config_.block_size;
+}
+
+char* BcmKnetRing::Frame(uint32 index) const {
+  // Blocks are a multiple of the frame size, so the frames are contiguous.
+  return ring_ + static_cast<size_t>(index) * config_.frame_size;
+}
+
+}  // namespace bcm
+}  // namespace hal
+}  // namespace stratum
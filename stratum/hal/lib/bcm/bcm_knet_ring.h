@@ -0,0 +1,137 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef STRATUM_HAL_LIB_BCM_BCM_KNET_RING_H_
+#define STRATUM_HAL_LIB_BCM_BCM_KNET_RING_H_
+
+#include <functional>
+#include <memory>
+
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/status/status.h"
+#include "stratum/glue/status/statusor.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+
+// Defined by both <linux/if_packet.h>, which the ring implementation needs,
+// and <netpacket/packet.h>, which the users of the ring include. The two
+// headers cannot be included together.
+struct sockaddr_ll;
+
+namespace stratum {
+namespace hal {
+namespace bcm {
+
+// A TPACKET_V3 ring shared with the kernel through mmap() on an AF_PACKET
+// socket. An RX ring lets the reader walk blocks of received frames in place,
+// without a recvmsg() call (and a copy) per packet. A TX ring lets the writer
+// build frames in place and hand all of them to the kernel with one send().
+// Each ring is attached to its own socket, which it does not own: the socket
+// must outlive the ring.
+class BcmKnetRing {
+ public:
+  enum Direction { RX, TX };
+
+  // The default size of a frame slot. A TX slot holds the tpacket3_hdr, the
+  // KNET header and the packet, so this is large enough for the 9K jumbo
+  // frames the socket TX path accepts. It also divides the default block size.
+  static constexpr uint32 kDefaultFrameSize = 16 * 1024;
+
+  // The geometry of a ring. block_size must be a multiple of the page size
+  // and of frame_size, and frame_size a multiple of TPACKET_ALIGNMENT. On an
+  // RX ring the frames are variable-sized and frame_size only bounds their
+  // number. On a TX ring every frame occupies frame_size bytes.
+  struct Config {
+    uint32 block_size;
+    uint32 num_blocks;
+    uint32 frame_size;
+    // RX only. Time after which the kernel hands a block which is not full
+    // over to the reader.
+    uint32 block_timeout_ms;
+    Config()
+        : block_size(1 << 20),
+          num_blocks(8),
+          frame_size(kDefaultFrameSize),
+          block_timeout_ms(10) {}
+  };
+
+  // Called for every frame read from an RX ring. 'data' points to the frame
+  // in the ring and is valid only for the duration of the call. 'size' is the
+  // num of bytes captured and 'truncated' is true if the frame did not fit.
+  using FrameHandler =
+      std::function<void(const char* data, size_t size, bool truncated,
+                         const struct sockaddr_ll& sa)>;
+
+  // Switches 'sock' to TPACKET_V3, sets up a ring in the given direction on
+  // it and maps the ring. Must be called before the socket is bound.
+  static ::util::StatusOr<std::unique_ptr<BcmKnetRing>> Create(
+      int sock, Direction direction, const Config& config);
+
+  // Unmaps the ring. Does not close the socket.
+  ~BcmKnetRing();
+
+  // RX only. Calls 'handler' for each frame of the next block released by the
+  // kernel, and then gives the block back to the kernel. Returns the num of
+  // frames read, or 0 if no block is ready. Must not be called concurrently.
+  int ReadBlock(const FrameHandler& handler);
+
+  // TX only. Copies a frame made of 'header' followed by 'payload' into the
+  // next free slot of the ring, and asks the kernel to send all the pending
+  // frames to the interface with the given 'ifindex'. Returns
+  // ERR_NO_RESOURCE if the ring is full and ERR_INVALID_PARAM if the frame
+  // does not fit in a slot. Thread-safe.
+  ::util::Status Send(absl::string_view header, absl::string_view payload,
+                      int ifindex) LOCKS_EXCLUDED(tx_lock_);
+
+  Direction direction() const { return direction_; }
+
+  // BcmKnetRing is neither copyable nor movable.
+  BcmKnetRing(const BcmKnetRing&) = delete;
+  BcmKnetRing& operator=(const BcmKnetRing&) = delete;
+
+ private:
+  BcmKnetRing(int sock, Direction direction, const Config& config, char* ring,
+              size_t ring_size);
+
+  // Returns the start of the given block or TX frame.
+  char* Block(uint32 index) const;
+  char* Frame(uint32 index) const;
+
+  const int sock_;
+  const Direction direction_;
+  const Config config_;
+
+  // The mapped ring and its size.
+  char* const ring_;
+  const size_t ring_size_;
+
+  // RX only. The next block to be read.
+  uint32 next_block_;
+
+  // TX only. Serializes senders, which share the ring.
+  absl::Mutex tx_lock_;
+
+  // TX only. The next frame to be filled in.
+  uint32 next_frame_ GUARDED_BY(tx_lock_);
+};
+
+}  // namespace bcm
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_BCM_BCM_KNET_RING_H_
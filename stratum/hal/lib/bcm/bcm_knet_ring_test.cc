@@ -0,0 +1,232 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "stratum/hal/lib/bcm/bcm_knet_ring.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <net/ethernet.h>
+#include <net/if.h>
+#include <netpacket/packet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "gflags/gflags.h"
+#include "stratum/glue/logging.h"
+#include "stratum/glue/status/status_test_util.h"
+#include "stratum/public/lib/error.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+DEFINE_string(knet_ring_test_intf, "lo",
+              "The interface the ring test receives packets on. The loopback "
+              "interface works on any Linux box.");
+DEFINE_string(knet_ring_test_tx_intf, "",
+              "The interface the ring test sends packets on. Defaults to "
+              "knet_ring_test_intf. To test against a veth pair, set the two "
+              "flags to the two ends of the pair.");
+
+namespace stratum {
+namespace hal {
+namespace bcm {
+namespace {
+
+// An EtherType reserved for local experiments, so that the test ignores any
+// other traffic on the interface.
+constexpr uint16 kTestEtherType = 0x88b5;
+constexpr int kNumPackets = 32;
+
+class BcmKnetRingTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ifindex_ = if_nametoindex(FLAGS_knet_ring_test_intf.c_str());
+    tx_ifindex_ = FLAGS_knet_ring_test_tx_intf.empty()
+                      ? ifindex_
+                      : if_nametoindex(FLAGS_knet_ring_test_tx_intf.c_str());
+    rx_sock_ = socket(AF_PACKET, SOCK_RAW, htons(kTestEtherType));
+    tx_sock_ = socket(AF_PACKET, SOCK_RAW, 0);
+  }
+
+  void TearDown() override {
+    rx_ring_.reset();
+    tx_ring_.reset();
+    if (rx_sock_ >= 0) close(rx_sock_);
+    if (tx_sock_ >= 0) close(tx_sock_);
+  }
+
+  // Returns false if the test cannot open packet sockets on the interface,
+  // e.g. because it is not run with CAP_NET_RAW.
+  bool CanRun() {
+    if (ifindex_ == 0 || tx_ifindex_ == 0 || rx_sock_ < 0 || tx_sock_ < 0) {
+      LOG(WARNING) << "Skipping test: no packet sockets on "
+                   << FLAGS_knet_ring_test_intf << ". errno: " << errno << ".";
+      return false;
+    }
+    return true;
+  }
+
+  ::util::Status BindRxSocket() {
+    struct sockaddr_ll addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sll_family = AF_PACKET;
+    addr.sll_protocol = htons(kTestEtherType);
+    addr.sll_ifindex = ifindex_;
+    if (bind(rx_sock_, reinterpret_cast<struct sockaddr*>(&addr),
+             sizeof(addr)) < 0) {
+      return MAKE_ERROR(ERR_INTERNAL) << "bind() failed: " << errno;
+    }
+    return ::util::OkStatus();
+  }
+
+  // Returns a broadcast Ethernet header with the test EtherType.
+  static std::string TestHeader() {
+    struct ether_header eth;
+    memset(eth.ether_dhost, 0xff, ETH_ALEN);
+    memset(eth.ether_shost, 0x02, ETH_ALEN);
+    eth.ether_type = htons(kTestEtherType);
+    return std::string(reinterpret_cast<const char*>(&eth), sizeof(eth));
+  }
+
+  // Reads blocks from the RX ring until 'num_packets' incoming test packets
+  // are received or the timeout expires. Returns the payloads received.
+  std::vector<std::string> Receive(int num_packets) {
+    std::vector<std::string> payloads;
+    absl::Time deadline = absl::Now() + absl::Seconds(5);
+    while (static_cast<int>(payloads.size()) < num_packets &&
+           absl::Now() < deadline) {
+      int n = rx_ring_->ReadBlock([&payloads](const char* data, size_t size,
+                                              bool truncated,
+                                              const struct sockaddr_ll& sa) {
+        EXPECT_FALSE(truncated);
+        // The copy of the packets we send, if we receive on the same
+        // interface.
+        if (sa.sll_pkttype == PACKET_OUTGOING) return;
+        if (size < sizeof(struct ether_header)) return;
+        payloads.emplace_back(data + sizeof(struct ether_header),
+                              size - sizeof(struct ether_header));
+      });
+      if (n == 0) absl::SleepFor(absl::Milliseconds(1));
+    }
+    return payloads;
+  }
+
+  int ifindex_ = 0;
+  int tx_ifindex_ = 0;
+  int rx_sock_ = -1;
+  int tx_sock_ = -1;
+  std::unique_ptr<BcmKnetRing> rx_ring_;
+  std::unique_ptr<BcmKnetRing> tx_ring_;
+};
+
+TEST_F(BcmKnetRingTest, SendAndReceiveThroughRings) {
+  if (!CanRun()) return;
+  BcmKnetRing::Config config;
+  config.block_size = 1 << 16;
+  config.num_blocks = 4;
+  config.frame_size = 2048;
+  config.block_timeout_ms = 1;
+  ASSERT_OK_AND_ASSIGN(rx_ring_,
+                       BcmKnetRing::Create(rx_sock_, BcmKnetRing::RX, config));
+  ASSERT_OK(BindRxSocket());
+  ASSERT_OK_AND_ASSIGN(tx_ring_,
+                       BcmKnetRing::Create(tx_sock_, BcmKnetRing::TX, config));
+
+  const std::string header = TestHeader();
+  for (int i = 0; i < kNumPackets; ++i) {
+    ASSERT_OK(tx_ring_->Send(header, "packet " + std::to_string(i),
+                             tx_ifindex_));
+  }
+
+  std::vector<std::string> payloads = Receive(kNumPackets);
+  ASSERT_EQ(kNumPackets, payloads.size());
+  for (int i = 0; i < kNumPackets; ++i) {
+    // Short frames are padded on the wire.
+    EXPECT_THAT(payloads[i],
+                ::testing::StartsWith("packet " + std::to_string(i)));
+  }
+}
+
+TEST_F(BcmKnetRingTest, RingWrapsAround) {
+  if (!CanRun()) return;
+  // A single page per ring, so both rings wrap many times.
+  BcmKnetRing::Config config;
+  config.block_size = sysconf(_SC_PAGESIZE);
+  config.num_blocks = 2;
+  config.frame_size = config.block_size / 2;
+  config.block_timeout_ms = 1;
+  ASSERT_OK_AND_ASSIGN(rx_ring_,
+                       BcmKnetRing::Create(rx_sock_, BcmKnetRing::RX, config));
+  ASSERT_OK(BindRxSocket());
+  ASSERT_OK_AND_ASSIGN(tx_ring_,
+                       BcmKnetRing::Create(tx_sock_, BcmKnetRing::TX, config));
+
+  const std::string header = TestHeader();
+  for (int i = 0; i < kNumPackets; ++i) {
+    ASSERT_OK(tx_ring_->Send(header, "packet " + std::to_string(i),
+                             tx_ifindex_));
+    std::vector<std::string> payloads = Receive(1);
+    ASSERT_EQ(1U, payloads.size());
+    EXPECT_THAT(payloads[0],
+                ::testing::StartsWith("packet " + std::to_string(i)));
+  }
+}
+
+TEST_F(BcmKnetRingTest, SendFailsForOversizedPacket) {
+  if (!CanRun()) return;
+  BcmKnetRing::Config config;
+  config.block_size = sysconf(_SC_PAGESIZE);
+  config.num_blocks = 1;
+  config.frame_size = 2048;
+  ASSERT_OK_AND_ASSIGN(tx_ring_,
+                       BcmKnetRing::Create(tx_sock_, BcmKnetRing::TX, config));
+
+  ::util::Status status =
+      tx_ring_->Send(TestHeader(), std::string(config.frame_size, 'x'),
+                     tx_ifindex_);
+  EXPECT_EQ(ERR_INVALID_PARAM, status.error_code());
+}
+
+TEST_F(BcmKnetRingTest, SendJumboFrameWithDefaultConfig) {
+  if (!CanRun()) return;
+  ASSERT_OK_AND_ASSIGN(tx_ring_, BcmKnetRing::Create(tx_sock_, BcmKnetRing::TX,
+                                                     BcmKnetRing::Config()));
+
+  // A 9K jumbo frame, which the socket TX path accepts as well, fits in a
+  // slot. Whether the interface takes it depends on its MTU, so only the
+  // size check of the ring is verified here.
+  ::util::Status status =
+      tx_ring_->Send(TestHeader(), std::string(9216, 'x'), tx_ifindex_);
+  EXPECT_NE(ERR_INVALID_PARAM, status.error_code()) << status;
+}
+
+TEST_F(BcmKnetRingTest, CreateFailsForInvalidConfig) {
+  if (!CanRun()) return;
+  BcmKnetRing::Config config;
+  config.block_size = 1000;  // not a multiple of the page size
+  EXPECT_FALSE(BcmKnetRing::Create(rx_sock_, BcmKnetRing::RX, config).ok());
+  config = BcmKnetRing::Config();
+  config.frame_size = 3000;  // does not divide the block size
+  EXPECT_FALSE(BcmKnetRing::Create(rx_sock_, BcmKnetRing::RX, config).ok());
+  EXPECT_FALSE(
+      BcmKnetRing::Create(-1, BcmKnetRing::RX, BcmKnetRing::Config()).ok());
+}
+
+}  // namespace
+}  // namespace bcm
+}  // namespace hal
+}  // namespace stratum
@@ -14,6 +14,8 @@
 // limitations under the License.
 
 #include <algorithm>
+#include <set>
+#include <utility>
 #include <vector>
 
 #include "stratum/hal/lib/bcm/bcm_l3_manager.h"
@@ -77,6 +79,11 @@ BcmL3Manager::~BcmL3Manager() {}
 
 ::util::Status BcmL3Manager::Shutdown() {
   router_intf_ref_count_.clear();
+  absl::MutexLock l(&ecmp_lock_);
+  ecmp_intf_to_members_.clear();
+  member_to_ecmp_intfs_.clear();
+  member_intf_to_port_.clear();
+  port_to_member_intfs_.clear();
   return ::util::OkStatus();
 }
 
@@ -88,7 +95,7 @@ BcmL3Manager::~BcmL3Manager() {}
   int vlan = nexthop.vlan();
   uint64 src_mac = nexthop.src_mac();
   uint64 dst_mac = nexthop.dst_mac();
-  int router_intf_id = -1, egress_intf_id = -1;
+  int router_intf_id = -1, egress_intf_id = -1, member_port = -1;
 
   // Given the router intf, find or create the egress intf.
   switch (nexthop.type()) {
@@ -106,6 +113,7 @@ BcmL3Manager::~BcmL3Manager() {}
             egress_intf_id,
             bcm_sdk_interface_->FindOrCreateL3PortEgressIntf(
                 unit_, dst_mac, logical_port, vlan, router_intf_id));
+        member_port = logical_port;
       } else {
         return MAKE_ERROR(ERR_INVALID_PARAM)
                << "Invalid nexthop of type NEXTHOP_TYPE_PORT: "
@@ -156,6 +164,10 @@ BcmL3Manager::~BcmL3Manager() {}
   // SDK internally allocates a router intf. We don care about those router
   // intfs in the code.
   if (router_intf_id > 0) RETURN_IF_ERROR(IncrementRefCount(router_intf_id));
+  {
+    absl::MutexLock l(&ecmp_lock_);
+    SetMemberPort(egress_intf_id, member_port);
+  }
 
   return egress_intf_id;
 }
@@ -176,6 +188,9 @@ BcmL3Manager::~BcmL3Manager() {}
     VLOG(1) << "Got a group with only one member: " << member_ids[0] << ".";
     member_ids.push_back(member_ids[0]);
   }
+  // The lock is held across the SDK call so that a concurrent
+  // PruneMultipathGroupsForPort() does not act on stale members.
+  absl::MutexLock l(&ecmp_lock_);
   ASSIGN_OR_RETURN(
       int egress_intf_id,
       bcm_sdk_interface_->FindOrCreateEcmpEgressIntf(unit_, member_ids));
@@ -183,6 +198,7 @@ BcmL3Manager::~BcmL3Manager() {}
     return MAKE_ERROR(ERR_INVALID_PARAM) << "No egress_intf_id found for "
                                          << nexthop.ShortDebugString() << ".";
   }
+  SetEcmpGroupMembers(egress_intf_id, member_ids);
 
   return egress_intf_id;
 }
@@ -199,7 +215,7 @@ BcmL3Manager::~BcmL3Manager() {}
   int vlan = nexthop.vlan();
   uint64 src_mac = nexthop.src_mac();
   uint64 dst_mac = nexthop.dst_mac();
-  int old_router_intf_id = -1, new_router_intf_id = -1;
+  int old_router_intf_id = -1, new_router_intf_id = -1, member_port = -1;
 
   // First find the old router intf the given egress intf is using. If the old
   // egress intf was for a DROP or CPU trap nexthop, this will return a
@@ -222,6 +238,7 @@ BcmL3Manager::~BcmL3Manager() {}
         RETURN_IF_ERROR(bcm_sdk_interface_->ModifyL3PortEgressIntf(
             unit_, egress_intf_id, dst_mac, logical_port, vlan,
             new_router_intf_id));
+        member_port = logical_port;
       } else {
         return MAKE_ERROR(ERR_INVALID_PARAM)
                << "Invalid nexthop of type NEXTHOP_TYPE_PORT: "
@@ -270,6 +287,10 @@ BcmL3Manager::~BcmL3Manager() {}
   if (old_router_intf_id > 0) {
     RETURN_IF_ERROR(DecrementRefCount(old_router_intf_id));
   }
+  {
+    absl::MutexLock l(&ecmp_lock_);
+    SetMemberPort(egress_intf_id, member_port);
+  }
 
   return ::util::OkStatus();
 }
@@ -284,8 +305,10 @@ BcmL3Manager::~BcmL3Manager() {}
       << "Received multipath nexthop for unit " << nexthop.unit() << " on unit "
       << unit_ << ".";
   ASSIGN_OR_RETURN(std::vector<int> member_ids, FindEcmpGroupMembers(nexthop));
+  absl::MutexLock l(&ecmp_lock_);
   RETURN_IF_ERROR(bcm_sdk_interface_->ModifyEcmpEgressIntf(
       unit_, egress_intf_id, member_ids));
+  SetEcmpGroupMembers(egress_intf_id, member_ids);
 
   return ::util::OkStatus();
 }
@@ -304,6 +327,10 @@ BcmL3Manager::~BcmL3Manager() {}
       bcm_sdk_interface_->FindRouterIntfFromEgressIntf(unit_, egress_intf_id));
   RETURN_IF_ERROR(
       bcm_sdk_interface_->DeleteL3EgressIntf(unit_, egress_intf_id));
+  {
+    absl::MutexLock l(&ecmp_lock_);
+    SetMemberPort(egress_intf_id, -1);
+  }
 
   // Update ref count for the router intf.
   if (router_intf_id > 0) RETURN_IF_ERROR(DecrementRefCount(router_intf_id));
@@ -316,8 +343,10 @@ BcmL3Manager::~BcmL3Manager() {}
     return MAKE_ERROR(ERR_INVALID_PARAM)
            << "Invalid egress_intf_id: " << egress_intf_id << ".";
   }
+  absl::MutexLock l(&ecmp_lock_);
   RETURN_IF_ERROR(
       bcm_sdk_interface_->DeleteEcmpEgressIntf(unit_, egress_intf_id));
+  SetEcmpGroupMembers(egress_intf_id, {});
 
   return ::util::OkStatus();
 }
@@ -425,6 +454,82 @@ BcmL3Manager::~BcmL3Manager() {}
   return ::util::OkStatus();
 }
 
+::util::Status BcmL3Manager::InsertTableEntries(
+    const std::vector<LpmOrHostFlow>& flows,
+    std::vector<::util::Status>* results) {
+  return WriteLpmOrHostFlows(::p4::v1::Update::INSERT, flows, results);
+}
+
+::util::Status BcmL3Manager::ModifyTableEntries(
+    const std::vector<LpmOrHostFlow>& flows,
+    std::vector<::util::Status>* results) {
+  return WriteLpmOrHostFlows(::p4::v1::Update::MODIFY, flows, results);
+}
+
+::util::Status BcmL3Manager::DeleteTableEntries(
+    const std::vector<LpmOrHostFlow>& flows,
+    std::vector<::util::Status>* results) {
+  return WriteLpmOrHostFlows(::p4::v1::Update::DELETE, flows, results);
+}
+
+::util::Status BcmL3Manager::WriteLpmOrHostFlows(
+    ::p4::v1::Update::Type type, const std::vector<LpmOrHostFlow>& flows,
+    std::vector<::util::Status>* results) {
+  CHECK_RETURN_IF_FALSE(results != nullptr) << "Null results!";
+  results->assign(flows.size(), ::util::OkStatus());
+
+  // Translate all the flows first. Flows which cannot be translated get their
+  // error right away and are not sent to the SDK.
+  std::vector<BcmSdkInterface::L3RouteBatchEntry> routes;
+  std::vector<size_t> route_to_flow;  // index into flows for each route
+  routes.reserve(flows.size());
+  route_to_flow.reserve(flows.size());
+  for (size_t i = 0; i < flows.size(); ++i) {
+    BcmSdkInterface::L3RouteBatchEntry route;
+    (*results)[i] =
+        FillL3RouteBatchEntry(type, flows[i].bcm_flow_entry, &route);
+    if (!(*results)[i].ok()) continue;
+    routes.push_back(std::move(route));
+    route_to_flow.push_back(i);
+  }
+  if (routes.empty()) return ::util::OkStatus();
+
+  std::vector<::util::Status> route_results;
+  RETURN_IF_ERROR(
+      bcm_sdk_interface_->ProgramL3RoutesBatch(unit_, routes, &route_results));
+  CHECK_RETURN_IF_FALSE(route_results.size() == routes.size())
+      << "Expected " << routes.size() << " results from SDK, got "
+      << route_results.size() << ".";
+
+  // Update the internal records in BcmTableManager for all the flows that
+  // were successfully programmed on hardware, in the original order.
+  for (size_t j = 0; j < routes.size(); ++j) {
+    size_t i = route_to_flow[j];
+    if (!route_results[j].ok()) {
+      (*results)[i] = route_results[j];
+      continue;
+    }
+    const ::p4::v1::TableEntry& entry = *flows[i].table_entry;
+    switch (type) {
+      case ::p4::v1::Update::INSERT:
+        (*results)[i] = bcm_table_manager_->AddTableEntry(entry);
+        break;
+      case ::p4::v1::Update::MODIFY:
+        (*results)[i] = bcm_table_manager_->UpdateTableEntry(entry);
+        break;
+      case ::p4::v1::Update::DELETE:
+        (*results)[i] = bcm_table_manager_->DeleteTableEntry(entry);
+        break;
+      default:
+        (*results)[i] = MAKE_ERROR(ERR_INTERNAL)
+                        << "Invalid update type "
+                        << ::p4::v1::Update::Type_Name(type) << ".";
+    }
+  }
+
+  return ::util::OkStatus();
+}
+
 ::util::Status BcmL3Manager::UpdateMultipathGroupsForPort(uint32 port_id) {
   // Generate map from BCM multipath group id to data for all groups which
   // reference the given port.
@@ -437,6 +542,55 @@ BcmL3Manager::~BcmL3Manager() {}
   return ::util::OkStatus();
 }
 
+::util::Status BcmL3Manager::PruneMultipathGroupsForPort(int logical_port) {
+  absl::MutexLock l(&ecmp_lock_);
+  const auto* member_intfs = gtl::FindOrNull(port_to_member_intfs_,
+                                             logical_port);
+  if (member_intfs == nullptr) return ::util::OkStatus();
+  // The groups are modified in a deterministic order.
+  std::set<int> ecmp_intfs;
+  for (int member : *member_intfs) {
+    const auto* groups = gtl::FindOrNull(member_to_ecmp_intfs_, member);
+    if (groups == nullptr) continue;
+    ecmp_intfs.insert(groups->begin(), groups->end());
+  }
+  if (ecmp_intfs.empty()) return ::util::OkStatus();
+
+  std::vector<BcmSdkInterface::EcmpEgressIntfBatchEntry> batch;
+  batch.reserve(ecmp_intfs.size());
+  for (int ecmp_intf : ecmp_intfs) {
+    BcmSdkInterface::EcmpEgressIntfBatchEntry entry;
+    entry.egress_intf_id = ecmp_intf;
+    for (int member : ecmp_intf_to_members_[ecmp_intf]) {
+      if (!member_intfs->count(member)) entry.member_ids.push_back(member);
+    }
+    // As in FindEcmpGroupMembers(), the SDK does not accept an empty group.
+    if (entry.member_ids.empty()) {
+      entry.member_ids.push_back(default_drop_intf_);
+    }
+    batch.push_back(entry);
+  }
+  std::vector<::util::Status> results;
+  RETURN_IF_ERROR(
+      bcm_sdk_interface_->ModifyEcmpEgressIntfsBatch(unit_, batch, &results));
+  CHECK_RETURN_IF_FALSE(results.size() == batch.size())
+      << "Expected " << batch.size() << " results, got " << results.size()
+      << ".";
+
+  ::util::Status status = ::util::OkStatus();
+  for (size_t i = 0; i < batch.size(); ++i) {
+    if (!results[i].ok()) {
+      APPEND_STATUS_IF_ERROR(status, results[i]);
+      continue;
+    }
+    SetEcmpGroupMembers(batch[i].egress_intf_id, batch[i].member_ids);
+  }
+  VLOG(1) << "Pruned logical port " << logical_port << " from "
+          << batch.size() << " ECMP/WCMP groups on unit " << unit_ << ".";
+
+  return status;
+}
+
 ::util::Status BcmL3Manager::DeleteLpmOrHostFlow(
     const BcmFlowEntry& bcm_flow_entry) {
   CHECK_RETURN_IF_FALSE(bcm_flow_entry.unit() == unit_)
@@ -466,6 +620,71 @@ BcmL3Manager::~BcmL3Manager() {}
   }
 }
 
+::util::Status BcmL3Manager::FillL3RouteBatchEntry(
+    ::p4::v1::Update::Type type, const BcmFlowEntry& bcm_flow_entry,
+    BcmSdkInterface::L3RouteBatchEntry* route) {
+  CHECK_RETURN_IF_FALSE(bcm_flow_entry.unit() == unit_)
+      << "Received L3 flow for unit " << bcm_flow_entry.unit() << " on unit "
+      << unit_ << ".";
+  typedef BcmSdkInterface::L3RouteBatchEntry L3RouteBatchEntry;
+  const auto bcm_table_type = bcm_flow_entry.bcm_table_type();
+  switch (bcm_table_type) {
+    case BcmFlowEntry::BCM_TABLE_IPV4_LPM:
+      route->type = L3RouteBatchEntry::Type::IPV4_LPM;
+      break;
+    case BcmFlowEntry::BCM_TABLE_IPV4_HOST:
+      route->type = L3RouteBatchEntry::Type::IPV4_HOST;
+      break;
+    case BcmFlowEntry::BCM_TABLE_IPV6_LPM:
+      route->type = L3RouteBatchEntry::Type::IPV6_LPM;
+      break;
+    case BcmFlowEntry::BCM_TABLE_IPV6_HOST:
+      route->type = L3RouteBatchEntry::Type::IPV6_HOST;
+      break;
+    default:
+      return MAKE_ERROR(ERR_INVALID_PARAM)
+             << "Invalid bcm_table_type: "
+             << BcmFlowEntry::BcmTableType_Name(bcm_table_type) << ", found in "
+             << bcm_flow_entry.ShortDebugString() << ".";
+  }
+  switch (type) {
+    case ::p4::v1::Update::INSERT:
+      route->op = L3RouteBatchEntry::Op::ADD;
+      break;
+    case ::p4::v1::Update::MODIFY:
+      route->op = L3RouteBatchEntry::Op::MODIFY;
+      break;
+    case ::p4::v1::Update::DELETE:
+      route->op = L3RouteBatchEntry::Op::DELETE;
+      break;
+    default:
+      return MAKE_ERROR(ERR_INVALID_PARAM)
+             << "Invalid update type " << ::p4::v1::Update::Type_Name(type)
+             << " for " << bcm_flow_entry.ShortDebugString() << ".";
+  }
+  LpmOrHostKey key;
+  RETURN_IF_ERROR(ExtractLpmOrHostKey(bcm_flow_entry, &key));
+  route->vrf = key.vrf;
+  route->subnet_ipv4 = key.subnet_ipv4;
+  route->mask_ipv4 = key.mask_ipv4;
+  route->subnet_ipv6 = key.subnet_ipv6;
+  route->mask_ipv6 = key.mask_ipv6;
+  if (type != ::p4::v1::Update::DELETE) {
+    LpmOrHostActionParams action_params;
+    RETURN_IF_ERROR(
+        ExtractLpmOrHostActionParams(bcm_flow_entry, &action_params));
+    route->class_id = action_params.class_id;
+    route->egress_intf_id = action_params.egress_intf_id;
+    // Only LPM routes can point to ECMP/WCMP egress intfs.
+    route->is_intf_multipath =
+        action_params.is_intf_multipath &&
+        (route->type == L3RouteBatchEntry::Type::IPV4_LPM ||
+         route->type == L3RouteBatchEntry::Type::IPV6_LPM);
+  }
+
+  return ::util::OkStatus();
+}
+
 std::unique_ptr<BcmL3Manager> BcmL3Manager::CreateInstance(
     BcmSdkInterface* bcm_sdk_interface, BcmTableManager* bcm_table_manager,
     int unit) {
@@ -696,6 +915,39 @@ std::unique_ptr<BcmL3Manager> BcmL3Manager::CreateInstance(
   return member_ids;
 }
 
+void BcmL3Manager::SetMemberPort(int egress_intf_id, int logical_port) {
+  auto it = member_intf_to_port_.find(egress_intf_id);
+  if (it != member_intf_to_port_.end()) {
+    if (it->second == logical_port) return;
+    auto& intfs = port_to_member_intfs_[it->second];
+    intfs.erase(egress_intf_id);
+    if (intfs.empty()) port_to_member_intfs_.erase(it->second);
+    member_intf_to_port_.erase(it);
+  }
+  if (logical_port < 0) return;
+  member_intf_to_port_[egress_intf_id] = logical_port;
+  port_to_member_intfs_[logical_port].insert(egress_intf_id);
+}
+
+void BcmL3Manager::SetEcmpGroupMembers(int egress_intf_id,
+                                       const std::vector<int>& member_ids) {
+  auto it = ecmp_intf_to_members_.find(egress_intf_id);
+  if (it != ecmp_intf_to_members_.end()) {
+    for (int member : it->second) {
+      auto groups = member_to_ecmp_intfs_.find(member);
+      if (groups == member_to_ecmp_intfs_.end()) continue;
+      groups->second.erase(egress_intf_id);
+      if (groups->second.empty()) member_to_ecmp_intfs_.erase(groups);
+    }
+    ecmp_intf_to_members_.erase(it);
+  }
+  if (member_ids.empty()) return;
+  ecmp_intf_to_members_[egress_intf_id] = member_ids;
+  for (int member : member_ids) {
+    member_to_ecmp_intfs_[member].insert(egress_intf_id);
+  }
+}
+
 ::util::Status BcmL3Manager::IncrementRefCount(int router_intf_id) {
   router_intf_ref_count_[router_intf_id]++;
 
@@ -27,6 +27,8 @@
 #include "stratum/glue/integral_types.h"
 #include "absl/base/thread_annotations.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/synchronization/mutex.h"
 #include "stratum/glue/status/status.h"
 #include "stratum/hal/lib/bcm/bcm.pb.h"
 #include "stratum/hal/lib/bcm/bcm_sdk_interface.h"
@@ -70,6 +72,17 @@ struct LpmOrHostActionParams {
       : class_id(-1), egress_intf_id(-1), is_intf_multipath(false) {}
 };
 
+// This struct encapsulates an IPv4/IPv6 LPM/host flow given to the batched
+// table entry APIs of BcmL3Manager, i.e. the P4 TableEntry along with the
+// BcmFlowEntry it has already been mapped to.
+struct LpmOrHostFlow {
+  // The P4 TableEntry for the flow. Not owned by this struct.
+  const ::p4::v1::TableEntry* table_entry;
+  // The BcmFlowEntry populated for table_entry by BcmTableManager.
+  BcmFlowEntry bcm_flow_entry;
+  LpmOrHostFlow() : table_entry(nullptr), bcm_flow_entry() {}
+};
+
 // The "BcmL3Manager" class implements the L3 routing functionality.
 class BcmL3Manager {
  public:
@@ -139,6 +152,21 @@ class BcmL3Manager {
   // not needed).
   virtual ::util::Status DeleteTableEntry(const ::p4::v1::TableEntry& entry);
 
+  // Batched versions of InsertTableEntry(), ModifyTableEntry() and
+  // DeleteTableEntry(). All the given flows are programmed on the unit using
+  // a single batched SDK call. results is populated with one status per flow,
+  // in the same order as the given flows. The returned status is an error only
+  // if the batch could not be attempted at all.
+  virtual ::util::Status InsertTableEntries(
+      const std::vector<LpmOrHostFlow>& flows,
+      std::vector<::util::Status>* results);
+  virtual ::util::Status ModifyTableEntries(
+      const std::vector<LpmOrHostFlow>& flows,
+      std::vector<::util::Status>* results);
+  virtual ::util::Status DeleteTableEntries(
+      const std::vector<LpmOrHostFlow>& flows,
+      std::vector<::util::Status>* results);
+
   // Updates any ECMP/WCMP groups which include a member pointing to the given
   // singleton port. Adds or removes the port to or from all groups referencing
   // it based on whether the port is UP or not, respectively. In the case that
@@ -146,6 +174,15 @@ class BcmL3Manager {
   // as the SDK does not support ECMP groups programmed with no nexthops.
   virtual ::util::Status UpdateMultipathGroupsForPort(uint32 port_id);
 
+  // Removes all the members egressing through the given logical port from the
+  // ECMP/WCMP groups, using a single batched SDK call. This is the fast path
+  // for link-down failover: it only relies on the state kept by this class
+  // and can be called without holding the locks protecting the state of the
+  // node (e.g. BcmTableManager). The port is added back to the groups once
+  // UpdateMultipathGroupsForPort() is called for it.
+  virtual ::util::Status PruneMultipathGroupsForPort(int logical_port)
+      LOCKS_EXCLUDED(ecmp_lock_);
+
   // Factory function for creating the instance of the class.
   static std::unique_ptr<BcmL3Manager> CreateInstance(
       BcmSdkInterface* bcm_sdk_interface, BcmTableManager* bcm_table_manager,
@@ -179,6 +216,18 @@ class BcmL3Manager {
   // define the key for the flow (the egress_intf_id or class_id not needed).
   ::util::Status DeleteLpmOrHostFlow(const BcmFlowEntry& bcm_flow_entry);
 
+  // Common implementation of the batched table entry APIs, programming the
+  // given flows using the given update type.
+  ::util::Status WriteLpmOrHostFlows(::p4::v1::Update::Type type,
+                                     const std::vector<LpmOrHostFlow>& flows,
+                                     std::vector<::util::Status>* results);
+
+  // Helper to populate the BcmSdkInterface::L3RouteBatchEntry used to program
+  // the given IPv4/IPv6 L3 LPM/Host flow as part of a batch.
+  ::util::Status FillL3RouteBatchEntry(
+      ::p4::v1::Update::Type type, const BcmFlowEntry& bcm_flow_entry,
+      BcmSdkInterface::L3RouteBatchEntry* route);
+
   // Helper to extract IPv4/IPv6 L3 LPM/Host flow keys given BcmFlowEntry.
   ::util::Status ExtractLpmOrHostKey(const BcmFlowEntry& bcm_flow_entry,
                                      LpmOrHostKey* key);
@@ -200,12 +249,43 @@ class BcmL3Manager {
   ::util::Status IncrementRefCount(int router_intf_id);
   ::util::Status DecrementRefCount(int router_intf_id);
 
+  // Helpers to keep track of the logical port of the non-multipath egress
+  // intfs and of the members of the multipath egress intfs, as used by
+  // PruneMultipathGroupsForPort(). A negative logical_port or an empty
+  // member_ids removes the egress intf from the maps.
+  void SetMemberPort(int egress_intf_id, int logical_port)
+      EXCLUSIVE_LOCKS_REQUIRED(ecmp_lock_);
+  void SetEcmpGroupMembers(int egress_intf_id,
+                           const std::vector<int>& member_ids)
+      EXCLUSIVE_LOCKS_REQUIRED(ecmp_lock_);
+
   // Map from router_intf_id to ref counts (the number egress intfs pointing to
   // this router intf).
   // TODO(unknown): We keep this map as there is no good way to get this
   // directly from SDK. Investigate.
   absl::flat_hash_map<int, uint32> router_intf_ref_count_;
 
+  // Mutex protecting the maps below, which are also accessed from the
+  // link-down failover path.
+  mutable absl::Mutex ecmp_lock_;
+
+  // Map from multipath egress intf ID to the egress intf IDs of its members,
+  // as last programmed in the SDK.
+  absl::flat_hash_map<int, std::vector<int>> ecmp_intf_to_members_
+      GUARDED_BY(ecmp_lock_);
+
+  // Map from non-multipath egress intf ID to the multipath egress intf IDs
+  // having it as a member.
+  absl::flat_hash_map<int, absl::flat_hash_set<int>> member_to_ecmp_intfs_
+      GUARDED_BY(ecmp_lock_);
+
+  // Map from non-multipath egress intf ID to the logical port it egresses
+  // through, and its reverse. Only the egress intfs pointing to a regular
+  // port are kept here.
+  absl::flat_hash_map<int, int> member_intf_to_port_ GUARDED_BY(ecmp_lock_);
+  absl::flat_hash_map<int, absl::flat_hash_set<int>> port_to_member_intfs_
+      GUARDED_BY(ecmp_lock_);
+
   // Pointer to a BcmSdkInterface implementation that wraps all the SDK calls.
   BcmSdkInterface* bcm_sdk_interface_;  // Not owned by this class.
 
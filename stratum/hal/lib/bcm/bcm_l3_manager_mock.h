@@ -19,6 +19,8 @@
 #ifndef STRATUM_HAL_LIB_BCM_BCM_L3_MANAGER_MOCK_H_
 #define STRATUM_HAL_LIB_BCM_BCM_L3_MANAGER_MOCK_H_
 
+#include <vector>
+
 #include "stratum/hal/lib/bcm/bcm_l3_manager.h"
 #include "gmock/gmock.h"
 
@@ -51,7 +53,17 @@ class BcmL3ManagerMock : public BcmL3Manager {
                ::util::Status(const ::p4::v1::TableEntry& entry));
   MOCK_METHOD1(DeleteTableEntry,
                ::util::Status(const ::p4::v1::TableEntry& entry));
+  MOCK_METHOD2(InsertTableEntries,
+               ::util::Status(const std::vector<LpmOrHostFlow>& flows,
+                              std::vector<::util::Status>* results));
+  MOCK_METHOD2(ModifyTableEntries,
+               ::util::Status(const std::vector<LpmOrHostFlow>& flows,
+                              std::vector<::util::Status>* results));
+  MOCK_METHOD2(DeleteTableEntries,
+               ::util::Status(const std::vector<LpmOrHostFlow>& flows,
+                              std::vector<::util::Status>* results));
   MOCK_METHOD1(UpdateMultipathGroupsForPort, ::util::Status(uint32 port_id));
+  MOCK_METHOD1(PruneMultipathGroupsForPort, ::util::Status(int logical_port));
 };
 
 }  // namespace bcm
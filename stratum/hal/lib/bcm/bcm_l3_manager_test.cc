@@ -36,7 +36,9 @@ using test_utils::EqualsProto;
 using ::testing::_;
 using ::testing::DoAll;
 using ::testing::HasSubstr;
+using ::testing::Invoke;
 using ::testing::Return;
+using ::testing::SaveArg;
 using ::testing::SetArgPointee;
 using ::testing::StrictMock;
 
@@ -1014,6 +1016,98 @@ TEST_F(BcmL3ManagerTest, UpdateMultipathGroupsForPortFailure) {
   EXPECT_EQ("error2", status.error_message());
 }
 
+TEST_F(BcmL3ManagerTest, PruneMultipathGroupsForPortSuccess) {
+  constexpr int kOtherLogicalPort = 34;
+  ChassisConfig config;
+  config.add_nodes()->set_id(kNodeId);
+  EXPECT_CALL(*bcm_sdk_mock_, FindOrCreateL3DropIntf(kUnit))
+      .WillOnce(Return(kEgressIntfId2 + 1));
+  ASSERT_OK(bcm_l3_manager_->PushChassisConfig(config, kNodeId));
+
+  // Members 1 and 3 egress through kLogicalPort, member 2 through
+  // kOtherLogicalPort.
+  BcmNonMultipathNexthop other_port_nexthop = port_nexthop_;
+  other_port_nexthop.set_logical_port(kOtherLogicalPort);
+  EXPECT_CALL(*bcm_sdk_mock_, FindOrCreateL3RouterIntf(kUnit, kSrcMac, kVlan))
+      .WillRepeatedly(Return(kNewRouterIntfId));
+  EXPECT_CALL(*bcm_sdk_mock_,
+              FindOrCreateL3PortEgressIntf(kUnit, kDstMac, kLogicalPort, kVlan,
+                                           kNewRouterIntfId))
+      .WillOnce(Return(kMemberEgressIntfId1))
+      .WillOnce(Return(kMemberEgressIntfId3));
+  EXPECT_CALL(*bcm_sdk_mock_,
+              FindOrCreateL3PortEgressIntf(kUnit, kDstMac, kOtherLogicalPort,
+                                           kVlan, kNewRouterIntfId))
+      .WillOnce(Return(kMemberEgressIntfId2));
+  ASSERT_OK(
+      bcm_l3_manager_->FindOrCreateNonMultipathNexthop(port_nexthop_).status());
+  ASSERT_OK(bcm_l3_manager_->FindOrCreateNonMultipathNexthop(other_port_nexthop)
+                .status());
+  ASSERT_OK(
+      bcm_l3_manager_->FindOrCreateNonMultipathNexthop(port_nexthop_).status());
+  EXPECT_CALL(*bcm_sdk_mock_,
+              FindOrCreateEcmpEgressIntf(kUnit, wcmp_group1_member_ids_))
+      .WillOnce(Return(kEgressIntfId1));
+  EXPECT_CALL(*bcm_sdk_mock_,
+              FindOrCreateEcmpEgressIntf(kUnit, wcmp_group2_member_ids_))
+      .WillOnce(Return(kEgressIntfId2));
+  ASSERT_OK(
+      bcm_l3_manager_->FindOrCreateMultipathNexthop(wcmp_nexthop1_).status());
+  ASSERT_OK(
+      bcm_l3_manager_->FindOrCreateMultipathNexthop(wcmp_nexthop2_).status());
+
+  // Both groups are modified with a single batched call. The second group has
+  // no member left and points to the drop intf.
+  std::vector<BcmSdkInterface::EcmpEgressIntfBatchEntry> batch;
+  EXPECT_CALL(*bcm_sdk_mock_, ModifyEcmpEgressIntfsBatch(kUnit, _, _))
+      .WillOnce(DoAll(SaveArg<1>(&batch),
+                      SetArgPointee<2>(std::vector<::util::Status>(
+                          2, ::util::OkStatus())),
+                      Return(::util::OkStatus())));
+  ASSERT_OK(bcm_l3_manager_->PruneMultipathGroupsForPort(kLogicalPort));
+  ASSERT_EQ(2U, batch.size());
+  EXPECT_EQ(kEgressIntfId1, batch[0].egress_intf_id);
+  EXPECT_EQ(std::vector<int>(kMemberWeight2, kMemberEgressIntfId2),
+            batch[0].member_ids);
+  EXPECT_EQ(kEgressIntfId2, batch[1].egress_intf_id);
+  EXPECT_EQ(std::vector<int>(1, kEgressIntfId2 + 1), batch[1].member_ids);
+
+  // The port is not a member of any group anymore. No SDK call is expected.
+  ASSERT_OK(bcm_l3_manager_->PruneMultipathGroupsForPort(kLogicalPort));
+  ASSERT_OK(bcm_l3_manager_->PruneMultipathGroupsForPort(kLogicalPort + 100));
+}
+
+TEST_F(BcmL3ManagerTest, PruneMultipathGroupsForPortFailure) {
+  EXPECT_CALL(*bcm_sdk_mock_, FindOrCreateL3RouterIntf(kUnit, kSrcMac, kVlan))
+      .WillOnce(Return(kNewRouterIntfId));
+  EXPECT_CALL(*bcm_sdk_mock_,
+              FindOrCreateL3PortEgressIntf(kUnit, kDstMac, kLogicalPort, kVlan,
+                                           kNewRouterIntfId))
+      .WillOnce(Return(kMemberEgressIntfId1));
+  EXPECT_CALL(*bcm_sdk_mock_,
+              FindOrCreateEcmpEgressIntf(kUnit, wcmp_group1_member_ids_))
+      .WillOnce(Return(kEgressIntfId1));
+  ASSERT_OK(
+      bcm_l3_manager_->FindOrCreateNonMultipathNexthop(port_nexthop_).status());
+  ASSERT_OK(
+      bcm_l3_manager_->FindOrCreateMultipathNexthop(wcmp_nexthop1_).status());
+
+  // The SDK rejects the group. The port is kept in the group so that the next
+  // attempt retries it.
+  EXPECT_CALL(*bcm_sdk_mock_, ModifyEcmpEgressIntfsBatch(kUnit, _, _))
+      .WillOnce(DoAll(SetArgPointee<2>(std::vector<::util::Status>(
+                          1, ::util::UnknownErrorBuilder(GTL_LOC) << "error")),
+                      Return(::util::OkStatus())))
+      .WillOnce(DoAll(SetArgPointee<2>(std::vector<::util::Status>(
+                          1, ::util::OkStatus())),
+                      Return(::util::OkStatus())));
+  auto status = bcm_l3_manager_->PruneMultipathGroupsForPort(kLogicalPort);
+  EXPECT_FALSE(status.ok());
+  EXPECT_EQ(ERR_UNKNOWN, status.error_code());
+  EXPECT_THAT(status.error_message(), HasSubstr("error"));
+  ASSERT_OK(bcm_l3_manager_->PruneMultipathGroupsForPort(kLogicalPort));
+}
+
 // TODO(unknown): Define static proto text and others constants in the test
 // class, similar to nexthops.
 TEST_F(BcmL3ManagerTest,
@@ -1906,6 +2000,98 @@ TEST_F(BcmL3ManagerTest, DeleteLpmOrHostFlowP4ConversionFailure) {
   ASSERT_FALSE(bcm_l3_manager_->DeleteTableEntry(p4_table_entry).ok());
 }
 
+TEST_F(BcmL3ManagerTest, InsertTableEntriesBatchesLpmFlowsInOneSdkCall) {
+  const std::string kBcmFlowEntryText = R"(
+      unit: 3
+      bcm_table_type: BCM_TABLE_IPV4_LPM
+      fields: {
+        type: IPV4_DST
+        value {
+          u32: 0xc0a00100
+        }
+        mask {
+          u32: 0xffffff00
+        }
+      }
+      fields: {
+        type: VRF
+        value {
+          u32: 80
+        }
+      }
+      actions: {
+        type: OUTPUT_L3
+        params {
+          type: EGRESS_INTF_ID
+          value {
+            u32: 200256
+          }
+        }
+      }
+  )";
+
+  std::vector<LpmOrHostFlow> flows(2);
+  std::vector<::p4::v1::TableEntry> p4_table_entries(2);
+  for (int i = 0; i < 2; ++i) {
+    ASSERT_OK(
+        ParseProtoFromString(kBcmFlowEntryText, &flows[i].bcm_flow_entry));
+    flows[i].bcm_flow_entry.mutable_fields(0)->mutable_value()->set_u32(
+        0xc0a00100 + (i << 8));
+    p4_table_entries[i].set_table_id(i + 1);
+    flows[i].table_entry = &p4_table_entries[i];
+  }
+
+  // The second route is rejected by the SDK. Only the first one must be
+  // recorded in BcmTableManager.
+  EXPECT_CALL(*bcm_sdk_mock_, ProgramL3RoutesBatch(kUnit, _, _))
+      .WillOnce(Invoke(
+          [](int unit,
+             const std::vector<BcmSdkInterface::L3RouteBatchEntry>& routes,
+             std::vector<::util::Status>* results) {
+            EXPECT_EQ(2U, routes.size());
+            for (const auto& route : routes) {
+              EXPECT_EQ(BcmSdkInterface::L3RouteBatchEntry::Op::ADD, route.op);
+              EXPECT_EQ(BcmSdkInterface::L3RouteBatchEntry::Type::IPV4_LPM,
+                        route.type);
+              EXPECT_EQ(80, route.vrf);
+              EXPECT_EQ(0xffffff00, route.mask_ipv4);
+              EXPECT_EQ(200256, route.egress_intf_id);
+              EXPECT_TRUE(route.is_intf_multipath);
+            }
+            EXPECT_EQ(0xc0a00100, routes[0].subnet_ipv4);
+            EXPECT_EQ(0xc0a00200, routes[1].subnet_ipv4);
+            results->push_back(::util::OkStatus());
+            results->push_back(::util::UnknownErrorBuilder(GTL_LOC)
+                               << "error");
+            return ::util::OkStatus();
+          }));
+  EXPECT_CALL(*bcm_table_manager_mock_,
+              AddTableEntry(EqualsProto(p4_table_entries[0])))
+      .WillOnce(Return(::util::OkStatus()));
+
+  std::vector<::util::Status> results;
+  ASSERT_OK(bcm_l3_manager_->InsertTableEntries(flows, &results));
+  ASSERT_EQ(2U, results.size());
+  EXPECT_OK(results[0]);
+  EXPECT_EQ(ERR_UNKNOWN, results[1].error_code());
+}
+
+TEST_F(BcmL3ManagerTest, DeleteTableEntriesFailureForInvalidFlow) {
+  std::vector<LpmOrHostFlow> flows(1);
+  ::p4::v1::TableEntry p4_table_entry;
+  flows[0].table_entry = &p4_table_entry;
+  flows[0].bcm_flow_entry.set_unit(kUnit + 1);  // wrong unit
+  flows[0].bcm_flow_entry.set_bcm_table_type(BcmFlowEntry::BCM_TABLE_IPV4_LPM);
+
+  // Flows which cannot be translated never reach the SDK.
+  EXPECT_CALL(*bcm_sdk_mock_, ProgramL3RoutesBatch(_, _, _)).Times(0);
+
+  std::vector<::util::Status> results;
+  ASSERT_OK(bcm_l3_manager_->DeleteTableEntries(flows, &results));
+  ASSERT_EQ(1U, results.size());
+  EXPECT_FALSE(results[0].ok());
+}
+
 // TODO(unknown): Add more coverage for the failure case.
 
 }  // namespace bcm
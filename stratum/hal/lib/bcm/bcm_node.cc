@@ -13,6 +13,8 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <limits>
 #include <utility>
 #include <set>
 
@@ -27,6 +29,13 @@
 DEFINE_bool(enable_static_table_writes, true,
             "Enables writes of static table "
             "entries from the P4 pipeline config to the hardware tables");
+DEFINE_int32(read_response_chunk_size, 1024,
+             "Max number of table entries in every ReadResponse streamed back "
+             "for a P4Runtime Read request. 0 means no limit.");
+DEFINE_int32(max_l3_flow_batch_size, 1024,
+             "Max number of consecutive IPv4/IPv6 LPM/host flow updates in a "
+             "P4 WriteRequest which are programmed on hardware as a single "
+             "batch. If 0, the flows are programmed one by one.");
 
 namespace stratum {
 namespace hal {
@@ -124,6 +133,7 @@ BcmNode::~BcmNode() {}
   RETURN_IF_ERROR(p4_table_mapper_->PushForwardingPipelineConfig(config));
   RETURN_IF_ERROR(bcm_acl_manager_->PushForwardingPipelineConfig(config));
   RETURN_IF_ERROR(bcm_tunnel_manager_->PushForwardingPipelineConfig(config));
+  RETURN_IF_ERROR(bcm_packetio_manager_->PushForwardingPipelineConfig(config));
   RETURN_IF_ERROR(StaticEntryWrite(p4_pipeline_config, /*post_push=*/true));
 
   return ::util::OkStatus();
@@ -132,6 +142,9 @@ BcmNode::~BcmNode() {}
 ::util::Status BcmNode::VerifyForwardingPipelineConfig(
     const ::p4::v1::ForwardingPipelineConfig& config) {
   absl::ReaderMutexLock l(&lock_);
+  // Flows may be written while verifying, as both only hold lock_ shared.
+  absl::ReaderMutexLock fwd_lock(&fwd_lock_);
+  absl::ReaderMutexLock acl_lock(&acl_lock_);
   ::util::Status status = ::util::OkStatus();
   APPEND_STATUS_IF_ERROR(
       status, p4_table_mapper_->VerifyForwardingPipelineConfig(config));
@@ -172,12 +185,16 @@ BcmNode::~BcmNode() {}
     const ::p4::v1::WriteRequest& req, std::vector<::util::Status>* results) {
   CHECK_RETURN_IF_FALSE(results) << "Results pointer must be non-null.";
 
-  absl::WriterMutexLock l(&lock_);
+  absl::ReaderMutexLock l(&lock_);
   CHECK_RETURN_IF_FALSE(req.device_id() == node_id_)
       << "Request device id must be same as id of this BcmNode.";
   if (!initialized_) {
     return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
   }
+  bool needs_fwd = false, needs_acl = false;
+  GetWriteLockStripes(req, &needs_fwd, &needs_acl);
+  absl::MutexLockMaybe fwd_lock(needs_fwd ? &fwd_lock_ : nullptr);
+  absl::MutexLockMaybe acl_lock(needs_acl ? &acl_lock_ : nullptr);
   return DoWriteForwardingEntries(req, results);
 }
 
@@ -188,12 +205,6 @@ BcmNode::~BcmNode() {}
   CHECK_RETURN_IF_FALSE(writer) << "Channel writer must be non-null.";
   CHECK_RETURN_IF_FALSE(details) << "Details pointer must be non-null.";
 
-  absl::ReaderMutexLock l(&lock_);
-  CHECK_RETURN_IF_FALSE(req.device_id() == node_id_)
-      << "Request device id must be same as id of this BcmNode.";
-  if (!initialized_) {
-    return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
-  }
   std::set<uint32> table_ids = {};
   std::set<uint32> action_profile_ids = {};
   std::set<uint32> clone_session_ids = {};
@@ -203,109 +214,120 @@ BcmNode::~BcmNode() {}
   bool action_profile_groups_requested = false;
   bool clone_sessions_requested = false;
   bool multicast_groups_requested = false;
-  for (const auto& entity : req.entities()) {
-    ::util::Status status = ::util::OkStatus();
-    switch (entity.entity_case()) {
-      case ::p4::v1::Entity::kExternEntry:
-        // TODO(unknown): Implement this.
-        return MAKE_ERROR(ERR_OPER_NOT_SUPPORTED)
-               << "Extern entries are not currently supported.";
-      case ::p4::v1::Entity::kTableEntry:
-        table_ids.insert(entity.table_entry().table_id());
-        table_entries_requested = true;
-        break;
-      case ::p4::v1::Entity::kActionProfileMember:
-        action_profile_ids.insert(
-            entity.action_profile_member().action_profile_id());
-        action_profile_members_requested = true;
-        break;
-      case ::p4::v1::Entity::kActionProfileGroup:
-        action_profile_ids.insert(
-            entity.action_profile_group().action_profile_id());
-        action_profile_groups_requested = true;
-        break;
-      case ::p4::v1::Entity::kPacketReplicationEngineEntry:
-        if (entity.packet_replication_engine_entry().has_multicast_group_entry()) {
-          multicast_group_ids.insert(
-              entity.packet_replication_engine_entry().multicast_group_entry()
-                  .multicast_group_id());
-          multicast_groups_requested = true;
-        }
-        if (entity.packet_replication_engine_entry().has_clone_session_entry()) {
-            clone_session_ids.insert(
-              entity.packet_replication_engine_entry().clone_session_entry()
-                  .session_id());
-          clone_sessions_requested = true;
-        }
-        break;
-      case ::p4::v1::Entity::kMeterEntry:
-        // TODO(unknown): Implement this.
-        status = MAKE_ERROR(ERR_OPER_NOT_SUPPORTED)
-                 << "Meter entries are not currently supported: "
-                 << entity.ShortDebugString() << ".";
-        if (details != nullptr) details->push_back(status);
-        break;
-      case ::p4::v1::Entity::kDirectMeterEntry:
-        // TODO(unknown): Implement this.
-        status = MAKE_ERROR(ERR_OPER_NOT_SUPPORTED)
-                 << "Direct meter entries are not currently supported: "
-                 << entity.ShortDebugString() << ".";
-        if (details != nullptr) details->push_back(status);
-        break;
-      case ::p4::v1::Entity::kCounterEntry:
-        // TODO(unknown): Implement this.
-        status = MAKE_ERROR(ERR_OPER_NOT_SUPPORTED)
-                 << "Counter entries are not currently supported: "
-                 << entity.ShortDebugString() << ".";
-        if (details != nullptr) details->push_back(status);
-        break;
-      case ::p4::v1::Entity::kDirectCounterEntry: {
-        // Attempt to read ACL stats for table entry identified in request.
-        ::p4::v1::ReadResponse resp;
-        ::p4::v1::CounterData* counter =
-            resp.add_entities()->mutable_direct_counter_entry()->mutable_data();
-        RETURN_IF_ERROR(bcm_acl_manager_->GetTableEntryStats(
-            entity.direct_counter_entry().table_entry(), counter));
-        if (!writer->Write(resp)) {
-          return MAKE_ERROR(ERR_INTERNAL)
-                 << "Write to stream for failed for node " << node_id_ << ".";
+  std::vector<BcmFlowTableSnapshot> snapshots;
+  {
+    absl::ReaderMutexLock l(&lock_);
+    CHECK_RETURN_IF_FALSE(req.device_id() == node_id_)
+        << "Request device id must be same as id of this BcmNode.";
+    if (!initialized_) {
+      return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
+    }
+    absl::ReaderMutexLock fwd_lock(&fwd_lock_);
+    absl::ReaderMutexLock acl_lock(&acl_lock_);
+    for (const auto& entity : req.entities()) {
+      ::util::Status status = ::util::OkStatus();
+      switch (entity.entity_case()) {
+        case ::p4::v1::Entity::kExternEntry:
+          // TODO(unknown): Implement this.
+          return MAKE_ERROR(ERR_OPER_NOT_SUPPORTED)
+                 << "Extern entries are not currently supported.";
+        case ::p4::v1::Entity::kTableEntry:
+          table_ids.insert(entity.table_entry().table_id());
+          table_entries_requested = true;
+          break;
+        case ::p4::v1::Entity::kActionProfileMember:
+          action_profile_ids.insert(
+              entity.action_profile_member().action_profile_id());
+          action_profile_members_requested = true;
+          break;
+        case ::p4::v1::Entity::kActionProfileGroup:
+          action_profile_ids.insert(
+              entity.action_profile_group().action_profile_id());
+          action_profile_groups_requested = true;
+          break;
+        case ::p4::v1::Entity::kPacketReplicationEngineEntry:
+          if (entity.packet_replication_engine_entry().has_multicast_group_entry()) {
+            multicast_group_ids.insert(
+                entity.packet_replication_engine_entry().multicast_group_entry()
+                    .multicast_group_id());
+            multicast_groups_requested = true;
+          }
+          if (entity.packet_replication_engine_entry().has_clone_session_entry()) {
+              clone_session_ids.insert(
+                entity.packet_replication_engine_entry().clone_session_entry()
+                    .session_id());
+            clone_sessions_requested = true;
+          }
+          break;
+        case ::p4::v1::Entity::kMeterEntry:
+          // TODO(unknown): Implement this.
+          status = MAKE_ERROR(ERR_OPER_NOT_SUPPORTED)
+                   << "Meter entries are not currently supported: "
+                   << entity.ShortDebugString() << ".";
+          if (details != nullptr) details->push_back(status);
+          break;
+        case ::p4::v1::Entity::kDirectMeterEntry:
+          // TODO(unknown): Implement this.
+          status = MAKE_ERROR(ERR_OPER_NOT_SUPPORTED)
+                   << "Direct meter entries are not currently supported: "
+                   << entity.ShortDebugString() << ".";
+          if (details != nullptr) details->push_back(status);
+          break;
+        case ::p4::v1::Entity::kCounterEntry:
+          // TODO(unknown): Implement this.
+          status = MAKE_ERROR(ERR_OPER_NOT_SUPPORTED)
+                   << "Counter entries are not currently supported: "
+                   << entity.ShortDebugString() << ".";
+          if (details != nullptr) details->push_back(status);
+          break;
+        case ::p4::v1::Entity::kDirectCounterEntry: {
+          // Attempt to read ACL stats for table entry identified in request.
+          ::p4::v1::ReadResponse resp;
+          ::p4::v1::CounterData* counter =
+              resp.add_entities()->mutable_direct_counter_entry()->mutable_data();
+          RETURN_IF_ERROR(bcm_acl_manager_->GetTableEntryStats(
+              entity.direct_counter_entry().table_entry(), counter));
+          if (!writer->Write(resp)) {
+            return MAKE_ERROR(ERR_INTERNAL)
+                   << "Write to stream for failed for node " << node_id_ << ".";
+          }
+          break;
         }
-        break;
+        case ::p4::v1::Entity::ENTITY_NOT_SET:
+          status = MAKE_ERROR(ERR_INVALID_PARAM)
+                   << "Empty entity: " << entity.ShortDebugString() << ".";
+          if (details != nullptr) details->push_back(status);
+          break;
+        default:
+          status = MAKE_ERROR(ERR_OPER_NOT_SUPPORTED)
+                   << "Unsupported entity type " << entity.entity_case()
+                   << " with no plan of support: " << entity.ShortDebugString()
+                   << ".";
+          if (details != nullptr) details->push_back(status);
       }
-      case ::p4::v1::Entity::ENTITY_NOT_SET:
-        status = MAKE_ERROR(ERR_INVALID_PARAM)
-                 << "Empty entity: " << entity.ShortDebugString() << ".";
-        if (details != nullptr) details->push_back(status);
-        break;
-      default:
-        status = MAKE_ERROR(ERR_OPER_NOT_SUPPORTED)
-                 << "Unsupported entity type " << entity.entity_case()
-                 << " with no plan of support: " << entity.ShortDebugString()
-                 << ".";
-        if (details != nullptr) details->push_back(status);
     }
-  }
 
-  if (table_ids.count(0)) table_ids.clear();                    // request all
-  if (action_profile_ids.count(0)) action_profile_ids.clear();  // request all
+    if (table_ids.count(0)) table_ids.clear();                    // request all
+    if (action_profile_ids.count(0)) action_profile_ids.clear();  // request all
 
-  if (table_entries_requested) {
-    ::p4::v1::ReadResponse resp;
-    std::vector<::p4::v1::TableEntry*> acl_flows;
-    // Populate response with table entries and obtain list of pointers into the
-    // response to entries for which stats need to be collected.
-    RETURN_IF_ERROR(
-        bcm_table_manager_->ReadTableEntries(table_ids, &resp, &acl_flows));
-    // Collect ACL stats.
-    for (auto* flow : acl_flows) {
-      RETURN_IF_ERROR(bcm_acl_manager_->GetTableEntryStats(
-          *flow, flow->mutable_counter_data()));
-    }
-    if (!writer->Write(resp)) {
-      return MAKE_ERROR(ERR_INTERNAL)
-             << "Write to stream for failed for node " << node_id_ << ".";
+    // Only a snapshot of the table entries is taken while holding the locks.
+    // The entries are then materialized and streamed to the writer in chunks
+    // without blocking the writes.
+    if (table_entries_requested) {
+      RETURN_IF_ERROR(
+          bcm_table_manager_->SnapshotTableEntries(table_ids, &snapshots));
     }
   }
+
+  if (table_entries_requested) {
+    RETURN_IF_ERROR(StreamTableEntries(snapshots, req.device_id(), writer));
+  }
+
+  absl::ReaderMutexLock l(&lock_);
+  if (!initialized_) {
+    return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
+  }
+  absl::ReaderMutexLock fwd_lock(&fwd_lock_);
   if (action_profile_members_requested) {
     RETURN_IF_ERROR(bcm_table_manager_->ReadActionProfileMembers(
         action_profile_ids, writer));
@@ -326,6 +348,72 @@ BcmNode::~BcmNode() {}
   return ::util::OkStatus();
 }
 
+::util::Status BcmNode::StreamTableEntries(
+    const std::vector<BcmFlowTableSnapshot>& snapshots, uint64 node_id,
+    WriterInterface<::p4::v1::ReadResponse>* writer) {
+  const int chunk_size = FLAGS_read_response_chunk_size > 0
+                             ? FLAGS_read_response_chunk_size
+                             : std::numeric_limits<int>::max();
+  ::p4::v1::ReadResponse resp;
+  bool written = false;
+  auto write_resp = [writer, node_id, &resp, &written]() -> ::util::Status {
+    if (!writer->Write(resp)) {
+      return MAKE_ERROR(ERR_INTERNAL)
+             << "Write to stream for failed for node " << node_id << ".";
+    }
+    resp.Clear();
+    written = true;
+    return ::util::OkStatus();
+  };
+  for (const auto& snapshot : snapshots) {
+    size_t i = 0;
+    while (i < snapshot.entries.size()) {
+      size_t n = std::min(
+          static_cast<size_t>(chunk_size - resp.entities_size()),
+          snapshot.entries.size() - i);
+      std::vector<::p4::v1::TableEntry> flows;
+      flows.reserve(n);
+      for (size_t j = i; j < i + n; ++j) {
+        ASSIGN_OR_RETURN(::p4::v1::TableEntry flow,
+                         snapshot.entries[j].Unpack());
+        flows.push_back(std::move(flow));
+      }
+      i += n;
+      if (snapshot.is_acl) RETURN_IF_ERROR(CollectAclStats(&flows));
+      for (auto& flow : flows) {
+        *resp.add_entities()->mutable_table_entry() = std::move(flow);
+      }
+      if (resp.entities_size() >= chunk_size) RETURN_IF_ERROR(write_resp());
+    }
+  }
+  // Always write at least one response, even if empty.
+  if (resp.entities_size() > 0 || !written) RETURN_IF_ERROR(write_resp());
+
+  return ::util::OkStatus();
+}
+
+::util::Status BcmNode::CollectAclStats(
+    std::vector<::p4::v1::TableEntry>* flows) {
+  absl::ReaderMutexLock l(&lock_);
+  if (!initialized_) {
+    return MAKE_ERROR(ERR_NOT_INITIALIZED) << "Not initialized!";
+  }
+  absl::ReaderMutexLock acl_lock(&acl_lock_);
+  size_t num_flows = 0;
+  for (auto& flow : *flows) {
+    ::util::Status status = bcm_acl_manager_->GetTableEntryStats(
+        flow, flow.mutable_counter_data());
+    // The flow may have been removed after the snapshot was taken.
+    if (status.error_code() == ERR_ENTRY_NOT_FOUND) continue;
+    RETURN_IF_ERROR(status);
+    if (&flow != &(*flows)[num_flows]) (*flows)[num_flows] = std::move(flow);
+    ++num_flows;
+  }
+  flows->resize(num_flows);
+
+  return ::util::OkStatus();
+}
+
 ::util::Status BcmNode::RegisterPacketReceiveWriter(
     const std::shared_ptr<WriterInterface<::p4::v1::PacketIn>>& writer) {
   absl::WriterMutexLock l(&lock_);
@@ -364,6 +452,18 @@ BcmNode::~BcmNode() {}
   return ::util::OkStatus();
 }
 
+::util::Status BcmNode::PrunePortFromMultipathGroups(int logical_port) {
+  // BcmL3Manager is created with the node and keeps its own lock for the
+  // state used here. If the node is not initialized, there is nothing to
+  // prune.
+  return bcm_l3_manager_->PruneMultipathGroupsForPort(logical_port);
+}
+
+std::string BcmNode::DumpPacketioStats() const {
+  absl::ReaderMutexLock l(&lock_);
+  return bcm_packetio_manager_->DumpStats();
+}
+
 std::unique_ptr<BcmNode> BcmNode::CreateInstance(
     BcmAclManager* bcm_acl_manager, BcmL2Manager* bcm_l2_manager,
     BcmL3Manager* bcm_l3_manager, BcmPacketioManager* bcm_packetio_manager,
@@ -421,9 +521,69 @@ std::unique_ptr<BcmNode> BcmNode::CreateInstance(
   return static_status;
 }
 
+namespace {
+
+// Returns true if the given BCM table type is for IPv4/IPv6 LPM/host flows,
+// i.e. flows that can be programmed in batches by BcmL3Manager.
+bool IsLpmOrHostTable(BcmFlowEntry::BcmTableType bcm_table_type) {
+  return bcm_table_type == BcmFlowEntry::BCM_TABLE_IPV4_LPM ||
+         bcm_table_type == BcmFlowEntry::BCM_TABLE_IPV4_HOST ||
+         bcm_table_type == BcmFlowEntry::BCM_TABLE_IPV6_LPM ||
+         bcm_table_type == BcmFlowEntry::BCM_TABLE_IPV6_HOST;
+}
+
+}  // namespace
+
+void BcmNode::GetWriteLockStripes(const ::p4::v1::WriteRequest& req,
+                                  bool* needs_fwd, bool* needs_acl) const {
+  *needs_fwd = false;
+  *needs_acl = false;
+  for (const auto& update : req.updates()) {
+    switch (update.entity().entity_case()) {
+      case ::p4::v1::Entity::kTableEntry: {
+        const auto& entry = update.entity().table_entry();
+        if (!bcm_table_manager_->IsAclTable(entry.table_id())) {
+          *needs_fwd = true;
+          break;
+        }
+        *needs_acl = true;
+        // ACL flows pointing to action profiles also update the flow ref
+        // counts of the members/groups, which belong to the forwarding stripe.
+        // A MODIFY or DELETE changes the ref counts of the profile the stored
+        // flow points to, which the action in the request does not tell, so
+        // these always take the forwarding stripe as well.
+        if (update.type() != ::p4::v1::Update::INSERT ||
+            entry.action().action_profile_member_id() != 0 ||
+            entry.action().action_profile_group_id() != 0) {
+          *needs_fwd = true;
+        }
+        break;
+      }
+      case ::p4::v1::Entity::kDirectMeterEntry:
+        *needs_acl = true;
+        break;
+      default:
+        // Unsupported entities do not touch any state, taking the forwarding
+        // stripe for them is harmless.
+        *needs_fwd = true;
+        break;
+    }
+    if (*needs_fwd && *needs_acl) return;
+  }
+}
+
 ::util::Status BcmNode::DoWriteForwardingEntries(
     const ::p4::v1::WriteRequest& req, std::vector<::util::Status>* results) {
-  bool success = true;
+  const size_t first_result = results->size();
+  results->reserve(first_result + req.updates_size());
+  // Consecutive updates of the same type for IPv4/IPv6 LPM/host flows are
+  // accumulated in l3_flows and handed to BcmL3Manager as a single batch. Any
+  // other update flushes the pending batch first, so the updates are still
+  // applied to hardware in the order given in the request. The results of the
+  // pending flows are contiguous and start at l3_flows_first_result.
+  std::vector<LpmOrHostFlow> l3_flows;
+  ::p4::v1::Update::Type l3_flows_type = ::p4::v1::Update::UNSPECIFIED;
+  size_t l3_flows_first_result = 0;
   for (const auto& update : req.updates()) {
     ::util::Status status = ::util::OkStatus();
     switch (update.entity().entity_case()) {
@@ -432,9 +592,44 @@ std::unique_ptr<BcmNode> BcmNode::CreateInstance(
         status = MAKE_ERROR(ERR_OPER_NOT_SUPPORTED)
                  << "Extern entries are not currently supported.";
         break;
-      case ::p4::v1::Entity::kTableEntry:
-        status = TableWrite(update.entity().table_entry(), update.type());
+      case ::p4::v1::Entity::kTableEntry: {
+        const ::p4::v1::TableEntry& entry = update.entity().table_entry();
+        if (update.type() == ::p4::v1::Update::UNSPECIFIED) {
+          status = MAKE_ERROR(ERR_INVALID_PARAM)
+                   << "Unspecified update type for TableEntry: "
+                   << entry.ShortDebugString() << ".";
+          break;
+        }
+        // We populate BcmFlowEntry based on the given TableEntry.
+        LpmOrHostFlow flow;
+        status = bcm_table_manager_->FillBcmFlowEntry(entry, update.type(),
+                                                      &flow.bcm_flow_entry);
+        if (!status.ok()) break;
+        if (FLAGS_max_l3_flow_batch_size > 0 &&
+            IsLpmOrHostTable(flow.bcm_flow_entry.bcm_table_type())) {
+          if (!l3_flows.empty() &&
+              (l3_flows_type != update.type() ||
+               l3_flows.size() >=
+                   static_cast<size_t>(FLAGS_max_l3_flow_batch_size))) {
+            RETURN_IF_ERROR(LpmOrHostFlowsWrite(l3_flows_type, &l3_flows,
+                                                l3_flows_first_result,
+                                                results));
+          }
+          if (l3_flows.empty()) {
+            l3_flows_type = update.type();
+            l3_flows_first_result = results->size();
+          }
+          flow.table_entry = &entry;
+          l3_flows.push_back(std::move(flow));
+          // Placeholder, filled in when the batch is flushed.
+          results->push_back(::util::OkStatus());
+          continue;
+        }
+        RETURN_IF_ERROR(LpmOrHostFlowsWrite(l3_flows_type, &l3_flows,
+                                            l3_flows_first_result, results));
+        status = TableWrite(entry, update.type(), flow.bcm_flow_entry);
         break;
+      }
       case ::p4::v1::Entity::kActionProfileMember:
         status = ActionProfileMemberWrite(
             update.entity().action_profile_member(), update.type());
@@ -486,10 +681,21 @@ std::unique_ptr<BcmNode> BcmNode::CreateInstance(
                  << " with no plan of support: " << update.ShortDebugString()
                  << ".";
     }
-    success &= status.ok();
+    // Any non-batched update, including a table entry rejected above, flushes
+    // the pending batch before its own result is recorded, so that the results
+    // of the pending flows stay contiguous. If the batch was already flushed,
+    // this is a no-op.
+    RETURN_IF_ERROR(LpmOrHostFlowsWrite(l3_flows_type, &l3_flows,
+                                        l3_flows_first_result, results));
     results->push_back(status);
   }
+  RETURN_IF_ERROR(LpmOrHostFlowsWrite(l3_flows_type, &l3_flows,
+                                      l3_flows_first_result, results));
 
+  bool success = true;
+  for (size_t i = first_result; i < results->size(); ++i) {
+    success &= (*results)[i].ok();
+  }
   if (!success) {
     return MAKE_ERROR(ERR_AT_LEAST_ONE_OPER_FAILED)
            << "One or more write operations failed.";
@@ -501,15 +707,49 @@ std::unique_ptr<BcmNode> BcmNode::CreateInstance(
   return ::util::OkStatus();
 }
 
+::util::Status BcmNode::LpmOrHostFlowsWrite(
+    ::p4::v1::Update::Type type, std::vector<LpmOrHostFlow>* flows,
+    size_t first_result, std::vector<::util::Status>* results) {
+  if (flows->empty()) return ::util::OkStatus();
+  CHECK_RETURN_IF_FALSE(first_result + flows->size() <= results->size())
+      << "Something is wrong. This should never happen.";
+  std::vector<::util::Status> flow_results;
+  ::util::Status status = ::util::OkStatus();
+  switch (type) {
+    case ::p4::v1::Update::INSERT:
+      status = bcm_l3_manager_->InsertTableEntries(*flows, &flow_results);
+      break;
+    case ::p4::v1::Update::MODIFY:
+      status = bcm_l3_manager_->ModifyTableEntries(*flows, &flow_results);
+      break;
+    case ::p4::v1::Update::DELETE:
+      status = bcm_l3_manager_->DeleteTableEntries(*flows, &flow_results);
+      break;
+    default:
+      status = MAKE_ERROR(ERR_INTERNAL)
+               << "Invalid update type " << ::p4::v1::Update::Type_Name(type)
+               << ".";
+  }
+  // If the whole batch failed, all of its flows get the same error.
+  if (status.ok() && flow_results.size() != flows->size()) {
+    status = MAKE_ERROR(ERR_INTERNAL)
+             << "Expected " << flows->size() << " results for the batch, got "
+             << flow_results.size() << ".";
+  }
+  for (size_t i = 0; i < flows->size(); ++i) {
+    (*results)[first_result + i] = status.ok() ? flow_results[i] : status;
+  }
+  flows->clear();
+
+  return ::util::OkStatus();
+}
+
 // TODO(unknown): Complete this function for all the update types.
 ::util::Status BcmNode::TableWrite(const ::p4::v1::TableEntry& entry,
-                                   ::p4::v1::Update::Type type) {
+                                   ::p4::v1::Update::Type type,
+                                   const BcmFlowEntry& bcm_flow_entry) {
   CHECK_RETURN_IF_FALSE(type != ::p4::v1::Update::UNSPECIFIED);
 
-  // We populate BcmFlowEntry based on the given TableEntry.
-  BcmFlowEntry bcm_flow_entry;
-  RETURN_IF_ERROR(
-      bcm_table_manager_->FillBcmFlowEntry(entry, type, &bcm_flow_entry));
   BcmFlowEntry::BcmTableType bcm_table_type = bcm_flow_entry.bcm_table_type();
   // Try to program the flow.
   bool consumed = false;  // will be set to true if we know what to do
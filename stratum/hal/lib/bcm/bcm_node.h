@@ -119,6 +119,19 @@ class BcmNode {
   virtual ::util::Status UpdatePortState(uint32 port_id)
       SHARED_LOCKS_REQUIRED(chassis_lock) LOCKS_EXCLUDED(lock_);
 
+  // Removes the given logical port from all the multipath groups as soon as
+  // the port goes down, ahead of the UpdatePortState() call which reconciles
+  // the groups with the state of the node. Unlike the other methods, this
+  // does not require chassis_lock or lock_, so that a link-down event is not
+  // delayed by a config push or a flow programming in progress.
+  virtual ::util::Status PrunePortFromMultipathGroups(int logical_port)
+      LOCKS_EXCLUDED(lock_);
+
+  // Returns the packet I/O stats of this node (e.g. the RX/TX stats and the
+  // per-CoS RX queue stats of all the KNET interfaces) as a string.
+  virtual std::string DumpPacketioStats() const
+      SHARED_LOCKS_REQUIRED(chassis_lock) LOCKS_EXCLUDED(lock_);
+
   // Factory function for creating a BcmNode instance.
   static std::unique_ptr<BcmNode> CreateInstance(
       BcmAclManager* bcm_acl_manager, BcmL2Manager* bcm_l2_manager,
@@ -152,14 +165,45 @@ class BcmNode {
                                   bool post_push)
       EXCLUSIVE_LOCKS_REQUIRED(lock_);
 
-  // Non-locking internal version of WriteForwardingEntries().
+  // Non-locking internal version of WriteForwardingEntries(). The caller must
+  // either hold lock_ exclusively, or hold it shared together with the write
+  // lock stripes returned by GetWriteLockStripes() for the request.
   virtual ::util::Status DoWriteForwardingEntries(
       const ::p4::v1::WriteRequest& req, std::vector<::util::Status>* results)
-      EXCLUSIVE_LOCKS_REQUIRED(lock_);
+      SHARED_LOCKS_REQUIRED(lock_);
+
+  // Finds out which write lock stripes the given request needs: fwd_lock_ for
+  // anything but ACL flows, acl_lock_ for ACL flows and direct meters. ACL
+  // flows which may touch action profiles, i.e. any MODIFY or DELETE and any
+  // INSERT pointing to a member/group, take both.
+  void GetWriteLockStripes(const ::p4::v1::WriteRequest& req, bool* needs_fwd,
+                           bool* needs_acl) const SHARED_LOCKS_REQUIRED(lock_);
+
+  // Materializes the snapshotted table entries and streams them to the writer
+  // in ReadResponses of at most FLAGS_read_response_chunk_size entities. At
+  // least one (possibly empty) response is written. Called without holding
+  // any lock, so that big reads do not block the writes.
+  ::util::Status StreamTableEntries(
+      const std::vector<BcmFlowTableSnapshot>& snapshots, uint64 node_id,
+      WriterInterface<::p4::v1::ReadResponse>* writer) LOCKS_EXCLUDED(lock_);
+
+  // Fills in the counter data of the given ACL flows. Flows deleted after
+  // their table was snapshotted are dropped from the vector.
+  ::util::Status CollectAclStats(std::vector<::p4::v1::TableEntry>* flows)
+      LOCKS_EXCLUDED(lock_);
 
-  // Write a single P4 TableEntry.
+  // Write a single P4 TableEntry, already mapped to the given BcmFlowEntry.
   ::util::Status TableWrite(const ::p4::v1::TableEntry& entry,
-                            ::p4::v1::Update::Type type);
+                            ::p4::v1::Update::Type type,
+                            const BcmFlowEntry& bcm_flow_entry);
+
+  // Writes a batch of IPv4/IPv6 LPM/host flows, all with the same update type,
+  // using BcmL3Manager batched APIs. The result for the i-th flow is stored in
+  // (*results)[first_result + i]. Clears flows upon return.
+  ::util::Status LpmOrHostFlowsWrite(::p4::v1::Update::Type type,
+                                     std::vector<LpmOrHostFlow>* flows,
+                                     size_t first_result,
+                                     std::vector<::util::Status>* results);
 
   // Write a single P4 ActionProfileMember.
   ::util::Status ActionProfileMemberWrite(
@@ -174,9 +218,22 @@ class BcmNode {
       const ::p4::v1::PacketReplicationEngineEntry& entry,
       ::p4::v1::Update::Type type);
 
-  // Reader-writer lock used to protect access to node-specific state.
+  // Reader-writer lock used to protect access to node-specific state. Flow
+  // writes and reads only hold it in shared mode, and are serialized using the
+  // write lock stripes below.
   mutable absl::Mutex lock_;
 
+  // Write lock stripes protecting the forwarding state of the managers. ACL
+  // flows only touch BcmAclManager and the ACL tables in BcmTableManager,
+  // while all other entities (L2/L3/tunnel flows, action profiles, PRE
+  // entries) touch the rest of the state, so two WriteRequests which do not
+  // share a stripe are programmed concurrently. A WriteRequest holds all of its
+  // stripes for its whole duration, which keeps the P4Runtime in-order
+  // semantics within the request. Stripes are always acquired in the order
+  // they are declared here. Reads hold all the stripes in shared mode.
+  mutable absl::Mutex fwd_lock_ ACQUIRED_BEFORE(acl_lock_);
+  mutable absl::Mutex acl_lock_;
+
   // Flag indicate whether chip is initialized.
   bool initialized_ GUARDED_BY(lock_);
 
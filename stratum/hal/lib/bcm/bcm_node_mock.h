@@ -57,6 +57,9 @@ class BcmNodeMock : public BcmNode {
   MOCK_METHOD1(TransmitPacket,
                ::util::Status(const ::p4::v1::PacketOut& packet));
   MOCK_METHOD1(UpdatePortState, ::util::Status(uint32 port_id));
+  MOCK_METHOD1(PrunePortFromMultipathGroups,
+               ::util::Status(int logical_port));
+  MOCK_CONST_METHOD0(DumpPacketioStats, std::string());
 };
 
 }  // namespace bcm
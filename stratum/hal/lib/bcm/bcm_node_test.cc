@@ -27,6 +27,7 @@
 #include "stratum/hal/lib/common/writer_mock.h"
 #include "stratum/hal/lib/p4/p4_table_mapper_mock.h"
 #include "stratum/lib/utils.h"
+#include "gflags/gflags.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "absl/memory/memory.h"
@@ -39,8 +40,11 @@ using ::testing::HasSubstr;
 using ::testing::InSequence;
 using ::testing::Invoke;
 using ::testing::Return;
+using ::testing::SizeIs;
 using ::testing::WithArgs;
 
+DECLARE_int32(read_response_chunk_size);
+
 namespace stratum {
 namespace hal {
 namespace bcm {
@@ -106,6 +110,14 @@ class BcmNodeTest : public ::testing::Test {
     return bcm_node_->WriteForwardingEntries(req, results);
   }
 
+  ::util::Status ReadForwardingEntries(
+      const ::p4::v1::ReadRequest& req,
+      WriterInterface<::p4::v1::ReadResponse>* writer,
+      std::vector<::util::Status>* details) {
+    absl::ReaderMutexLock l(&chassis_lock);
+    return bcm_node_->ReadForwardingEntries(req, writer, details);
+  }
+
   ::util::Status RegisterPacketReceiveWriter(
       const std::shared_ptr<WriterInterface<::p4::v1::PacketIn>>& writer) {
     absl::ReaderMutexLock l(&chassis_lock);
@@ -122,6 +134,12 @@ class BcmNodeTest : public ::testing::Test {
     return bcm_node_->UpdatePortState(port_id);
   }
 
+  void GetWriteLockStripes(const ::p4::v1::WriteRequest& req, bool* needs_fwd,
+                           bool* needs_acl) {
+    absl::ReaderMutexLock l(&bcm_node_->lock_);
+    bcm_node_->GetWriteLockStripes(req, needs_fwd, needs_acl);
+  }
+
   void PushChassisConfigWithCheck() {
     ChassisConfig config;
     config.add_nodes()->set_id(kNodeId);
@@ -746,6 +764,9 @@ TEST_F(BcmNodeTest, PushForwardingPipelineConfigSuccess) {
     EXPECT_CALL(*bcm_tunnel_manager_mock_,
                 PushForwardingPipelineConfig(EqualsProto(config)))
         .WillOnce(Return(::util::OkStatus()));
+    EXPECT_CALL(*bcm_packetio_manager_mock_,
+                PushForwardingPipelineConfig(EqualsProto(config)))
+        .WillOnce(Return(::util::OkStatus()));
     // P4TableMapper should check for static entry post-push after other pushes.
     EXPECT_CALL(*p4_table_mapper_mock_, HandlePostPushStaticEntryChanges(_, _))
         .WillOnce(Return(::util::OkStatus()));
@@ -775,6 +796,10 @@ TEST_F(BcmNodeTest, PushForwardingPipelineConfigFailueOnAnyManagerPushFailure) {
               PushForwardingPipelineConfig(EqualsProto(config)))
       .WillOnce(Return(DefaultError()))
       .WillRepeatedly(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_packetio_manager_mock_,
+              PushForwardingPipelineConfig(EqualsProto(config)))
+      .WillOnce(Return(DefaultError()))
+      .WillRepeatedly(Return(::util::OkStatus()));
   EXPECT_CALL(*p4_table_mapper_mock_, HandlePostPushStaticEntryChanges(_, _))
       .WillOnce(Return(DefaultError()))
       .WillRepeatedly(Return(::util::OkStatus()));
@@ -789,6 +814,8 @@ TEST_F(BcmNodeTest, PushForwardingPipelineConfigFailueOnAnyManagerPushFailure) {
               DerivedFromStatus(DefaultError()));
   EXPECT_THAT(PushForwardingPipelineConfig(config),
               DerivedFromStatus(DefaultError()));
+  EXPECT_THAT(PushForwardingPipelineConfig(config),
+              DerivedFromStatus(DefaultError()));
 }
 
 // VerifyForwardingPipelineConfig() should verify the config.
@@ -838,6 +865,11 @@ TEST_F(BcmNodeTest,
 
 namespace {
 
+// Mimics a batched L3 write in which every flow was programmed successfully.
+void FillOkResults(std::vector<::util::Status>* results) {
+  results->push_back(::util::OkStatus());
+}
+
 ::p4::v1::TableEntry* SetupTableEntryToInsert(::p4::v1::WriteRequest* req,
                                               uint64 node_id) {
   req->set_device_id(node_id);
@@ -880,8 +912,9 @@ TEST_F(BcmNodeTest, WriteForwardingEntriesSuccess_InsertTableEntry_Ipv4Lpm) {
                         x->set_bcm_table_type(BcmFlowEntry::BCM_TABLE_IPV4_LPM);
                       })),
                       Return(::util::OkStatus())));
-  EXPECT_CALL(*bcm_l3_manager_mock_, InsertTableEntry(_))
-      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_l3_manager_mock_, InsertTableEntries(SizeIs(1), _))
+      .WillOnce(DoAll(WithArgs<1>(Invoke(FillOkResults)),
+                      Return(::util::OkStatus())));
 
   std::vector<::util::Status> results = {};
   EXPECT_OK(WriteForwardingEntries(req, &results));
@@ -902,8 +935,9 @@ TEST_F(BcmNodeTest, WriteForwardingEntriesSuccess_InsertTableEntry_Ipv4Host) {
                             BcmFlowEntry::BCM_TABLE_IPV4_HOST);
                       })),
                       Return(::util::OkStatus())));
-  EXPECT_CALL(*bcm_l3_manager_mock_, InsertTableEntry(_))
-      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_l3_manager_mock_, InsertTableEntries(SizeIs(1), _))
+      .WillOnce(DoAll(WithArgs<1>(Invoke(FillOkResults)),
+                      Return(::util::OkStatus())));
 
   std::vector<::util::Status> results = {};
   EXPECT_OK(WriteForwardingEntries(req, &results));
@@ -923,8 +957,9 @@ TEST_F(BcmNodeTest, WriteForwardingEntriesSuccess_InsertTableEntry_Ipv6Lpm) {
                         x->set_bcm_table_type(BcmFlowEntry::BCM_TABLE_IPV6_LPM);
                       })),
                       Return(::util::OkStatus())));
-  EXPECT_CALL(*bcm_l3_manager_mock_, InsertTableEntry(_))
-      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_l3_manager_mock_, InsertTableEntries(SizeIs(1), _))
+      .WillOnce(DoAll(WithArgs<1>(Invoke(FillOkResults)),
+                      Return(::util::OkStatus())));
 
   std::vector<::util::Status> results = {};
   EXPECT_OK(WriteForwardingEntries(req, &results));
@@ -945,8 +980,9 @@ TEST_F(BcmNodeTest, WriteForwardingEntriesSuccess_InsertTableEntry_Ipv6Host) {
                             BcmFlowEntry::BCM_TABLE_IPV6_HOST);
                       })),
                       Return(::util::OkStatus())));
-  EXPECT_CALL(*bcm_l3_manager_mock_, InsertTableEntry(_))
-      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_l3_manager_mock_, InsertTableEntries(SizeIs(1), _))
+      .WillOnce(DoAll(WithArgs<1>(Invoke(FillOkResults)),
+                      Return(::util::OkStatus())));
 
   std::vector<::util::Status> results = {};
   EXPECT_OK(WriteForwardingEntries(req, &results));
@@ -1058,8 +1094,9 @@ TEST_F(BcmNodeTest, WriteForwardingEntriesSuccess_ModifyTableEntry_Ipv4Lpm) {
                         x->set_bcm_table_type(BcmFlowEntry::BCM_TABLE_IPV4_LPM);
                       })),
                       Return(::util::OkStatus())));
-  EXPECT_CALL(*bcm_l3_manager_mock_, ModifyTableEntry(_))
-      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_l3_manager_mock_, ModifyTableEntries(SizeIs(1), _))
+      .WillOnce(DoAll(WithArgs<1>(Invoke(FillOkResults)),
+                      Return(::util::OkStatus())));
 
   std::vector<::util::Status> results = {};
   EXPECT_OK(WriteForwardingEntries(req, &results));
@@ -1080,8 +1117,9 @@ TEST_F(BcmNodeTest, WriteForwardingEntriesSuccess_ModifyTableEntry_Ipv4Host) {
                             BcmFlowEntry::BCM_TABLE_IPV4_HOST);
                       })),
                       Return(::util::OkStatus())));
-  EXPECT_CALL(*bcm_l3_manager_mock_, ModifyTableEntry(_))
-      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_l3_manager_mock_, ModifyTableEntries(SizeIs(1), _))
+      .WillOnce(DoAll(WithArgs<1>(Invoke(FillOkResults)),
+                      Return(::util::OkStatus())));
 
   std::vector<::util::Status> results = {};
   EXPECT_OK(WriteForwardingEntries(req, &results));
@@ -1101,8 +1139,9 @@ TEST_F(BcmNodeTest, WriteForwardingEntriesSuccess_ModifyTableEntry_Ipv6Lpm) {
                         x->set_bcm_table_type(BcmFlowEntry::BCM_TABLE_IPV6_LPM);
                       })),
                       Return(::util::OkStatus())));
-  EXPECT_CALL(*bcm_l3_manager_mock_, ModifyTableEntry(_))
-      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_l3_manager_mock_, ModifyTableEntries(SizeIs(1), _))
+      .WillOnce(DoAll(WithArgs<1>(Invoke(FillOkResults)),
+                      Return(::util::OkStatus())));
 
   std::vector<::util::Status> results = {};
   EXPECT_OK(WriteForwardingEntries(req, &results));
@@ -1123,8 +1162,9 @@ TEST_F(BcmNodeTest, WriteForwardingEntriesSuccess_ModifyTableEntry_Ipv6Host) {
                             BcmFlowEntry::BCM_TABLE_IPV6_HOST);
                       })),
                       Return(::util::OkStatus())));
-  EXPECT_CALL(*bcm_l3_manager_mock_, ModifyTableEntry(_))
-      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_l3_manager_mock_, ModifyTableEntries(SizeIs(1), _))
+      .WillOnce(DoAll(WithArgs<1>(Invoke(FillOkResults)),
+                      Return(::util::OkStatus())));
 
   std::vector<::util::Status> results = {};
   EXPECT_OK(WriteForwardingEntries(req, &results));
@@ -1186,8 +1226,9 @@ TEST_F(BcmNodeTest, WriteForwardingEntriesSuccess_DeleteTableEntry_Ipv4Lpm) {
                         x->set_bcm_table_type(BcmFlowEntry::BCM_TABLE_IPV4_LPM);
                       })),
                       Return(::util::OkStatus())));
-  EXPECT_CALL(*bcm_l3_manager_mock_, DeleteTableEntry(_))
-      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_l3_manager_mock_, DeleteTableEntries(SizeIs(1), _))
+      .WillOnce(DoAll(WithArgs<1>(Invoke(FillOkResults)),
+                      Return(::util::OkStatus())));
 
   std::vector<::util::Status> results = {};
   EXPECT_OK(WriteForwardingEntries(req, &results));
@@ -1208,8 +1249,9 @@ TEST_F(BcmNodeTest, WriteForwardingEntriesSuccess_DeleteTableEntry_Ipv4Host) {
                             BcmFlowEntry::BCM_TABLE_IPV4_HOST);
                       })),
                       Return(::util::OkStatus())));
-  EXPECT_CALL(*bcm_l3_manager_mock_, DeleteTableEntry(_))
-      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_l3_manager_mock_, DeleteTableEntries(SizeIs(1), _))
+      .WillOnce(DoAll(WithArgs<1>(Invoke(FillOkResults)),
+                      Return(::util::OkStatus())));
 
   std::vector<::util::Status> results = {};
   EXPECT_OK(WriteForwardingEntries(req, &results));
@@ -1229,8 +1271,9 @@ TEST_F(BcmNodeTest, WriteForwardingEntriesSuccess_DeleteTableEntry_Ipv6Lpm) {
                         x->set_bcm_table_type(BcmFlowEntry::BCM_TABLE_IPV6_LPM);
                       })),
                       Return(::util::OkStatus())));
-  EXPECT_CALL(*bcm_l3_manager_mock_, DeleteTableEntry(_))
-      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_l3_manager_mock_, DeleteTableEntries(SizeIs(1), _))
+      .WillOnce(DoAll(WithArgs<1>(Invoke(FillOkResults)),
+                      Return(::util::OkStatus())));
 
   std::vector<::util::Status> results = {};
   EXPECT_OK(WriteForwardingEntries(req, &results));
@@ -1251,8 +1294,9 @@ TEST_F(BcmNodeTest, WriteForwardingEntriesSuccess_DeleteTableEntry_Ipv6Host) {
                             BcmFlowEntry::BCM_TABLE_IPV6_HOST);
                       })),
                       Return(::util::OkStatus())));
-  EXPECT_CALL(*bcm_l3_manager_mock_, DeleteTableEntry(_))
-      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_l3_manager_mock_, DeleteTableEntries(SizeIs(1), _))
+      .WillOnce(DoAll(WithArgs<1>(Invoke(FillOkResults)),
+                      Return(::util::OkStatus())));
 
   std::vector<::util::Status> results = {};
   EXPECT_OK(WriteForwardingEntries(req, &results));
@@ -1331,6 +1375,45 @@ TEST_F(BcmNodeTest, WriteForwardingEntriesSuccess_DeleteTableEntry_Acl) {
   EXPECT_EQ(1U, results.size());
 }
 
+TEST_F(BcmNodeTest, AclFlowsTakeForwardingStripeUnlessPlainInsert) {
+  constexpr uint32 kAclTableId = 33554433;
+  EXPECT_CALL(*bcm_table_manager_mock_, IsAclTable(kAclTableId))
+      .WillRepeatedly(Return(true));
+  bool needs_fwd = false, needs_acl = false;
+
+  // An INSERT with a direct action only touches the ACL state.
+  ::p4::v1::WriteRequest req;
+  SetupTableEntryToInsert(&req, kNodeId)->set_table_id(kAclTableId);
+  GetWriteLockStripes(req, &needs_fwd, &needs_acl);
+  EXPECT_FALSE(needs_fwd);
+  EXPECT_TRUE(needs_acl);
+
+  // A DELETE of a flow pointing to a group releases the ref count of the
+  // group, which is forwarding state.
+  req.Clear();
+  auto* table_entry = SetupTableEntryToDelete(&req, kNodeId);
+  table_entry->set_table_id(kAclTableId);
+  table_entry->mutable_action()->set_action_profile_group_id(kGroupId);
+  GetWriteLockStripes(req, &needs_fwd, &needs_acl);
+  EXPECT_TRUE(needs_fwd);
+  EXPECT_TRUE(needs_acl);
+
+  // The same holds if the DELETE does not carry the action, as the stored
+  // flow may still point to a group.
+  req.Clear();
+  SetupTableEntryToDelete(&req, kNodeId)->set_table_id(kAclTableId);
+  GetWriteLockStripes(req, &needs_fwd, &needs_acl);
+  EXPECT_TRUE(needs_fwd);
+  EXPECT_TRUE(needs_acl);
+
+  // A MODIFY may move the flow from one group to another.
+  req.Clear();
+  SetupTableEntryToModify(&req, kNodeId)->set_table_id(kAclTableId);
+  GetWriteLockStripes(req, &needs_fwd, &needs_acl);
+  EXPECT_TRUE(needs_fwd);
+  EXPECT_TRUE(needs_acl);
+}
+
 TEST_F(BcmNodeTest, WriteForwardingEntriesSuccess_DeleteTableEntry_Tunnel) {
   ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
 
@@ -1352,6 +1435,53 @@ TEST_F(BcmNodeTest, WriteForwardingEntriesSuccess_DeleteTableEntry_Tunnel) {
   EXPECT_EQ(1U, results.size());
 }
 
+TEST_F(BcmNodeTest,
+       WriteForwardingEntriesFailure_InvalidUpdateBetweenBatchedL3Entries) {
+  ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
+
+  // Two LPM routes, an update with no type and one more LPM route. The
+  // invalid update must split the batch, so that every update gets its own
+  // result.
+  ::p4::v1::WriteRequest req;
+  SetupTableEntryToInsert(&req, kNodeId);
+  SetupTableEntryToInsert(&req, kNodeId);
+  SetupTableEntryToInsert(&req, kNodeId);
+  req.mutable_updates(2)->set_type(::p4::v1::Update::UNSPECIFIED);
+  SetupTableEntryToInsert(&req, kNodeId);
+
+  EXPECT_CALL(*bcm_table_manager_mock_,
+              FillBcmFlowEntry(_, ::p4::v1::Update::INSERT, _))
+      .Times(3)
+      .WillRepeatedly(DoAll(WithArgs<2>(Invoke([](BcmFlowEntry* x) {
+                              x->set_bcm_table_type(
+                                  BcmFlowEntry::BCM_TABLE_IPV4_LPM);
+                            })),
+                            Return(::util::OkStatus())));
+  {
+    InSequence sequence;
+    EXPECT_CALL(*bcm_l3_manager_mock_, InsertTableEntries(SizeIs(2), _))
+        .WillOnce(DoAll(
+            WithArgs<1>(Invoke([](std::vector<::util::Status>* results) {
+              results->push_back(::util::OkStatus());
+              results->push_back(::util::Status(StratumErrorSpace(),
+                                                ERR_ENTRY_EXISTS, "Exists."));
+            })),
+            Return(::util::OkStatus())));
+    EXPECT_CALL(*bcm_l3_manager_mock_, InsertTableEntries(SizeIs(1), _))
+        .WillOnce(DoAll(WithArgs<1>(Invoke(FillOkResults)),
+                        Return(::util::OkStatus())));
+  }
+
+  std::vector<::util::Status> results = {};
+  ::util::Status status = WriteForwardingEntries(req, &results);
+  EXPECT_EQ(ERR_AT_LEAST_ONE_OPER_FAILED, status.error_code());
+  ASSERT_EQ(4U, results.size());
+  EXPECT_OK(results[0]);
+  EXPECT_EQ(ERR_ENTRY_EXISTS, results[1].error_code());
+  EXPECT_EQ(ERR_INVALID_PARAM, results[2].error_code());
+  EXPECT_OK(results[3]);
+}
+
 TEST_F(BcmNodeTest, WriteForwardingEntriesSuccess_InsertActionProfileMember) {
   ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
 
@@ -1632,6 +1762,64 @@ TEST_F(BcmNodeTest, WriteForwardingEntriesSuccess_DeleteMulticastGroupEntry) {
   EXPECT_EQ(1U, results.size());
 }
 
+// ReadForwardingEntries() should stream the table entries in chunks of at most
+// FLAGS_read_response_chunk_size entities, with stats for the ACL flows.
+TEST_F(BcmNodeTest, ReadForwardingEntriesSuccess_TableEntriesInChunks) {
+  ASSERT_NO_FATAL_FAILURE(PushChassisConfigWithCheck());
+  const int saved_chunk_size = FLAGS_read_response_chunk_size;
+  FLAGS_read_response_chunk_size = 2;
+
+  std::vector<BcmFlowTableSnapshot> snapshots(2);
+  std::vector<::p4::v1::TableEntry> entries(5);
+  for (int i = 0; i < 5; ++i) {
+    entries[i].set_table_id(i < 3 ? 1 : 2);
+    entries[i].set_priority(i + 1);
+    snapshots[i < 3 ? 0 : 1].entries.emplace_back(entries[i]);
+  }
+  snapshots[0].table_id = 1;
+  snapshots[1].table_id = 2;
+  snapshots[1].is_acl = true;
+
+  ::p4::v1::ReadRequest req;
+  req.set_device_id(kNodeId);
+  req.add_entities()->mutable_table_entry();  // all tables
+
+  EXPECT_CALL(*bcm_table_manager_mock_, SnapshotTableEntries(SizeIs(0), _))
+      .WillOnce(
+          DoAll(WithArgs<1>(Invoke([&snapshots](
+                                       std::vector<BcmFlowTableSnapshot>* x) {
+                  *x = snapshots;
+                })),
+                Return(::util::OkStatus())));
+  // The last ACL flow is deleted after the snapshot is taken.
+  EXPECT_CALL(*bcm_acl_manager_mock_, GetTableEntryStats(_, _))
+      .WillOnce(DoAll(WithArgs<1>(Invoke([](::p4::v1::CounterData* x) {
+                        x->set_packet_count(10);
+                      })),
+                      Return(::util::OkStatus())))
+      .WillOnce(Return(::util::Status(StratumErrorSpace(), ERR_ENTRY_NOT_FOUND,
+                                      kErrorMsg)));
+
+  ::p4::v1::ReadResponse resp1, resp2;
+  *resp1.add_entities()->mutable_table_entry() = entries[0];
+  *resp1.add_entities()->mutable_table_entry() = entries[1];
+  *resp2.add_entities()->mutable_table_entry() = entries[2];
+  auto* acl_entry = resp2.add_entities()->mutable_table_entry();
+  *acl_entry = entries[3];
+  acl_entry->mutable_counter_data()->set_packet_count(10);
+  WriterMock<::p4::v1::ReadResponse> writer_mock;
+  {
+    InSequence sequence;
+    EXPECT_CALL(writer_mock, Write(EqualsProto(resp1))).WillOnce(Return(true));
+    EXPECT_CALL(writer_mock, Write(EqualsProto(resp2))).WillOnce(Return(true));
+  }
+
+  std::vector<::util::Status> details = {};
+  EXPECT_OK(ReadForwardingEntries(req, &writer_mock, &details));
+  EXPECT_TRUE(details.empty());
+  FLAGS_read_response_chunk_size = saved_chunk_size;
+}
+
 // RegisterPacketReceiveWriter() should forward the call to BcmPacketioManager
 // and return success or error based on the returned result.
 TEST_F(BcmNodeTest, RegisterPacketReceiveWriter) {
@@ -1681,6 +1869,22 @@ TEST_F(BcmNodeTest, TestUpdatePortState) {
   EXPECT_EQ(expected_error.ToString(), status.ToString());
 }
 
+// Check functions invoked on PrunePortFromMultipathGroups() call, which does
+// not require the node to be initialized.
+TEST_F(BcmNodeTest, TestPrunePortFromMultipathGroups) {
+  ::util::Status expected_error = ::util::UnknownErrorBuilder(GTL_LOC)
+                                  << "error";
+  EXPECT_CALL(*bcm_l3_manager_mock_,
+              PruneMultipathGroupsForPort(kLogicalPortId))
+      .WillOnce(Return(::util::OkStatus()))
+      .WillOnce(Return(expected_error));
+
+  EXPECT_OK(bcm_node_->PrunePortFromMultipathGroups(kLogicalPortId));
+  auto status = bcm_node_->PrunePortFromMultipathGroups(kLogicalPortId);
+  EXPECT_FALSE(status.ok());
+  EXPECT_EQ(expected_error.ToString(), status.ToString());
+}
+
 // TODO(unknown): Complete unit test coverage.
 
 }  // namespace bcm
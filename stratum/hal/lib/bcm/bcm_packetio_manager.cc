@@ -30,6 +30,7 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <memory>
 #include <utility>
 
@@ -39,8 +40,10 @@
 #include "stratum/lib/utils.h"
 #include "stratum/glue/integral_types.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/memory/memory.h"
 #include "absl/strings/substitute.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
 #include "stratum/glue/gtl/map_util.h"
 #include "stratum/glue/gtl/stl_util.h"
 
@@ -51,6 +54,42 @@ DEFINE_int32(knet_rx_poll_timeout_ms, 100,
 DEFINE_int32(knet_max_num_packets_to_read_at_once, 8,
              "Determines the number of packets we try to read at once as soon "
              "as the socket FD becomes available.");
+DEFINE_int32(knet_ring_block_size, 1 << 20,
+             "Size of a block of the mmap'ed RX/TX rings of the KNET "
+             "interfaces with use_mmap_rings set. Must be a multiple of the "
+             "page size.");
+DEFINE_int32(knet_ring_num_blocks, 8,
+             "Num of blocks of each mmap'ed RX/TX ring.");
+DEFINE_int32(knet_ring_frame_size,
+             ::stratum::hal::bcm::BcmKnetRing::kDefaultFrameSize,
+             "Size of a frame slot of the mmap'ed TX rings. Must divide "
+             "knet_ring_block_size and fit the largest KNET packet, jumbo "
+             "frames included. Larger packets fail with ERR_INVALID_PARAM.");
+DEFINE_int32(knet_rx_ring_block_timeout_ms, 10,
+             "Time after which the kernel hands a partially filled block of "
+             "an mmap'ed RX ring to the RX thread.");
+DEFINE_bool(knet_rx_batch_mode, true,
+            "If true, the KNET RX threads read up to "
+            "knet_max_num_packets_to_read_at_once packets with a single "
+            "recvmmsg() call into preallocated buffers. If false, packets are "
+            "read one by one with recvmsg().");
+DEFINE_bool(knet_tx_batch_mode, false,
+            "If true, the packets transmitted on a KNET interface without an "
+            "mmap'ed TX ring are put in a queue, and a TX thread per "
+            "interface sends up to knet_max_num_packets_to_send_at_once of "
+            "them with a single sendmmsg() call. Send errors are then only "
+            "reported in the TX stats. If false, each packet is sent with its "
+            "own sendmsg() call.");
+DEFINE_int32(knet_max_num_packets_to_send_at_once, 32,
+             "Max num of packets sent with a single sendmmsg() call in batched "
+             "TX mode.");
+DEFINE_int32(knet_tx_queue_depth, 1024,
+             "Max num of packets waiting in the TX queue of a KNET interface "
+             "in batched TX mode. Packets transmitted when the queue is full "
+             "are dropped.");
+DEFINE_int32(knet_tx_metadata_cache_size, 1024,
+             "Max num of distinct sets of PacketOut metadata whose parsed "
+             "version is cached. 0 disables the cache.");
 
 // TODO(unknown): I really really wish we could use google3 thread libraries.
 namespace stratum {
@@ -85,6 +124,103 @@ namespace {
 
 }  // namespace
 
+// The buffers used by a KNET RX thread in batched RX mode. Allocated once when
+// the thread starts and reused for every recvmmsg() call. The buffers are not
+// cleared between calls, as recvmmsg() reports the num of valid bytes.
+struct KnetRxBatch {
+  // Max num of messages read at once.
+  size_t num_msgs;
+  // Size of the KNET header and the max size of the payload of each message.
+  size_t header_size;
+  size_t payload_size;
+  // One contiguous buffer holding the header followed by the payload of all
+  // the messages.
+  std::unique_ptr<char[]> buffer;
+  std::vector<struct iovec> iovs;
+  std::vector<struct sockaddr_ll> addrs;
+  std::vector<struct mmsghdr> msgs;
+  KnetRxBatch(size_t _num_msgs, size_t _header_size, size_t _payload_size)
+      : num_msgs(_num_msgs),
+        header_size(_header_size),
+        payload_size(_payload_size),
+        buffer(new char[_num_msgs * (_header_size + _payload_size)]),
+        iovs(2 * _num_msgs),
+        addrs(_num_msgs),
+        msgs(_num_msgs) {
+    for (size_t i = 0; i < num_msgs; ++i) {
+      iovs[2 * i].iov_base = header(i);
+      iovs[2 * i].iov_len = header_size;
+      iovs[2 * i + 1].iov_base = payload(i);
+      iovs[2 * i + 1].iov_len = payload_size;
+      memset(&msgs[i], 0, sizeof(msgs[i]));
+      msgs[i].msg_hdr.msg_iov = &iovs[2 * i];
+      msgs[i].msg_hdr.msg_iovlen = 2;
+      msgs[i].msg_hdr.msg_name = &addrs[i];
+    }
+  }
+  char* header(size_t i) {
+    return buffer.get() + i * (header_size + payload_size);
+  }
+  char* payload(size_t i) { return header(i) + header_size; }
+  // Resets the fields recvmmsg() overwrites. Called before each read.
+  void Reset() {
+    for (size_t i = 0; i < num_msgs; ++i) {
+      msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+      msgs[i].msg_hdr.msg_flags = 0;
+      msgs[i].msg_len = 0;
+    }
+  }
+};
+
+// The buffers used by a KNET TX thread in batched TX mode. Allocated once when
+// the thread starts and pointed at the packets to send before every
+// sendmmsg() call.
+struct KnetTxBatch {
+  std::vector<struct iovec> iovs;
+  std::vector<struct mmsghdr> msgs;
+  // All the packets of a KNET interface go to the same netif.
+  struct sockaddr_ll sa;
+  KnetTxBatch(size_t num_msgs, int netif_index)
+      : iovs(2 * num_msgs), msgs(num_msgs) {
+    // Here sa.sll_addr is left zeroed out, matching what's in rcpu_hdr.
+    memset(&sa, 0, sizeof(sa));
+    sa.sll_family = AF_PACKET;
+    sa.sll_ifindex = netif_index;
+    sa.sll_halen = ETH_ALEN;
+    for (size_t i = 0; i < num_msgs; ++i) {
+      memset(&msgs[i], 0, sizeof(msgs[i]));
+      msgs[i].msg_hdr.msg_iov = &iovs[2 * i];
+      msgs[i].msg_hdr.msg_iovlen = 2;
+      msgs[i].msg_hdr.msg_name = &sa;
+      msgs[i].msg_hdr.msg_namelen = sizeof(sa);
+    }
+  }
+  // Points the i-th message to the given packet, which must outlive the send.
+  void Set(size_t i, const KnetTxPacket& packet) {
+    iovs[2 * i].iov_base = const_cast<char*>(packet.header.data());
+    iovs[2 * i].iov_len = packet.header.size();
+    iovs[2 * i + 1].iov_base = const_cast<char*>(packet.payload.data());
+    iovs[2 * i + 1].iov_len = packet.payload.size();
+    msgs[i].msg_len = 0;
+  }
+};
+
+namespace {
+
+// Returns the key of the given packet in the PacketOut metadata cache. The
+// length of each value is part of the key, so that two different sets of
+// metadata never map to the same key.
+std::string PacketOutMetadataCacheKey(const ::p4::v1::PacketOut& packet) {
+  std::string key = "";
+  for (const auto& metadata : packet.metadata()) {
+    absl::StrAppend(&key, metadata.metadata_id(), ":", metadata.value().size(),
+                    ":", metadata.value(), ";");
+  }
+  return key;
+}
+
+}  // namespace
+
 BcmPacketioManager::BcmPacketioManager(
     OperationMode mode, BcmChassisRoInterface* bcm_chassis_ro_interface,
     P4TableMapper* p4_table_mapper, BcmSdkInterface* bcm_sdk_interface,
@@ -282,6 +418,15 @@ BcmPacketioManager::~BcmPacketioManager() {}
   return status;
 }
 
+::util::Status BcmPacketioManager::PushForwardingPipelineConfig(
+    const ::p4::v1::ForwardingPipelineConfig& config) {
+  // The P4 PacketMetadata IDs may map to different fields in the new pipeline.
+  absl::WriterMutexLock l(&packet_out_metadata_cache_lock_);
+  packet_out_metadata_cache_.clear();
+
+  return ::util::OkStatus();
+}
+
 ::util::Status BcmPacketioManager::Shutdown() {
   // Simulation mode does not support KNET.
   // TODO: Find a way to do packet I/O in sim mode.
@@ -294,19 +439,35 @@ BcmPacketioManager::~BcmPacketioManager() {}
 
   ::util::Status status = ::util::OkStatus();
   // Wait for all the threads to join. All threads exit once shutdown has
-  // been set true.
+  // been set true. Closing the RX CoS queues wakes up the dispatch threads
+  // right away, instead of after their poll timeout.
   for (const auto& entry : purpose_to_knet_intf_) {
-    if (entry.second.rx_thread_id > 0 &&
-        pthread_join(entry.second.rx_thread_id, nullptr) != 0) {
-      ::util::Status error = MAKE_ERROR(ERR_INTERNAL)
-                             << "Failed to join thread "
-                             << entry.second.rx_thread_id;
-      APPEND_STATUS_IF_ERROR(status, error);
+    if (entry.second.rx_cos_queues != nullptr) {
+      entry.second.rx_cos_queues->Close();
+    }
+    if (entry.second.tx_queue != nullptr) {
+      entry.second.tx_queue->Close();
     }
   }
-  // Perform the rest of the shutdown. First close the TX/RX sockets and
-  // destroy all the KNET filters and KNET interfaces.
   for (const auto& entry : purpose_to_knet_intf_) {
+    for (pthread_t thread_id :
+         {entry.second.rx_thread_id, entry.second.rx_dispatch_thread_id,
+          entry.second.tx_thread_id}) {
+      if (thread_id > 0 && pthread_join(thread_id, nullptr) != 0) {
+        ::util::Status error = MAKE_ERROR(ERR_INTERNAL)
+                               << "Failed to join thread " << thread_id;
+        APPEND_STATUS_IF_ERROR(status, error);
+      }
+    }
+  }
+  // Perform the rest of the shutdown. First unmap the rings, close the TX/RX
+  // sockets and destroy all the KNET filters and KNET interfaces.
+  for (auto& entry : purpose_to_knet_intf_) {
+    entry.second.rx_cos_queues.reset();
+    entry.second.tx_queue_writer.reset();
+    entry.second.tx_queue.reset();
+    entry.second.rx_ring.reset();
+    entry.second.tx_ring.reset();
     if (entry.second.tx_sock != -1) {
       close(entry.second.tx_sock);
     }
@@ -485,17 +646,14 @@ BcmPacketioManager::~BcmPacketioManager() {}
     std::string header = "";
     RETURN_IF_ERROR(bcm_sdk_interface_->GetKnetHeaderForDirectTx(
         unit_, *logical_port, meta.cos, intf->smac, packet.payload().size(), &header));
-    RETURN_IF_ERROR(TxPacket(purpose, intf->tx_sock, intf->vlan,
-                             intf->netif_index, true, header,
-                             packet.payload()));
+    RETURN_IF_ERROR(TxPacket(purpose, *intf, true, header, packet.payload()));
     INCREMENT_TX_COUNTER(purpose, tx_accepts_direct);
   } else {
     std::string header = "";
     RETURN_IF_ERROR(bcm_sdk_interface_->GetKnetHeaderForIngressPipelineTx(
         unit_, intf->smac, packet.payload().size(), &header));
-    RETURN_IF_ERROR(TxPacket(purpose, intf->tx_sock, intf->vlan,
-                             intf->netif_index, false, header,
-                             packet.payload()));
+    RETURN_IF_ERROR(
+        TxPacket(purpose, *intf, false, header, packet.payload()));
     INCREMENT_TX_COUNTER(purpose, tx_accepts_ingress_pipeline);
   }
 
@@ -555,7 +713,8 @@ std::string BcmPacketioManager::DumpStats() const {
     }
   }
 
-  LOG(INFO) << msg;
+  // Called on every gNMI poll of the stats, so only logged when verbose.
+  VLOG(1) << msg;
   return msg;
 }
 
@@ -712,6 +871,27 @@ std::string BcmPacketioManager::GetKnetIntfNameTemplate(
       purpose_to_knet_intf_[purpose].cpu_queue = knet_intf_config.cpu_queue();
       purpose_to_knet_intf_[purpose].mtu = knet_intf_config.mtu();
       purpose_to_knet_intf_[purpose].vlan = knet_intf_config.vlan();
+      purpose_to_knet_intf_[purpose].use_mmap_rings =
+          knet_intf_config.use_mmap_rings();
+      if (knet_intf_config.rx_cos_queueing()) {
+        std::map<int, BcmRxCosQueues::QueueConfig> queue_configs;
+        for (const auto& e : knet_intf_config.rx_cos_queue_configs()) {
+          CHECK_RETURN_IF_FALSE(e.first >= 0 && e.first <= kMaxCos)
+              << "Invalid CoS " << e.first << " in the RX CoS queue configs, "
+              << "found in " << bcm_knet_config.ShortDebugString();
+          CHECK_RETURN_IF_FALSE(e.second.weight() >= 0)
+              << "Invalid weight " << e.second.weight() << " for the RX "
+              << "queue of CoS " << e.first << ", found in "
+              << bcm_knet_config.ShortDebugString();
+          BcmRxCosQueues::QueueConfig& queue_config = queue_configs[e.first];
+          queue_config.max_depth = e.second.max_depth() > 0
+                                       ? e.second.max_depth()
+                                       : BcmRxCosQueues::kDefaultMaxDepth;
+          queue_config.weight = e.second.weight();
+        }
+        purpose_to_knet_intf_[purpose].rx_cos_queues =
+            absl::make_unique<BcmRxCosQueues>(kMaxCos + 1, queue_configs);
+      }
       // The name is just a template for the intf name at this point.
       purpose_to_knet_intf_[purpose].netif_name =
           GetKnetIntfNameTemplate(purpose, knet_intf_config.cpu_queue());
@@ -756,6 +936,39 @@ std::string BcmPacketioManager::GetKnetIntfNameTemplate(
              << ", rx_thread_id: " << entry.second.rx_thread_id
              << "). Err: " << ret << ".";
     }
+    if (entry.second.rx_cos_queues != nullptr) {
+      // The same thread data is shared by the two threads of the interface.
+      ret = pthread_create(&entry.second.rx_dispatch_thread_id, nullptr,
+                           &BcmPacketioManager::KnetIntfRxDispatchThreadFunc,
+                           data);
+      if (ret != 0) {
+        return MAKE_ERROR(ERR_INTERNAL)
+               << "Failed to spawn RX dispatch thread for KNET interface "
+               << entry.second.netif_name << " created for node with ID "
+               << node_id_ << " (unit: " << unit_ << ", purpose: "
+               << GoogleConfig::BcmKnetIntfPurpose_Name(entry.first)
+               << "). Err: " << ret << ".";
+      }
+    }
+    // Batched TX does not apply to the interfaces with a TX ring, which
+    // already hand many packets to the kernel with one call.
+    if (FLAGS_knet_tx_batch_mode && entry.second.tx_ring == nullptr &&
+        FLAGS_knet_max_num_packets_to_send_at_once > 0) {
+      entry.second.tx_queue =
+          Channel<KnetTxPacket>::Create(FLAGS_knet_tx_queue_depth);
+      entry.second.tx_queue_writer =
+          ChannelWriter<KnetTxPacket>::Create(entry.second.tx_queue);
+      ret = pthread_create(&entry.second.tx_thread_id, nullptr,
+                           &BcmPacketioManager::KnetIntfTxThreadFunc, data);
+      if (ret != 0) {
+        return MAKE_ERROR(ERR_INTERNAL)
+               << "Failed to spawn TX thread for KNET interface "
+               << entry.second.netif_name << " created for node with ID "
+               << node_id_ << " (unit: " << unit_ << ", purpose: "
+               << GoogleConfig::BcmKnetIntfPurpose_Name(entry.first)
+               << "). Err: " << ret << ".";
+      }
+    }
     LOG(INFO) << "KNET interface " << entry.second.netif_name
               << " created for node with ID " << node_id_ << " (unit: " << unit_
               << ", purpose: "
@@ -940,6 +1153,33 @@ std::string BcmPacketioManager::GetKnetIntfNameTemplate(
     }
   }
 
+  // Set up the RX/TX rings (if requested by the config). The rings need to be
+  // in place before the RX socket is bound.
+  if (intf->use_mmap_rings) {
+    BcmKnetRing::Config ring_config;
+    ring_config.block_size = FLAGS_knet_ring_block_size;
+    ring_config.num_blocks = FLAGS_knet_ring_num_blocks;
+    ring_config.frame_size = FLAGS_knet_ring_frame_size;
+    ring_config.block_timeout_ms = FLAGS_knet_rx_ring_block_timeout_ms;
+    ::util::StatusOr<std::unique_ptr<BcmKnetRing>> ring =
+        BcmKnetRing::Create(intf->rx_sock, BcmKnetRing::RX, ring_config);
+    if (ring.ok()) {
+      intf->rx_ring = ring.ConsumeValueOrDie();
+      ring = BcmKnetRing::Create(intf->tx_sock, BcmKnetRing::TX, ring_config);
+    }
+    if (!ring.ok()) {
+      // Unmap the RX ring (if created) and close both sockets, so that a
+      // failed setup does not leak them.
+      intf->rx_ring.reset();
+      close(intf->tx_sock);
+      close(intf->rx_sock);
+      intf->tx_sock = -1;
+      intf->rx_sock = -1;
+      return ring.status();
+    }
+    intf->tx_ring = ring.ConsumeValueOrDie();
+  }
+
   // Now bind socket to the interface. To bind to the interface, we do not use
   // setsockopt(SO_BINDTODEVICE). Instead we use bind with netif_index.
   struct sockaddr_ll addr;
@@ -1000,12 +1240,16 @@ std::string BcmPacketioManager::GetKnetIntfNameTemplate(
   // not expect BcmKnetIntf for this purpose to change at all (if it does,
   // VerifyChassisConfig() will return reboot required).
   int rx_sock = -1, netif_index = -1;
+  BcmKnetRing* rx_ring = nullptr;
+  BcmRxCosQueues* rx_cos_queues = nullptr;
   {
     absl::ReaderMutexLock l(&chassis_lock);
     if (shutdown) return ::util::OkStatus();
     ASSIGN_OR_RETURN(const BcmKnetIntf* intf, GetBcmKnetIntf(purpose));
     rx_sock = intf->rx_sock;
     netif_index = intf->netif_index;
+    rx_ring = intf->rx_ring.get();
+    rx_cos_queues = intf->rx_cos_queues.get();
     CHECK_RETURN_IF_FALSE(rx_sock > 0)  // MUST NOT HAPPEN!
         << "KNET interface with purpose "
         << GoogleConfig::BcmKnetIntfPurpose_Name(purpose) << " on node with ID "
@@ -1027,6 +1271,18 @@ std::string BcmPacketioManager::GetKnetIntfNameTemplate(
     return MAKE_ERROR(ERR_INTERNAL)
            << "epoll_ctl() failed. errno: " << errno << ".";
   }
+  // In batched RX mode, the buffers for all the messages read at once are
+  // allocated here and reused for the lifetime of the thread.
+  std::unique_ptr<KnetRxBatch> rx_batch;
+  if (rx_ring == nullptr && FLAGS_knet_rx_batch_mode &&
+      FLAGS_knet_max_num_packets_to_read_at_once > 0) {
+    rx_batch = absl::make_unique<KnetRxBatch>(
+        FLAGS_knet_max_num_packets_to_read_at_once,
+        bcm_sdk_interface_->GetKnetHeaderSizeForRx(unit_), kMaxRxBufferSize);
+  }
+  // The packets read at once. Reused across the reads, so that its storage is
+  // allocated only once.
+  std::vector<KnetRxPacket> packets;
   while (true) {
     {
       absl::ReaderMutexLock l(&chassis_lock);
@@ -1044,94 +1300,54 @@ std::string BcmPacketioManager::GetKnetIntfNameTemplate(
       // We have data to receive. Try to read max of
       // FLAGS_knet_max_num_packets_to_read_at_once packets before we try to
       // check for exit criteria.
-      std::vector<::p4::v1::PacketIn> packets;
-      for (int i = 0; i < FLAGS_knet_max_num_packets_to_read_at_once; ++i) {
-        absl::ReaderMutexLock l(&chassis_lock);
-        if (shutdown) break;
-        std::string header = "";
-        ::p4::v1::PacketIn packet;
-        ASSIGN_OR_RETURN(bool retry,
-                         RxPacket(purpose, rx_sock, netif_index, &header,
-                                  packet.mutable_payload()));
-        if (!retry) break;
-        if (!header.empty()) {
+      packets.clear();
+      absl::Time batch_start = absl::Now();
+      int batch_size = 0;
+      if (rx_ring != nullptr) {
+        batch_size = RxPacketRing(purpose, netif_index, rx_ring, &packets);
+      } else if (rx_batch != nullptr) {
+        ASSIGN_OR_RETURN(batch_size,
+                         RxPacketBatch(purpose, rx_sock, netif_index,
+                                       rx_batch.get(), &packets));
+      } else {
+        for (int i = 0; i < FLAGS_knet_max_num_packets_to_read_at_once; ++i) {
+          absl::ReaderMutexLock l(&chassis_lock);
+          if (shutdown) break;
+          std::string header = "";
+          KnetRxPacket packet;
+          ASSIGN_OR_RETURN(bool retry,
+                           RxPacket(purpose, rx_sock, netif_index, &header,
+                                    packet.packet.mutable_payload()));
+          if (!retry) break;
           // We received good data. Process it. The parsing errors will not
           // result in RX thread to shutdown.
-          int ingress_logical_port = 0, egress_logical_port = 0;
-          PacketInMetadata meta;
-          ::util::Status status = bcm_sdk_interface_->ParseKnetHeaderForRx(
-              unit_, header, &ingress_logical_port, &egress_logical_port,
-              &meta.cos);
-          if (!status.ok()) {
-            VLOG(1) << "Failed to parse KNET header for a packet on unit "
-                    << unit_ << ": " << status.error_message();
-            INCREMENT_RX_COUNTER(purpose, rx_drops_knet_header_parse_error);
-            continue;  // let it retry
-          }
-          // Find ingress port ID.
-          if (ingress_logical_port == kCpuLogicalPort) {
-            // This means CPU port by default.
-            meta.ingress_port_id = kCpuPortId;
-          } else {
-            uint32* ingress_port_id =
-                gtl::FindOrNull(logical_port_to_port_id_, ingress_logical_port);
-            if (ingress_port_id == nullptr) {
-              VLOG(1) << "Ingress logical port " << ingress_logical_port
-                      << " on unit " << unit_ << " is unknown!";
-              INCREMENT_RX_COUNTER(purpose, rx_drops_unknown_ingress_port);
-              continue;  // let it retry
-            }
-            meta.ingress_port_id = *ingress_port_id;
-            auto ret = bcm_chassis_ro_interface_->GetParentTrunkId(
-                node_id_, *ingress_port_id);
-            if (ret.ok()) {
-              // If status is OK, there is a parent trunk.
-              meta.ingress_trunk_id = ret.ValueOrDie();
-            }
-          }
-          // Find egress port ID.
-          if (egress_logical_port == kCpuLogicalPort) {
-            // This means CPU port by default.
-            meta.egress_port_id = kCpuPortId;
-          } else if (egress_logical_port == 1) {
-            // SDKLT sets egress port to 1 for packets that do not match
-            // MY_STATION table or got dropped by the ASIC?
-            // TODO: check this and decide what to report upwards
-            meta.egress_port_id = 1;
-          } else {
-            uint32* egress_port_id =
-                gtl::FindOrNull(logical_port_to_port_id_, egress_logical_port);
-            if (egress_port_id == nullptr) {
-              VLOG(1) << "Egress logical port " << egress_logical_port
-                      << " on unit " << unit_ << " is unknown!";
-              INCREMENT_RX_COUNTER(purpose, rx_drops_unknown_egress_port);
-              continue;  // let it retry
-            }
-            meta.egress_port_id = *egress_port_id;
-          }
-          VLOG(1) << "PacketInMetadata.ingress_port_id: " << meta.ingress_port_id
-              << "\n" << "PacketInMetadata.ingress_trunk_id: " << meta.ingress_trunk_id
-              << "\n" << "PacketInMetadata.egress_port_id: " << meta.egress_port_id
-              << "\n" << "PacketInMetadata.cos: " << meta.cos;
-          status = DeparsePacketInMetadata(meta, &packet);
-          if (!status.ok()) {
-            INCREMENT_RX_COUNTER(purpose, rx_drops_metadata_deparse_error);
+          if (header.empty() || !ProcessRxPacket(purpose, header,
+                                                 &packet.packet, &packet.cos)) {
             continue;  // let it retry
           }
           INCREMENT_RX_COUNTER(purpose, rx_accepts);
-          packets.push_back(packet);
+          packets.push_back(std::move(packet));
         }
       }
-      // Send the packet to the packet RX writer.
-      if (!packets.empty()) {
+      // Send the packet to the packet RX writer, or to the RX CoS queues for
+      // the dispatch thread to send them.
+      if (!packets.empty() && rx_cos_queues != nullptr) {
+        EnqueueRxPackets(purpose, rx_cos_queues, &packets);
+      } else if (!packets.empty()) {
         absl::ReaderMutexLock l(&rx_writer_lock_);
         auto* writer = gtl::FindOrNull(purpose_to_rx_writer_, purpose);
         if (writer != nullptr) {
-          for (const auto& p : packets) {
-            (*writer)->Write(p);
+          // The packets are not used after this point. Moving them lets the
+          // payloads travel to the controller stream without any copy.
+          for (auto& p : packets) {
+            (*writer)->Write(std::move(p.packet));
           }
         }
       }
+      if (batch_size > 0) {
+        UpdateRxBatchStats(purpose, batch_size, packets.size(),
+                           absl::Now() - batch_start);
+      }
     }
   }
 
@@ -1209,31 +1425,124 @@ std::string BcmPacketioManager::GetKnetIntfNameTemplate(
 
   INCREMENT_RX_COUNTER(purpose, all_rx);
   // res > 0 so cast to size_t is safe.
-  if (static_cast<size_t>(res) < header_size) {
+  ExtractRxPacket(purpose, netif_index, static_cast<size_t>(res),
+                  msg.msg_flags, sa, header_buffer.get(), header_size,
+                  payload_buffer.get(), header, payload);
+
+  return true;
+}
+
+::util::StatusOr<int> BcmPacketioManager::RxPacketBatch(
+    GoogleConfig::BcmKnetIntfPurpose purpose, int sock, int netif_index,
+    KnetRxBatch* batch, std::vector<KnetRxPacket>* packets) {
+  if (batch == nullptr || packets == nullptr) {
+    return MAKE_ERROR(ERR_INTERNAL) << "Null batch or packets!";
+  }
+
+  batch->Reset();
+  int res = recvmmsg(sock, batch->msgs.data(), batch->num_msgs, MSG_DONTWAIT,
+                     nullptr);
+  if (res < 0) {
+    // EINTR and EAGAIN mean there was nothing to read. We retry after the next
+    // epoll_wait() in any case.
+    if (errno != EINTR && errno != EAGAIN) {
+      VLOG(1) << "Error when receiving packets on netif  " << netif_index
+              << " on unit " << unit_ << ": " << errno;
+      INCREMENT_RX_COUNTER(purpose, rx_errors_internal_read_failures);
+    }
+    return 0;
+  }
+
+  absl::ReaderMutexLock l(&chassis_lock);
+  if (shutdown) return 0;
+  // Reused for all the packets to avoid allocating a header per packet.
+  std::string header;
+  for (int i = 0; i < res; ++i) {
+    const struct mmsghdr& msg = batch->msgs[i];
+    if (msg.msg_len == 0) {
+      // Only this message is bad. Skip it, so the packets already decoded
+      // from this batch and the ones after it are still delivered.
+      VLOG(1) << "Received an empty message on netif  " << netif_index
+              << " on unit " << unit_ << ".";
+      INCREMENT_RX_COUNTER(purpose, rx_errors_sock_shutdown);
+      continue;
+    }
+    KnetRxPacket packet;
+    if (!ExtractRxPacket(purpose, netif_index, msg.msg_len,
+                         msg.msg_hdr.msg_flags, batch->addrs[i],
+                         batch->header(i), batch->header_size,
+                         batch->payload(i), &header,
+                         packet.packet.mutable_payload()) ||
+        !ProcessRxPacket(purpose, header, &packet.packet, &packet.cos)) {
+      continue;
+    }
+    packets->push_back(std::move(packet));
+  }
+
+  return res;
+}
+
+int BcmPacketioManager::RxPacketRing(
+    GoogleConfig::BcmKnetIntfPurpose purpose, int netif_index,
+    BcmKnetRing* ring, std::vector<KnetRxPacket>* packets) {
+  const size_t header_size = bcm_sdk_interface_->GetKnetHeaderSizeForRx(unit_);
+  absl::ReaderMutexLock l(&chassis_lock);
+  if (shutdown) return 0;
+  // Each frame in the ring holds the KNET header followed by the payload.
+  // Reused for all the packets to avoid allocating a header per packet.
+  std::string header;
+  auto handler = [&](const char* data, size_t size, bool truncated,
+                     const struct sockaddr_ll& sa) {
+    KnetRxPacket packet;
+    if (!ExtractRxPacket(purpose, netif_index, size, truncated ? MSG_TRUNC : 0,
+                         sa, data, header_size, data + header_size, &header,
+                         packet.packet.mutable_payload()) ||
+        !ProcessRxPacket(purpose, header, &packet.packet, &packet.cos)) {
+      return;
+    }
+    packets->push_back(std::move(packet));
+  };
+  // Read at most a full ring, so that we get to check for exit criteria.
+  int num_frames = 0;
+  for (int i = 0; i < FLAGS_knet_ring_num_blocks; ++i) {
+    int n = ring->ReadBlock(handler);
+    if (n == 0) break;
+    num_frames += n;
+  }
+
+  return num_frames;
+}
+
+bool BcmPacketioManager::ExtractRxPacket(
+    GoogleConfig::BcmKnetIntfPurpose purpose, int netif_index, size_t size,
+    int msg_flags, const struct sockaddr_ll& sa, const char* header_buffer,
+    size_t header_size, const char* payload_buffer, std::string* header,
+    std::string* payload) {
+  if (size < header_size) {
     VLOG(1) << "Num of received bytes on netif  " << netif_index << " on unit "
             << unit_ << " < " << header_size << ".";
     INCREMENT_RX_COUNTER(purpose, rx_errors_incomplete_read);
-    return true;
+    return false;
   }
-  size_t payload_size = static_cast<size_t>(res - header_size);
+  size_t payload_size = size - header_size;
 
   // Try to see if the message looks OK. If not retry.
-  if (msg.msg_flags & MSG_TRUNC || sa.sll_ifindex != netif_index ||
+  if (msg_flags & MSG_TRUNC || sa.sll_ifindex != netif_index ||
       sa.sll_pkttype == PACKET_OUTGOING) {
     VLOG(1) << "Received invalid packet on netif  " << netif_index
             << " on unit " << unit_ << ".";
     INCREMENT_RX_COUNTER(purpose, rx_errors_invalid_packet);
-    return true;
+    return false;
   }
 
   // Strip some known VLAN tags.
-  struct ether_header* ether_header =
-      reinterpret_cast<struct ether_header*>(payload_buffer.get());
+  const struct ether_header* ether_header =
+      reinterpret_cast<const struct ether_header*>(payload_buffer);
   bool tagged = false;
   if (payload_size >= sizeof(struct ether_header) + kVlanIdSize &&
       ntohs(ether_header->ether_type) == ETHERTYPE_VLAN) {
-    auto* pid = reinterpret_cast<uint16*>(payload_buffer.get() +
-                                          sizeof(struct ether_header));
+    const auto* pid = reinterpret_cast<const uint16*>(
+        payload_buffer + sizeof(struct ether_header));
     uint16 vlan = ntohs(*pid) & kVlanIdMask;
     if (vlan == kDefaultVlan || vlan == kArpVlan) {
       tagged = true;
@@ -1241,17 +1550,170 @@ std::string BcmPacketioManager::GetKnetIntfNameTemplate(
   }
 
   if (tagged) {
-    payload->assign(payload_buffer.get(), ETH_ALEN * 2);
-    payload->append(payload_buffer.get() + ETH_ALEN * 2 + kVlanTagSize,
+    payload->assign(payload_buffer, ETH_ALEN * 2);
+    payload->append(payload_buffer + ETH_ALEN * 2 + kVlanTagSize,
                     payload_size - ETH_ALEN * 2 - kVlanTagSize);
   } else {
-    payload->assign(payload_buffer.get(), payload_size);
+    payload->assign(payload_buffer, payload_size);
   }
-  header->assign(header_buffer.get(), header_size);
+  header->assign(header_buffer, header_size);
 
   return true;
 }
 
+bool BcmPacketioManager::ProcessRxPacket(
+    GoogleConfig::BcmKnetIntfPurpose purpose, const std::string& header,
+    ::p4::v1::PacketIn* packet, int* cos) {
+  int ingress_logical_port = 0, egress_logical_port = 0;
+  PacketInMetadata meta;
+  ::util::Status status = bcm_sdk_interface_->ParseKnetHeaderForRx(
+      unit_, header, &ingress_logical_port, &egress_logical_port, &meta.cos);
+  if (!status.ok()) {
+    VLOG(1) << "Failed to parse KNET header for a packet on unit " << unit_
+            << ": " << status.error_message();
+    INCREMENT_RX_COUNTER(purpose, rx_drops_knet_header_parse_error);
+    return false;
+  }
+  // Find ingress port ID.
+  if (ingress_logical_port == kCpuLogicalPort) {
+    // This means CPU port by default.
+    meta.ingress_port_id = kCpuPortId;
+  } else {
+    const uint32* ingress_port_id =
+        gtl::FindOrNull(logical_port_to_port_id_, ingress_logical_port);
+    if (ingress_port_id == nullptr) {
+      VLOG(1) << "Ingress logical port " << ingress_logical_port << " on unit "
+              << unit_ << " is unknown!";
+      INCREMENT_RX_COUNTER(purpose, rx_drops_unknown_ingress_port);
+      return false;
+    }
+    meta.ingress_port_id = *ingress_port_id;
+    auto ret =
+        bcm_chassis_ro_interface_->GetParentTrunkId(node_id_, *ingress_port_id);
+    if (ret.ok()) {
+      // If status is OK, there is a parent trunk.
+      meta.ingress_trunk_id = ret.ValueOrDie();
+    }
+  }
+  // Find egress port ID.
+  if (egress_logical_port == kCpuLogicalPort) {
+    // This means CPU port by default.
+    meta.egress_port_id = kCpuPortId;
+  } else if (egress_logical_port == 1) {
+    // SDKLT sets egress port to 1 for packets that do not match
+    // MY_STATION table or got dropped by the ASIC?
+    // TODO: check this and decide what to report upwards
+    meta.egress_port_id = 1;
+  } else {
+    const uint32* egress_port_id =
+        gtl::FindOrNull(logical_port_to_port_id_, egress_logical_port);
+    if (egress_port_id == nullptr) {
+      VLOG(1) << "Egress logical port " << egress_logical_port << " on unit "
+              << unit_ << " is unknown!";
+      INCREMENT_RX_COUNTER(purpose, rx_drops_unknown_egress_port);
+      return false;
+    }
+    meta.egress_port_id = *egress_port_id;
+  }
+  VLOG(1) << "PacketInMetadata.ingress_port_id: " << meta.ingress_port_id
+          << "\n"
+          << "PacketInMetadata.ingress_trunk_id: " << meta.ingress_trunk_id
+          << "\n"
+          << "PacketInMetadata.egress_port_id: " << meta.egress_port_id << "\n"
+          << "PacketInMetadata.cos: " << meta.cos;
+  status = DeparsePacketInMetadata(meta, packet);
+  if (!status.ok()) {
+    INCREMENT_RX_COUNTER(purpose, rx_drops_metadata_deparse_error);
+    return false;
+  }
+  *cos = meta.cos;
+
+  return true;
+}
+
+void BcmPacketioManager::EnqueueRxPackets(
+    GoogleConfig::BcmKnetIntfPurpose purpose, BcmRxCosQueues* rx_cos_queues,
+    std::vector<KnetRxPacket>* packets) {
+  // Count locally and update the stats once per batch, to not take the stats
+  // lock once per packet.
+  std::array<uint64, kMaxCos + 1> enqueues = {};
+  std::array<uint64, kMaxCos + 1> drops = {};
+  for (auto& p : *packets) {
+    // A CoS out of range goes to the lowest CoS queue, so count it there.
+    int cos = (p.cos >= 0 && p.cos <= kMaxCos) ? p.cos : 0;
+    if (rx_cos_queues->Enqueue(cos, &p.packet)) {
+      ++enqueues[cos];
+    } else {
+      ++drops[cos];
+    }
+  }
+  absl::WriterMutexLock l(&rx_stats_lock_);
+  BcmKnetRxStats& stats = purpose_to_rx_stats_[purpose];
+  for (int cos = 0; cos <= kMaxCos; ++cos) {
+    stats.rx_cos_queue_enqueues[cos] += enqueues[cos];
+    stats.rx_drops_cos_queue_full[cos] += drops[cos];
+  }
+}
+
+::util::Status BcmPacketioManager::HandleKnetIntfPacketDispatch(
+    GoogleConfig::BcmKnetIntfPurpose purpose) {
+  BcmRxCosQueues* rx_cos_queues = nullptr;
+  {
+    absl::ReaderMutexLock l(&chassis_lock);
+    if (shutdown) return ::util::OkStatus();
+    ASSIGN_OR_RETURN(const BcmKnetIntf* intf, GetBcmKnetIntf(purpose));
+    rx_cos_queues = intf->rx_cos_queues.get();
+    CHECK_RETURN_IF_FALSE(rx_cos_queues != nullptr)  // MUST NOT HAPPEN!
+        << "KNET interface with purpose "
+        << GoogleConfig::BcmKnetIntfPurpose_Name(purpose) << " on node with ID "
+        << node_id_ << " mapped to unit " << unit_
+        << " does not have RX CoS queues.";
+  }
+
+  ::p4::v1::PacketIn packet;
+  int cos = 0;
+  while (true) {
+    {
+      absl::ReaderMutexLock l(&chassis_lock);
+      if (shutdown) break;
+    }
+    if (!rx_cos_queues->Dequeue(
+            &packet, &cos,
+            absl::Milliseconds(FLAGS_knet_rx_poll_timeout_ms))) {
+      continue;
+    }
+    absl::ReaderMutexLock l(&rx_writer_lock_);
+    auto* writer = gtl::FindOrNull(purpose_to_rx_writer_, purpose);
+    if (writer != nullptr) {
+      (*writer)->Write(std::move(packet));
+    }
+  }
+
+  LOG(INFO) << "Killed RX dispatch thread for KNET interface with purpose "
+            << GoogleConfig::BcmKnetIntfPurpose_Name(purpose)
+            << " on node with ID " << node_id_ << " mapped to unit " << unit_
+            << ".";
+
+  return ::util::OkStatus();
+}
+
+void BcmPacketioManager::UpdateRxBatchStats(
+    GoogleConfig::BcmKnetIntfPurpose purpose, int num_packets, int num_accepts,
+    absl::Duration latency) {
+  uint64 latency_usecs = absl::ToInt64Microseconds(latency);
+  absl::WriterMutexLock l(&rx_stats_lock_);
+  BcmKnetRxStats& stats = purpose_to_rx_stats_[purpose];
+  stats.all_rx += num_packets;
+  stats.rx_accepts += num_accepts;
+  stats.rx_batches++;
+  stats.rx_batch_packets += num_packets;
+  stats.rx_batch_max_size =
+      std::max(stats.rx_batch_max_size, static_cast<uint64>(num_packets));
+  stats.rx_batch_total_latency_usecs += latency_usecs;
+  stats.rx_batch_max_latency_usecs =
+      std::max(stats.rx_batch_max_latency_usecs, latency_usecs);
+}
+
 ::util::Status BcmPacketioManager::DeparsePacketInMetadata(
     const PacketInMetadata& meta, ::p4::v1::PacketIn* packet) {
   // Note: We are down-casting to uint32 for the port/trunk IDs in this method.
@@ -1328,10 +1790,46 @@ std::string BcmPacketioManager::GetKnetIntfNameTemplate(
 }
 
 ::util::Status BcmPacketioManager::TxPacket(
-    GoogleConfig::BcmKnetIntfPurpose purpose, int sock, int vlan,
-    int netif_index, bool direct_tx, const std::string& header,
-    const std::string& payload) {
+    GoogleConfig::BcmKnetIntfPurpose purpose, const BcmKnetIntf& intf,
+    bool direct_tx, const std::string& header, const std::string& payload) {
   CHECK_RETURN_IF_FALSE(payload.length() >= sizeof(struct ether_header));
+  const int sock = intf.tx_sock;
+  const int netif_index = intf.netif_index;
+
+  // With a TX ring, the packet is copied into the ring shared with the kernel.
+  if (intf.tx_ring != nullptr) {
+    ::util::Status status = intf.tx_ring->Send(header, payload, netif_index);
+    if (!status.ok()) {
+      // A full ring is not an internal error. The caller gets
+      // ERR_NO_RESOURCE back, the same as for a full TX queue, and can back
+      // off and retry.
+      if (status.error_code() == ERR_NO_RESOURCE) {
+        INCREMENT_TX_COUNTER(purpose, tx_drops_ring_full);
+      } else {
+        INCREMENT_TX_COUNTER(purpose, tx_errors_internal_send_failures);
+      }
+      return MAKE_ERROR(static_cast<ErrorCode>(status.error_code()))
+             << "Error when transmitting packet to netif " << netif_index
+             << " on unit " << unit_ << ": " << status.error_message();
+    }
+    return ::util::OkStatus();
+  }
+
+  // In batched TX mode, the packet is sent later by the TX thread.
+  if (intf.tx_queue_writer != nullptr) {
+    KnetTxPacket tx_packet;
+    tx_packet.header = header;
+    tx_packet.payload = payload;
+    ::util::Status status =
+        intf.tx_queue_writer->TryWrite(std::move(tx_packet));
+    if (!status.ok()) {
+      INCREMENT_TX_COUNTER(purpose, tx_drops_queue_full);
+      return MAKE_ERROR(ERR_NO_RESOURCE)
+             << "TX queue of netif " << netif_index << " on unit " << unit_
+             << " is full: " << status.error_message();
+    }
+    return ::util::OkStatus();
+  }
 
   constexpr size_t kMaxIovLen = 4;
   struct iovec iov[kMaxIovLen];
@@ -1391,8 +1889,111 @@ std::string BcmPacketioManager::GetKnetIntfNameTemplate(
   return ::util::OkStatus();
 }
 
+::util::Status BcmPacketioManager::HandleKnetIntfPacketTx(
+    GoogleConfig::BcmKnetIntfPurpose purpose) {
+  int tx_sock = -1, netif_index = -1;
+  std::shared_ptr<Channel<KnetTxPacket>> tx_queue;
+  {
+    absl::ReaderMutexLock l(&chassis_lock);
+    if (shutdown) return ::util::OkStatus();
+    ASSIGN_OR_RETURN(const BcmKnetIntf* intf, GetBcmKnetIntf(purpose));
+    tx_sock = intf->tx_sock;
+    netif_index = intf->netif_index;
+    tx_queue = intf->tx_queue;
+    // MUST NOT HAPPEN!
+    CHECK_RETURN_IF_FALSE(tx_sock > 0 && tx_queue != nullptr)
+        << "KNET interface with purpose "
+        << GoogleConfig::BcmKnetIntfPurpose_Name(purpose) << " on node with ID "
+        << node_id_ << " mapped to unit " << unit_
+        << " does not have a TX socket or a TX queue.";
+  }
+
+  auto reader = ChannelReader<KnetTxPacket>::Create(tx_queue);
+  // The packets and the buffers to send them are allocated once and reused
+  // for the lifetime of the thread.
+  const size_t max_batch_size = FLAGS_knet_max_num_packets_to_send_at_once;
+  std::vector<KnetTxPacket> packets(max_batch_size);
+  KnetTxBatch tx_batch(max_batch_size, netif_index);
+  while (true) {
+    {
+      absl::ReaderMutexLock l(&chassis_lock);
+      if (shutdown) break;
+    }
+    // Wait for the first packet, then take whatever else is already queued.
+    ::util::Status status = reader->Read(
+        &packets[0], absl::Milliseconds(FLAGS_knet_rx_poll_timeout_ms));
+    if (status.error_code() == ERR_CANCELLED) break;
+    if (!status.ok()) continue;
+    size_t num_packets = 1;
+    while (num_packets < max_batch_size &&
+           reader->TryRead(&packets[num_packets]).ok()) {
+      ++num_packets;
+    }
+    TxPacketBatch(purpose, tx_sock, &tx_batch, packets, num_packets);
+  }
+
+  LOG(INFO) << "Killed TX thread for KNET interface with purpose "
+            << GoogleConfig::BcmKnetIntfPurpose_Name(purpose)
+            << " on node with ID " << node_id_ << " mapped to unit " << unit_
+            << ".";
+
+  return ::util::OkStatus();
+}
+
+void BcmPacketioManager::TxPacketBatch(
+    GoogleConfig::BcmKnetIntfPurpose purpose, int sock, KnetTxBatch* batch,
+    const std::vector<KnetTxPacket>& packets, size_t num_packets) {
+  for (size_t i = 0; i < num_packets; ++i) batch->Set(i, packets[i]);
+  uint64 num_send_failures = 0, num_incomplete_sends = 0;
+  size_t num_sent = 0;  // num of messages done with, sent or failed
+  while (num_sent < num_packets) {
+    int res = sendmmsg(sock, &batch->msgs[num_sent], num_packets - num_sent,
+                       MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (res <= 0) {
+      if (res < 0 && errno == EINTR) {
+        // signal received before we could transmit anything. Need to retry.
+        continue;
+      }
+      // The first message could not be sent. Drop it and go on with the rest.
+      VLOG(1) << "Error when transmitting packet to netif "
+              << batch->sa.sll_ifindex << " on unit " << unit_ << ": "
+              << errno;
+      ++num_send_failures;
+      ++num_sent;
+      continue;
+    }
+    for (size_t i = num_sent; i < num_sent + static_cast<size_t>(res); ++i) {
+      if (batch->msgs[i].msg_len !=
+          packets[i].header.size() + packets[i].payload.size()) {
+        ++num_incomplete_sends;
+      }
+    }
+    num_sent += res;
+  }
+
+  absl::WriterMutexLock l(&tx_stats_lock_);
+  BcmKnetTxStats& stats = purpose_to_tx_stats_[purpose];
+  stats.tx_errors_internal_send_failures += num_send_failures;
+  stats.tx_errors_incomplete_send += num_incomplete_sends;
+  stats.tx_batches++;
+  stats.tx_batch_packets += num_packets;
+  stats.tx_batch_max_size =
+      std::max(stats.tx_batch_max_size, static_cast<uint64>(num_packets));
+}
+
 ::util::Status BcmPacketioManager::ParsePacketOutMetadata(
     const ::p4::v1::PacketOut& packet, PacketOutMetadata* meta) {
+  std::string key = "";
+  if (FLAGS_knet_tx_metadata_cache_size > 0 && packet.metadata_size() > 0) {
+    key = PacketOutMetadataCacheKey(packet);
+    absl::ReaderMutexLock l(&packet_out_metadata_cache_lock_);
+    const PacketOutMetadata* cached =
+        gtl::FindOrNull(packet_out_metadata_cache_, key);
+    if (cached != nullptr) {
+      *meta = *cached;
+      return ::util::OkStatus();
+    }
+  }
   meta->cos = kDefaultCos;  // default
   for (const auto& metadata : packet.metadata()) {
     // Query P4TableMapper to understand what this metadata refers to.
@@ -1420,6 +2021,15 @@ std::string BcmPacketioManager::GetKnetIntfNameTemplate(
   // TODO(max): This implicit way is in conflict with the explicit flag in packet_out header
   meta->use_ingress_pipeline =
       (meta->egress_port_id == 0 && meta->egress_trunk_id == 0);
+  // Only the successfully parsed metadata are cached.
+  if (!key.empty()) {
+    absl::WriterMutexLock l(&packet_out_metadata_cache_lock_);
+    if (packet_out_metadata_cache_.size() >=
+        static_cast<size_t>(FLAGS_knet_tx_metadata_cache_size)) {
+      packet_out_metadata_cache_.clear();
+    }
+    packet_out_metadata_cache_[key] = *meta;
+  }
 
   return ::util::OkStatus();
 }
@@ -1463,6 +2073,30 @@ void* BcmPacketioManager::KnetIntfRxThreadFunc(void* arg) {
   return nullptr;
 }
 
+void* BcmPacketioManager::KnetIntfTxThreadFunc(void* arg) {
+  KnetIntfRxThreadData* data = static_cast<KnetIntfRxThreadData*>(arg);
+  ::util::Status status = data->mgr->HandleKnetIntfPacketTx(data->purpose);
+  if (!status.ok()) {
+    LOG(ERROR) << "Non-OK exit of TX thread for KNET interface with purpose "
+               << GoogleConfig::BcmKnetIntfPurpose_Name(data->purpose)
+               << " on node with ID " << data->node_id << ".";
+  }
+  return nullptr;
+}
+
+void* BcmPacketioManager::KnetIntfRxDispatchThreadFunc(void* arg) {
+  KnetIntfRxThreadData* data = static_cast<KnetIntfRxThreadData*>(arg);
+  ::util::Status status =
+      data->mgr->HandleKnetIntfPacketDispatch(data->purpose);
+  if (!status.ok()) {
+    LOG(ERROR) << "Non-OK exit of RX dispatch thread for KNET interface with "
+               << "purpose "
+               << GoogleConfig::BcmKnetIntfPurpose_Name(data->purpose)
+               << " on node with ID " << data->node_id << ".";
+  }
+  return nullptr;
+}
+
 }  // namespace bcm
 }  // namespace hal
 }  // namespace stratum
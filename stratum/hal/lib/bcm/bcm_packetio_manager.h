@@ -20,9 +20,11 @@
 #define STRATUM_HAL_LIB_BCM_BCM_PACKETIO_MANAGER_H_
 
 #include <net/ethernet.h>
+#include <netpacket/packet.h>
 #include <pthread.h>
 #include <signal.h>
 
+#include <array>
 #include <functional>
 #include <map>
 #include <vector>
@@ -34,18 +36,23 @@
 #include "stratum/hal/lib/bcm/bcm.pb.h"
 #include "stratum/hal/lib/bcm/bcm_chassis_ro_interface.h"
 #include "stratum/hal/lib/bcm/bcm_global_vars.h"
+#include "stratum/hal/lib/bcm/bcm_knet_ring.h"
+#include "stratum/hal/lib/bcm/bcm_rx_cos_queues.h"
 #include "stratum/hal/lib/bcm/bcm_sdk_interface.h"
 #include "stratum/hal/lib/bcm/constants.h"
 #include "stratum/hal/lib/common/writer_interface.h"
 #include "stratum/hal/lib/common/common.pb.h"
 #include "stratum/hal/lib/common/constants.h"
 #include "stratum/hal/lib/p4/p4_table_mapper.h"
+#include "stratum/lib/channel/channel.h"
 #include "stratum/lib/utils.h"
 #include "stratum/glue/integral_types.h"
 #include "absl/base/thread_annotations.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
 #include "p4/v1/p4runtime.pb.h"
 
 namespace stratum {
@@ -54,6 +61,8 @@ namespace bcm {
 
 class BcmPacketioManager;
 struct BcmKnetIntf;
+struct KnetRxBatch;
+struct KnetTxBatch;
 
 // Encapsulates the data passed to the RX thread for each KNET interface.
 struct KnetIntfRxThreadData {
@@ -69,6 +78,21 @@ struct KnetIntfRxThreadData {
       : node_id(_node_id), purpose(_purpose), mgr(ABSL_DIE_IF_NULL(_mgr)) {}
 };
 
+// A packet received on a KNET interface, along with the CoS it was received
+// on.
+struct KnetRxPacket {
+  ::p4::v1::PacketIn packet;
+  int cos;
+  KnetRxPacket() : packet(), cos(kDefaultCos) {}
+};
+
+// A packet waiting in the TX queue of a KNET interface in batched TX mode,
+// made of the KNET header built for the packet followed by its payload.
+struct KnetTxPacket {
+  std::string header;
+  std::string payload;
+};
+
 // All the TX stats we collect for each KNET interface.
 struct BcmKnetTxStats {
   // All TX packets (accepted + dropped + error)
@@ -90,6 +114,19 @@ struct BcmKnetTxStats {
   // (Probably valid) TX packets dropped due to egress trunk being down (i.e.
   // all the ports in the trunk were down or trunk was empty).
   uint64 tx_drops_down_trunk;
+  // (Probably valid) TX packets dropped because the TX queue was full, in
+  // batched TX mode.
+  uint64 tx_drops_queue_full;
+  // (Probably valid) TX packets dropped because the mmap'ed TX ring was full.
+  uint64 tx_drops_ring_full;
+  // Num of batches sent in batched TX mode. A batch takes a single sendmmsg()
+  // call, unless the kernel does not take all of it at once.
+  uint64 tx_batches;
+  // Num of packets sent in batches. tx_batch_packets / tx_batches gives the
+  // average batch size.
+  uint64 tx_batch_packets;
+  // Size of the largest batch.
+  uint64 tx_batch_max_size;
   BcmKnetTxStats()
       : all_tx(0),
         tx_accepts_ingress_pipeline(0),
@@ -99,7 +136,12 @@ struct BcmKnetTxStats {
         tx_drops_metadata_parse_error(0),
         tx_drops_unknown_port(0),
         tx_drops_down_port(0),
-        tx_drops_down_trunk(0) {}
+        tx_drops_down_trunk(0),
+        tx_drops_queue_full(0),
+        tx_drops_ring_full(0),
+        tx_batches(0),
+        tx_batch_packets(0),
+        tx_batch_max_size(0) {}
   std::string ToString() const {
     return absl::StrCat(
         "(all_tx:", all_tx,
@@ -110,7 +152,11 @@ struct BcmKnetTxStats {
         ", tx_drops_metadata_parse_error:", tx_drops_metadata_parse_error,
         ", tx_drops_unknown_port:", tx_drops_unknown_port,
         ", tx_drops_down_port:", tx_drops_down_port,
-        ", tx_drops_down_trunk:", tx_drops_down_trunk, ")");
+        ", tx_drops_down_trunk:", tx_drops_down_trunk,
+        ", tx_drops_queue_full:", tx_drops_queue_full,
+        ", tx_drops_ring_full:", tx_drops_ring_full,
+        ", tx_batches:", tx_batches, ", tx_batch_packets:", tx_batch_packets,
+        ", tx_batch_max_size:", tx_batch_max_size, ")");
   }
 };
 
@@ -141,6 +187,24 @@ struct BcmKnetRxStats {
   uint64 rx_drops_unknown_ingress_port;
   // (Probably valid) RX packets dropped due to unknown egress port.
   uint64 rx_drops_unknown_egress_port;
+  // Num of batches read by a single recvmmsg() call, when the batched RX mode
+  // is enabled. Empty reads are not counted.
+  uint64 rx_batches;
+  // Num of packets read in batches. rx_batch_packets / rx_batches gives the
+  // average batch size.
+  uint64 rx_batch_packets;
+  // Size of the largest batch.
+  uint64 rx_batch_max_size;
+  // Total and max time (in usecs) spent to read, process and forward a batch
+  // to the RX packet writer.
+  uint64 rx_batch_total_latency_usecs;
+  uint64 rx_batch_max_latency_usecs;
+  // Num of accepted packets put in the RX queue of each CoS, when the per-CoS
+  // RX queueing is enabled.
+  std::array<uint64, kMaxCos + 1> rx_cos_queue_enqueues;
+  // Num of accepted packets dropped because the RX queue of their CoS was
+  // full (or closed).
+  std::array<uint64, kMaxCos + 1> rx_drops_cos_queue_full;
   BcmKnetRxStats()
       : all_rx(0),
         rx_accepts(0),
@@ -152,7 +216,14 @@ struct BcmKnetRxStats {
         rx_drops_knet_header_parse_error(0),
         rx_drops_metadata_deparse_error(0),
         rx_drops_unknown_ingress_port(0),
-        rx_drops_unknown_egress_port(0) {}
+        rx_drops_unknown_egress_port(0),
+        rx_batches(0),
+        rx_batch_packets(0),
+        rx_batch_max_size(0),
+        rx_batch_total_latency_usecs(0),
+        rx_batch_max_latency_usecs(0),
+        rx_cos_queue_enqueues(),
+        rx_drops_cos_queue_full() {}
   std::string ToString() const {
     return absl::StrCat(
         "(all_rx:", all_rx, ", rx_accepts:", rx_accepts,
@@ -164,7 +235,15 @@ struct BcmKnetRxStats {
         ", rx_drops_knet_header_parse_error:", rx_drops_knet_header_parse_error,
         ", rx_drops_metadata_deparse_error:", rx_drops_metadata_deparse_error,
         ", rx_drops_unknown_ingress_port:", rx_drops_unknown_ingress_port,
-        ", rx_drops_unknown_egress_port:", rx_drops_unknown_egress_port, ")");
+        ", rx_drops_unknown_egress_port:", rx_drops_unknown_egress_port,
+        ", rx_batches:", rx_batches, ", rx_batch_packets:", rx_batch_packets,
+        ", rx_batch_max_size:", rx_batch_max_size,
+        ", rx_batch_total_latency_usecs:", rx_batch_total_latency_usecs,
+        ", rx_batch_max_latency_usecs:", rx_batch_max_latency_usecs,
+        ", rx_cos_queue_enqueues:[",
+        absl::StrJoin(rx_cos_queue_enqueues, ","),
+        "], rx_drops_cos_queue_full:[",
+        absl::StrJoin(rx_drops_cos_queue_full, ","), "])");
   }
 };
 
@@ -195,8 +274,26 @@ struct BcmKnetIntf {
   int tx_sock;
   // RX socket fd.
   int rx_sock;
+  // Whether RX and TX use mmap'ed rings on rx_sock and tx_sock.
+  bool use_mmap_rings;
+  // The rings, if use_mmap_rings is true. Must be released before the
+  // sockets are closed.
+  std::unique_ptr<BcmKnetRing> rx_ring;
+  std::unique_ptr<BcmKnetRing> tx_ring;
+  // The per-CoS queues between the RX thread and the application, if RX CoS
+  // queueing is enabled for the interface.
+  std::unique_ptr<BcmRxCosQueues> rx_cos_queues;
   // The ID of the RX thread which is in charge of receiving the packets.
   pthread_t rx_thread_id;
+  // The ID of the thread which sends the packets from rx_cos_queues to the
+  // application, if rx_cos_queues is set.
+  pthread_t rx_dispatch_thread_id;
+  // In batched TX mode, the queue of the packets waiting to be sent, the
+  // writer used to put packets in it, and the ID of the TX thread which sends
+  // them in batches.
+  std::shared_ptr<Channel<KnetTxPacket>> tx_queue;
+  std::unique_ptr<ChannelWriter<KnetTxPacket>> tx_queue_writer;
+  pthread_t tx_thread_id;
   BcmKnetIntf()
       : cpu_queue(-1),
         mtu(0),
@@ -208,7 +305,15 @@ struct BcmKnetIntf {
         filter_ids(),
         tx_sock(-1),
         rx_sock(-1),
-        rx_thread_id(0) {}
+        use_mmap_rings(false),
+        rx_ring(nullptr),
+        tx_ring(nullptr),
+        rx_cos_queues(nullptr),
+        rx_thread_id(0),
+        rx_dispatch_thread_id(0),
+        tx_queue(nullptr),
+        tx_queue_writer(nullptr),
+        tx_thread_id(0) {}
 };
 
 // Metadata we need to parse from each packet received from controller to
@@ -280,6 +385,13 @@ class BcmPacketioManager {
   virtual ::util::Status VerifyChassisConfig(const ChassisConfig& config,
                                              uint64 node_id);
 
+  // Pushes the P4-based forwarding pipeline config. Called after the config is
+  // pushed to P4TableMapper. Drops the cached translations of the P4
+  // PacketMetadata of transmitted packets, which depend on the pipeline.
+  virtual ::util::Status PushForwardingPipelineConfig(
+      const ::p4::v1::ForwardingPipelineConfig& config)
+      LOCKS_EXCLUDED(packet_out_metadata_cache_lock_);
+
   // Performs coldboot shutdown. Note that there is no public Initialize().
   // Initialization is done as part of PushChassisConfig() if the class is not
   // initialized by the time we push config.
@@ -414,6 +526,64 @@ class BcmPacketioManager {
                                   int sock, int netif_index,
                                   std::string* header, std::string* payload);
 
+  // Helper called by HandleKnetIntfPacketRx() in batched RX mode. Reads up to
+  // a full batch of messages from a socket with a single recvmmsg() call into
+  // the preallocated buffers of 'batch', and appends the accepted packets to
+  // 'packets'. Returns the number of messages read. Bad messages, including
+  // empty ones, are counted and skipped without dropping the rest of the
+  // batch. If any non-recoverable error is encountered, returns error.
+  ::util::StatusOr<int> RxPacketBatch(
+      GoogleConfig::BcmKnetIntfPurpose purpose, int sock, int netif_index,
+      KnetRxBatch* batch, std::vector<KnetRxPacket>* packets)
+      LOCKS_EXCLUDED(chassis_lock);
+
+  // Helper called by HandleKnetIntfPacketRx() in mmap ring mode. Reads the
+  // blocks of frames the kernel released on 'ring' and appends the accepted
+  // packets to 'packets'. Returns the number of frames read.
+  int RxPacketRing(GoogleConfig::BcmKnetIntfPurpose purpose, int netif_index,
+                   BcmKnetRing* ring, std::vector<KnetRxPacket>* packets)
+      LOCKS_EXCLUDED(chassis_lock);
+
+  // Validates a message of 'size' bytes read from the RX socket of a KNET
+  // interface into 'header_buffer' and 'payload_buffer', and copies the KNET
+  // header and the payload (with known VLAN tags stripped) to 'header' and
+  // 'payload'. Returns false if the message is not a valid packet.
+  bool ExtractRxPacket(GoogleConfig::BcmKnetIntfPurpose purpose,
+                       int netif_index, size_t size, int msg_flags,
+                       const struct sockaddr_ll& sa, const char* header_buffer,
+                       size_t header_size, const char* payload_buffer,
+                       std::string* header, std::string* payload);
+
+  // Parses the KNET header of a received packet, adds the corresponding
+  // metadata to 'packet' and saves the CoS the packet was received on in
+  // 'cos'. Returns false if the packet needs to be dropped.
+  bool ProcessRxPacket(GoogleConfig::BcmKnetIntfPurpose purpose,
+                       const std::string& header, ::p4::v1::PacketIn* packet,
+                       int* cos) SHARED_LOCKS_REQUIRED(chassis_lock);
+
+  // Called by HandleKnetIntfPacketRx() when RX CoS queueing is enabled. Moves
+  // the given packets to the queues of their CoS and accounts the enqueues and
+  // the drops in the RX stats.
+  void EnqueueRxPackets(GoogleConfig::BcmKnetIntfPurpose purpose,
+                        BcmRxCosQueues* rx_cos_queues,
+                        std::vector<KnetRxPacket>* packets)
+      LOCKS_EXCLUDED(rx_stats_lock_);
+
+  // Called in the context of the KNET interface RX dispatch thread, when RX
+  // CoS queueing is enabled. Includes a loop to take the packets out of the
+  // per-CoS queues in scheduling order and forward them to the registered
+  // callback (if any).
+  ::util::Status HandleKnetIntfPacketDispatch(
+      GoogleConfig::BcmKnetIntfPurpose purpose)
+      LOCKS_EXCLUDED(chassis_lock, rx_writer_lock_);
+
+  // Accounts a batch of 'num_packets' packets read in batched RX mode, out of
+  // which 'num_accepts' were accepted, in the RX stats.
+  void UpdateRxBatchStats(GoogleConfig::BcmKnetIntfPurpose purpose,
+                          int num_packets, int num_accepts,
+                          absl::Duration latency)
+      LOCKS_EXCLUDED(rx_stats_lock_);
+
   // Deparses the given PacketInMetadata to the a set of
   // P4 PacketMetadata protos in the given P4 PacketIn which
   // is then sent to the controller.
@@ -424,16 +594,36 @@ class BcmPacketioManager {
                                           ::p4::v1::PacketOut* packet);
 
   // Helper called by TransmitPacket() to send packet (KNET headers + payload).
-  ::util::Status TxPacket(GoogleConfig::BcmKnetIntfPurpose purpose, int sock,
-                          int vlan, int netif_index, bool direct_tx,
+  // In batched TX mode, the packet is put in the TX queue of the interface
+  // and sent later by the TX thread.
+  ::util::Status TxPacket(GoogleConfig::BcmKnetIntfPurpose purpose,
+                          const BcmKnetIntf& intf, bool direct_tx,
                           const std::string& header,
                           const std::string& payload);
 
+  // Called in the context of the KNET interface TX thread in batched TX mode.
+  // Includes a loop to take the packets out of the TX queue of the interface
+  // and send them in batches.
+  ::util::Status HandleKnetIntfPacketTx(
+      GoogleConfig::BcmKnetIntfPurpose purpose) LOCKS_EXCLUDED(chassis_lock);
+
+  // Helper called by HandleKnetIntfPacketTx() to send the first 'num_packets'
+  // packets of 'packets' with as few sendmmsg() calls as possible, using the
+  // preallocated buffers of 'batch'. Send errors are only accounted in the TX
+  // stats, as the callers of TransmitPacket() are gone by then.
+  void TxPacketBatch(GoogleConfig::BcmKnetIntfPurpose purpose, int sock,
+                     KnetTxBatch* batch,
+                     const std::vector<KnetTxPacket>& packets,
+                     size_t num_packets) LOCKS_EXCLUDED(tx_stats_lock_);
+
   // Parses the P4 PacketMetadata protos in the given P4 PacketOut and
   // fills in the given PacketOutMetadata proto, which is then used to transmit
-  // the packet (directly to a port or to ingress pipeline).
+  // the packet (directly to a port or to ingress pipeline). The result is
+  // cached, so that the packets sent with the same metadata are parsed only
+  // once.
   ::util::Status ParsePacketOutMetadata(const ::p4::v1::PacketOut& packet,
-                                        PacketOutMetadata* meta);
+                                        PacketOutMetadata* meta)
+      LOCKS_EXCLUDED(packet_out_metadata_cache_lock_);
 
   ::util::Status ParsePacketInMetadata(const ::p4::v1::PacketIn& packet,
                                        PacketInMetadata* meta);
@@ -441,6 +631,12 @@ class BcmPacketioManager {
   // KNET interface RX thread function.
   static void* KnetIntfRxThreadFunc(void* arg);
 
+  // KNET interface RX dispatch thread function.
+  static void* KnetIntfRxDispatchThreadFunc(void* arg);
+
+  // KNET interface TX thread function.
+  static void* KnetIntfTxThreadFunc(void* arg);
+
   // Determines the mode of operation:
   // - OPERATION_MODE_STANDALONE: when Stratum stack runs independently and
   // therefore needs to do all the SDK initialization itself.
@@ -460,6 +656,9 @@ class BcmPacketioManager {
   // Mutex lock for protecting the purpose_to_rx_stats_ map.
   mutable absl::Mutex rx_stats_lock_;
 
+  // Mutex lock for protecting the packet_out_metadata_cache_ map.
+  mutable absl::Mutex packet_out_metadata_cache_lock_;
+
   // Map from KNET interface purpose (specifying which application will use the
   // interface, e.g. controller, sflow, etc.) to the BcmKnetIntf instance
   // encapsulating the settings for that KNET interface. Each node can only
@@ -516,6 +715,15 @@ class BcmPacketioManager {
   std::map<GoogleConfig::BcmKnetIntfPurpose, BcmKnetRxStats>
       purpose_to_rx_stats_ GUARDED_BY(rx_stats_lock_);
 
+  // Map from the P4 PacketMetadata of a transmitted packet, serialized by
+  // PacketOutMetadataCacheKey(), to the PacketOutMetadata parsed from it. The
+  // controller sends most of its packets to a small set of ports, so this
+  // saves the P4TableMapper lookups for nearly all the packets. Cleared when
+  // it grows past FLAGS_knet_tx_metadata_cache_size entries and when a new
+  // forwarding pipeline config is pushed.
+  absl::flat_hash_map<std::string, PacketOutMetadata>
+      packet_out_metadata_cache_ GUARDED_BY(packet_out_metadata_cache_lock_);
+
   // Pointer to BcmChassisRoInterface class to get the most updated node & port
   // maps after the config is pushed.
   BcmChassisRoInterface* bcm_chassis_ro_interface_;  // not owned by this class.
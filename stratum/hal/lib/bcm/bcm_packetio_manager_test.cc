@@ -32,6 +32,12 @@
 #include "absl/memory/memory.h"
 #include "absl/strings/substitute.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+DECLARE_bool(knet_rx_batch_mode);
+DECLARE_bool(knet_tx_batch_mode);
+DECLARE_int32(knet_tx_metadata_cache_size);
 
 // #include "util/libcproxy/libcproxy.h"
 // #include "util/libcproxy/libcwrapper.h"
@@ -97,9 +103,17 @@ class LibcProxyMock : public PassthroughLibcProxy {
   ssize_t sendmsg(int sockfd, const struct msghdr* msg, int flags) override {
     return SendMsg(sockfd, msg, flags);
   }
+  int sendmmsg(int sockfd, struct mmsghdr* msgvec, unsigned int vlen,
+               int flags) override {
+    return SendMMsg(sockfd, msgvec, vlen, flags);
+  }
   ssize_t recvmsg(int sockfd, struct msghdr* msg, int flags) override {
     return RecvMsg(sockfd, msg, flags);
   }
+  int recvmmsg(int sockfd, struct mmsghdr* msgvec, unsigned int vlen,
+               int flags, struct timespec* timeout) override {
+    return RecvMMsg(sockfd, msgvec, vlen, flags);
+  }
   int epoll_create1(int flags) override { return EpollCreate1(flags); }
   int epoll_ctl(int efd, int op, int fd, struct epoll_event* event) override {
     return EpollCtl(efd, op, fd, event);
@@ -123,7 +137,11 @@ class LibcProxyMock : public PassthroughLibcProxy {
                          socklen_t addrlen));
   MOCK_METHOD3(SendMsg,
                ssize_t(int sockfd, const struct msghdr* msg, int flags));
+  MOCK_METHOD4(SendMMsg, int(int sockfd, struct mmsghdr* msgvec,
+                             unsigned int vlen, int flags));
   MOCK_METHOD3(RecvMsg, ssize_t(int sockfd, struct msghdr* msg, int flags));
+  MOCK_METHOD4(RecvMMsg, int(int sockfd, struct mmsghdr* msgvec,
+                             unsigned int vlen, int flags));
   MOCK_METHOD1(EpollCreate1, int(int flags));
   MOCK_METHOD4(EpollCtl,
                int(int efd, int op, int fd, struct epoll_event* event));
@@ -207,6 +225,14 @@ class BcmPacketioManagerTest : public ::testing::TestWithParam<OperationMode> {
       absl::WriterMutexLock l(&chassis_lock);
       shutdown = false;
     }
+    // The RX tests mock recvmsg(), except for the ones for batched RX mode.
+    FLAGS_knet_rx_batch_mode = false;
+    // The TX tests mock sendmsg(), except for the ones for batched TX mode.
+    FLAGS_knet_tx_batch_mode = false;
+    // The TX tests map the same metadata differently from one packet to the
+    // next, which the metadata cache does not expect. Only the tests for the
+    // cache enable it.
+    FLAGS_knet_tx_metadata_cache_size = 0;
   }
 
   ::util::Status PushChassisConfig(const ChassisConfig& config,
@@ -1124,6 +1150,36 @@ TEST_P(BcmPacketioManagerTest,
   ASSERT_OK(Shutdown());
 }
 
+TEST_P(BcmPacketioManagerTest,
+       PushChassisConfigFailureForInvalidRxCosQueueConfig) {
+  if (mode_ == OPERATION_MODE_SIM) return;  // no need to run in sim mode
+
+  ChassisConfig config;
+  ASSERT_OK(PopulateChassisConfigAndPortMaps(kNodeId1, &config, nullptr));
+  auto* knet_intf_config = config.mutable_vendor_config()
+                               ->mutable_google_config()
+                               ->mutable_node_id_to_knet_config()
+                               ->at(kNodeId1)
+                               .mutable_knet_intf_configs(0);
+  knet_intf_config->set_rx_cos_queueing(true);
+  (*knet_intf_config->mutable_rx_cos_queue_configs())[kMaxCos + 1].set_weight(
+      1);
+
+  // Expected calls to BcmSdkInterface. The config is rejected before any KNET
+  // interface is created.
+  EXPECT_CALL(*bcm_sdk_mock_, StartRx(kUnit1, _))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_sdk_mock_, StopRx(kUnit1))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_sdk_mock_, CreateKnetIntf(_, _, _, _)).Times(0);
+
+  ::util::Status status = PushChassisConfig(config, kNodeId1);
+  EXPECT_EQ(ERR_INVALID_PARAM, status.error_code());
+  EXPECT_THAT(status.error_message(), HasSubstr("Invalid CoS"));
+
+  ASSERT_OK(Shutdown());
+}
+
 TEST_P(BcmPacketioManagerTest,
        PushChassisConfigFailureForErrorInCreateKnetFilter) {
   if (mode_ == OPERATION_MODE_SIM) return;  // no need to run in sim mode
@@ -1387,8 +1443,9 @@ TEST_P(BcmPacketioManagerTest,
 }
 
 TEST_P(BcmPacketioManagerTest,
-       RegisterPacketReceiveWriterAndHandleReceiveErrors) {
+       RegisterPacketReceiveWriterAndReceivePacketBatch) {
   if (mode_ == OPERATION_MODE_SIM) return;  // no need to run in sim mode
+  FLAGS_knet_rx_batch_mode = true;
 
   //--------------------------------------------------------------
   // Config push
@@ -1441,52 +1498,60 @@ TEST_P(BcmPacketioManagerTest,
                               p[0].events = EPOLLIN;
                             })),
                             Return(1)));  // 1 means RX packet is available
-  EXPECT_CALL(*LibcProxyMock::Instance(), RecvMsg(kSocket1, _, _))
-      .WillRepeatedly(DoAll(WithArgs<1>(Invoke([](struct msghdr* msg) {
-                              // Any modification to msg goes here. Not needed
-                              // At the moment.
-                            })),
-                            Return(kTestKnetHeaderSize + kTestPacketBodySize)));
+  // Every read returns a batch of two packets.
+  constexpr size_t kPacketSize = kTestKnetHeaderSize + kTestPacketBodySize;
+  EXPECT_CALL(*LibcProxyMock::Instance(), RecvMMsg(kSocket1, _, _, _))
+      .WillRepeatedly(
+          DoAll(WithArgs<1, 2>(Invoke([](struct mmsghdr* msgs,
+                                         unsigned int vlen) {
+                  ASSERT_GE(vlen, 2U);
+                  for (int i = 0; i < 2; ++i) {
+                    memset(msgs[i].msg_hdr.msg_name, 0,
+                           msgs[i].msg_hdr.msg_namelen);
+                    msgs[i].msg_len = kPacketSize;
+                  }
+                })),
+                Return(2)));
 
   // BcmSdkInterface calls triggered by RX thread.
   EXPECT_CALL(*bcm_sdk_mock_, GetKnetHeaderSizeForRx(kUnit1))
       .WillRepeatedly(Return(kTestKnetHeaderSize));
 
-  // We expect the 4+ calls from ParseKnetHeaderForRx:
-  // 1- An error in parsing --. will increment rx_drops_knet_header_parse_error
-  // 2- Returns bad ingress port --> increments rx_drops_unknown_ingress_port
-  // 3- Returns bad egress port --> increments rx_drops_unknown_egress_port
-  // 4+- Return OK
   EXPECT_CALL(*bcm_sdk_mock_, ParseKnetHeaderForRx(kUnit1, _, _, _, _))
-      .WillOnce(Return(
-          ::util::Status(StratumErrorSpace(), ERR_HARDWARE_ERROR, "Blah")))
-      .WillOnce(DoAll(SetArgPointee<2>(kUnknownLogicalPort),
-                      SetArgPointee<3>(kCpuLogicalPort), SetArgPointee<4>(5),
-                      Return(::util::OkStatus())))
-      .WillOnce(DoAll(SetArgPointee<2>(kLogicalPort1),  // unknown
-                      SetArgPointee<3>(kUnknownLogicalPort),
-                      SetArgPointee<4>(5), Return(::util::OkStatus())))
       .WillRepeatedly(DoAll(SetArgPointee<2>(kLogicalPort1),
                             SetArgPointee<3>(kCpuLogicalPort),
                             SetArgPointee<4>(5), Return(::util::OkStatus())));
 
-  // We expect that all the calls to GetParentTrunkId fail due to port not
-  // being part of any trunk.
+  // BcmChassisRoInterface calls triggered by RX thread.
   EXPECT_CALL(*bcm_chassis_ro_mock_, GetParentTrunkId(kNodeId1, kPortId1))
-      .WillRepeatedly(Return(
-          ::util::Status(StratumErrorSpace(), ERR_INVALID_PARAM, "Blah")));
+      .WillRepeatedly(Return(kTrunkId1));
 
   // P4TableMapper calls triggered by RX thread.
-  // We expect the 4+ calls from ParseKnetHeaderForRx:
-  // 1-3- Returns OK. Corresponds to bad outputs from ParseKnetHeaderForRx.
-  // 4- Return error --> increments rx_drops_metadata_deparse_error
-  // 5+ - Returns OK
-  EXPECT_CALL(*p4_table_mapper_mock_, DeparsePacketInMetadata(_, _))
-      .WillOnce(Return(::util::OkStatus()))
-      .WillOnce(Return(::util::OkStatus()))
-      .WillOnce(Return(::util::OkStatus()))
-      .WillOnce(Return(
-          ::util::Status(StratumErrorSpace(), ERR_HARDWARE_ERROR, "Blah")))
+  MappedPacketMetadata mapped_packet_metadata1, mapped_packet_metadata2,
+      mapped_packet_metadata3;
+  mapped_packet_metadata1.set_type(P4_FIELD_TYPE_INGRESS_PORT);
+  mapped_packet_metadata1.set_u32(kPortId1);
+  mapped_packet_metadata2.set_type(P4_FIELD_TYPE_INGRESS_TRUNK);
+  mapped_packet_metadata2.set_u32(kTrunkId1);
+  mapped_packet_metadata3.set_type(P4_FIELD_TYPE_EGRESS_PORT);
+  mapped_packet_metadata3.set_u32(kCpuPortId);
+
+  EXPECT_CALL(*p4_table_mapper_mock_,
+              DeparsePacketInMetadata(EqualsProto(mapped_packet_metadata1), _))
+      .WillRepeatedly(
+          DoAll(WithArgs<1>(Invoke([](::p4::v1::PacketMetadata* m) {
+                  ParseProtoFromString(kTestPacketMetadata1, m).IgnoreError();
+                })),
+                Return(::util::OkStatus())));
+  EXPECT_CALL(*p4_table_mapper_mock_,
+              DeparsePacketInMetadata(EqualsProto(mapped_packet_metadata2), _))
+      .WillRepeatedly(
+          DoAll(WithArgs<1>(Invoke([](::p4::v1::PacketMetadata* m) {
+                  ParseProtoFromString(kTestPacketMetadata1, m).IgnoreError();
+                })),
+                Return(::util::OkStatus())));
+  EXPECT_CALL(*p4_table_mapper_mock_,
+              DeparsePacketInMetadata(EqualsProto(mapped_packet_metadata3), _))
       .WillRepeatedly(
           DoAll(WithArgs<1>(Invoke([](::p4::v1::PacketMetadata* m) {
                   ParseProtoFromString(kTestPacketMetadata1, m).IgnoreError();
@@ -1514,14 +1579,13 @@ TEST_P(BcmPacketioManagerTest,
   // We now wait until a few packets are sent to the receive handler.
   while (!RxComplete()) {
   }  // no sleep, check as fast as possible
+  // The batch stats are updated after the batch is forwarded to the writer.
+  while (true) {
+    auto ret = bcm_packetio_manager_->GetRxStats(
+        GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER);
+    if (ret.ok() && ret.ValueOrDie().rx_batches > 0) break;
+  }
 
-  // Based on the set of expections above, we will have the following situation:
-  // - The 1st RX will increment rx_drops_knet_header_parse_error
-  // - The 2nd RX will increment rx_drops_unknown_ingress_port
-  // - The 3rd RX will increment rx_drops_unknown_egress_port
-  // - The 4th RX will increment rx_drops_metadata_deparse_error
-  // - All other will increment rx_accepts.
-  // Also all RXs will increment all_rx as well.
   {
     SCOPED_TRACE(bcm_packetio_manager_->DumpStats());
     CheckNoTxStats();
@@ -1529,6 +1593,14 @@ TEST_P(BcmPacketioManagerTest,
                               all_rx);
     CHECK_NON_ZERO_RX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
                               rx_accepts);
+    CHECK_NON_ZERO_RX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                              rx_batches);
+    auto ret = bcm_packetio_manager_->GetRxStats(
+        GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER);
+    ASSERT_TRUE(ret.ok()) << ret.status();
+    EXPECT_EQ(2U, ret.ValueOrDie().rx_batch_max_size);
+    EXPECT_EQ(2 * ret.ValueOrDie().rx_batches,
+              ret.ValueOrDie().rx_batch_packets);
     CHECK_ZERO_RX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
                           rx_errors_epoll_wait_failures);
     CHECK_ZERO_RX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
@@ -1539,14 +1611,14 @@ TEST_P(BcmPacketioManagerTest,
                           rx_errors_incomplete_read);
     CHECK_ZERO_RX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
                           rx_errors_invalid_packet);
-    CHECK_NON_ZERO_RX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
-                              rx_drops_knet_header_parse_error);
-    CHECK_NON_ZERO_RX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
-                              rx_drops_metadata_deparse_error);
-    CHECK_NON_ZERO_RX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
-                              rx_drops_unknown_ingress_port);
-    CHECK_NON_ZERO_RX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
-                              rx_drops_unknown_egress_port);
+    CHECK_ZERO_RX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                          rx_drops_knet_header_parse_error);
+    CHECK_ZERO_RX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                          rx_drops_metadata_deparse_error);
+    CHECK_ZERO_RX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                          rx_drops_unknown_ingress_port);
+    CHECK_ZERO_RX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                          rx_drops_unknown_egress_port);
   }
 
   //--------------------------------------------------------------
@@ -1579,27 +1651,10 @@ TEST_P(BcmPacketioManagerTest,
   }
 }
 
-TEST_P(BcmPacketioManagerTest, TransmitPacketBeforeChassisConfigPush) {
-  ::p4::v1::PacketOut packet;
-
-  ::util::Status status =
-      TransmitPacket(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER, packet);
-  ASSERT_FALSE(status.ok());
-  EXPECT_EQ(ERR_INVALID_PARAM, status.error_code());
-  EXPECT_THAT(
-      status.error_message(),
-      HasSubstr("KNET interface with purpose BCM_KNET_INTF_PURPOSE_CONTROLLER "
-                "does not exist for node with ID"));
-
-  {
-    SCOPED_TRACE(bcm_packetio_manager_->DumpStats());
-    CheckNoTxStats();
-    CheckNoRxStats();
-  }
-}
-
-TEST_P(BcmPacketioManagerTest, TransmitPacketAfterChassisConfigPush) {
+TEST_P(BcmPacketioManagerTest,
+       RegisterPacketReceiveWriterAndSkipEmptyMessageInBatch) {
   if (mode_ == OPERATION_MODE_SIM) return;  // no need to run in sim mode
+  FLAGS_knet_rx_batch_mode = true;
 
   //--------------------------------------------------------------
   // Config push
@@ -1641,84 +1696,507 @@ TEST_P(BcmPacketioManagerTest, TransmitPacketAfterChassisConfigPush) {
   EXPECT_CALL(*bcm_sdk_mock_, CreateKnetFilter(kUnit1, _, kFilterTypeCatchAll))
       .WillOnce(Return(kCatchAllFilterId1));
 
-  // Possible libc calls (triggered only if in the RX thread is spawned).
+  // libc calls triggered by RX thread.
   EXPECT_CALL(*LibcProxyMock::Instance(), EpollCreate1(0))
       .WillRepeatedly(Return(kEfd));
   EXPECT_CALL(*LibcProxyMock::Instance(),
               EpollCtl(kEfd, EPOLL_CTL_ADD, kSocket1, _))
       .WillRepeatedly(Return(0));
   EXPECT_CALL(*LibcProxyMock::Instance(), EpollWait(kEfd, _, 1, _))
-      .WillRepeatedly(Return(0));  // 0 means no packet
+      .WillRepeatedly(DoAll(WithArgs<1>(Invoke([](struct epoll_event* p) {
+                              p[0].events = EPOLLIN;
+                            })),
+                            Return(1)));  // 1 means RX packet is available
+  // Every read returns a batch of three messages, with an empty one in the
+  // middle. The two packets around it must still be delivered.
+  constexpr size_t kPacketSize = kTestKnetHeaderSize + kTestPacketBodySize;
+  EXPECT_CALL(*LibcProxyMock::Instance(), RecvMMsg(kSocket1, _, _, _))
+      .WillRepeatedly(
+          DoAll(WithArgs<1, 2>(Invoke([](struct mmsghdr* msgs,
+                                         unsigned int vlen) {
+                  ASSERT_GE(vlen, 3U);
+                  for (int i = 0; i < 3; ++i) {
+                    memset(msgs[i].msg_hdr.msg_name, 0,
+                           msgs[i].msg_hdr.msg_namelen);
+                    msgs[i].msg_len = (i == 1 ? 0 : kPacketSize);
+                  }
+                })),
+                Return(3)));
 
-  // Call PushChassisConfig to initialize the class.
-  ASSERT_OK(PushChassisConfig(config, kNodeId1));
+  // BcmSdkInterface calls triggered by RX thread.
+  EXPECT_CALL(*bcm_sdk_mock_, GetKnetHeaderSizeForRx(kUnit1))
+      .WillRepeatedly(Return(kTestKnetHeaderSize));
 
-  //--------------------------------------------------------------
-  // Packet TX
-  //--------------------------------------------------------------
-  ::p4::v1::PacketOut packet;
+  EXPECT_CALL(*bcm_sdk_mock_, ParseKnetHeaderForRx(kUnit1, _, _, _, _))
+      .WillRepeatedly(DoAll(SetArgPointee<2>(kLogicalPort1),
+                            SetArgPointee<3>(kCpuLogicalPort),
+                            SetArgPointee<4>(5), Return(::util::OkStatus())));
 
-  // 1- A packet with bad (unknown) port and some unknown meta (discarded).
-  packet.set_payload(std::string(kTestPacket, sizeof(kTestPacket)));
-  ASSERT_OK(ParseProtoFromString(kTestPacketMetadata1, packet.add_metadata()));
-  ASSERT_OK(ParseProtoFromString(kTestPacketMetadata2, packet.add_metadata()));
+  // BcmChassisRoInterface calls triggered by RX thread.
+  EXPECT_CALL(*bcm_chassis_ro_mock_, GetParentTrunkId(kNodeId1, kPortId1))
+      .WillRepeatedly(Return(kTrunkId1));
+
+  // P4TableMapper calls triggered by RX thread.
+  MappedPacketMetadata mapped_packet_metadata1, mapped_packet_metadata2,
+      mapped_packet_metadata3;
+  mapped_packet_metadata1.set_type(P4_FIELD_TYPE_INGRESS_PORT);
+  mapped_packet_metadata1.set_u32(kPortId1);
+  mapped_packet_metadata2.set_type(P4_FIELD_TYPE_INGRESS_TRUNK);
+  mapped_packet_metadata2.set_u32(kTrunkId1);
+  mapped_packet_metadata3.set_type(P4_FIELD_TYPE_EGRESS_PORT);
+  mapped_packet_metadata3.set_u32(kCpuPortId);
 
   EXPECT_CALL(*p4_table_mapper_mock_,
-              ParsePacketOutMetadata(EqualsProto(packet.metadata(0)), _))
-      .WillOnce(DoAll(WithArgs<1>(Invoke([](MappedPacketMetadata* x) {
-                        x->set_type(P4_FIELD_TYPE_EGRESS_PORT);
-                        x->set_u32(9999);
-                      })),
-                      Return(::util::OkStatus())));
+              DeparsePacketInMetadata(EqualsProto(mapped_packet_metadata1), _))
+      .WillRepeatedly(
+          DoAll(WithArgs<1>(Invoke([](::p4::v1::PacketMetadata* m) {
+                  ParseProtoFromString(kTestPacketMetadata1, m).IgnoreError();
+                })),
+                Return(::util::OkStatus())));
   EXPECT_CALL(*p4_table_mapper_mock_,
-              ParsePacketOutMetadata(EqualsProto(packet.metadata(1)), _))
-      .WillOnce(DoAll(WithArgs<1>(Invoke([](MappedPacketMetadata* x) {
-                        x->set_type(P4_FIELD_TYPE_VRF);  // unknown meta
-                      })),
-                      Return(::util::OkStatus())));
-  EXPECT_CALL(*bcm_chassis_ro_mock_, GetPortState(kNodeId1, 9999))
-      .WillOnce(Return(PORT_STATE_UP));
+              DeparsePacketInMetadata(EqualsProto(mapped_packet_metadata2), _))
+      .WillRepeatedly(
+          DoAll(WithArgs<1>(Invoke([](::p4::v1::PacketMetadata* m) {
+                  ParseProtoFromString(kTestPacketMetadata1, m).IgnoreError();
+                })),
+                Return(::util::OkStatus())));
+  EXPECT_CALL(*p4_table_mapper_mock_,
+              DeparsePacketInMetadata(EqualsProto(mapped_packet_metadata3), _))
+      .WillRepeatedly(
+          DoAll(WithArgs<1>(Invoke([](::p4::v1::PacketMetadata* m) {
+                  ParseProtoFromString(kTestPacketMetadata1, m).IgnoreError();
+                })),
+                Return(::util::OkStatus())));
 
-  ::util::Status status =
-      TransmitPacket(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER, packet);
-  ASSERT_FALSE(status.ok());
-  EXPECT_EQ(ERR_INVALID_PARAM, status.error_code());
-  EXPECT_THAT(status.error_message(), HasSubstr("Port ID 9999 not found"));
+  // Call PushChassisConfig to initialize the class. The RX thread will be
+  // initialized as part of config push.
+  ASSERT_OK(PushChassisConfig(config, kNodeId1));
 
-  {
-    SCOPED_TRACE(bcm_packetio_manager_->DumpStats());
-    CheckNoRxStats();
-    CHECK_NON_ZERO_TX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
-                              all_tx);
-    CHECK_ZERO_TX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
-                          tx_accepts_ingress_pipeline);
-    CHECK_ZERO_TX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
-                          tx_accepts_direct);
-    CHECK_ZERO_TX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
-                          tx_errors_internal_send_failures);
-    CHECK_ZERO_TX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
-                          tx_errors_incomplete_send);
-    CHECK_ZERO_TX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
-                          tx_drops_metadata_parse_error);
-    CHECK_NON_ZERO_TX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
-                              tx_drops_unknown_port);
-    CHECK_ZERO_TX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
-                          tx_drops_down_port);
-    CHECK_ZERO_TX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
-                          tx_drops_down_trunk);
-  }
+  //--------------------------------------------------------------
+  // Register packet receive handler
+  //--------------------------------------------------------------
+  auto writer = std::make_shared<WriterMock<::p4::v1::PacketIn>>();
+  EXPECT_CALL(*writer, Write(_))
+      .WillOnce(DoAll(InvokeWithoutArgs([this] {
+                        absl::WriterMutexLock l(&rx_lock_);
+                        rx_complete_ = true;
+                      }),
+                      Return(true)))
+      .WillRepeatedly(Return(false));
+  ASSERT_OK(RegisterPacketReceiveWriter(
+      GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER, writer));
 
-  // 2- A packet with one metadata field poiting to a down port.
-  packet.clear_metadata();
-  ASSERT_OK(ParseProtoFromString(kTestPacketMetadata1, packet.add_metadata()));
+  // We now wait until a few packets are sent to the receive handler.
+  while (!RxComplete()) {
+  }  // no sleep, check as fast as possible
+  // The batch stats are updated after the batch is forwarded to the writer.
+  // Waiting for a second batch also shows the RX thread keeps running after
+  // reading an empty message.
+  while (true) {
+    auto ret = bcm_packetio_manager_->GetRxStats(
+        GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER);
+    if (ret.ok() && ret.ValueOrDie().rx_batches > 1) break;
+  }
 
-  EXPECT_CALL(*p4_table_mapper_mock_,
-              ParsePacketOutMetadata(EqualsProto(packet.metadata(0)), _))
-      .WillOnce(DoAll(WithArgs<1>(Invoke([](MappedPacketMetadata* x) {
-                        x->set_type(P4_FIELD_TYPE_EGRESS_PORT);
-                        x->set_u32(kPortId1);
-                      })),
-                      Return(::util::OkStatus())));
+  {
+    SCOPED_TRACE(bcm_packetio_manager_->DumpStats());
+    CheckNoTxStats();
+    CHECK_NON_ZERO_RX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                              all_rx);
+    CHECK_NON_ZERO_RX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                              rx_accepts);
+    CHECK_NON_ZERO_RX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                              rx_batches);
+    auto ret = bcm_packetio_manager_->GetRxStats(
+        GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER);
+    ASSERT_TRUE(ret.ok()) << ret.status();
+    EXPECT_EQ(3U, ret.ValueOrDie().rx_batch_max_size);
+    EXPECT_EQ(3 * ret.ValueOrDie().rx_batches,
+              ret.ValueOrDie().rx_batch_packets);
+    EXPECT_EQ(2 * ret.ValueOrDie().rx_batches, ret.ValueOrDie().rx_accepts);
+    EXPECT_LE(ret.ValueOrDie().rx_batches,
+              ret.ValueOrDie().rx_errors_sock_shutdown);
+    CHECK_ZERO_RX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                          rx_errors_epoll_wait_failures);
+    CHECK_ZERO_RX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                          rx_errors_internal_read_failures);
+    CHECK_ZERO_RX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                          rx_errors_incomplete_read);
+    CHECK_ZERO_RX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                          rx_errors_invalid_packet);
+    CHECK_ZERO_RX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                          rx_drops_knet_header_parse_error);
+    CHECK_ZERO_RX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                          rx_drops_metadata_deparse_error);
+    CHECK_ZERO_RX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                          rx_drops_unknown_ingress_port);
+    CHECK_ZERO_RX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                          rx_drops_unknown_egress_port);
+  }
+
+  //--------------------------------------------------------------
+  // Shutdown
+  //--------------------------------------------------------------
+
+  // Expected libc calls for shutdown.
+  EXPECT_CALL(*LibcProxyMock::Instance(), Close(kSocket1))
+      .Times(2)
+      .WillRepeatedly(Return(0));
+
+  // Expected calls to BcmSdkInterface for shutdown.
+  EXPECT_CALL(*bcm_sdk_mock_, StopRx(kUnit1))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_sdk_mock_, DestroyKnetFilter(kUnit1, kCatchAllFilterId1))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_sdk_mock_, DestroyKnetIntf(kUnit1, kNetifId))
+      .WillOnce(Return(::util::OkStatus()));
+
+  // libc calls triggered by RX thread.
+  EXPECT_CALL(*LibcProxyMock::Instance(), Close(kEfd))
+      .WillRepeatedly(Return(0));
+
+  ASSERT_OK(Shutdown());
+
+  {
+    SCOPED_TRACE(bcm_packetio_manager_->DumpStats());
+    CheckNoTxStats();
+    CheckNoRxStats();
+  }
+}
+
+TEST_P(BcmPacketioManagerTest,
+       RegisterPacketReceiveWriterAndHandleReceiveErrors) {
+  if (mode_ == OPERATION_MODE_SIM) return;  // no need to run in sim mode
+
+  //--------------------------------------------------------------
+  // Config push
+  //--------------------------------------------------------------
+
+  ChassisConfig config;
+  std::map<uint32, SdkPort> port_id_to_sdk_port = {};
+  ASSERT_OK(PopulateChassisConfigAndPortMaps(kNodeId1, &config,
+                                             &port_id_to_sdk_port));
+  config.clear_vendor_config();  // default config
+
+  // Expected calls to BcmChassisManager for first config push.
+  EXPECT_CALL(*bcm_chassis_ro_mock_, GetPortIdToSdkPortMap(kNodeId1))
+      .WillOnce(Return(port_id_to_sdk_port));
+
+  // Track the socket FDs;
+  LibcProxyMock::Instance()->TrackFds({kSocket1, kEfd});
+
+  // Expected libc calls for config push.
+  EXPECT_CALL(*LibcProxyMock::Instance(), Socket(_, _, _))
+      .Times(3)
+      .WillRepeatedly(Return(kSocket1));
+  EXPECT_CALL(*LibcProxyMock::Instance(), Ioctl(kSocket1, _, _))
+      .Times(5)
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*LibcProxyMock::Instance(), Close(kSocket1)).WillOnce(Return(0));
+  EXPECT_CALL(*LibcProxyMock::Instance(), SetSockOpt(kSocket1, _, _, _, _))
+      .Times(2)
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*LibcProxyMock::Instance(), Bind(kSocket1, _, _))
+      .WillOnce(Return(0));
+
+  // Expected calls to BcmSdkInterface for config push.
+  EXPECT_CALL(*bcm_sdk_mock_, StartRx(kUnit1, _))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_sdk_mock_, CreateKnetIntf(kUnit1, kDefaultVlan, _, _))
+      .WillRepeatedly(
+          DoAll(SetArgPointee<3>(kNetifId), Return(::util::OkStatus())));
+  EXPECT_CALL(*bcm_sdk_mock_, CreateKnetFilter(kUnit1, _, kFilterTypeCatchAll))
+      .WillOnce(Return(kCatchAllFilterId1));
+
+  // libc calls triggered by RX thread.
+  EXPECT_CALL(*LibcProxyMock::Instance(), EpollCreate1(0))
+      .WillRepeatedly(Return(kEfd));
+  EXPECT_CALL(*LibcProxyMock::Instance(),
+              EpollCtl(kEfd, EPOLL_CTL_ADD, kSocket1, _))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*LibcProxyMock::Instance(), EpollWait(kEfd, _, 1, _))
+      .WillRepeatedly(DoAll(WithArgs<1>(Invoke([](struct epoll_event* p) {
+                              p[0].events = EPOLLIN;
+                            })),
+                            Return(1)));  // 1 means RX packet is available
+  EXPECT_CALL(*LibcProxyMock::Instance(), RecvMsg(kSocket1, _, _))
+      .WillRepeatedly(DoAll(WithArgs<1>(Invoke([](struct msghdr* msg) {
+                              // Any modification to msg goes here. Not needed
+                              // At the moment.
+                            })),
+                            Return(kTestKnetHeaderSize + kTestPacketBodySize)));
+
+  // BcmSdkInterface calls triggered by RX thread.
+  EXPECT_CALL(*bcm_sdk_mock_, GetKnetHeaderSizeForRx(kUnit1))
+      .WillRepeatedly(Return(kTestKnetHeaderSize));
+
+  // We expect the 4+ calls from ParseKnetHeaderForRx:
+  // 1- An error in parsing --. will increment rx_drops_knet_header_parse_error
+  // 2- Returns bad ingress port --> increments rx_drops_unknown_ingress_port
+  // 3- Returns bad egress port --> increments rx_drops_unknown_egress_port
+  // 4+- Return OK
+  EXPECT_CALL(*bcm_sdk_mock_, ParseKnetHeaderForRx(kUnit1, _, _, _, _))
+      .WillOnce(Return(
+          ::util::Status(StratumErrorSpace(), ERR_HARDWARE_ERROR, "Blah")))
+      .WillOnce(DoAll(SetArgPointee<2>(kUnknownLogicalPort),
+                      SetArgPointee<3>(kCpuLogicalPort), SetArgPointee<4>(5),
+                      Return(::util::OkStatus())))
+      .WillOnce(DoAll(SetArgPointee<2>(kLogicalPort1),  // unknown
+                      SetArgPointee<3>(kUnknownLogicalPort),
+                      SetArgPointee<4>(5), Return(::util::OkStatus())))
+      .WillRepeatedly(DoAll(SetArgPointee<2>(kLogicalPort1),
+                            SetArgPointee<3>(kCpuLogicalPort),
+                            SetArgPointee<4>(5), Return(::util::OkStatus())));
+
+  // We expect that all the calls to GetParentTrunkId fail due to port not
+  // being part of any trunk.
+  EXPECT_CALL(*bcm_chassis_ro_mock_, GetParentTrunkId(kNodeId1, kPortId1))
+      .WillRepeatedly(Return(
+          ::util::Status(StratumErrorSpace(), ERR_INVALID_PARAM, "Blah")));
+
+  // P4TableMapper calls triggered by RX thread.
+  // We expect the 4+ calls from ParseKnetHeaderForRx:
+  // 1-3- Returns OK. Corresponds to bad outputs from ParseKnetHeaderForRx.
+  // 4- Return error --> increments rx_drops_metadata_deparse_error
+  // 5+ - Returns OK
+  EXPECT_CALL(*p4_table_mapper_mock_, DeparsePacketInMetadata(_, _))
+      .WillOnce(Return(::util::OkStatus()))
+      .WillOnce(Return(::util::OkStatus()))
+      .WillOnce(Return(::util::OkStatus()))
+      .WillOnce(Return(
+          ::util::Status(StratumErrorSpace(), ERR_HARDWARE_ERROR, "Blah")))
+      .WillRepeatedly(
+          DoAll(WithArgs<1>(Invoke([](::p4::v1::PacketMetadata* m) {
+                  ParseProtoFromString(kTestPacketMetadata1, m).IgnoreError();
+                })),
+                Return(::util::OkStatus())));
+
+  // Call PushChassisConfig to initialize the class. The RX thread will be
+  // initialized as part of config push.
+  ASSERT_OK(PushChassisConfig(config, kNodeId1));
+
+  //--------------------------------------------------------------
+  // Register packet receive handler
+  //--------------------------------------------------------------
+  auto writer = std::make_shared<WriterMock<::p4::v1::PacketIn>>();
+  EXPECT_CALL(*writer, Write(_))
+      .WillOnce(DoAll(InvokeWithoutArgs([this] {
+                        absl::WriterMutexLock l(&rx_lock_);
+                        rx_complete_ = true;
+                      }),
+                      Return(true)))
+      .WillRepeatedly(Return(false));
+  ASSERT_OK(RegisterPacketReceiveWriter(
+      GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER, writer));
+
+  // We now wait until a few packets are sent to the receive handler.
+  while (!RxComplete()) {
+  }  // no sleep, check as fast as possible
+
+  // Based on the set of expections above, we will have the following situation:
+  // - The 1st RX will increment rx_drops_knet_header_parse_error
+  // - The 2nd RX will increment rx_drops_unknown_ingress_port
+  // - The 3rd RX will increment rx_drops_unknown_egress_port
+  // - The 4th RX will increment rx_drops_metadata_deparse_error
+  // - All other will increment rx_accepts.
+  // Also all RXs will increment all_rx as well.
+  {
+    SCOPED_TRACE(bcm_packetio_manager_->DumpStats());
+    CheckNoTxStats();
+    CHECK_NON_ZERO_RX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                              all_rx);
+    CHECK_NON_ZERO_RX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                              rx_accepts);
+    CHECK_ZERO_RX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                          rx_errors_epoll_wait_failures);
+    CHECK_ZERO_RX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                          rx_errors_internal_read_failures);
+    CHECK_ZERO_RX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                          rx_errors_sock_shutdown);
+    CHECK_ZERO_RX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                          rx_errors_incomplete_read);
+    CHECK_ZERO_RX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                          rx_errors_invalid_packet);
+    CHECK_NON_ZERO_RX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                              rx_drops_knet_header_parse_error);
+    CHECK_NON_ZERO_RX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                              rx_drops_metadata_deparse_error);
+    CHECK_NON_ZERO_RX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                              rx_drops_unknown_ingress_port);
+    CHECK_NON_ZERO_RX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                              rx_drops_unknown_egress_port);
+  }
+
+  //--------------------------------------------------------------
+  // Shutdown
+  //--------------------------------------------------------------
+
+  // Expected libc calls for shutdown.
+  EXPECT_CALL(*LibcProxyMock::Instance(), Close(kSocket1))
+      .Times(2)
+      .WillRepeatedly(Return(0));
+
+  // Expected calls to BcmSdkInterface for shutdown.
+  EXPECT_CALL(*bcm_sdk_mock_, StopRx(kUnit1))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_sdk_mock_, DestroyKnetFilter(kUnit1, kCatchAllFilterId1))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_sdk_mock_, DestroyKnetIntf(kUnit1, kNetifId))
+      .WillOnce(Return(::util::OkStatus()));
+
+  // libc calls triggered by RX thread.
+  EXPECT_CALL(*LibcProxyMock::Instance(), Close(kEfd))
+      .WillRepeatedly(Return(0));
+
+  ASSERT_OK(Shutdown());
+
+  {
+    SCOPED_TRACE(bcm_packetio_manager_->DumpStats());
+    CheckNoTxStats();
+    CheckNoRxStats();
+  }
+}
+
+TEST_P(BcmPacketioManagerTest, TransmitPacketBeforeChassisConfigPush) {
+  ::p4::v1::PacketOut packet;
+
+  ::util::Status status =
+      TransmitPacket(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER, packet);
+  ASSERT_FALSE(status.ok());
+  EXPECT_EQ(ERR_INVALID_PARAM, status.error_code());
+  EXPECT_THAT(
+      status.error_message(),
+      HasSubstr("KNET interface with purpose BCM_KNET_INTF_PURPOSE_CONTROLLER "
+                "does not exist for node with ID"));
+
+  {
+    SCOPED_TRACE(bcm_packetio_manager_->DumpStats());
+    CheckNoTxStats();
+    CheckNoRxStats();
+  }
+}
+
+TEST_P(BcmPacketioManagerTest, TransmitPacketAfterChassisConfigPush) {
+  if (mode_ == OPERATION_MODE_SIM) return;  // no need to run in sim mode
+
+  //--------------------------------------------------------------
+  // Config push
+  //--------------------------------------------------------------
+
+  ChassisConfig config;
+  std::map<uint32, SdkPort> port_id_to_sdk_port = {};
+  ASSERT_OK(PopulateChassisConfigAndPortMaps(kNodeId1, &config,
+                                             &port_id_to_sdk_port));
+  config.clear_vendor_config();  // default config
+
+  // Expected calls to BcmChassisManager for first config push.
+  EXPECT_CALL(*bcm_chassis_ro_mock_, GetPortIdToSdkPortMap(kNodeId1))
+      .WillOnce(Return(port_id_to_sdk_port));
+
+  // Track the socket FDs;
+  LibcProxyMock::Instance()->TrackFds({kSocket1, kEfd});
+
+  // Expected libc calls for config push.
+  EXPECT_CALL(*LibcProxyMock::Instance(), Socket(_, _, _))
+      .Times(3)
+      .WillRepeatedly(Return(kSocket1));
+  EXPECT_CALL(*LibcProxyMock::Instance(), Ioctl(kSocket1, _, _))
+      .Times(5)
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*LibcProxyMock::Instance(), Close(kSocket1)).WillOnce(Return(0));
+  EXPECT_CALL(*LibcProxyMock::Instance(), SetSockOpt(kSocket1, _, _, _, _))
+      .Times(2)
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*LibcProxyMock::Instance(), Bind(kSocket1, _, _))
+      .WillOnce(Return(0));
+
+  // Expected calls to BcmSdkInterface for config push.
+  EXPECT_CALL(*bcm_sdk_mock_, StartRx(kUnit1, _))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_sdk_mock_, CreateKnetIntf(kUnit1, kDefaultVlan, _, _))
+      .WillRepeatedly(
+          DoAll(SetArgPointee<3>(kNetifId), Return(::util::OkStatus())));
+  EXPECT_CALL(*bcm_sdk_mock_, CreateKnetFilter(kUnit1, _, kFilterTypeCatchAll))
+      .WillOnce(Return(kCatchAllFilterId1));
+
+  // Possible libc calls (triggered only if in the RX thread is spawned).
+  EXPECT_CALL(*LibcProxyMock::Instance(), EpollCreate1(0))
+      .WillRepeatedly(Return(kEfd));
+  EXPECT_CALL(*LibcProxyMock::Instance(),
+              EpollCtl(kEfd, EPOLL_CTL_ADD, kSocket1, _))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*LibcProxyMock::Instance(), EpollWait(kEfd, _, 1, _))
+      .WillRepeatedly(Return(0));  // 0 means no packet
+
+  // Call PushChassisConfig to initialize the class.
+  ASSERT_OK(PushChassisConfig(config, kNodeId1));
+
+  //--------------------------------------------------------------
+  // Packet TX
+  //--------------------------------------------------------------
+  ::p4::v1::PacketOut packet;
+
+  // 1- A packet with bad (unknown) port and some unknown meta (discarded).
+  packet.set_payload(std::string(kTestPacket, sizeof(kTestPacket)));
+  ASSERT_OK(ParseProtoFromString(kTestPacketMetadata1, packet.add_metadata()));
+  ASSERT_OK(ParseProtoFromString(kTestPacketMetadata2, packet.add_metadata()));
+
+  EXPECT_CALL(*p4_table_mapper_mock_,
+              ParsePacketOutMetadata(EqualsProto(packet.metadata(0)), _))
+      .WillOnce(DoAll(WithArgs<1>(Invoke([](MappedPacketMetadata* x) {
+                        x->set_type(P4_FIELD_TYPE_EGRESS_PORT);
+                        x->set_u32(9999);
+                      })),
+                      Return(::util::OkStatus())));
+  EXPECT_CALL(*p4_table_mapper_mock_,
+              ParsePacketOutMetadata(EqualsProto(packet.metadata(1)), _))
+      .WillOnce(DoAll(WithArgs<1>(Invoke([](MappedPacketMetadata* x) {
+                        x->set_type(P4_FIELD_TYPE_VRF);  // unknown meta
+                      })),
+                      Return(::util::OkStatus())));
+  EXPECT_CALL(*bcm_chassis_ro_mock_, GetPortState(kNodeId1, 9999))
+      .WillOnce(Return(PORT_STATE_UP));
+
+  ::util::Status status =
+      TransmitPacket(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER, packet);
+  ASSERT_FALSE(status.ok());
+  EXPECT_EQ(ERR_INVALID_PARAM, status.error_code());
+  EXPECT_THAT(status.error_message(), HasSubstr("Port ID 9999 not found"));
+
+  {
+    SCOPED_TRACE(bcm_packetio_manager_->DumpStats());
+    CheckNoRxStats();
+    CHECK_NON_ZERO_TX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                              all_tx);
+    CHECK_ZERO_TX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                          tx_accepts_ingress_pipeline);
+    CHECK_ZERO_TX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                          tx_accepts_direct);
+    CHECK_ZERO_TX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                          tx_errors_internal_send_failures);
+    CHECK_ZERO_TX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                          tx_errors_incomplete_send);
+    CHECK_ZERO_TX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                          tx_drops_metadata_parse_error);
+    CHECK_NON_ZERO_TX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                              tx_drops_unknown_port);
+    CHECK_ZERO_TX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                          tx_drops_down_port);
+    CHECK_ZERO_TX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                          tx_drops_down_trunk);
+  }
+
+  // 2- A packet with one metadata field poiting to a down port.
+  packet.clear_metadata();
+  ASSERT_OK(ParseProtoFromString(kTestPacketMetadata1, packet.add_metadata()));
+
+  EXPECT_CALL(*p4_table_mapper_mock_,
+              ParsePacketOutMetadata(EqualsProto(packet.metadata(0)), _))
+      .WillOnce(DoAll(WithArgs<1>(Invoke([](MappedPacketMetadata* x) {
+                        x->set_type(P4_FIELD_TYPE_EGRESS_PORT);
+                        x->set_u32(kPortId1);
+                      })),
+                      Return(::util::OkStatus())));
   EXPECT_CALL(*bcm_chassis_ro_mock_, GetPortState(kNodeId1, kPortId1))
       .WillOnce(Return(PORT_STATE_DOWN));
 
@@ -1942,6 +2420,267 @@ TEST_P(BcmPacketioManagerTest, TransmitPacketAfterChassisConfigPush) {
   }
 }
 
+TEST_P(BcmPacketioManagerTest, TransmitPacketUsesMetadataCache) {
+  if (mode_ == OPERATION_MODE_SIM) return;  // no need to run in sim mode
+  FLAGS_knet_tx_metadata_cache_size = 16;
+
+  //--------------------------------------------------------------
+  // Config push
+  //--------------------------------------------------------------
+
+  ChassisConfig config;
+  std::map<uint32, SdkPort> port_id_to_sdk_port = {};
+  ASSERT_OK(PopulateChassisConfigAndPortMaps(kNodeId1, &config,
+                                             &port_id_to_sdk_port));
+  config.clear_vendor_config();  // default config
+
+  // Expected calls to BcmChassisManager for first config push.
+  EXPECT_CALL(*bcm_chassis_ro_mock_, GetPortIdToSdkPortMap(kNodeId1))
+      .WillOnce(Return(port_id_to_sdk_port));
+
+  // Track the socket FDs;
+  LibcProxyMock::Instance()->TrackFds({kSocket1, kEfd});
+
+  // Expected libc calls for config push.
+  EXPECT_CALL(*LibcProxyMock::Instance(), Socket(_, _, _))
+      .Times(3)
+      .WillRepeatedly(Return(kSocket1));
+  EXPECT_CALL(*LibcProxyMock::Instance(), Ioctl(kSocket1, _, _))
+      .Times(5)
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*LibcProxyMock::Instance(), Close(kSocket1)).WillOnce(Return(0));
+  EXPECT_CALL(*LibcProxyMock::Instance(), SetSockOpt(kSocket1, _, _, _, _))
+      .Times(2)
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*LibcProxyMock::Instance(), Bind(kSocket1, _, _))
+      .WillOnce(Return(0));
+
+  // Expected calls to BcmSdkInterface for config push.
+  EXPECT_CALL(*bcm_sdk_mock_, StartRx(kUnit1, _))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_sdk_mock_, CreateKnetIntf(kUnit1, kDefaultVlan, _, _))
+      .WillRepeatedly(
+          DoAll(SetArgPointee<3>(kNetifId), Return(::util::OkStatus())));
+  EXPECT_CALL(*bcm_sdk_mock_, CreateKnetFilter(kUnit1, _, kFilterTypeCatchAll))
+      .WillOnce(Return(kCatchAllFilterId1));
+
+  // Possible libc calls (triggered only if in the RX thread is spawned).
+  EXPECT_CALL(*LibcProxyMock::Instance(), EpollCreate1(0))
+      .WillRepeatedly(Return(kEfd));
+  EXPECT_CALL(*LibcProxyMock::Instance(),
+              EpollCtl(kEfd, EPOLL_CTL_ADD, kSocket1, _))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*LibcProxyMock::Instance(), EpollWait(kEfd, _, 1, _))
+      .WillRepeatedly(Return(0));  // 0 means no packet
+
+  // Call PushChassisConfig to initialize the class.
+  ASSERT_OK(PushChassisConfig(config, kNodeId1));
+
+  //--------------------------------------------------------------
+  // Packet TX
+  //--------------------------------------------------------------
+  ::p4::v1::PacketOut packet;
+  packet.set_payload(std::string(kTestPacket, sizeof(kTestPacket)));
+  ASSERT_OK(ParseProtoFromString(kTestPacketMetadata1, packet.add_metadata()));
+
+  // The metadata is parsed for the first packet only. The next ones use the
+  // cached result, until a new pipeline config is pushed.
+  EXPECT_CALL(*p4_table_mapper_mock_,
+              ParsePacketOutMetadata(EqualsProto(packet.metadata(0)), _))
+      .Times(2)
+      .WillRepeatedly(DoAll(WithArgs<1>(Invoke([](MappedPacketMetadata* x) {
+                              x->set_type(P4_FIELD_TYPE_EGRESS_PORT);
+                              x->set_u32(kPortId1);
+                            })),
+                            Return(::util::OkStatus())));
+  EXPECT_CALL(*bcm_chassis_ro_mock_, GetPortState(kNodeId1, kPortId1))
+      .Times(4)
+      .WillRepeatedly(Return(PORT_STATE_UP));
+  EXPECT_CALL(*bcm_sdk_mock_, GetKnetHeaderForDirectTx(kUnit1, kLogicalPort1,
+                                                       kDefaultCos, _, _, _))
+      .Times(4)
+      .WillRepeatedly(Return(::util::OkStatus()));
+  EXPECT_CALL(*LibcProxyMock::Instance(), SendMsg(kSocket1, _, _))
+      .Times(4)
+      .WillRepeatedly(Return(64));  // 64 is tot_len of the packet.
+
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_OK(
+        TransmitPacket(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER, packet));
+  }
+  ASSERT_OK(bcm_packetio_manager_->PushForwardingPipelineConfig(
+      ::p4::v1::ForwardingPipelineConfig()));
+  ASSERT_OK(
+      TransmitPacket(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER, packet));
+
+  {
+    SCOPED_TRACE(bcm_packetio_manager_->DumpStats());
+    CheckNoRxStats();
+    CHECK_NON_ZERO_TX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                              tx_accepts_direct);
+    CHECK_ZERO_TX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                          tx_drops_metadata_parse_error);
+  }
+
+  //--------------------------------------------------------------
+  // Shutdown
+  //--------------------------------------------------------------
+
+  // Expected libc calls for shutdown.
+  EXPECT_CALL(*LibcProxyMock::Instance(), Close(kSocket1))
+      .Times(2)
+      .WillRepeatedly(Return(0));
+
+  // Expected calls to BcmSdkInterface for shutdown.
+  EXPECT_CALL(*bcm_sdk_mock_, StopRx(kUnit1))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_sdk_mock_, DestroyKnetFilter(kUnit1, kCatchAllFilterId1))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_sdk_mock_, DestroyKnetIntf(kUnit1, kNetifId))
+      .WillOnce(Return(::util::OkStatus()));
+
+  // Possible libc calls (triggered only if in the RX thread is spawned).
+  EXPECT_CALL(*LibcProxyMock::Instance(), Close(kEfd))
+      .WillRepeatedly(Return(0));
+
+  ASSERT_OK(Shutdown());
+}
+
+TEST_P(BcmPacketioManagerTest, TransmitPacketBatch) {
+  if (mode_ == OPERATION_MODE_SIM) return;  // no need to run in sim mode
+  FLAGS_knet_tx_batch_mode = true;
+
+  //--------------------------------------------------------------
+  // Config push
+  //--------------------------------------------------------------
+
+  ChassisConfig config;
+  std::map<uint32, SdkPort> port_id_to_sdk_port = {};
+  ASSERT_OK(PopulateChassisConfigAndPortMaps(kNodeId1, &config,
+                                             &port_id_to_sdk_port));
+  config.clear_vendor_config();  // default config
+
+  // Expected calls to BcmChassisManager for first config push.
+  EXPECT_CALL(*bcm_chassis_ro_mock_, GetPortIdToSdkPortMap(kNodeId1))
+      .WillOnce(Return(port_id_to_sdk_port));
+
+  // Track the socket FDs;
+  LibcProxyMock::Instance()->TrackFds({kSocket1, kEfd});
+
+  // Expected libc calls for config push.
+  EXPECT_CALL(*LibcProxyMock::Instance(), Socket(_, _, _))
+      .Times(3)
+      .WillRepeatedly(Return(kSocket1));
+  EXPECT_CALL(*LibcProxyMock::Instance(), Ioctl(kSocket1, _, _))
+      .Times(5)
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*LibcProxyMock::Instance(), Close(kSocket1)).WillOnce(Return(0));
+  EXPECT_CALL(*LibcProxyMock::Instance(), SetSockOpt(kSocket1, _, _, _, _))
+      .Times(2)
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*LibcProxyMock::Instance(), Bind(kSocket1, _, _))
+      .WillOnce(Return(0));
+
+  // Expected calls to BcmSdkInterface for config push.
+  EXPECT_CALL(*bcm_sdk_mock_, StartRx(kUnit1, _))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_sdk_mock_, CreateKnetIntf(kUnit1, kDefaultVlan, _, _))
+      .WillRepeatedly(
+          DoAll(SetArgPointee<3>(kNetifId), Return(::util::OkStatus())));
+  EXPECT_CALL(*bcm_sdk_mock_, CreateKnetFilter(kUnit1, _, kFilterTypeCatchAll))
+      .WillOnce(Return(kCatchAllFilterId1));
+
+  // Possible libc calls (triggered only if in the RX thread is spawned).
+  EXPECT_CALL(*LibcProxyMock::Instance(), EpollCreate1(0))
+      .WillRepeatedly(Return(kEfd));
+  EXPECT_CALL(*LibcProxyMock::Instance(),
+              EpollCtl(kEfd, EPOLL_CTL_ADD, kSocket1, _))
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*LibcProxyMock::Instance(), EpollWait(kEfd, _, 1, _))
+      .WillRepeatedly(Return(0));  // 0 means no packet
+
+  // Call PushChassisConfig to initialize the class.
+  ASSERT_OK(PushChassisConfig(config, kNodeId1));
+
+  //--------------------------------------------------------------
+  // Packet TX
+  //--------------------------------------------------------------
+  // The packets are queued and sent by the TX thread with sendmmsg(), which
+  // sends all the messages it is given in full.
+  constexpr uint64 kNumPackets = 5;
+  EXPECT_CALL(*bcm_sdk_mock_, GetKnetHeaderForIngressPipelineTx(kUnit1, _, _, _))
+      .Times(kNumPackets)
+      .WillRepeatedly(Return(::util::OkStatus()));
+  EXPECT_CALL(*LibcProxyMock::Instance(), SendMMsg(kSocket1, _, _, _))
+      .WillRepeatedly(Invoke([](int sockfd, struct mmsghdr* msgs,
+                                unsigned int vlen, int flags) {
+        for (unsigned int i = 0; i < vlen; ++i) {
+          msgs[i].msg_len = 0;
+          for (size_t j = 0; j < msgs[i].msg_hdr.msg_iovlen; ++j) {
+            msgs[i].msg_len += msgs[i].msg_hdr.msg_iov[j].iov_len;
+          }
+        }
+        return static_cast<int>(vlen);
+      }));
+
+  ::p4::v1::PacketOut packet;
+  packet.set_payload(std::string(kTestPacket, sizeof(kTestPacket)));
+  for (uint64 i = 0; i < kNumPackets; ++i) {
+    ASSERT_OK(
+        TransmitPacket(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER, packet));
+  }
+
+  // Wait for the TX thread to send all the packets.
+  absl::Time deadline = absl::Now() + absl::Seconds(5);
+  uint64 num_sent = 0;
+  while (num_sent < kNumPackets && absl::Now() < deadline) {
+    absl::SleepFor(absl::Milliseconds(1));
+    auto ret = bcm_packetio_manager_->GetTxStats(
+        GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER);
+    ASSERT_TRUE(ret.ok()) << ret.status();
+    num_sent = ret.ValueOrDie().tx_batch_packets;
+  }
+  EXPECT_EQ(kNumPackets, num_sent);
+
+  {
+    SCOPED_TRACE(bcm_packetio_manager_->DumpStats());
+    CheckNoRxStats();
+    CHECK_NON_ZERO_TX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                              tx_accepts_ingress_pipeline);
+    CHECK_NON_ZERO_TX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                              tx_batches);
+    CHECK_ZERO_TX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                          tx_errors_internal_send_failures);
+    CHECK_ZERO_TX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                          tx_errors_incomplete_send);
+    CHECK_ZERO_TX_COUNTER(GoogleConfig::BCM_KNET_INTF_PURPOSE_CONTROLLER,
+                          tx_drops_queue_full);
+  }
+
+  //--------------------------------------------------------------
+  // Shutdown
+  //--------------------------------------------------------------
+
+  // Expected libc calls for shutdown.
+  EXPECT_CALL(*LibcProxyMock::Instance(), Close(kSocket1))
+      .Times(2)
+      .WillRepeatedly(Return(0));
+
+  // Expected calls to BcmSdkInterface for shutdown.
+  EXPECT_CALL(*bcm_sdk_mock_, StopRx(kUnit1))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_sdk_mock_, DestroyKnetFilter(kUnit1, kCatchAllFilterId1))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*bcm_sdk_mock_, DestroyKnetIntf(kUnit1, kNetifId))
+      .WillOnce(Return(::util::OkStatus()));
+
+  // Possible libc calls (triggered only if in the RX thread is spawned).
+  EXPECT_CALL(*LibcProxyMock::Instance(), Close(kEfd))
+      .WillRepeatedly(Return(0));
+
+  ASSERT_OK(Shutdown());
+}
+
 INSTANTIATE_TEST_SUITE_P(BcmPacketioManagerTestWithMode, BcmPacketioManagerTest,
                         ::testing::Values(OPERATION_MODE_STANDALONE,
                                           OPERATION_MODE_COUPLED,
@@ -0,0 +1,117 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "stratum/hal/lib/bcm/bcm_rx_cos_queues.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "stratum/glue/logging.h"
+
+namespace stratum {
+namespace hal {
+namespace bcm {
+
+constexpr size_t BcmRxCosQueues::kDefaultMaxDepth;
+
+BcmRxCosQueues::BcmRxCosQueues(int num_cos,
+                               const std::map<int, QueueConfig>& configs)
+    : num_cos_(std::max(num_cos, 1)),
+      queues_(num_cos_),
+      num_queued_(0),
+      closed_(false) {
+  for (const auto& e : configs) {
+    if (e.first < 0 || e.first >= num_cos_) {
+      LOG(WARNING) << "Ignoring the config of RX queue of invalid CoS "
+                   << e.first << ".";
+      continue;
+    }
+    queues_[e.first].config = e.second;
+  }
+  for (auto& queue : queues_) {
+    queue.config.max_depth = std::max(queue.config.max_depth, size_t{1});
+    queue.config.weight = std::max(queue.config.weight, 0);
+    queue.credits = queue.config.weight;
+  }
+}
+
+bool BcmRxCosQueues::Enqueue(int cos, ::p4::v1::PacketIn* packet) {
+  absl::MutexLock l(&lock_);
+  if (closed_) return false;
+  Queue& queue = queues_[QueueIndex(cos)];
+  if (queue.packets.size() >= queue.config.max_depth) return false;
+  queue.packets.push_back(std::move(*packet));
+  ++num_queued_;
+  not_empty_.Signal();
+  return true;
+}
+
+bool BcmRxCosQueues::Dequeue(::p4::v1::PacketIn* packet, int* cos,
+                             absl::Duration timeout) {
+  absl::MutexLock l(&lock_);
+  absl::Time deadline = absl::Now() + timeout;
+  while (!closed_ && num_queued_ == 0) {
+    if (not_empty_.WaitWithDeadline(&lock_, deadline)) break;
+  }
+  if (closed_ || num_queued_ == 0) return false;
+  int picked = PickQueue();
+  Queue& queue = queues_[picked];
+  *packet = std::move(queue.packets.front());
+  queue.packets.pop_front();
+  --num_queued_;
+  *cos = picked;
+  return true;
+}
+
+void BcmRxCosQueues::Close() {
+  absl::MutexLock l(&lock_);
+  closed_ = true;
+  for (auto& queue : queues_) queue.packets.clear();
+  num_queued_ = 0;
+  not_empty_.SignalAll();
+}
+
+size_t BcmRxCosQueues::Depth(int cos) const {
+  absl::MutexLock l(&lock_);
+  return queues_[QueueIndex(cos)].packets.size();
+}
+
+int BcmRxCosQueues::PickQueue() {
+  // At most two passes: if all the non-empty queues used up their weight in
+  // the first pass, a new round starts and the second pass finds one.
+  for (int pass = 0; pass < 2; ++pass) {
+    for (int cos = num_cos_ - 1; cos >= 0; --cos) {
+      Queue& queue = queues_[cos];
+      if (queue.packets.empty()) continue;
+      if (queue.config.weight == 0) return cos;
+      if (queue.credits > 0) {
+        --queue.credits;
+        return cos;
+      }
+    }
+    for (auto& queue : queues_) queue.credits = queue.config.weight;
+  }
+  // Not reached as long as there is a packet queued.
+  LOG(DFATAL) << "No RX queue to serve with " << num_queued_
+              << " packets queued.";
+  return 0;
+}
+
+int BcmRxCosQueues::QueueIndex(int cos) const {
+  return (cos >= 0 && cos < num_cos_) ? cos : 0;
+}
+
+}  // namespace bcm
+}  // namespace hal
+}  // namespace stratum
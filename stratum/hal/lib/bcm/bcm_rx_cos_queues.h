@@ -0,0 +1,126 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef STRATUM_HAL_LIB_BCM_BCM_RX_COS_QUEUES_H_
+#define STRATUM_HAL_LIB_BCM_BCM_RX_COS_QUEUES_H_
+
+#include <deque>
+#include <map>
+#include <vector>
+
+#include "stratum/glue/integral_types.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "p4/v1/p4runtime.pb.h"
+
+namespace stratum {
+namespace hal {
+namespace bcm {
+
+// Bounded per-CoS queues for the packets received on a KNET interface, and the
+// scheduler deciding the order in which the packets leave the queues. The
+// queues decouple the RX thread, which must never block on a slow
+// application, from the thread writing the packets to the application. When
+// the application falls behind, the queues of the lower CoS fill up and drop
+// their packets first, while the control packets on the higher CoS keep going
+// through.
+//
+// The queues are served from the highest CoS to the lowest. A queue with a
+// weight of 0 has strict priority over all the lower CoS queues. A queue with
+// a weight of N > 0 is served at most N packets per scheduling round, after
+// which the lower CoS queues get their turn. A new round starts once all the
+// non-empty queues used up their weight.
+//
+// The class is thread-safe.
+class BcmRxCosQueues {
+ public:
+  struct QueueConfig {
+    // Max num of packets in the queue.
+    size_t max_depth;
+    // Max num of packets served per round. 0 means strict priority.
+    int weight;
+    QueueConfig() : max_depth(kDefaultMaxDepth), weight(0) {}
+  };
+
+  static constexpr size_t kDefaultMaxDepth = 128;
+
+  // Creates one queue for each CoS in [0, num_cos). The queues of the CoS
+  // found in 'configs' use the given config, the others the default one.
+  BcmRxCosQueues(int num_cos, const std::map<int, QueueConfig>& configs);
+
+  // Moves 'packet' received on 'cos' to the back of the queue of 'cos'. A CoS
+  // out of range is treated as the lowest CoS. Returns false if the queue is
+  // full or the queues are closed, in which case the packet is dropped.
+  bool Enqueue(int cos, ::p4::v1::PacketIn* packet) LOCKS_EXCLUDED(lock_);
+
+  // Moves the next packet picked by the scheduler to 'packet' and its CoS to
+  // 'cos'. Blocks until there is a packet or the timeout expires. Returns
+  // false if no packet could be dequeued before the timeout or if the queues
+  // are closed.
+  bool Dequeue(::p4::v1::PacketIn* packet, int* cos, absl::Duration timeout)
+      LOCKS_EXCLUDED(lock_);
+
+  // Closes the queues, drops all the packets still queued, and wakes up all
+  // the blocked Dequeue() calls.
+  void Close() LOCKS_EXCLUDED(lock_);
+
+  // Returns the num of packets currently in the queue of 'cos'.
+  size_t Depth(int cos) const LOCKS_EXCLUDED(lock_);
+
+  int num_cos() const { return num_cos_; }
+
+  // BcmRxCosQueues is neither copyable nor movable.
+  BcmRxCosQueues(const BcmRxCosQueues&) = delete;
+  BcmRxCosQueues& operator=(const BcmRxCosQueues&) = delete;
+
+ private:
+  struct Queue {
+    std::deque<::p4::v1::PacketIn> packets;
+    QueueConfig config;
+    // Num of packets the queue can still be served in the current round.
+    int credits;
+  };
+
+  // Returns the CoS of the queue to serve next. Must be called only when at
+  // least one packet is queued.
+  int PickQueue() EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  // Returns the index of the queue of 'cos'.
+  int QueueIndex(int cos) const;
+
+  const int num_cos_;
+
+  mutable absl::Mutex lock_;
+
+  // Signaled when a packet is queued or the queues are closed.
+  absl::CondVar not_empty_;
+
+  // The queues, indexed by CoS.
+  std::vector<Queue> queues_ GUARDED_BY(lock_);
+
+  // Total num of packets in all the queues.
+  size_t num_queued_ GUARDED_BY(lock_);
+
+  bool closed_ GUARDED_BY(lock_);
+};
+
+}  // namespace bcm
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_BCM_BCM_RX_COS_QUEUES_H_
@@ -0,0 +1,156 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "stratum/hal/lib/bcm/bcm_rx_cos_queues.h"
+
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+namespace stratum {
+namespace hal {
+namespace bcm {
+namespace {
+
+constexpr int kNumCos = 8;
+
+::p4::v1::PacketIn MakePacket(const std::string& payload) {
+  ::p4::v1::PacketIn packet;
+  packet.set_payload(payload);
+  return packet;
+}
+
+// Dequeues all the packets queued and returns the CoS of each of them, in the
+// order they were dequeued.
+std::vector<int> DrainCos(BcmRxCosQueues* queues) {
+  std::vector<int> cos_list;
+  ::p4::v1::PacketIn packet;
+  int cos = -1;
+  while (queues->Dequeue(&packet, &cos, absl::ZeroDuration())) {
+    cos_list.push_back(cos);
+  }
+  return cos_list;
+}
+
+TEST(BcmRxCosQueuesTest, FifoWithinQueue) {
+  BcmRxCosQueues queues(kNumCos, {});
+  for (int i = 0; i < 3; ++i) {
+    auto packet = MakePacket("packet " + std::to_string(i));
+    ASSERT_TRUE(queues.Enqueue(5, &packet));
+  }
+  EXPECT_EQ(3U, queues.Depth(5));
+  ::p4::v1::PacketIn packet;
+  int cos = -1;
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_TRUE(queues.Dequeue(&packet, &cos, absl::ZeroDuration()));
+    EXPECT_EQ(5, cos);
+    EXPECT_EQ("packet " + std::to_string(i), packet.payload());
+  }
+  EXPECT_EQ(0U, queues.Depth(5));
+}
+
+TEST(BcmRxCosQueuesTest, StrictPriorityServesHighestCosFirst) {
+  BcmRxCosQueues queues(kNumCos, {});
+  for (int cos : {0, 3, 7, 3, 0, 7}) {
+    auto packet = MakePacket("");
+    ASSERT_TRUE(queues.Enqueue(cos, &packet));
+  }
+  EXPECT_THAT(DrainCos(&queues), ::testing::ElementsAre(7, 7, 3, 3, 0, 0));
+}
+
+TEST(BcmRxCosQueuesTest, WeightedQueuesShareBandwidth) {
+  std::map<int, BcmRxCosQueues::QueueConfig> configs;
+  configs[7].weight = 2;
+  configs[1].weight = 1;
+  BcmRxCosQueues queues(kNumCos, configs);
+  for (int i = 0; i < 4; ++i) {
+    auto packet = MakePacket("");
+    ASSERT_TRUE(queues.Enqueue(7, &packet));
+    packet = MakePacket("");
+    ASSERT_TRUE(queues.Enqueue(1, &packet));
+  }
+  // CoS 7 is served twice as often as CoS 1 until it runs out of packets.
+  EXPECT_THAT(DrainCos(&queues),
+              ::testing::ElementsAre(7, 7, 1, 7, 7, 1, 1, 1));
+}
+
+TEST(BcmRxCosQueuesTest, FullQueueDropsOnlyItsOwnPackets) {
+  std::map<int, BcmRxCosQueues::QueueConfig> configs;
+  configs[0].max_depth = 2;
+  BcmRxCosQueues queues(kNumCos, configs);
+  auto packet = MakePacket("");
+  EXPECT_TRUE(queues.Enqueue(0, &packet));
+  EXPECT_TRUE(queues.Enqueue(0, &packet));
+  EXPECT_FALSE(queues.Enqueue(0, &packet));
+  EXPECT_TRUE(queues.Enqueue(6, &packet));
+  EXPECT_EQ(2U, queues.Depth(0));
+  EXPECT_EQ(1U, queues.Depth(6));
+}
+
+TEST(BcmRxCosQueuesTest, InvalidCosUsesLowestQueue) {
+  BcmRxCosQueues queues(kNumCos, {});
+  auto packet = MakePacket("");
+  EXPECT_TRUE(queues.Enqueue(kNumCos, &packet));
+  EXPECT_TRUE(queues.Enqueue(-1, &packet));
+  EXPECT_EQ(2U, queues.Depth(0));
+}
+
+TEST(BcmRxCosQueuesTest, DequeueTimesOutWhenEmpty) {
+  BcmRxCosQueues queues(kNumCos, {});
+  ::p4::v1::PacketIn packet;
+  int cos = -1;
+  EXPECT_FALSE(queues.Dequeue(&packet, &cos, absl::Milliseconds(10)));
+}
+
+TEST(BcmRxCosQueuesTest, DequeueWakesUpOnEnqueue) {
+  BcmRxCosQueues queues(kNumCos, {});
+  std::thread producer([&queues]() {
+    absl::SleepFor(absl::Milliseconds(10));
+    auto packet = MakePacket("late");
+    queues.Enqueue(4, &packet);
+  });
+  ::p4::v1::PacketIn packet;
+  int cos = -1;
+  EXPECT_TRUE(queues.Dequeue(&packet, &cos, absl::Seconds(5)));
+  EXPECT_EQ(4, cos);
+  EXPECT_EQ("late", packet.payload());
+  producer.join();
+}
+
+TEST(BcmRxCosQueuesTest, CloseWakesUpAndRejects) {
+  BcmRxCosQueues queues(kNumCos, {});
+  std::thread consumer([&queues]() {
+    ::p4::v1::PacketIn packet;
+    int cos = -1;
+    absl::Time start = absl::Now();
+    EXPECT_FALSE(queues.Dequeue(&packet, &cos, absl::Seconds(5)));
+    EXPECT_LT(absl::Now() - start, absl::Seconds(5));
+  });
+  absl::SleepFor(absl::Milliseconds(10));
+  queues.Close();
+  consumer.join();
+  auto packet = MakePacket("");
+  EXPECT_FALSE(queues.Enqueue(2, &packet));
+  EXPECT_EQ(0U, queues.Depth(2));
+}
+
+}  // namespace
+}  // namespace bcm
+}  // namespace hal
+}  // namespace stratum
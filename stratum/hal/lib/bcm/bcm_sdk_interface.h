@@ -31,6 +31,7 @@
 #include "stratum/hal/lib/bcm/bcm.pb.h"
 #include "stratum/hal/lib/common/common.pb.h"
 #include "stratum/lib/channel/channel.h"
+#include "absl/time/time.h"
 
 namespace stratum {
 namespace hal {
@@ -178,6 +179,56 @@ class BcmSdkInterface {
     int unit;
     int port;
     PortState state;
+    // The time the event was received from the SDK.
+    absl::Time timestamp;
+  };
+
+  // L3RouteBatchEntry encapsulates a single IPv4/IPv6 LPM/host route operation
+  // that is programmed as part of a batch. Given to ProgramL3RoutesBatch() API.
+  struct L3RouteBatchEntry {
+    // The operation to perform on the route.
+    enum class Op { ADD, MODIFY, DELETE };
+    // The type of the route, which determines the SDK table used.
+    enum class Type { IPV4_LPM, IPV4_HOST, IPV6_LPM, IPV6_HOST };
+    Op op;
+    Type type;
+    // The VRF. If vrf == 0, default VRF is used.
+    int vrf;
+    // IPv4 subnet/mask. For host routes, only subnet_ipv4 is used.
+    uint32 subnet_ipv4;
+    uint32 mask_ipv4;
+    // IPv6 subnet/mask. For host routes, only subnet_ipv6 is used.
+    std::string subnet_ipv6;
+    std::string mask_ipv6;
+    // The class ID. Ignored for DELETE. If class_id <= 0, no class ID is set.
+    int class_id;
+    // The egress intf ID for the route. Ignored for DELETE.
+    int egress_intf_id;
+    // True if egress_intf_id is an ECMP/WCMP egress intf. LPM routes only.
+    bool is_intf_multipath;
+    L3RouteBatchEntry()
+        : op(Op::ADD),
+          type(Type::IPV4_LPM),
+          vrf(0),
+          subnet_ipv4(0),
+          mask_ipv4(0),
+          subnet_ipv6(),
+          mask_ipv6(),
+          class_id(0),
+          egress_intf_id(0),
+          is_intf_multipath(false) {}
+  };
+
+  // EcmpEgressIntfBatchEntry encapsulates the new members of an existing
+  // ECMP/WCMP egress intf that is modified as part of a batch. Given to
+  // ModifyEcmpEgressIntfsBatch() API.
+  struct EcmpEgressIntfBatchEntry {
+    // The ECMP/WCMP egress intf ID.
+    int egress_intf_id;
+    // The new member egress intf IDs, in the format used by
+    // ModifyEcmpEgressIntf().
+    std::vector<int> member_ids;
+    EcmpEgressIntfBatchEntry() : egress_intf_id(0), member_ids() {}
   };
 
   // A few predefined priority values that can be used by external functions
@@ -357,6 +408,16 @@ class BcmSdkInterface {
   // Deletes an L3 ECMP/WCMP egress intf given its ID from a given unit.
   virtual ::util::Status DeleteEcmpEgressIntf(int unit, int egress_intf_id) = 0;
 
+  // Modifies the members of a batch of existing ECMP/WCMP egress intfs on a
+  // given unit with a single SDK transaction. The per-intf semantics are
+  // identical to ModifyEcmpEgressIntf(). results is populated with exactly one
+  // status per entry in intfs, in the same order. The returned status is an
+  // error only if the batch could not be attempted at all, in which case the
+  // content of results is undefined.
+  virtual ::util::Status ModifyEcmpEgressIntfsBatch(
+      int unit, const std::vector<EcmpEgressIntfBatchEntry>& intfs,
+      std::vector<::util::Status>* results) = 0;
+
   // Adds an IPv4 L3 LPM route for given IPv4 subnet/mask and VRF. If vrf == 0,
   // default VRF is used. If class_id == 0, no class ID will be set. The egress
   // intf used is given by egress_intf_id and is assumed to be already created.
@@ -457,6 +518,17 @@ class BcmSdkInterface {
   virtual ::util::Status DeleteL3HostIpv6(int unit, int vrf,
                                           const std::string& ipv6) = 0;
 
+  // Programs a batch of IPv4/IPv6 L3 LPM/host route operations on a given unit
+  // with a single SDK transaction. Each route is validated and gets the same
+  // error codes (e.g. ERR_ENTRY_EXISTS, ERR_ENTRY_NOT_FOUND) as with the
+  // single route Add/Modify/Delete APIs above. results is populated with
+  // exactly one status per entry in routes, in the same order. The returned
+  // status is an error only if the batch could not be attempted at all, in
+  // which case the content of results is undefined.
+  virtual ::util::Status ProgramL3RoutesBatch(
+      int unit, const std::vector<L3RouteBatchEntry>& routes,
+      std::vector<::util::Status>* results) = 0;
+
   // Adds an entry to match the given (vlan, vlan_mask, dst_mac, dst_mac_mask)
   // to the my station TCAM, with the given priority. NOOP if the entry already
   // exists. All the IPv4/IPv6 packets, independent of the src port, will be
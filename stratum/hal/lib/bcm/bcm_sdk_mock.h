@@ -94,6 +94,11 @@ class BcmSdkMock : public BcmSdkInterface {
                               const std::vector<int>& member_ids));
   MOCK_METHOD2(DeleteEcmpEgressIntf,
                ::util::Status(int unit, int egress_intf_id));
+  MOCK_METHOD3(
+      ModifyEcmpEgressIntfsBatch,
+      ::util::Status(int unit,
+                     const std::vector<EcmpEgressIntfBatchEntry>& intfs,
+                     std::vector<::util::Status>* results));
   MOCK_METHOD7(AddL3RouteIpv4,
                ::util::Status(int unit, int vrf, uint32 subnet, uint32 mask,
                               int class_id, int egress_intf_id,
@@ -130,6 +135,10 @@ class BcmSdkMock : public BcmSdkInterface {
                ::util::Status(int unit, int vrf, uint32 ipv4));
   MOCK_METHOD3(DeleteL3HostIpv6,
                ::util::Status(int unit, int vrf, const std::string& ipv6));
+  MOCK_METHOD3(ProgramL3RoutesBatch,
+               ::util::Status(int unit,
+                              const std::vector<L3RouteBatchEntry>& routes,
+                              std::vector<::util::Status>* results));
   MOCK_METHOD6(AddMyStationEntry,
                ::util::StatusOr<int>(int unit, int priority, int vlan,
                                      int vlan_mask, uint64 dst_mac,
@@ -41,6 +41,7 @@
 #include "absl/strings/str_split.h"
 #include "absl/strings/substitute.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
 #include "gflags/gflags.h"
 #include "stratum/glue/gtl/cleanup.h"
 #include "stratum/glue/gtl/map_util.h"
@@ -477,6 +478,76 @@ std::string PrintL3Host(const l3_host_t& host) {
   return buffer.str();
 }
 
+// Returns an error if class_id is outside of the range accepted by the given
+// L3 LPM route table. class_id <= 0 means no class ID and is always valid.
+::util::Status CheckL3RouteClassId(int unit, const char* table, int class_id) {
+  if (class_id <= 0) return ::util::OkStatus();
+  uint64_t min;
+  uint64_t max;
+  RETURN_IF_BCM_ERROR(GetFieldMinMaxValue(unit, table, CLASS_IDs, &min, &max));
+  if ((class_id > static_cast<int>(max)) ||
+      (class_id < static_cast<int>(min))) {
+    return MAKE_ERROR(ERR_INVALID_PARAM)
+           << "Invalid class_id (" << class_id << "), valid class_id range is "
+           << static_cast<int>(min) << " - "
+           << static_cast<int>(max) << ".";
+  }
+  return ::util::OkStatus();
+}
+
+// Pretty prints an L3 LPM or host route given to the batch APIs, the same way
+// the single route APIs print it in their errors.
+std::string PrintL3RouteBatchEntry(
+    const BcmSdkInterface::L3RouteBatchEntry& route) {
+  typedef BcmSdkInterface::L3RouteBatchEntry L3RouteBatchEntry;
+  switch (route.type) {
+    case L3RouteBatchEntry::Type::IPV4_LPM:
+      return "IPv4 L3 LPM route " +
+             PrintL3Route({false, route.vrf, route.class_id,
+                           route.egress_intf_id, route.subnet_ipv4,
+                           route.mask_ipv4, "", ""});
+    case L3RouteBatchEntry::Type::IPV6_LPM:
+      return "IPv6 L3 LPM route " +
+             PrintL3Route({true, route.vrf, route.class_id,
+                           route.egress_intf_id, 0, 0, route.subnet_ipv6,
+                           route.mask_ipv6});
+    case L3RouteBatchEntry::Type::IPV4_HOST:
+      return "IPv4 L3 host " +
+             PrintL3Host({false, route.vrf, route.class_id,
+                          route.egress_intf_id, route.subnet_ipv4, ""});
+    case L3RouteBatchEntry::Type::IPV6_HOST:
+      return "IPv6 L3 host " +
+             PrintL3Host({true, route.vrf, route.class_id,
+                          route.egress_intf_id, 0, route.subnet_ipv6});
+  }
+  return "L3 route";
+}
+
+// Converts the SDK return value of adding, modifying or deleting the L3 route
+// described by 'route' to a status. Used by both the single and the batched
+// route APIs, so that an existing route on ADD and a missing route on
+// MODIFY/DELETE give the same errors either way.
+::util::Status L3RouteCommitStatus(int unit, int rv,
+                                   BcmSdkInterface::L3RouteBatchEntry::Op op,
+                                   const std::string& route) {
+  typedef BcmSdkInterface::L3RouteBatchEntry L3RouteBatchEntry;
+  if (rv == SHR_E_EXISTS && op == L3RouteBatchEntry::Op::ADD) {
+    return MAKE_ERROR(ERR_ENTRY_EXISTS).without_logging()
+           << route << " already exists on unit " << unit << ".";
+  }
+  if (rv == SHR_E_NOT_FOUND && op != L3RouteBatchEntry::Op::ADD) {
+    return MAKE_ERROR(ERR_ENTRY_NOT_FOUND).without_logging()
+           << route << " not found on unit " << unit << ".";
+  }
+  const BooleanBcmStatus ret(rv);
+  if (!ret) {
+    return MAKE_ERROR(ret.error_code()).without_logging()
+           << "Programming " << route << " on unit " << unit
+           << " failed with error message: " << FixMessage(shr_errmsg(rv));
+  }
+  return ::util::OkStatus();
+}
+
 // RCPU header for KNET packets. This structure is private to this file, hence
 // defined in private namespace.
 struct VlanTag {
@@ -963,198 +1034,207 @@ BcmSdkWrapper::~BcmSdkWrapper() { ShutdownAllUnits().IgnoreError(); }
     RETURN_IF_BCM_ERROR(bcmlt_entry_free(entry_hdl));
   }
 
-  RETURN_IF_ERROR(GetTableLimits(unit, L2_MY_STATIONs, &table_min, &table_max));
-  unit_to_my_station_min_limit_[unit] = table_min;
-  unit_to_my_station_max_limit_[unit] = table_max;
-  my_station_ids_[unit] = {};
-
-  RETURN_IF_ERROR(GetTableLimits(unit, L3_EIFs, &table_min, &table_max));
-  // TODO(BRCM): fixup to avoid interface with,
-  // is this really needed, verify
-  unit_to_l3_intf_min_limit_[unit] = table_min + 1;
-  unit_to_l3_intf_max_limit_[unit] = table_max;
-  l3_interface_ids_[unit] = {};
-
-  InUseMap l3_egress_intf;
-  RETURN_IF_ERROR(GetTableLimits(unit, L3_UC_NHOPs, &table_min, &table_max));
-  for (auto i = table_min; i <= table_max; i++) {
-    l3_egress_intf.emplace(i, false);
-  }
-  l3_egress_interface_ids_[unit] = l3_egress_intf;
-
-  InUseMap l3_ecmp_egress_intf;
-  RETURN_IF_ERROR(GetTableLimits(unit, ECMPs, &table_min, &table_max));
-  for (auto i = table_min; i <= table_max; i++) {
-    l3_ecmp_egress_intf.emplace(i + 1, false);
-  }
-  l3_ecmp_egress_interface_ids_[unit] = l3_ecmp_egress_intf;
-
-  fp_group_ids_[unit] = new AclGroupIds();
-  int max_fp_groups = 0;
-
-  // IFP - group
-  RETURN_IF_ERROR(GetTableLimits(unit, FP_ING_GRP_TEMPLATEs,
-                                 &table_min, &table_max));
-  InUseMap ifp_groups;
-  for (auto i = table_min; i <= table_max; i++) {
-    ifp_groups.emplace(i, false);
-  }
-  ifp_group_ids_[unit] = ifp_groups;
-  max_fp_groups += table_max;
-
-  // VFP - group
-  InUseMap vfp_groups;
-  RETURN_IF_ERROR(GetTableLimits(unit, FP_VLAN_GRP_TEMPLATEs,
-                                 &table_min, &table_max));
-  for (auto i = table_min; i <= table_max; i++) {
-    vfp_groups.emplace(i, false);
-  }
-  vfp_group_ids_[unit] = vfp_groups;
-  max_fp_groups += table_max;
-
-  // EFP - group
-  InUseMap efp_groups;
-  RETURN_IF_ERROR(GetTableLimits(unit, FP_EGR_GRP_TEMPLATEs,
-                                 &table_min, &table_max));
-  for (auto i = table_min; i <= table_max; i++) {
-    efp_groups.emplace(i, false);
-  }
-  efp_group_ids_[unit] = efp_groups;
-  max_fp_groups += table_max;
-
-  unit_to_fp_groups_max_limit_[unit] = max_fp_groups;
-
-  fp_rule_ids_[unit] = new AclRuleIds();
-  int max_fp_rules = 0;
-  // IFP - rules
-  InUseMap ifp_rules;
-  RETURN_IF_ERROR(GetTableLimits(unit, FP_ING_RULE_TEMPLATEs,
-                                 &table_min, &table_max));
-  for (auto i = table_min; i <= table_max; i++) {
-    ifp_rules.emplace(i, false);
-  }
-  ifp_rule_ids_[unit] = ifp_rules;
-  max_fp_rules += table_max;
-
-  // VFP - rules
-  InUseMap vfp_rules;
-  RETURN_IF_ERROR(GetTableLimits(unit, FP_VLAN_RULE_TEMPLATEs,
-                                 &table_min, &table_max));
-  for (auto i = table_min; i <= table_max; i++) {
-    vfp_rules.emplace(i, false);
-  }
-  vfp_rule_ids_[unit] = vfp_rules;
-  max_fp_rules += table_max;
-
-  // EFP - rules
-  InUseMap efp_rules;
-  RETURN_IF_ERROR(GetTableLimits(unit, FP_EGR_RULE_TEMPLATEs,
-                                 &table_min, &table_max));
-  for (auto i = table_min; i <= table_max; i++) {
-    efp_rules.emplace(i, false);
-  }
-  efp_rule_ids_[unit] = efp_rules;
-  max_fp_rules += table_max;
-
-  unit_to_fp_rules_max_limit_[unit] = max_fp_rules;
-
-  fp_policy_ids_[unit] = new AclPolicyIds();
-  int max_fp_policies = 0;
-  // IFP - policies
-  InUseMap ifp_policies;
-  RETURN_IF_ERROR(GetTableLimits(unit, FP_ING_POLICY_TEMPLATEs,
-                                 &table_min, &table_max));
-  for (auto i = table_min; i <= table_max; i++) {
-    ifp_policies.emplace(i, false);
-  }
-  ifp_policy_ids_[unit] = ifp_policies;
-  max_fp_policies += table_max;
-
-  // VFP - policies
-  InUseMap vfp_policies;
-  RETURN_IF_ERROR(GetTableLimits(unit, FP_VLAN_POLICY_TEMPLATEs,
-                                 &table_min, &table_max));
-  for (auto i = table_min; i <= table_max; i++) {
-    vfp_policies.emplace(i, false);
-  }
-  vfp_policy_ids_[unit] = vfp_policies;
-  max_fp_policies += table_max;
-
-  // EFP - policies
-  InUseMap efp_policies;
-  RETURN_IF_ERROR(GetTableLimits(unit, FP_EGR_POLICY_TEMPLATEs,
-                                 &table_min, &table_max));
-  for (auto i = table_min; i <= table_max; i++) {
-    efp_policies.emplace(i, false);
-  }
-  efp_policy_ids_[unit] = efp_policies;
-  max_fp_policies += table_max;
-
-  unit_to_fp_policy_max_limit_[unit] = max_fp_policies;
-
-  fp_meter_ids_[unit] = new AclMeterIds();
-  int max_fp_meters = 0;
-  // IFP - Meters
-  InUseMap ifp_meters;
-  RETURN_IF_ERROR(GetTableLimits(unit, METER_FP_ING_TEMPLATEs,
-                                 &table_min, &table_max));
-  for (auto i = table_min; i <= table_max; i++) {
-    ifp_meters.emplace(i, false);
-  }
-  ifp_meter_ids_[unit] = ifp_meters;
-  max_fp_meters += table_max;
-
-  // EFP - Meters
-  InUseMap efp_meters;
-  RETURN_IF_ERROR(GetTableLimits(unit, METER_FP_EGR_TEMPLATEs,
-                                 &table_min, &table_max));
-  for (auto i = table_min; i <= table_max; i++) {
-    efp_meters.emplace(i, false);
-  }
-  efp_meter_ids_[unit] = efp_meters;
-  max_fp_meters += table_max;
-
-  unit_to_fp_meter_max_limit_[unit] = max_fp_meters;
-
-  // FP ACLs
-  fp_acl_ids_[unit] = new AclIds();
-  int max_fp_acls = 0;
-  // IFP Acls
-  InUseMap ifp_acls;
-  RETURN_IF_ERROR(GetTableLimits(unit, FP_ING_ENTRYs, &table_min, &table_max));
-  for (auto i = table_min; i <= table_max; i++) {
-    ifp_acls.emplace(i, false);
-  }
-  ifp_acl_ids_[unit] = ifp_acls;
-  max_fp_acls += table_max;
-
-  // VFP Acls
-  InUseMap vfp_acls;
-  RETURN_IF_ERROR(GetTableLimits(unit, FP_VLAN_ENTRYs, &table_min, &table_max));
-  for (auto i = table_min; i <= table_max; i++) {
-    vfp_acls.emplace(i, false);
-  }
-  vfp_acl_ids_[unit] = vfp_acls;
-  max_fp_acls += table_max;
-
-  // EFP Acls
-  InUseMap efp_acls;
-  RETURN_IF_ERROR(GetTableLimits(unit, FP_EGR_ENTRYs, &table_min, &table_max));
-  for (auto i = table_min; i <= table_max; i++) {
-    efp_acls.emplace(i, false);
-  }
-  efp_acl_ids_[unit] = efp_acls;
-  max_fp_acls += table_max;
-
-  unit_to_fp_max_limit_[unit] = max_fp_acls;
-
-  // UDF Chunks
-  InUseMap udf_chunks;
-  for (auto i = 0; i <= kUdfMaxChunks; i++) {
-    udf_chunks.emplace(i, false);
-  }
-  unit_to_udf_chunk_ids_[unit] = udf_chunks;
-  unit_to_chunk_ids_[unit] = new ChunkIds();
+  // The per-unit ID pools. The units are initialized in parallel, so the
+  // maps are only modified while holding data_lock_.
+  {
+    absl::WriterMutexLock l(&data_lock_);
+    RETURN_IF_ERROR(
+        GetTableLimits(unit, L2_MY_STATIONs, &table_min, &table_max));
+    unit_to_my_station_min_limit_[unit] = table_min;
+    unit_to_my_station_max_limit_[unit] = table_max;
+    my_station_ids_[unit] = {};
+
+    RETURN_IF_ERROR(GetTableLimits(unit, L3_EIFs, &table_min, &table_max));
+    // TODO(BRCM): fixup to avoid interface with,
+    // is this really needed, verify
+    unit_to_l3_intf_min_limit_[unit] = table_min + 1;
+    unit_to_l3_intf_max_limit_[unit] = table_max;
+    l3_interface_ids_[unit] = {};
+
+    InUseMap l3_egress_intf;
+    RETURN_IF_ERROR(GetTableLimits(unit, L3_UC_NHOPs, &table_min, &table_max));
+    for (auto i = table_min; i <= table_max; i++) {
+      l3_egress_intf.emplace(i, false);
+    }
+    l3_egress_interface_ids_[unit] = l3_egress_intf;
+
+    InUseMap l3_ecmp_egress_intf;
+    RETURN_IF_ERROR(GetTableLimits(unit, ECMPs, &table_min, &table_max));
+    for (auto i = table_min; i <= table_max; i++) {
+      l3_ecmp_egress_intf.emplace(i + 1, false);
+    }
+    l3_ecmp_egress_interface_ids_[unit] = l3_ecmp_egress_intf;
+
+    fp_group_ids_[unit] = new AclGroupIds();
+    int max_fp_groups = 0;
+
+    // IFP - group
+    RETURN_IF_ERROR(GetTableLimits(unit, FP_ING_GRP_TEMPLATEs,
+                                   &table_min, &table_max));
+    InUseMap ifp_groups;
+    for (auto i = table_min; i <= table_max; i++) {
+      ifp_groups.emplace(i, false);
+    }
+    ifp_group_ids_[unit] = ifp_groups;
+    max_fp_groups += table_max;
+
+    // VFP - group
+    InUseMap vfp_groups;
+    RETURN_IF_ERROR(GetTableLimits(unit, FP_VLAN_GRP_TEMPLATEs,
+                                   &table_min, &table_max));
+    for (auto i = table_min; i <= table_max; i++) {
+      vfp_groups.emplace(i, false);
+    }
+    vfp_group_ids_[unit] = vfp_groups;
+    max_fp_groups += table_max;
+
+    // EFP - group
+    InUseMap efp_groups;
+    RETURN_IF_ERROR(GetTableLimits(unit, FP_EGR_GRP_TEMPLATEs,
+                                   &table_min, &table_max));
+    for (auto i = table_min; i <= table_max; i++) {
+      efp_groups.emplace(i, false);
+    }
+    efp_group_ids_[unit] = efp_groups;
+    max_fp_groups += table_max;
+
+    unit_to_fp_groups_max_limit_[unit] = max_fp_groups;
+
+    fp_rule_ids_[unit] = new AclRuleIds();
+    int max_fp_rules = 0;
+    // IFP - rules
+    InUseMap ifp_rules;
+    RETURN_IF_ERROR(GetTableLimits(unit, FP_ING_RULE_TEMPLATEs,
+                                   &table_min, &table_max));
+    for (auto i = table_min; i <= table_max; i++) {
+      ifp_rules.emplace(i, false);
+    }
+    ifp_rule_ids_[unit] = ifp_rules;
+    max_fp_rules += table_max;
+
+    // VFP - rules
+    InUseMap vfp_rules;
+    RETURN_IF_ERROR(GetTableLimits(unit, FP_VLAN_RULE_TEMPLATEs,
+                                   &table_min, &table_max));
+    for (auto i = table_min; i <= table_max; i++) {
+      vfp_rules.emplace(i, false);
+    }
+    vfp_rule_ids_[unit] = vfp_rules;
+    max_fp_rules += table_max;
+
+    // EFP - rules
+    InUseMap efp_rules;
+    RETURN_IF_ERROR(GetTableLimits(unit, FP_EGR_RULE_TEMPLATEs,
+                                   &table_min, &table_max));
+    for (auto i = table_min; i <= table_max; i++) {
+      efp_rules.emplace(i, false);
+    }
+    efp_rule_ids_[unit] = efp_rules;
+    max_fp_rules += table_max;
+
+    unit_to_fp_rules_max_limit_[unit] = max_fp_rules;
+
+    fp_policy_ids_[unit] = new AclPolicyIds();
+    int max_fp_policies = 0;
+    // IFP - policies
+    InUseMap ifp_policies;
+    RETURN_IF_ERROR(GetTableLimits(unit, FP_ING_POLICY_TEMPLATEs,
+                                   &table_min, &table_max));
+    for (auto i = table_min; i <= table_max; i++) {
+      ifp_policies.emplace(i, false);
+    }
+    ifp_policy_ids_[unit] = ifp_policies;
+    max_fp_policies += table_max;
+
+    // VFP - policies
+    InUseMap vfp_policies;
+    RETURN_IF_ERROR(GetTableLimits(unit, FP_VLAN_POLICY_TEMPLATEs,
+                                   &table_min, &table_max));
+    for (auto i = table_min; i <= table_max; i++) {
+      vfp_policies.emplace(i, false);
+    }
+    vfp_policy_ids_[unit] = vfp_policies;
+    max_fp_policies += table_max;
+
+    // EFP - policies
+    InUseMap efp_policies;
+    RETURN_IF_ERROR(GetTableLimits(unit, FP_EGR_POLICY_TEMPLATEs,
+                                   &table_min, &table_max));
+    for (auto i = table_min; i <= table_max; i++) {
+      efp_policies.emplace(i, false);
+    }
+    efp_policy_ids_[unit] = efp_policies;
+    max_fp_policies += table_max;
+
+    unit_to_fp_policy_max_limit_[unit] = max_fp_policies;
+
+    fp_meter_ids_[unit] = new AclMeterIds();
+    int max_fp_meters = 0;
+    // IFP - Meters
+    InUseMap ifp_meters;
+    RETURN_IF_ERROR(GetTableLimits(unit, METER_FP_ING_TEMPLATEs,
+                                   &table_min, &table_max));
+    for (auto i = table_min; i <= table_max; i++) {
+      ifp_meters.emplace(i, false);
+    }
+    ifp_meter_ids_[unit] = ifp_meters;
+    max_fp_meters += table_max;
+
+    // EFP - Meters
+    InUseMap efp_meters;
+    RETURN_IF_ERROR(GetTableLimits(unit, METER_FP_EGR_TEMPLATEs,
+                                   &table_min, &table_max));
+    for (auto i = table_min; i <= table_max; i++) {
+      efp_meters.emplace(i, false);
+    }
+    efp_meter_ids_[unit] = efp_meters;
+    max_fp_meters += table_max;
+
+    unit_to_fp_meter_max_limit_[unit] = max_fp_meters;
+
+    // FP ACLs
+    fp_acl_ids_[unit] = new AclIds();
+    int max_fp_acls = 0;
+    // IFP Acls
+    InUseMap ifp_acls;
+    RETURN_IF_ERROR(
+        GetTableLimits(unit, FP_ING_ENTRYs, &table_min, &table_max));
+    for (auto i = table_min; i <= table_max; i++) {
+      ifp_acls.emplace(i, false);
+    }
+    ifp_acl_ids_[unit] = ifp_acls;
+    max_fp_acls += table_max;
+
+    // VFP Acls
+    InUseMap vfp_acls;
+    RETURN_IF_ERROR(
+        GetTableLimits(unit, FP_VLAN_ENTRYs, &table_min, &table_max));
+    for (auto i = table_min; i <= table_max; i++) {
+      vfp_acls.emplace(i, false);
+    }
+    vfp_acl_ids_[unit] = vfp_acls;
+    max_fp_acls += table_max;
+
+    // EFP Acls
+    InUseMap efp_acls;
+    RETURN_IF_ERROR(
+        GetTableLimits(unit, FP_EGR_ENTRYs, &table_min, &table_max));
+    for (auto i = table_min; i <= table_max; i++) {
+      efp_acls.emplace(i, false);
+    }
+    efp_acl_ids_[unit] = efp_acls;
+    max_fp_acls += table_max;
+
+    unit_to_fp_max_limit_[unit] = max_fp_acls;
+
+    // UDF Chunks
+    InUseMap udf_chunks;
+    for (auto i = 0; i <= kUdfMaxChunks; i++) {
+      udf_chunks.emplace(i, false);
+    }
+    unit_to_udf_chunk_ids_[unit] = udf_chunks;
+    unit_to_chunk_ids_[unit] = new ChunkIds();
+  }
 
   // Disable port level MAC address learning
   RETURN_IF_BCM_ERROR(bcmlt_entry_allocate(unit, PORT_LEARNs, &entry_hdl));
@@ -2854,6 +2934,100 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
   return ::util::OkStatus();
 }
 
+::util::Status BcmSdkWrapper::ModifyEcmpEgressIntfsBatch(
+    int unit, const std::vector<EcmpEgressIntfBatchEntry>& intfs,
+    std::vector<::util::Status>* results) {
+  CHECK_RETURN_IF_FALSE(results != nullptr) << "Null results!";
+  // Check if the unit is valid
+  RETURN_IF_BCM_ERROR(CheckIfUnitExists(unit));
+  InUseMap* ecmp_intfs = gtl::FindOrNull(l3_ecmp_egress_interface_ids_, unit);
+  CHECK_RETURN_IF_FALSE(ecmp_intfs != nullptr)
+      << "Unit " << unit
+      << " not initialized yet. Call InitializeUnit first.";
+  results->assign(intfs.size(), ::util::OkStatus());
+  if (intfs.empty()) return ::util::OkStatus();
+
+  bcmlt_transaction_hdl_t trans_hdl;
+  RETURN_IF_BCM_ERROR(
+      bcmlt_transaction_allocate(BCMLT_TRANS_TYPE_BATCH, &trans_hdl));
+  // The index of the intf for each entry added to the transaction, in the
+  // order the entries were added.
+  std::vector<size_t> trans_entry_to_intf;
+  trans_entry_to_intf.reserve(intfs.size());
+  for (size_t i = 0; i < intfs.size(); ++i) {
+    const auto& intf = intfs[i];
+    ::util::Status& intf_status = (*results)[i];
+    auto it = ecmp_intfs->find(intf.egress_intf_id);
+    if (it == ecmp_intfs->end() || !it->second) {
+      intf_status = MAKE_ERROR(ERR_INVALID_PARAM).without_logging()
+                    << "Invalid ECMP egress interface " << intf.egress_intf_id
+                    << ".";
+      continue;
+    }
+    if (intf.member_ids.empty() ||
+        intf.member_ids.size() > static_cast<size_t>(kMaxEcmpGroupSize)) {
+      intf_status = MAKE_ERROR(ERR_INVALID_PARAM).without_logging()
+                    << "Invalid number of members "
+                    << intf.member_ids.size() << " for ECMP egress interface "
+                    << intf.egress_intf_id << ".";
+      continue;
+    }
+    uint64 members_array[kMaxEcmpGroupSize] = {};
+    for (size_t j = 0; j < intf.member_ids.size(); ++j) {
+      members_array[j] = static_cast<uint64>(intf.member_ids[j]);
+    }
+    int members_count = static_cast<int>(intf.member_ids.size());
+    bcmlt_entry_handle_t entry_hdl;
+    APPEND_STATUS_IF_BCM_ERROR(intf_status,
+                               bcmlt_entry_allocate(unit, ECMPs, &entry_hdl));
+    if (!intf_status.ok()) continue;
+    APPEND_STATUS_IF_BCM_ERROR(
+        intf_status,
+        bcmlt_entry_field_add(entry_hdl, ECMP_IDs, intf.egress_intf_id));
+    APPEND_STATUS_IF_BCM_ERROR(
+        intf_status,
+        bcmlt_entry_field_add(entry_hdl, NUM_PATHSs, members_count));
+    APPEND_STATUS_IF_BCM_ERROR(
+        intf_status, bcmlt_entry_field_array_add(entry_hdl, NHOP_IDs, 0,
+                                                 members_array, members_count));
+    if (intf_status.ok()) {
+      APPEND_STATUS_IF_BCM_ERROR(
+          intf_status, bcmlt_transaction_entry_add(
+                           trans_hdl, BCMLT_OPCODE_UPDATE, entry_hdl));
+    }
+    if (!intf_status.ok()) {
+      bcmlt_entry_free(entry_hdl);
+      continue;
+    }
+    trans_entry_to_intf.push_back(i);
+  }
+
+  ::util::Status status = ::util::OkStatus();
+  if (!trans_entry_to_intf.empty()) {
+    // In a batch transaction, a failing entry does not prevent the rest from
+    // being committed. The overall result is therefore ignored here and the
+    // status of each entry is checked individually below.
+    bcmlt_transaction_commit(trans_hdl, BCMLT_PRIORITY_NORMAL);
+    for (size_t j = 0; j < trans_entry_to_intf.size(); ++j) {
+      size_t i = trans_entry_to_intf[j];
+      bcmlt_entry_info_t entry_info;
+      APPEND_STATUS_IF_BCM_ERROR(
+          (*results)[i],
+          bcmlt_transaction_entry_num_get(trans_hdl, j, &entry_info));
+      if (!(*results)[i].ok()) continue;
+      APPEND_STATUS_IF_BCM_ERROR((*results)[i], entry_info.status);
+    }
+  }
+  // Freeing the transaction also frees all the entries added to it.
+  APPEND_STATUS_IF_BCM_ERROR(status, bcmlt_transaction_free(trans_hdl));
+
+  VLOG(1) << "Modified a batch of " << trans_entry_to_intf.size()
+          << " out of " << intfs.size() << " ECMP groups on unit " << unit
+          << ".";
+
+  return status;
+}
+
 ::util::Status BcmSdkWrapper::DeleteEcmpEgressIntf(int unit,
                                                    int egress_intf_id) {
   bcmlt_entry_handle_t entry_hdl;
@@ -2912,18 +3086,7 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
            << static_cast<int>(min) << " - "
            << static_cast<int>(max) << ".";
   }
-  if (class_id > 0) {
-    RETURN_IF_BCM_ERROR(
-        GetFieldMinMaxValue(unit, L3_IPV4_UC_ROUTE_VRFs, CLASS_IDs, &min,
-                            &max));
-    if ((class_id > static_cast<int>(max)) ||
-        (class_id < static_cast<int>(min))) {
-      return MAKE_ERROR(ERR_INVALID_PARAM)
-             << "Invalid class_id (" << class_id << "), valid class_id range is "
-             << static_cast<int>(min) << " - "
-             << static_cast<int>(max) << ".";
-    }
-  }
+  RETURN_IF_ERROR(CheckL3RouteClassId(unit, L3_IPV4_UC_ROUTE_VRFs, class_id));
   InUseMap* l3_egress_intf = gtl::FindOrNull(l3_egress_interface_ids_, unit);
   CHECK_RETURN_IF_FALSE(l3_egress_intf != nullptr)
       << "Unit " << unit
@@ -2963,11 +3126,9 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
   rv = bcmlt_custom_entry_commit(entry_hdl, BCMLT_OPCODE_INSERT,
                                  BCMLT_PRIORITY_NORMAL);
   RETURN_IF_BCM_ERROR(bcmlt_entry_free(entry_hdl));
-  if (rv == SHR_E_EXISTS) {
-    return MAKE_ERROR(ERR_ENTRY_EXISTS)
-           << "IPv4 L3 LPM route " << PrintL3Route(route)
-           << " already exists on unit " << unit << ".";
-  }
+  RETURN_IF_ERROR(L3RouteCommitStatus(unit, rv, L3RouteBatchEntry::Op::ADD,
+                                      "IPv4 L3 LPM route " +
+                                          PrintL3Route(route)));
   VLOG(1) << "Added IPv4 L3 LPM route " << PrintL3Route(route) << " on unit "
           << unit << ".";
   return ::util::OkStatus();
@@ -2982,7 +3143,7 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
   uint64_t max;
   uint64_t min;
   InUseMap::iterator it;
-  l3_route_t route = {true, vrf, class_id, egress_intf_id, 0, 0, "", ""};
+  l3_route_t route = {true, vrf, class_id, egress_intf_id, 0, 0, subnet, mask};
 
   CHECK_RETURN_IF_FALSE(egress_intf_id > 0);
 
@@ -3002,18 +3163,7 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
            << static_cast<int>(min) << " - "
            << static_cast<int>(max) << ".";
   }
-  if (class_id > 0) {
-    RETURN_IF_BCM_ERROR(
-        GetFieldMinMaxValue(unit, L3_IPV6_UC_ROUTE_VRFs, CLASS_IDs, &min,
-                            &max));
-    if ((class_id > static_cast<int>(max)) ||
-        (class_id < static_cast<int>(min))) {
-      return MAKE_ERROR(ERR_INVALID_PARAM)
-             << "Invalid class_id (" << class_id << "), valid class_id range is "
-             << static_cast<int>(min) << " - "
-             << static_cast<int>(max) << ".";
-    }
-  }
+  RETURN_IF_ERROR(CheckL3RouteClassId(unit, L3_IPV6_UC_ROUTE_VRFs, class_id));
   InUseMap* l3_egress_intf = gtl::FindOrNull(l3_egress_interface_ids_, unit);
   CHECK_RETURN_IF_FALSE(l3_egress_intf != nullptr)
       << "Unit " << unit
@@ -3054,9 +3204,12 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
     RETURN_IF_BCM_ERROR(
         bcmlt_entry_field_add(entry_hdl, NHOP_IDs, egress_intf_id));
   }
-  RETURN_IF_BCM_ERROR(bcmlt_custom_entry_commit(entry_hdl, BCMLT_OPCODE_INSERT,
-                                                BCMLT_PRIORITY_NORMAL));
+  int rv = bcmlt_custom_entry_commit(entry_hdl, BCMLT_OPCODE_INSERT,
+                                     BCMLT_PRIORITY_NORMAL);
   RETURN_IF_BCM_ERROR(bcmlt_entry_free(entry_hdl));
+  RETURN_IF_ERROR(L3RouteCommitStatus(unit, rv, L3RouteBatchEntry::Op::ADD,
+                                      "IPv6 L3 LPM route " +
+                                          PrintL3Route(route)));
 
   VLOG(1) << "Added IPv6 L3 LPM route " << PrintL3Route(route) << " on unit "
           << unit << ".";
@@ -3104,9 +3257,12 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
   RETURN_IF_BCM_ERROR(bcmlt_entry_field_add(entry_hdl, ECMP_NHOPs, 0));
   RETURN_IF_BCM_ERROR(
       bcmlt_entry_field_add(entry_hdl, NHOP_IDs, egress_intf_id));
-  RETURN_IF_BCM_ERROR(bcmlt_custom_entry_commit(entry_hdl, BCMLT_OPCODE_INSERT,
-                                                BCMLT_PRIORITY_NORMAL));
+  int rv = bcmlt_custom_entry_commit(entry_hdl, BCMLT_OPCODE_INSERT,
+                                     BCMLT_PRIORITY_NORMAL);
   RETURN_IF_BCM_ERROR(bcmlt_entry_free(entry_hdl));
+  RETURN_IF_ERROR(L3RouteCommitStatus(unit, rv, L3RouteBatchEntry::Op::ADD,
+                                      "IPv4 L3 host " +
+                                          PrintL3Host(host)));
 
   VLOG(1) << "Added IPv4 L3 host route " << PrintL3Host(host) << " on unit "
           << unit << ".";
@@ -3161,9 +3317,12 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
   RETURN_IF_BCM_ERROR(bcmlt_entry_field_add(entry_hdl, ECMP_NHOPs, 0));
   RETURN_IF_BCM_ERROR(
       bcmlt_entry_field_add(entry_hdl, NHOP_IDs, egress_intf_id));
-  RETURN_IF_BCM_ERROR(bcmlt_custom_entry_commit(entry_hdl, BCMLT_OPCODE_INSERT,
-                                                BCMLT_PRIORITY_NORMAL));
+  int rv = bcmlt_custom_entry_commit(entry_hdl, BCMLT_OPCODE_INSERT,
+                                     BCMLT_PRIORITY_NORMAL);
   RETURN_IF_BCM_ERROR(bcmlt_entry_free(entry_hdl));
+  RETURN_IF_ERROR(L3RouteCommitStatus(unit, rv, L3RouteBatchEntry::Op::ADD,
+                                      "IPv6 L3 host " +
+                                          PrintL3Host(host)));
 
   VLOG(1) << "Added IPv6 L3 host route " << PrintL3Host(host) << " on unit "
           << unit << ".";
@@ -3195,18 +3354,7 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
            << static_cast<int>(min) << " - "
            << static_cast<int>(max) << ".";
   }
-  if (class_id > 0) {
-    RETURN_IF_BCM_ERROR(
-        GetFieldMinMaxValue(unit, L3_IPV4_UC_ROUTE_VRFs, CLASS_IDs, &min,
-                            &max));
-    if ((class_id > static_cast<int>(max)) ||
-        (class_id < static_cast<int>(min))) {
-      return MAKE_ERROR(ERR_INVALID_PARAM)
-             << "Invalid class_id (" << class_id << "), valid class_id range is "
-             << static_cast<int>(min) << " - "
-             << static_cast<int>(max) << ".";
-    }
-  }
+  RETURN_IF_ERROR(CheckL3RouteClassId(unit, L3_IPV4_UC_ROUTE_VRFs, class_id));
   InUseMap* l3_egress_intf = gtl::FindOrNull(l3_egress_interface_ids_, unit);
   CHECK_RETURN_IF_FALSE(l3_egress_intf != nullptr)
       << "Unit " << unit
@@ -3300,18 +3448,7 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
            << static_cast<int>(min) << " - "
            << static_cast<int>(max) << ".";
   }
-  if (class_id > 0) {
-    RETURN_IF_BCM_ERROR(
-        GetFieldMinMaxValue(unit, L3_IPV6_UC_ROUTE_VRFs, CLASS_IDs, &min,
-                            &max));
-    if ((class_id > static_cast<int>(max)) ||
-        (class_id < static_cast<int>(min))) {
-      return MAKE_ERROR(ERR_INVALID_PARAM)
-             << "Invalid class_id (" << class_id << "), valid class_id range is "
-             << static_cast<int>(min) << " - "
-             << static_cast<int>(max) << ".";
-    }
-  }
+  RETURN_IF_ERROR(CheckL3RouteClassId(unit, L3_IPV6_UC_ROUTE_VRFs, class_id));
   InUseMap* l3_egress_intf = gtl::FindOrNull(l3_egress_interface_ids_, unit);
   CHECK_RETURN_IF_FALSE(l3_egress_intf != nullptr)
       << "Unit " << unit
@@ -3755,6 +3892,205 @@ BcmSdkWrapper::GetPortLinkscanMode(int unit, int port) {
   return ::util::OkStatus();
 }
 
+namespace {
+
+// Returns the LT table name used for the given L3 route type.
+const char* L3RouteBatchEntryTable(
+    BcmSdkInterface::L3RouteBatchEntry::Type type) {
+  switch (type) {
+    case BcmSdkInterface::L3RouteBatchEntry::Type::IPV4_LPM:
+      return L3_IPV4_UC_ROUTE_VRFs;
+    case BcmSdkInterface::L3RouteBatchEntry::Type::IPV4_HOST:
+      return L3_IPV4_UC_HOSTs;
+    case BcmSdkInterface::L3RouteBatchEntry::Type::IPV6_LPM:
+      return L3_IPV6_UC_ROUTE_VRFs;
+    case BcmSdkInterface::L3RouteBatchEntry::Type::IPV6_HOST:
+      return L3_IPV6_UC_HOSTs;
+  }
+  return nullptr;
+}
+
+// Returns the LT opcode used for the given L3 route operation.
+bcmlt_opcode_t L3RouteBatchEntryOpcode(
+    BcmSdkInterface::L3RouteBatchEntry::Op op) {
+  switch (op) {
+    case BcmSdkInterface::L3RouteBatchEntry::Op::ADD:
+      return BCMLT_OPCODE_INSERT;
+    case BcmSdkInterface::L3RouteBatchEntry::Op::MODIFY:
+      return BCMLT_OPCODE_UPDATE;
+    case BcmSdkInterface::L3RouteBatchEntry::Op::DELETE:
+      return BCMLT_OPCODE_DELETE;
+  }
+  return BCMLT_OPCODE_NOP;
+}
+
+// Populates the key and (for ADD/MODIFY) the data fields of an already
+// allocated LT entry for the given route.
+::util::Status FillL3RouteBatchEntryFields(
+    const BcmSdkInterface::L3RouteBatchEntry& route,
+    bcmlt_entry_handle_t entry_hdl) {
+  typedef BcmSdkInterface::L3RouteBatchEntry L3RouteBatchEntry;
+  RETURN_IF_BCM_ERROR(bcmlt_entry_field_add(entry_hdl, VRF_IDs, route.vrf));
+  switch (route.type) {
+    case L3RouteBatchEntry::Type::IPV4_LPM:
+      RETURN_IF_BCM_ERROR(bcmlt_entry_field_add(
+          entry_hdl, IPV4_MASKs,
+          (!route.subnet_ipv4 ? 0
+                              : (route.mask_ipv4 ? route.mask_ipv4
+                                                 : 0xffffffff))));
+      RETURN_IF_BCM_ERROR(
+          bcmlt_entry_field_add(entry_hdl, IPV4s, route.subnet_ipv4));
+      break;
+    case L3RouteBatchEntry::Type::IPV4_HOST:
+      RETURN_IF_BCM_ERROR(
+          bcmlt_entry_field_add(entry_hdl, IPV4s, route.subnet_ipv4));
+      break;
+    case L3RouteBatchEntry::Type::IPV6_LPM:
+      CHECK_RETURN_IF_FALSE(route.subnet_ipv6.size() == 16 &&
+                            route.mask_ipv6.size() == 16)
+          << "Invalid IPv6 subnet or mask size.";
+      RETURN_IF_BCM_ERROR(bcmlt_entry_field_add(
+          entry_hdl, IPV6_UPPER_MASKs,
+          ByteStreamToUint<uint64>(route.mask_ipv6.substr(0, 8))));
+      RETURN_IF_BCM_ERROR(bcmlt_entry_field_add(
+          entry_hdl, IPV6_LOWER_MASKs,
+          ByteStreamToUint<uint64>(route.mask_ipv6.substr(8, 16))));
+      ABSL_FALLTHROUGH_INTENDED;
+    case L3RouteBatchEntry::Type::IPV6_HOST:
+      CHECK_RETURN_IF_FALSE(route.subnet_ipv6.size() == 16)
+          << "Invalid IPv6 subnet size.";
+      RETURN_IF_BCM_ERROR(bcmlt_entry_field_add(
+          entry_hdl, IPV6_UPPERs,
+          ByteStreamToUint<uint64>(route.subnet_ipv6.substr(0, 8))));
+      RETURN_IF_BCM_ERROR(bcmlt_entry_field_add(
+          entry_hdl, IPV6_LOWERs,
+          ByteStreamToUint<uint64>(route.subnet_ipv6.substr(8, 16))));
+      break;
+  }
+  if (route.op == L3RouteBatchEntry::Op::DELETE) return ::util::OkStatus();
+  if (route.class_id > 0) {
+    RETURN_IF_BCM_ERROR(
+        bcmlt_entry_field_add(entry_hdl, CLASS_IDs, route.class_id));
+  }
+  RETURN_IF_BCM_ERROR(
+      bcmlt_entry_field_add(entry_hdl, ECMP_NHOPs, route.is_intf_multipath));
+  RETURN_IF_BCM_ERROR(bcmlt_entry_field_add(
+      entry_hdl, route.is_intf_multipath ? ECMP_IDs : NHOP_IDs,
+      route.egress_intf_id));
+
+  return ::util::OkStatus();
+}
+
+}  // namespace
+
+::util::Status BcmSdkWrapper::ProgramL3RoutesBatch(
+    int unit, const std::vector<L3RouteBatchEntry>& routes,
+    std::vector<::util::Status>* results) {
+  CHECK_RETURN_IF_FALSE(results != nullptr) << "Null results!";
+  // Check if the unit is valid
+  RETURN_IF_BCM_ERROR(CheckIfUnitExists(unit));
+  InUseMap* l3_egress_intf = gtl::FindOrNull(l3_egress_interface_ids_, unit);
+  InUseMap* ecmp_intfs = gtl::FindOrNull(l3_ecmp_egress_interface_ids_, unit);
+  CHECK_RETURN_IF_FALSE(l3_egress_intf != nullptr && ecmp_intfs != nullptr)
+      << "Unit " << unit
+      << " not initialized yet. Call InitializeUnit first.";
+  results->assign(routes.size(), ::util::OkStatus());
+  if (routes.empty()) return ::util::OkStatus();
+
+  // The VRF ranges are fetched once per table for the whole batch, instead of
+  // once per route as done by the single route APIs.
+  std::map<const char*, std::pair<uint64_t, uint64_t>> vrf_ranges;
+  bcmlt_transaction_hdl_t trans_hdl;
+  RETURN_IF_BCM_ERROR(
+      bcmlt_transaction_allocate(BCMLT_TRANS_TYPE_BATCH, &trans_hdl));
+  // The index of the route for each entry added to the transaction, in the
+  // order the entries were added.
+  std::vector<size_t> trans_entry_to_route;
+  trans_entry_to_route.reserve(routes.size());
+  for (size_t i = 0; i < routes.size(); ++i) {
+    const auto& route = routes[i];
+    const char* table = L3RouteBatchEntryTable(route.type);
+    ::util::Status& route_status = (*results)[i];
+    if (route.op != L3RouteBatchEntry::Op::DELETE) {
+      const InUseMap* intfs =
+          route.is_intf_multipath ? ecmp_intfs : l3_egress_intf;
+      auto it = intfs->find(route.egress_intf_id);
+      if (route.egress_intf_id <= 0 || it == intfs->end() || !it->second) {
+        route_status = MAKE_ERROR(ERR_INVALID_PARAM).without_logging()
+                  << "Invalid L3 Egress interface " << route.egress_intf_id
+                  << ".";
+        continue;
+      }
+    }
+    if (!vrf_ranges.count(table)) {
+      uint64_t min, max;
+      APPEND_STATUS_IF_BCM_ERROR(
+          route_status, GetFieldMinMaxValue(unit, table, VRF_IDs, &min, &max));
+      if (!route_status.ok()) continue;
+      vrf_ranges[table] = std::make_pair(min, max);
+    }
+    const auto& vrf_range = vrf_ranges[table];
+    if (route.vrf < static_cast<int>(vrf_range.first) ||
+        route.vrf > static_cast<int>(vrf_range.second)) {
+      route_status = MAKE_ERROR(ERR_INVALID_PARAM).without_logging()
+                << "Invalid vrf (" << route.vrf << "), valid vrf range is "
+                << static_cast<int>(vrf_range.first) << " - "
+                << static_cast<int>(vrf_range.second) << ".";
+      continue;
+    }
+    // As in the single route APIs, the class_id is checked for LPM routes.
+    if (route.op != L3RouteBatchEntry::Op::DELETE &&
+        (route.type == L3RouteBatchEntry::Type::IPV4_LPM ||
+         route.type == L3RouteBatchEntry::Type::IPV6_LPM)) {
+      route_status = CheckL3RouteClassId(unit, table, route.class_id);
+      if (!route_status.ok()) continue;
+    }
+    bcmlt_entry_handle_t entry_hdl;
+    APPEND_STATUS_IF_BCM_ERROR(route_status,
+                               bcmlt_entry_allocate(unit, table, &entry_hdl));
+    if (!route_status.ok()) continue;
+    route_status = FillL3RouteBatchEntryFields(route, entry_hdl);
+    if (route_status.ok()) {
+      APPEND_STATUS_IF_BCM_ERROR(
+          route_status, bcmlt_transaction_entry_add(
+                       trans_hdl, L3RouteBatchEntryOpcode(route.op),
+                       entry_hdl));
+    }
+    if (!route_status.ok()) {
+      bcmlt_entry_free(entry_hdl);
+      continue;
+    }
+    trans_entry_to_route.push_back(i);
+  }
+
+  ::util::Status status = ::util::OkStatus();
+  if (!trans_entry_to_route.empty()) {
+    // In a batch transaction, a failing entry does not prevent the rest from
+    // being committed. The overall result is therefore ignored here and the
+    // status of each entry is checked individually below.
+    bcmlt_transaction_commit(trans_hdl, BCMLT_PRIORITY_NORMAL);
+    for (size_t j = 0; j < trans_entry_to_route.size(); ++j) {
+      size_t i = trans_entry_to_route[j];
+      bcmlt_entry_info_t entry_info;
+      APPEND_STATUS_IF_BCM_ERROR(
+          (*results)[i],
+          bcmlt_transaction_entry_num_get(trans_hdl, j, &entry_info));
+      if (!(*results)[i].ok()) continue;
+      (*results)[i] =
+          L3RouteCommitStatus(unit, entry_info.status, routes[i].op,
+                              PrintL3RouteBatchEntry(routes[i]));
+    }
+  }
+  // Freeing the transaction also frees all the entries added to it.
+  APPEND_STATUS_IF_BCM_ERROR(status, bcmlt_transaction_free(trans_hdl));
+
+  VLOG(1) << "Programmed a batch of " << trans_entry_to_route.size()
+          << " out of " << routes.size() << " L3 routes on unit " << unit
+          << ".";
+
+  return status;
+}
+
 ::util::StatusOr<int> BcmSdkWrapper::AddMyStationEntry(int unit, int priority,
                                                        int vlan, int vlan_mask,
                                                        uint64 dst_mac,
@@ -7560,7 +7896,7 @@ void BcmSdkWrapper::OnLinkscanEvent(int unit, int port, PortState linkstatus) {
   } else {
     state = PORT_STATE_UNKNOWN;
   }
-  LinkscanEvent event = {unit, port, state};
+  LinkscanEvent event = {unit, port, state, absl::Now()};
 
   {
     absl::ReaderMutexLock l(&linkscan_writers_lock_);
@@ -153,6 +153,9 @@ class BcmSdkWrapper : public BcmSdkInterface {
       int unit, int egress_intf_id,
       const std::vector<int>& member_ids) override;
   ::util::Status DeleteEcmpEgressIntf(int unit, int egress_intf_id) override;
+  ::util::Status ModifyEcmpEgressIntfsBatch(
+      int unit, const std::vector<EcmpEgressIntfBatchEntry>& intfs,
+      std::vector<::util::Status>* results) override;
   ::util::Status AddL3RouteIpv4(int unit, int vrf, uint32 subnet, uint32 mask,
                                 int class_id, int egress_intf_id,
                                 bool is_intf_multipath) override;
@@ -183,6 +186,9 @@ class BcmSdkWrapper : public BcmSdkInterface {
   ::util::Status DeleteL3HostIpv4(int unit, int vrf, uint32 ipv4) override;
   ::util::Status DeleteL3HostIpv6(int unit, int vrf,
                                   const std::string& ipv6) override;
+  ::util::Status ProgramL3RoutesBatch(
+      int unit, const std::vector<L3RouteBatchEntry>& routes,
+      std::vector<::util::Status>* results) override;
   ::util::StatusOr<int> AddMyStationEntry(int unit, int priority, int vlan,
                                           int vlan_mask, uint64 dst_mac,
                                           uint64 dst_mac_mask) override;
@@ -31,6 +31,7 @@
 #include "absl/synchronization/mutex.h"
 #include "absl/time/clock.h"
 #include "stratum/glue/gtl/map_util.h"
+#include "stratum/hal/lib/bcm/utils.h"
 
 namespace stratum {
 namespace hal {
@@ -65,13 +66,39 @@ BcmSwitch::~BcmSwitch() {}
   ASSIGN_OR_RETURN(const auto& node_id_to_unit,
                    bcm_chassis_manager_->GetNodeIdToUnitMap());
   node_id_to_bcm_node_.clear();
+  std::vector<int> units;
+  std::map<int, uint64> unit_to_node_id;
+  std::map<int, BcmNode*> unit_to_bcm_node;
+  std::map<int, bool> unit_to_pushed;
   for (const auto& entry : node_id_to_unit) {
     uint64 node_id = entry.first;
     int unit = entry.second;
     ASSIGN_OR_RETURN(auto* bcm_node, GetBcmNodeFromUnit(unit));
-    RETURN_IF_ERROR(bcm_node->PushChassisConfig(config, node_id));
-    node_id_to_bcm_node_[node_id] = bcm_node;
+    units.push_back(unit);
+    unit_to_node_id[unit] = node_id;
+    unit_to_bcm_node[unit] = bcm_node;
+    unit_to_pushed[unit] = false;
   }
+  // The nodes do not share any state other than what is read from the chassis
+  // manager, so the config is pushed to all of them in parallel. This thread
+  // holds chassis_lock until all the pushes are done, which the analysis
+  // cannot see from the workers. Each push only writes the entry of its own
+  // unit in unit_to_pushed.
+  ::util::Status status = RunForEachUnit(
+      "Chassis config push", units,
+      [&config, &unit_to_node_id, &unit_to_bcm_node, &unit_to_pushed](int unit)
+          NO_THREAD_SAFETY_ANALYSIS -> ::util::Status {
+        RETURN_IF_ERROR(unit_to_bcm_node.at(unit)->PushChassisConfig(
+            config, unit_to_node_id.at(unit)));
+        unit_to_pushed.at(unit) = true;
+        return ::util::OkStatus();
+      });
+  for (int unit : units) {
+    if (unit_to_pushed[unit]) {
+      node_id_to_bcm_node_[unit_to_node_id[unit]] = unit_to_bcm_node[unit];
+    }
+  }
+  RETURN_IF_ERROR(status);
 
   LOG(INFO) << "Chassis config pushed successfully.";
 
@@ -141,11 +168,14 @@ BcmSwitch::~BcmSwitch() {}
   }
 
   // Shutdown all the managers and then PHAL at the end.
-  ::util::Status status = ::util::OkStatus();
-  for (const auto& entry : unit_to_bcm_node_) {
-    BcmNode* bcm_node = entry.second;
-    APPEND_STATUS_IF_ERROR(status, bcm_node->Shutdown());
-  }
+  // The nodes are shut down in parallel. The chassis manager shuts down the
+  // SDK, which is shared by all the units, so it goes after all the nodes.
+  std::vector<int> units;
+  for (const auto& entry : unit_to_bcm_node_) units.push_back(entry.first);
+  ::util::Status status =
+      RunForEachUnit("Node shutdown", units, [this](int unit) {
+        return unit_to_bcm_node_.at(unit)->Shutdown();
+      });
   APPEND_STATUS_IF_ERROR(status, bcm_chassis_manager_->Shutdown());
   APPEND_STATUS_IF_ERROR(status, phal_interface_->Shutdown());
   node_id_to_bcm_node_.clear();
@@ -253,10 +283,42 @@ BcmSwitch::~BcmSwitch() {}
   return ::util::OkStatus();
 }
 
+namespace {
+
+// Returns true if the given request is served by RetrievePortStateValue().
+bool IsPortStateRequest(const DataRequest::Request& req) {
+  switch (req.request_case()) {
+    case DataRequest::Request::kOperStatus:
+    case DataRequest::Request::kAdminStatus:
+    case DataRequest::Request::kPortSpeed:
+      return true;
+    default:
+      return false;
+  }
+}
+
+}  // namespace
+
 ::util::Status BcmSwitch::RetrieveValue(uint64 /*node_id*/,
                                         const DataRequest& request,
                                         WriterInterface<DataResponse>* writer,
                                         std::vector<::util::Status>* details) {
+  if (shutdown) {
+    return MAKE_ERROR(ERR_CANCELLED) << "Switch is shutdown.";
+  }
+  // The port state requests, which make up most of the gNMI polling, do not
+  // contend with the writers of chassis_lock, e.g. linkscan events.
+  if (std::all_of(request.requests().begin(), request.requests().end(),
+                  IsPortStateRequest)) {
+    for (const auto& req : request.requests()) {
+      DataResponse resp;
+      ::util::Status status = RetrievePortStateValue(req, &resp);
+      if (status.ok()) writer->Write(resp);
+      if (details) details->push_back(status);
+    }
+    return ::util::OkStatus();
+  }
+
   absl::ReaderMutexLock l(&chassis_lock);
   if (shutdown) {
     return MAKE_ERROR(ERR_CANCELLED) << "Switch is shutdown.";
@@ -266,40 +328,11 @@ BcmSwitch::~BcmSwitch() {}
     DataResponse resp;
     ::util::Status status = ::util::OkStatus();
     switch (req.request_case()) {
-      // Get singleton port operational state.
-      case DataRequest::Request::kOperStatus: {
-        auto port_state = bcm_chassis_manager_->GetPortState(
-            req.oper_status().node_id(), req.oper_status().port_id());
-        if (!port_state.ok()) {
-          status.Update(port_state.status());
-        } else {
-          resp.mutable_oper_status()->set_state(port_state.ValueOrDie());
-        }
+      case DataRequest::Request::kOperStatus:
+      case DataRequest::Request::kAdminStatus:
+      case DataRequest::Request::kPortSpeed:
+        status = RetrievePortStateValue(req, &resp);
         break;
-      }
-      // Get singleton port admin state.
-      case DataRequest::Request::kAdminStatus: {
-        auto admin_state = bcm_chassis_manager_->GetPortAdminState(
-            req.admin_status().node_id(), req.admin_status().port_id());
-        if (!admin_state.ok()) {
-          status.Update(admin_state.status());
-        } else {
-          resp.mutable_admin_status()->set_state(admin_state.ValueOrDie());
-        }
-        break;
-      }
-      // Get configured singleton port speed in bits per second.
-      case DataRequest::Request::kPortSpeed: {
-        auto bcm_port = bcm_chassis_manager_->GetBcmPort(
-            req.port_speed().node_id(), req.port_speed().port_id());
-        if (!bcm_port.ok()) {
-          status.Update(bcm_port.status());
-        } else {
-          resp.mutable_port_speed()->set_speed_bps(
-              bcm_port.ValueOrDie().speed_bps());
-        }
-        break;
-      }
       case DataRequest::Request::kLacpRouterMac:
         // Find LACP System ID MAC address of port located at:
         // - node_id: req.lacp_router_mac().node_id()
@@ -394,13 +427,19 @@ BcmSwitch::~BcmSwitch() {}
         counters->set_queue_id(req.port_qos_counters().queue_id());
         break;
       }
-      case DataRequest::Request::kNodePacketioDebugInfo:
-        // Find current debug info for node located at:
-        // - node_id: req.node_packet_io_debug_info().node_id()
-        // and then write it into the response.
-        resp.mutable_node_packetio_debug_info()->set_debug_string(
-            "A (sample) node debug string.");
+      case DataRequest::Request::kNodePacketioDebugInfo: {
+        // The packet I/O stats of the node, including the per-CoS RX queue
+        // stats of its KNET interfaces.
+        auto bcm_node =
+            GetBcmNodeFromNodeId(req.node_packetio_debug_info().node_id());
+        if (!bcm_node.ok()) {
+          status.Update(bcm_node.status());
+        } else {
+          resp.mutable_node_packetio_debug_info()->set_debug_string(
+              bcm_node.ValueOrDie()->DumpPacketioStats());
+        }
         break;
+      }
       default:
         status = MAKE_ERROR(ERR_INTERNAL) << "Not supported yet!";
     }
@@ -512,6 +551,41 @@ std::unique_ptr<BcmSwitch> BcmSwitch::CreateInstance(
   return status;
 }
 
+::util::Status BcmSwitch::RetrievePortStateValue(
+    const DataRequest::Request& req, DataResponse* resp) const {
+  switch (req.request_case()) {
+    // Get singleton port operational state.
+    case DataRequest::Request::kOperStatus: {
+      auto port_state = bcm_chassis_manager_->GetPortState(
+          req.oper_status().node_id(), req.oper_status().port_id());
+      if (!port_state.ok()) return port_state.status();
+      resp->mutable_oper_status()->set_state(port_state.ValueOrDie());
+      break;
+    }
+    // Get singleton port admin state.
+    case DataRequest::Request::kAdminStatus: {
+      auto admin_state = bcm_chassis_manager_->GetPortAdminState(
+          req.admin_status().node_id(), req.admin_status().port_id());
+      if (!admin_state.ok()) return admin_state.status();
+      resp->mutable_admin_status()->set_state(admin_state.ValueOrDie());
+      break;
+    }
+    // Get configured singleton port speed in bits per second.
+    case DataRequest::Request::kPortSpeed: {
+      auto bcm_port = bcm_chassis_manager_->GetBcmPort(
+          req.port_speed().node_id(), req.port_speed().port_id());
+      if (!bcm_port.ok()) return bcm_port.status();
+      resp->mutable_port_speed()->set_speed_bps(
+          bcm_port.ValueOrDie().speed_bps());
+      break;
+    }
+    default:
+      return MAKE_ERROR(ERR_INTERNAL) << "Not a port state request.";
+  }
+
+  return ::util::OkStatus();
+}
+
 ::util::StatusOr<BcmNode*> BcmSwitch::GetBcmNodeFromUnit(int unit) const {
   BcmNode* bcm_node = gtl::FindPtrOrNull(unit_to_bcm_node_, unit);
   if (bcm_node == nullptr) {
@@ -115,6 +115,12 @@ class BcmSwitch : public SwitchInterface {
       uint64 node_id, const ::p4::v1::ForwardingPipelineConfig& config)
       SHARED_LOCKS_REQUIRED(chassis_lock);
 
+  // Retrieves a singleton port oper status, admin status or speed. These are
+  // served from the ChassisStateSnapshot of BcmChassisManager and do not need
+  // chassis_lock.
+  ::util::Status RetrievePortStateValue(const DataRequest::Request& req,
+                                        DataResponse* resp) const;
+
   // Helper to get BcmNode pointer from unit number or return error indicating
   // invalid unit.
   ::util::StatusOr<BcmNode*> GetBcmNodeFromUnit(int unit) const;
@@ -32,6 +32,7 @@
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
 
 using ::testing::_;
 using ::testing::DoAll;
@@ -542,6 +543,51 @@ TEST_F(BcmSwitchTest, GetPortSpeed) {
   EXPECT_EQ(error.ToString(), details.at(0).ToString());
 }
 
+TEST_F(BcmSwitchTest, GetPortStateDoesNotNeedChassisLock) {
+  PushChassisConfigSuccess();
+
+  WriterMock<DataResponse> writer;
+  DataResponse resp;
+
+  EXPECT_CALL(*bcm_chassis_manager_mock_, GetPortState(kNodeId, kPortId))
+      .WillOnce(Return(PORT_STATE_UP));
+  ExpectMockWriteDataResponse(&writer, &resp);
+
+  DataRequest req;
+  auto* req_info = req.add_requests()->mutable_oper_status();
+  req_info->set_node_id(kNodeId);
+  req_info->set_port_id(kPortId);
+  std::vector<::util::Status> details;
+
+  // E.g. a linkscan event being handled.
+  absl::WriterMutexLock l(&chassis_lock);
+  EXPECT_OK(bcm_switch_->RetrieveValue(kNodeId, req, &writer, &details));
+  EXPECT_TRUE(resp.has_oper_status());
+  EXPECT_EQ(PORT_STATE_UP, resp.oper_status().state());
+  ASSERT_EQ(details.size(), 1);
+  EXPECT_THAT(details.at(0), ::util::OkStatus());
+}
+
+TEST_F(BcmSwitchTest, GetPortStateFailsAfterShutdown) {
+  PushChassisConfigSuccess();
+
+  WriterMock<DataResponse> writer;
+  EXPECT_CALL(*bcm_chassis_manager_mock_, GetPortState(_, _)).Times(0);
+  EXPECT_CALL(writer, Write(_)).Times(0);
+
+  DataRequest req;
+  auto* req_info = req.add_requests()->mutable_oper_status();
+  req_info->set_node_id(kNodeId);
+  req_info->set_port_id(kPortId);
+  std::vector<::util::Status> details;
+
+  shutdown = true;
+  ::util::Status status =
+      bcm_switch_->RetrieveValue(kNodeId, req, &writer, &details);
+  EXPECT_EQ(ERR_CANCELLED, status.error_code());
+  EXPECT_TRUE(details.empty());
+}
+
 TEST_F(BcmSwitchTest, GetMemoryErrorAlarmStatePass) {
   WriterMock<DataResponse> writer;
   DataResponse resp;
@@ -630,22 +676,45 @@ TEST_F(BcmSwitchTest, GetQosQueueCountersPass) {
 }
 
 TEST_F(BcmSwitchTest, GetNodePacketIoDebugInfoPass) {
+  PushChassisConfigSuccess();
+
   WriterMock<DataResponse> writer;
   DataResponse resp;
   // Expect Write() call and store data in resp.
   ExpectMockWriteDataResponse(&writer, &resp);
+  const std::string kDebugString =
+      "RX stats for KNET intf BCM_KNET_INTF_PURPOSE_CONTROLLER: (all_rx:1)";
+  EXPECT_CALL(*bcm_node_mock_, DumpPacketioStats())
+      .WillOnce(Return(kDebugString));
 
   DataRequest req;
   auto* request = req.add_requests()->mutable_node_packetio_debug_info();
-  request->set_node_id(1);
+  request->set_node_id(kNodeId);
 
   std::vector<::util::Status> details;
   EXPECT_OK(bcm_switch_->RetrieveValue(kNodeId, req, &writer, &details));
   EXPECT_TRUE(resp.has_node_packetio_debug_info());
+  EXPECT_EQ(kDebugString, resp.node_packetio_debug_info().debug_string());
   ASSERT_EQ(details.size(), 1);
   EXPECT_THAT(details.at(0), ::util::OkStatus());
 }
 
+TEST_F(BcmSwitchTest, GetNodePacketIoDebugInfoFailsForUnknownNode) {
+  PushChassisConfigSuccess();
+
+  WriterMock<DataResponse> writer;
+  EXPECT_CALL(writer, Write(_)).Times(0);
+
+  DataRequest req;
+  auto* request = req.add_requests()->mutable_node_packetio_debug_info();
+  request->set_node_id(kNodeId + 1);
+
+  std::vector<::util::Status> details;
+  EXPECT_OK(bcm_switch_->RetrieveValue(kNodeId, req, &writer, &details));
+  ASSERT_EQ(details.size(), 1);
+  EXPECT_EQ(ERR_INVALID_PARAM, details.at(0).error_code());
+}
+
 TEST_F(BcmSwitchTest, SetPortAdminStatusPass) {
   SetRequest req;
   auto* request = req.add_requests()->mutable_port();
@@ -958,12 +958,12 @@ namespace {
   if (result.ok()) {
     RETURN_IF_ERROR(result.ValueOrDie()->InsertEntry(table_entry));
   } else {
-    ::p4::config::v1::Table p4_table;
-    RETURN_IF_ERROR_WITH_APPEND(
-        p4_table_mapper_->LookupTable(table_id, &p4_table))
+    ::util::StatusOr<const ::p4::config::v1::Table*> p4_table =
+        p4_table_mapper_->FindTable(table_id);
+    RETURN_IF_ERROR_WITH_APPEND(p4_table.status())
         << "Table entry refers to unknown table id " << table_id << ".";
     auto table_result =
-        generic_flow_tables_.emplace(std::make_pair(table_id, p4_table));
+        generic_flow_tables_.emplace(table_id, *p4_table.ValueOrDie());
     if (!table_result.second) {
       return MAKE_ERROR(ERR_INTERNAL)
              << "Failed to add new table with id " << table_id << ".";
@@ -1034,9 +1034,14 @@ namespace {
   }
 
   // If this is the last entry in a generic table, remove the generic table.
-  auto table_iter = generic_flow_tables_.find(table_id);
-  if (table_iter != generic_flow_tables_.end() && table_iter->second.Empty()) {
-    generic_flow_tables_.erase(table_iter);
+  // ACL flows may be written concurrently with other flows (see BcmNode), so
+  // they must never touch generic_flow_tables_.
+  if (!IsAclTable(table_id)) {
+    auto table_iter = generic_flow_tables_.find(table_id);
+    if (table_iter != generic_flow_tables_.end() &&
+        table_iter->second.Empty()) {
+      generic_flow_tables_.erase(table_iter);
+    }
   }
 
   return ::util::OkStatus();
@@ -1558,8 +1563,8 @@ std::set<uint32> BcmTableManager::GetAllAclTableIDs() const {
     for (const auto& pair : generic_flow_tables_) {
       // We shouldn't return static flows.
       if (pair.second.IsConst()) continue;
-      for (const auto& table_entry : pair.second) {
-        *resp->add_entities()->mutable_table_entry() = table_entry;
+      for (auto table_entry : pair.second) {
+        *resp->add_entities()->mutable_table_entry() = std::move(table_entry);
       }
     }
     // Acl entries should also be recorded in acl_flows. These are pointers to
@@ -1567,9 +1572,9 @@ std::set<uint32> BcmTableManager::GetAllAclTableIDs() const {
     for (const auto& pair : acl_tables_) {
       // We shouldn't return static flows.
       if (pair.second.IsConst()) continue;
-      for (const auto& table_entry : pair.second) {
+      for (auto table_entry : pair.second) {
         auto entry_ptr = resp->add_entities()->mutable_table_entry();
-        *entry_ptr = table_entry;
+        *entry_ptr = std::move(table_entry);
         acl_flows->push_back(entry_ptr);
       }
     }
@@ -1583,9 +1588,9 @@ std::set<uint32> BcmTableManager::GetAllAclTableIDs() const {
         if (acl_lookup->IsConst()) continue;
         // Acl entries should also be recorded in acl_flows. These are pointers
         // to the acl entries in resp.
-        for (const auto& table_entry : *acl_lookup) {
+        for (auto table_entry : *acl_lookup) {
           auto entry_ptr = resp->add_entities()->mutable_table_entry();
-          *entry_ptr = table_entry;
+          *entry_ptr = std::move(table_entry);
           acl_flows->push_back(entry_ptr);
         }
         continue;
@@ -1596,8 +1601,8 @@ std::set<uint32> BcmTableManager::GetAllAclTableIDs() const {
       if (lookup) {
         // We shouldn't return static flows.
         if (lookup->IsConst()) continue;
-        for (const auto& table_entry : *lookup) {
-          *resp->add_entities()->mutable_table_entry() = table_entry;
+        for (auto table_entry : *lookup) {
+          *resp->add_entities()->mutable_table_entry() = std::move(table_entry);
         }
       }
     }
@@ -1606,6 +1611,41 @@ std::set<uint32> BcmTableManager::GetAllAclTableIDs() const {
   return ::util::OkStatus();
 }
 
+::util::Status BcmTableManager::SnapshotTableEntries(
+    const std::set<uint32>& table_ids,
+    std::vector<BcmFlowTableSnapshot>* snapshots) const {
+  if (snapshots == nullptr) {
+    return MAKE_ERROR(ERR_INTERNAL) << "Null snapshots.";
+  }
+  auto add_snapshot = [snapshots](const BcmFlowTable& table, bool is_acl) {
+    // We shouldn't return static flows.
+    if (table.IsConst() || table.Empty()) return;
+    snapshots->emplace_back();
+    snapshots->back().table_id = table.Id();
+    snapshots->back().is_acl = is_acl;
+    table.Snapshot(&snapshots->back().entries);
+  };
+  if (table_ids.empty()) {
+    for (const auto& pair : generic_flow_tables_) {
+      add_snapshot(pair.second, false);
+    }
+    for (const auto& pair : acl_tables_) add_snapshot(pair.second, true);
+  } else {
+    for (uint32 table_id : table_ids) {
+      const AclTable* acl_lookup = gtl::FindOrNull(acl_tables_, table_id);
+      if (acl_lookup) {
+        add_snapshot(*acl_lookup, true);
+        continue;
+      }
+      const BcmFlowTable* lookup =
+          gtl::FindOrNull(generic_flow_tables_, table_id);
+      if (lookup) add_snapshot(*lookup, false);
+    }
+  }
+
+  return ::util::OkStatus();
+}
+
 ::util::StatusOr<::p4::v1::TableEntry> BcmTableManager::LookupTableEntry(
     const ::p4::v1::TableEntry& entry) const {
   ASSIGN_OR_RETURN(
@@ -2284,33 +2324,50 @@ BcmTableManager::GetBcmMultipathNexthopInfo(uint32 group_id) const {
 
 ::util::StatusOr<BcmFlowTable*> BcmTableManager::GetMutableFlowTable(
     uint32 table_id) {
-  auto generic_lookup = generic_flow_tables_.find(table_id);
-  if (generic_lookup != generic_flow_tables_.end()) {
-    return &(generic_lookup->second);
-  }
+  // ACL tables are looked up first, so ACL flows never read
+  // generic_flow_tables_ which may be concurrently modified.
   auto acl_lookup = acl_tables_.find(table_id);
   if (acl_lookup != acl_tables_.end()) {
     return &(acl_lookup->second);
   }
+  auto generic_lookup = generic_flow_tables_.find(table_id);
+  if (generic_lookup != generic_flow_tables_.end()) {
+    return &(generic_lookup->second);
+  }
   return MAKE_ERROR(ERR_ENTRY_NOT_FOUND).without_logging()
          << "Table " << table_id << " not present.";
 }
 
 ::util::StatusOr<const BcmFlowTable*> BcmTableManager::GetConstantFlowTable(
     uint32 table_id) const {
-  const auto generic_lookup = generic_flow_tables_.find(table_id);
-  if (generic_lookup != generic_flow_tables_.end()) {
-    return &(generic_lookup->second);
-  }
   const auto acl_lookup = acl_tables_.find(table_id);
   if (acl_lookup != acl_tables_.end()) {
     return &(acl_lookup->second);
   }
+  const auto generic_lookup = generic_flow_tables_.find(table_id);
+  if (generic_lookup != generic_flow_tables_.end()) {
+    return &(generic_lookup->second);
+  }
 
   return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
          << "Table " << table_id << " not present.";
 }
 
+::util::StatusOr<size_t> BcmTableManager::GetTableMemoryUsage(
+    uint32 table_id) const {
+  ASSIGN_OR_RETURN(const BcmFlowTable* table, GetConstantFlowTable(table_id));
+  return table->MemoryUsage();
+}
+
+size_t BcmTableManager::GetTotalTableMemoryUsage() const {
+  size_t bytes = 0;
+  for (const auto& pair : generic_flow_tables_) {
+    bytes += pair.second.MemoryUsage();
+  }
+  for (const auto& pair : acl_tables_) bytes += pair.second.MemoryUsage();
+  return bytes;
+}
+
 bool BcmTableManager::HasTable(uint32 table_id) const {
   if (generic_flow_tables_.count(table_id)) return true;
   if (acl_tables_.count(table_id)) return true;
@@ -83,6 +83,18 @@ struct BcmMultipathNexthopInfo {
       : egress_intf_id(-1), flow_ref_count(0), member_id_to_weight() {}
 };
 
+// This struct holds a point-in-time copy of the entries of a flow table, as
+// returned by BcmTableManager::SnapshotTableEntries().
+struct BcmFlowTableSnapshot {
+  // P4 table ID.
+  uint32 table_id;
+  // True if this is an ACL table, i.e. its entries have counters to be read.
+  bool is_acl;
+  // The entries in packed form.
+  std::vector<PackedTableEntry> entries;
+  BcmFlowTableSnapshot() : table_id(0), is_acl(false), entries() {}
+};
+
 // The "BcmTableManager" class implements the L3 routing functionality.
 class BcmTableManager {
  public:
@@ -321,10 +333,33 @@ class BcmTableManager {
   // Returns the set of all known ACL table ids.
   virtual std::set<uint32> GetAllAclTableIDs() const;
 
+  // Returns true if the given table id refers to a known ACL table. The set of
+  // ACL tables only changes on forwarding pipeline config push, so this is safe
+  // to call while flows are being written.
+  virtual bool IsAclTable(uint32 table_id) const;
+
+  // Returns the approximate number of bytes of memory used to store the
+  // entries of the given table. Returns ERR_ENTRY_NOT_FOUND if the table
+  // cannot be found.
+  virtual ::util::StatusOr<size_t> GetTableMemoryUsage(uint32 table_id) const;
+
+  // Returns the approximate number of bytes of memory used to store the
+  // entries of all the tables.
+  virtual size_t GetTotalTableMemoryUsage() const;
+
   // Delete all entries in a table and delete the table itself. This is the only
   // way to fully remove an ACL table.
   virtual ::util::Status DeleteTable(uint32 table_id);
 
+  // Takes a snapshot of the P4 TableEntry(s) programmed in the given set of
+  // tables (given by table_ids) on the node. If table_ids is empty, takes a
+  // snapshot of all the entries programmed on the node. Entries of const tables
+  // are skipped. The snapshot keeps the entries in packed form, which makes it
+  // cheap to take while holding the node locks.
+  virtual ::util::Status SnapshotTableEntries(
+      const std::set<uint32>& table_ids,
+      std::vector<BcmFlowTableSnapshot>* snapshots) const;
+
   // Reads the P4 TableEntry(s) programmed in the given set of tables
   // (given by table_ids) on the node. If table_ids is empty, return all the
   // entries programmed on the node. Assembles a list of pointers to the
@@ -481,8 +516,6 @@ class BcmTableManager {
   // Returns true if this BcmTableManager has a table with the given table id.
   bool HasTable(uint32 table_id) const;
 
-  // Returns true if the given table id refers to a known ACL table.
-  bool IsAclTable(uint32 table_id) const;
 
   // ***************************************************************************
   // Port/trunk Maps
@@ -121,7 +121,12 @@ class BcmTableManagerMock : public BcmTableManager {
   MOCK_CONST_METHOD1(GetReadOnlyAclTable,
                      ::util::StatusOr<const AclTable*>(uint32 table_id));
   MOCK_CONST_METHOD0(GetAllAclTableIDs, std::set<uint32>());
+  MOCK_CONST_METHOD1(IsAclTable, bool(uint32 table_id));
   MOCK_METHOD1(DeleteTable, ::util::Status(uint32 table_id));
+  MOCK_CONST_METHOD2(
+      SnapshotTableEntries,
+      ::util::Status(const std::set<uint32>& table_ids,
+                     std::vector<BcmFlowTableSnapshot>* snapshots));
   MOCK_CONST_METHOD3(
       ReadTableEntries,
       ::util::Status(const std::set<uint32>& table_ids,
@@ -4418,6 +4418,67 @@ TEST_F(BcmTableManagerTest, ReadActionProfileMembersSuccess) {
   }
 }
 
+TEST_F(BcmTableManagerTest, SnapshotTableEntriesSuccess) {
+  ASSERT_NO_FATAL_FAILURE(PushTestConfig());
+
+  // Nothing to snapshot before anything is added.
+  std::vector<BcmFlowTableSnapshot> snapshots;
+  ASSERT_OK(bcm_table_manager_->SnapshotTableEntries({}, &snapshots));
+  EXPECT_TRUE(snapshots.empty());
+
+  ::p4::v1::ActionProfileMember member1;
+  ::p4::v1::TableEntry entry1, entry2;
+
+  member1.set_member_id(kMemberId1);
+  member1.set_action_profile_id(kActionProfileId1);
+
+  entry1.set_table_id(kTableId1);
+  entry1.add_match()->set_field_id(kFieldId1);
+  entry1.mutable_action()->set_action_profile_member_id(kMemberId1);
+  entry2.set_table_id(100);
+  entry2.add_match()->set_field_id(kFieldId1);
+  entry2.set_priority(10);
+
+  AclTable acl_table = CreateAclTable(
+      /*p4_id=*/100, /*match_fields=*/{kFieldId1},
+      /*stage=*/BCM_ACL_STAGE_IFP, /*size=*/10,
+      /*priority=*/20, /*physical_table_id=*/1);
+  ASSERT_OK(bcm_table_manager_->AddAclTable(acl_table));
+  ASSERT_OK(bcm_table_manager_->AddActionProfileMember(
+      member1, BcmNonMultipathNexthop::NEXTHOP_TYPE_PORT, kEgressIntfId1,
+      kLogicalPort1));
+  ASSERT_OK(bcm_table_manager_->AddTableEntry(entry1));
+  ASSERT_OK(bcm_table_manager_->AddTableEntry(entry2));
+
+  // Snapshot of all the tables.
+  ASSERT_OK(bcm_table_manager_->SnapshotTableEntries({}, &snapshots));
+  ASSERT_EQ(2U, snapshots.size());
+  EXPECT_EQ(kTableId1, snapshots[0].table_id);
+  EXPECT_FALSE(snapshots[0].is_acl);
+  ASSERT_EQ(1U, snapshots[0].entries.size());
+  EXPECT_THAT(snapshots[0].entries[0].Unpack(),
+              IsOkAndHolds(EqualsProto(entry1)));
+  EXPECT_EQ(100U, snapshots[1].table_id);
+  EXPECT_TRUE(snapshots[1].is_acl);
+  ASSERT_EQ(1U, snapshots[1].entries.size());
+  EXPECT_THAT(snapshots[1].entries[0].Unpack(),
+              IsOkAndHolds(EqualsProto(entry2)));
+
+  // Snapshot of a given table. Unknown tables are ignored.
+  snapshots.clear();
+  ASSERT_OK(
+      bcm_table_manager_->SnapshotTableEntries({100, kTableId2}, &snapshots));
+  ASSERT_EQ(1U, snapshots.size());
+  EXPECT_EQ(100U, snapshots[0].table_id);
+  EXPECT_TRUE(snapshots[0].is_acl);
+
+  // The snapshot is not affected by later changes to the table.
+  ASSERT_OK(bcm_table_manager_->DeleteTableEntry(entry2));
+  ASSERT_EQ(1U, snapshots[0].entries.size());
+  EXPECT_THAT(snapshots[0].entries[0].Unpack(),
+              IsOkAndHolds(EqualsProto(entry2)));
+}
+
 TEST_F(BcmTableManagerTest,
        CommonFlowEntryToBcmFlowEntry_AclWithMultipleConstConditions) {
   ASSERT_NO_FATAL_FAILURE(PushTestConfig());
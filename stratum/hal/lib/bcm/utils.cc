@@ -16,10 +16,23 @@
 
 #include "stratum/hal/lib/bcm/utils.h"
 
+#include <algorithm>
 #include <sstream>  // IWYU pragma: keep
 
+#include "gflags/gflags.h"
+#include "stratum/glue/logging.h"
 #include "stratum/hal/lib/common/utils.h"
+#include "stratum/hal/lib/phal/work_stealing_threadpool.h"
 #include "stratum/lib/constants.h"
+#include "stratum/lib/macros.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+DEFINE_int32(bcm_max_parallel_units, 8,
+             "Max number of units initialized, configured or shut down in "
+             "parallel. The default covers all the units of the supported "
+             "chassis. Set to 1 to handle the units one at a time, as "
+             "before.");
 
 namespace stratum {
 namespace hal {
@@ -81,6 +94,50 @@ std::string PrintBcmPortOptions(const BcmPortOptions& options) {
   return buffer.str();
 }
 
+::util::Status RunForEachUnit(const std::string& phase,
+                              const std::vector<int>& units,
+                              const std::function<::util::Status(int)>& func) {
+  const absl::Time start = absl::Now();
+  std::vector<::util::Status> statuses(units.size(), ::util::OkStatus());
+  std::vector<absl::Duration> durations(units.size());
+  auto run = [&](size_t i) {
+    const absl::Time unit_start = absl::Now();
+    statuses[i] = func(units[i]);
+    durations[i] = absl::Now() - unit_start;
+  };
+
+  const int num_threads = std::min(std::max(FLAGS_bcm_max_parallel_units, 1),
+                                   static_cast<int>(units.size()));
+  if (num_threads <= 1) {
+    // Nothing to gain from extra threads. Run on the calling thread.
+    for (size_t i = 0; i < units.size(); ++i) run(i);
+  } else {
+    // The calling thread runs the queued units too while it waits, so the pool
+    // needs one worker less than the number of units run in parallel.
+    phal::WorkStealingThreadpool pool(num_threads - 1);
+    pool.Start();
+    std::vector<phal::TaskId> tasks;
+    tasks.reserve(units.size());
+    for (size_t i = 0; i < units.size(); ++i) {
+      tasks.push_back(pool.Schedule([&run, i]() { run(i); }));
+    }
+    pool.WaitAll(tasks);
+  }
+
+  ::util::Status status = ::util::OkStatus();
+  for (size_t i = 0; i < units.size(); ++i) {
+    LOG(INFO) << phase << " on unit " << units[i] << " took "
+              << absl::FormatDuration(durations[i])
+              << (statuses[i].ok() ? "." : " and failed.");
+    APPEND_STATUS_IF_ERROR(status, statuses[i]);
+  }
+  LOG(INFO) << phase << " on " << units.size() << " unit(s) took "
+            << absl::FormatDuration(absl::Now() - start) << " with up to "
+            << num_threads << " unit(s) in parallel.";
+
+  return status;
+}
+
 }  // namespace bcm
 }  // namespace hal
 }  // namespace stratum
@@ -19,10 +19,14 @@
 #ifndef STRATUM_HAL_LIB_BCM_UTILS_H_
 #define STRATUM_HAL_LIB_BCM_UTILS_H_
 
+#include <functional>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "stratum/hal/lib/bcm/bcm.pb.h"
 #include "stratum/glue/integral_types.h"
+#include "stratum/glue/status/status.h"
 #include "absl/strings/str_cat.h"
 
 namespace stratum {
@@ -47,6 +51,10 @@ struct SdkPort {
   std::string ToString() const {
     return absl::StrCat("(unit: ", unit, ", logical_port: ", logical_port, ")");
   }
+  template <typename H>
+  friend H AbslHashValue(H h, const SdkPort& p) {
+    return H::combine(std::move(h), p.unit, p.logical_port);
+  }
 };
 
 // Encapsulate the data required to uniquely identify a BCM trunk port as needed
@@ -74,6 +82,17 @@ std::string PrintBcmPort(const BcmPort& p);
 // Prints BcmPortOptions message in a consistent and readable format.
 std::string PrintBcmPortOptions(const BcmPortOptions& options);
 
+// Runs 'func' once for every unit in 'units', with up to
+// FLAGS_bcm_max_parallel_units units handled in parallel. The work done for
+// the different units must be independent of each other; anything shared by
+// all the units (e.g. SDK init or the serdes DB) needs to be done before or
+// after. 'phase' is only used for logging the time taken on each unit and by
+// the whole phase. Waits for all the units to finish and returns the errors
+// of all the failed units, appended in the order given by 'units'.
+::util::Status RunForEachUnit(const std::string& phase,
+                              const std::vector<int>& units,
+                              const std::function<::util::Status(int)>& func);
+
 }  // namespace bcm
 }  // namespace hal
 }  // namespace stratum
@@ -16,8 +16,17 @@
 
 #include "stratum/hal/lib/bcm/utils.h"
 
+#include <set>
+#include <thread>  // NOLINT
+
+#include "gflags/gflags.h"
+#include "stratum/glue/status/status_test_util.h"
 #include "stratum/lib/constants.h"
+#include "stratum/lib/macros.h"
 #include "gtest/gtest.h"
+#include "absl/synchronization/mutex.h"
+
+DECLARE_int32(bcm_max_parallel_units);
 
 namespace stratum {
 namespace hal {
@@ -105,6 +114,64 @@ TEST(BcmUtilsTest, PrintBcmPortOptionsForNonEmptyOption) {
             PrintBcmPortOptions(options));
 }
 
+TEST(BcmUtilsTest, RunForEachUnitRunsAllUnitsAndAppendsErrors) {
+  ::gflags::FlagSaver flag_saver;  // Reverts FLAGS_bcm_max_parallel_units.
+  FLAGS_bcm_max_parallel_units = 4;
+  absl::Mutex lock;
+  std::set<int> visited;
+  ::util::Status status = RunForEachUnit(
+      "Test", {0, 1, 2, 3, 4}, [&](int unit) -> ::util::Status {
+        {
+          absl::MutexLock l(&lock);
+          visited.insert(unit);
+        }
+        if (unit % 2) {
+          return MAKE_ERROR(ERR_INTERNAL) << "Failed unit " << unit << ".";
+        }
+        return ::util::OkStatus();
+      });
+  EXPECT_EQ(std::set<int>({0, 1, 2, 3, 4}), visited);
+  ASSERT_FALSE(status.ok());
+  EXPECT_EQ(ERR_INTERNAL, status.error_code());
+  EXPECT_EQ("Failed unit 1. Failed unit 3.", status.error_message());
+}
+
+TEST(BcmUtilsTest, RunForEachUnitRunsUnitsInParallel) {
+  ::gflags::FlagSaver flag_saver;  // Reverts FLAGS_bcm_max_parallel_units.
+  FLAGS_bcm_max_parallel_units = 3;
+  absl::Mutex lock;
+  int arrived = 0;
+  // Every unit waits for all the others to start. This can only succeed if the
+  // units run at the same time.
+  ::util::Status status =
+      RunForEachUnit("Test", {1, 2, 3}, [&](int unit) -> ::util::Status {
+        absl::MutexLock l(&lock);
+        ++arrived;
+        auto all_arrived = [&arrived]() { return arrived == 3; };
+        if (!lock.AwaitWithTimeout(absl::Condition(&all_arrived),
+                                   absl::Seconds(10))) {
+          return MAKE_ERROR(ERR_INTERNAL) << "Unit " << unit << " timed out.";
+        }
+        return ::util::OkStatus();
+      });
+  EXPECT_OK(status);
+}
+
+TEST(BcmUtilsTest, RunForEachUnitRunsOnCallingThreadIfNotParallel) {
+  ::gflags::FlagSaver flag_saver;  // Reverts FLAGS_bcm_max_parallel_units.
+  FLAGS_bcm_max_parallel_units = 1;
+  std::vector<int> order;
+  std::set<std::thread::id> thread_ids;
+  EXPECT_OK(RunForEachUnit("Test", {2, 0, 1}, [&](int unit) {
+    order.push_back(unit);
+    thread_ids.insert(std::this_thread::get_id());
+    return ::util::OkStatus();
+  }));
+  EXPECT_EQ(std::vector<int>({2, 0, 1}), order);
+  EXPECT_EQ(std::set<std::thread::id>({std::this_thread::get_id()}),
+            thread_ids);
+}
+
 }  // namespace bcm
 }  // namespace hal
 }  // namespace stratum
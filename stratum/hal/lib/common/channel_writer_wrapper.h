@@ -44,6 +44,16 @@ class ChannelWriterWrapper : public WriterInterface<T> {
     }
     return true;
   }
+  bool Write(T&& msg) override {
+    if (!writer_) return false;
+    auto status = writer_->Write(std::move(msg), absl::InfiniteDuration());
+    if (!status.ok()) {
+      VLOG(3) << "Unable to write to Channel with error code: "
+              << status.error_code() << ".";
+      return false;
+    }
+    return true;
+  }
 
  private:
   std::unique_ptr<ChannelWriter<T>> writer_;
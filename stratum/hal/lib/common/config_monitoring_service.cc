@@ -28,6 +28,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <memory>
 #include <utility>
 #include <string>
 
@@ -46,6 +47,7 @@
 #include "absl/memory/memory.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "stratum/glue/gtl/map_util.h"
 
 DEFINE_string(chassis_config_file, "",
@@ -54,6 +56,14 @@ DEFINE_string(chassis_config_file, "",
               "includes the overall running config at any point of time. "
               "Default is empty and it is expected to be explicitly given by "
               "flags.");
+DEFINE_bool(chassis_config_file_binary, false,
+            "If true, the chassis config is saved to chassis_config_file in "
+            "binary proto format instead of text format, which is faster to "
+            "write and to read back for large configs.");
+DEFINE_int32(gnmi_set_batch_window_ms, 0,
+             "Time window in milliseconds within which the config changes of "
+             "the gNMI SetRequests are committed to the switch with a single "
+             "config push. If 0, each SetRequest is committed on its own.");
 
 namespace stratum {
 namespace hal {
@@ -62,6 +72,11 @@ ConfigMonitoringService::ConfigMonitoringService(
     OperationMode mode, SwitchInterface* switch_interface,
     AuthPolicyChecker* auth_policy_checker, ErrorBuffer* error_buffer)
     : running_chassis_config_(nullptr),
+      open_set_batch_(nullptr),
+      config_to_persist_(nullptr),
+      persist_in_progress_(false),
+      persist_thread_stopping_(false),
+      persist_tid_(0),
       mode_(mode),
       switch_interface_(ABSL_DIE_IF_NULL(switch_interface)),
       auth_policy_checker_(ABSL_DIE_IF_NULL(auth_policy_checker)),
@@ -70,9 +85,26 @@ ConfigMonitoringService::ConfigMonitoringService(
   if (TimerDaemon::Start() != ::util::OkStatus()) {
     LOG(ERROR) << "Could not start the timer subsystem.";
   }
+  if (pthread_create(&persist_tid_, nullptr, &PersistChassisConfigThread,
+                     this) != 0) {
+    LOG(ERROR) << "Could not start the config persistence thread. The chassis "
+               << "config will be saved on the gNMI Set threads.";
+    persist_tid_ = 0;
+  }
 }
 
 ConfigMonitoringService::~ConfigMonitoringService() {
+  if (persist_tid_ != 0) {
+    // The thread saves the config handed over last, if any, before exiting.
+    {
+      absl::MutexLock l(&persist_lock_);
+      persist_thread_stopping_ = true;
+      persist_cond_.SignalAll();
+    }
+    if (pthread_join(persist_tid_, nullptr) != 0) {
+      LOG(ERROR) << "Could not join the config persistence thread.";
+    }
+  }
   if (TimerDaemon::Stop() != ::util::OkStatus()) {
     LOG(ERROR) << "Could not stop the timer subsystem.";
   }
@@ -99,6 +131,9 @@ ConfigMonitoringService::~ConfigMonitoringService() {
 }
 
 ::util::Status ConfigMonitoringService::Teardown() {
+  // Make sure the last config pushed is saved before tearing down.
+  WaitForChassisConfigPersisted();
+
   absl::WriterMutexLock l(&config_lock_);
   running_chassis_config_ = nullptr;
 
@@ -117,7 +152,18 @@ ConfigMonitoringService::~ConfigMonitoringService() {
             << FLAGS_chassis_config_file << "...";
   auto config = absl::make_unique<ChassisConfig>();
   ::util::Status status =
-      ReadProtoFromTextFile(FLAGS_chassis_config_file, config.get());
+      FLAGS_chassis_config_file_binary
+          ? ReadProtoFromBinFile(FLAGS_chassis_config_file, config.get())
+          : ReadProtoFromTextFile(FLAGS_chassis_config_file, config.get());
+  if (!status.ok() && FLAGS_chassis_config_file_binary &&
+      status.error_code() != ERR_FILE_NOT_FOUND) {
+    // The file may have been saved in text format before the binary format
+    // was enabled.
+    config->Clear();
+    ::util::Status text_status =
+        ReadProtoFromTextFile(FLAGS_chassis_config_file, config.get());
+    if (text_status.ok()) status = text_status;
+  }
   if (!status.ok()) {
     if (!warmboot && status.error_code() == ERR_FILE_NOT_FOUND) {
       // Not a critical error. If coldboot, we don't even return error.
@@ -184,72 +230,117 @@ ConfigMonitoringService::~ConfigMonitoringService() {
 ::grpc::Status ConfigMonitoringService::DoSet(::grpc::ServerContext* context,
                                               const ::gnmi::SetRequest* req,
                                               ::gnmi::SetResponse* resp) {
-  absl::WriterMutexLock l(&config_lock_);
-
-  CopyOnWriteChassisConfig config(running_chassis_config_.get());
-
-  for (const auto& path : req->delete_()) {
-    VLOG(1) << "SET(DELETE): " << path.ShortDebugString();
-    ::util::Status status;
-    ::gnmi::TypedValue val;
-    if (!(status = gnmi_publisher_.HandleDelete(path, &config)).ok()) {
-      // Something went wrong. Abort the whole gNMI SET operation.
-      return ::grpc::Status(ToGrpcCode(status.CanonicalCode()),
-                            status.error_message());
+  // The batch the SetRequest has joined if it changes the chassis config.
+  std::shared_ptr<SetBatch> batch = nullptr;
+  bool opened_batch = false;
+  {
+    absl::WriterMutexLock l(&config_lock_);
+
+    // The SetRequest is applied on top of the changes of the SetRequests
+    // waiting for the open batch to be committed, if any.
+    CopyOnWriteChassisConfig config(open_set_batch_ != nullptr
+                                        ? open_set_batch_->config.get()
+                                        : running_chassis_config_.get());
+
+    for (const auto& path : req->delete_()) {
+      VLOG(1) << "SET(DELETE): " << path.ShortDebugString();
+      ::util::Status status;
+      ::gnmi::TypedValue val;
+      if (!(status = gnmi_publisher_.HandleDelete(path, &config)).ok()) {
+        // Something went wrong. Abort the whole gNMI SET operation.
+        return ::grpc::Status(ToGrpcCode(status.CanonicalCode()),
+                              status.error_message());
+      }
+      // Add to response object in SetResponse
+      ::gnmi::UpdateResult* res = resp->add_response();
+      res->mutable_path()->CopyFrom(path);
+      res->set_op(
+          ::gnmi::UpdateResult_Operation::UpdateResult_Operation_DELETE);
     }
-    // Add to response object in SetResponse
-    ::gnmi::UpdateResult* res = resp->add_response();
-    res->mutable_path()->CopyFrom(path);
-    res->set_op(::gnmi::UpdateResult_Operation::UpdateResult_Operation_DELETE);
-  }
-  for (const auto& replace : req->replace()) {
-    const auto& path = replace.path();
-    VLOG(1) << "SET(REPLACE): " << path.ShortDebugString();
-    ::util::Status status;
-    if (!(status = gnmi_publisher_.HandleReplace(path, replace.val(), &config))
-             .ok()) {
-      return ::grpc::Status(ToGrpcCode(status.CanonicalCode()),
-                            status.error_message());
+    for (const auto& replace : req->replace()) {
+      const auto& path = replace.path();
+      VLOG(1) << "SET(REPLACE): " << path.ShortDebugString();
+      ::util::Status status;
+      if (!(status =
+                gnmi_publisher_.HandleReplace(path, replace.val(), &config))
+               .ok()) {
+        return ::grpc::Status(ToGrpcCode(status.CanonicalCode()),
+                              status.error_message());
+      }
+      // Add to response object in SetResponse
+      ::gnmi::UpdateResult* res = resp->add_response();
+      res->mutable_path()->CopyFrom(replace.path());
+      res->set_op(
+          ::gnmi::UpdateResult_Operation::UpdateResult_Operation_REPLACE);
     }
-    // Add to response object in SetResponse
-    ::gnmi::UpdateResult* res = resp->add_response();
-    res->mutable_path()->CopyFrom(replace.path());
-    res->set_op(::gnmi::UpdateResult_Operation::UpdateResult_Operation_REPLACE);
-  }
-  for (const auto& update : req->update()) {
-    const auto& path = update.path();
-    VLOG(1) << "SET(UPDATE): " << path.ShortDebugString();
-    ::util::Status status;
-    if (!(status = gnmi_publisher_.HandleUpdate(path, update.val(), &config))
-             .ok()) {
-      return ::grpc::Status(ToGrpcCode(status.CanonicalCode()),
-                            status.error_message());
+    for (const auto& update : req->update()) {
+      const auto& path = update.path();
+      VLOG(1) << "SET(UPDATE): " << path.ShortDebugString();
+      ::util::Status status;
+      if (!(status = gnmi_publisher_.HandleUpdate(path, update.val(), &config))
+               .ok()) {
+        return ::grpc::Status(ToGrpcCode(status.CanonicalCode()),
+                              status.error_message());
+      }
+      // Add to response object in SetResponse
+      ::gnmi::UpdateResult* res = resp->add_response();
+      res->mutable_path()->CopyFrom(update.path());
+      res->set_op(
+          ::gnmi::UpdateResult_Operation::UpdateResult_Operation_UPDATE);
     }
-    // Add to response object in SetResponse
-    ::gnmi::UpdateResult* res = resp->add_response();
-    res->mutable_path()->CopyFrom(update.path());
-    res->set_op(::gnmi::UpdateResult_Operation::UpdateResult_Operation_UPDATE);
-  }
 
-  if (config.HasBeenChanged()) {
-    // ChassisConfig has changed, so, we need to push it now!
-    ::util::Status status = switch_interface_->PushChassisConfig(*config);
-    // If the config push was successful or reported reboot required, save the
-    // config on the switch. Any other config push error is considered
-    // blocking.
-    if (status.ok() || status.error_code() == ERR_REBOOT_REQUIRED) {
-      APPEND_STATUS_IF_ERROR(
-          status, WriteProtoToTextFile(*config, FLAGS_chassis_config_file));
+    if (config.HasBeenChanged()) {
+      // ChassisConfig has changed, so, it needs to be pushed. Join the open
+      // batch, or open a new one.
+      if (open_set_batch_ == nullptr) {
+        open_set_batch_ = std::make_shared<SetBatch>();
+        opened_batch = true;
+      }
+      open_set_batch_->config.reset(config.PassOwnership());
+      batch = open_set_batch_;
     }
+  }
+
+  if (batch != nullptr) {
+    ::util::Status status =
+        opened_batch ? CommitSetBatch(batch) : WaitForSetBatch(batch);
     if (!status.ok()) {
-      error_buffer_->AddError(status,
-                              "Pushing chassis config failed: ", GTL_LOC);
       return ::grpc::Status(ToGrpcCode(status.CanonicalCode()),
                             status.error_message());
     }
+  }
 
+  // Add data to SetResponse Object
+  resp->mutable_prefix()->CopyFrom(req->prefix());
+  resp->mutable_extension()->CopyFrom(req->extension());
+  resp->set_timestamp(absl::GetCurrentTimeNanos());
+  return ::grpc::Status::OK;
+}
+
+::util::Status ConfigMonitoringService::CommitSetBatch(
+    const std::shared_ptr<SetBatch>& batch) {
+  if (FLAGS_gnmi_set_batch_window_ms > 0) {
+    absl::SleepFor(absl::Milliseconds(FLAGS_gnmi_set_batch_window_ms));
+  }
+
+  absl::WriterMutexLock l(&config_lock_);
+  // Close the batch. The SetRequests received from now on are applied on top
+  // of the config pushed below.
+  open_set_batch_ = nullptr;
+  std::shared_ptr<const ChassisConfig> config(std::move(batch->config));
+
+  ::util::Status status = switch_interface_->PushChassisConfig(*config);
+  // If the config push was successful or reported reboot required, save the
+  // config on the switch. Any other config push error is considered
+  // blocking.
+  if (status.ok() || status.error_code() == ERR_REBOOT_REQUIRED) {
+    PersistChassisConfig(config);
+  }
+  if (!status.ok()) {
+    error_buffer_->AddError(status, "Pushing chassis config failed: ", GTL_LOC);
+  } else {
     // Save running_chassis_config_ after everything went OK.
-    running_chassis_config_.reset(config.PassOwnership());
+    running_chassis_config_ = config;
 
     // Notify the gNMI GnmiPublisher that the config has changed.
     APPEND_STATUS_IF_ERROR(
@@ -258,16 +349,84 @@ ConfigMonitoringService::~ConfigMonitoringService() {
     if (!status.ok()) {
       error_buffer_->AddError(
           status, "Failed to handle config change at GnmiPublisher: ", GTL_LOC);
-      return ::grpc::Status(ToGrpcCode(status.CanonicalCode()),
-                            status.error_message());
     }
   }
 
-  // Add data to SetResponse Object
-  resp->mutable_prefix()->CopyFrom(req->prefix());
-  resp->mutable_extension()->CopyFrom(req->extension());
-  resp->set_timestamp(absl::GetCurrentTimeNanos());
-  return ::grpc::Status::OK;
+  batch->status = status;
+  batch->committed = true;
+  set_batch_committed_.SignalAll();
+
+  return status;
+}
+
+::util::Status ConfigMonitoringService::WaitForSetBatch(
+    const std::shared_ptr<SetBatch>& batch) {
+  absl::WriterMutexLock l(&config_lock_);
+  while (!batch->committed) set_batch_committed_.Wait(&config_lock_);
+
+  return batch->status;
+}
+
+void ConfigMonitoringService::PersistChassisConfig(
+    std::shared_ptr<const ChassisConfig> config) {
+  if (persist_tid_ == 0) {
+    ::util::Status status = SaveChassisConfig(*config);
+    if (!status.ok()) {
+      error_buffer_->AddError(status, "Saving chassis config failed: ",
+                              GTL_LOC);
+    }
+    return;
+  }
+  absl::MutexLock l(&persist_lock_);
+  config_to_persist_ = std::move(config);
+  persist_cond_.SignalAll();
+}
+
+void ConfigMonitoringService::WaitForChassisConfigPersisted() {
+  absl::MutexLock l(&persist_lock_);
+  while (config_to_persist_ != nullptr || persist_in_progress_) {
+    persist_cond_.Wait(&persist_lock_);
+  }
+}
+
+::util::Status ConfigMonitoringService::SaveChassisConfig(
+    const ChassisConfig& config) {
+  if (FLAGS_chassis_config_file_binary) {
+    return WriteProtoToBinFile(config, FLAGS_chassis_config_file);
+  }
+  return WriteProtoToTextFile(config, FLAGS_chassis_config_file);
+}
+
+void* ConfigMonitoringService::PersistChassisConfigThread(void* arg) {
+  ConfigMonitoringService* service = static_cast<ConfigMonitoringService*>(arg);
+  while (true) {
+    std::shared_ptr<const ChassisConfig> config = nullptr;
+    {
+      absl::MutexLock l(&service->persist_lock_);
+      while (service->config_to_persist_ == nullptr &&
+             !service->persist_thread_stopping_) {
+        service->persist_cond_.Wait(&service->persist_lock_);
+      }
+      if (service->config_to_persist_ == nullptr) break;
+      config.swap(service->config_to_persist_);
+      service->persist_in_progress_ = true;
+    }
+    absl::Time start = absl::Now();
+    ::util::Status status = SaveChassisConfig(*config);
+    if (!status.ok()) {
+      service->error_buffer_->AddError(
+          status, "Saving chassis config failed: ", GTL_LOC);
+    } else {
+      VLOG(1) << "Saved the chassis config to " << FLAGS_chassis_config_file
+              << " in " << absl::FormatDuration(absl::Now() - start) << ".";
+    }
+    {
+      absl::MutexLock l(&service->persist_lock_);
+      service->persist_in_progress_ = false;
+      service->persist_cond_.SignalAll();
+    }
+  }
+  return nullptr;
 }
 
 ::grpc::Status ConfigMonitoringService::Get(::grpc::ServerContext* context,
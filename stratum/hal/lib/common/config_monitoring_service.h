@@ -20,6 +20,7 @@
 #define STRATUM_HAL_LIB_COMMON_CONFIG_MONITORING_SERVICE_H_
 
 #include <grpcpp/grpcpp.h>
+#include <pthread.h>
 
 #include <memory>
 
@@ -47,6 +48,13 @@ using ServerSubscribeReaderWriterInterface =
 // The "ConfigMonitoringService" class implements ::gnmi::gNMI::Service. It
 // handles all the RPCs that are part of the gRPC Network Management Interface
 // (gNMI) which are in charge of configuration and monitoring/telemetry.
+//
+// The config changes of the gNMI SetRequests received within
+// FLAGS_gnmi_set_batch_window_ms are committed together: the first SetRequest
+// opens a batch, the next ones are applied on top of the changes already in
+// the batch, and the resulting config is pushed to the switch once when the
+// window is over. The pushed config is saved to FLAGS_chassis_config_file by a
+// background thread, so that the Set RPCs do not wait for the file write.
 class ConfigMonitoringService final : public ::gnmi::gNMI::Service {
  public:
   ConfigMonitoringService(OperationMode mode, SwitchInterface* switch_interface,
@@ -65,7 +73,9 @@ class ConfigMonitoringService final : public ::gnmi::gNMI::Service {
   ::util::Status Teardown() LOCKS_EXCLUDED(config_lock_);
 
   // Public helper function called in Setup(). It deserializes the contents
-  // of the FLAGS_chassis_config_file file and calls PushChassisConfig().
+  // of the FLAGS_chassis_config_file file and calls PushChassisConfig(). The
+  // file is read in binary format if FLAGS_chassis_config_file_binary is true,
+  // falling back to the text format for a file saved before.
   ::util::Status PushSavedChassisConfig(bool warmboot);
 
   // Public helper function that is called to perform actual config push. It is
@@ -145,13 +155,83 @@ class ConfigMonitoringService final : public ::gnmi::gNMI::Service {
                        const ::gnmi::SetRequest* req, ::gnmi::SetResponse* resp)
       LOCKS_EXCLUDED(config_lock_);
 
+  // The config changes of the SetRequests committed together.
+  struct SetBatch {
+    // The running config with the changes of all the SetRequests of the batch.
+    std::unique_ptr<ChassisConfig> config;
+    // Set to true once the config has been pushed, with the result of the push
+    // in 'status'.
+    bool committed;
+    ::util::Status status;
+    SetBatch() : config(nullptr), committed(false), status() {}
+  };
+
+  // Called by the SetRequest which opened the batch. Waits for the batch window
+  // to be over, pushes the config of the batch to the switch and hands it over
+  // to the config persistence thread. Returns the result of the push, which is
+  // also the result of all the SetRequests of the batch.
+  ::util::Status CommitSetBatch(const std::shared_ptr<SetBatch>& batch)
+      LOCKS_EXCLUDED(config_lock_);
+
+  // Called by the other SetRequests of the batch. Waits for the batch to be
+  // committed and returns the result of the push.
+  ::util::Status WaitForSetBatch(const std::shared_ptr<SetBatch>& batch)
+      LOCKS_EXCLUDED(config_lock_);
+
+  // Hands the config over to the config persistence thread, which saves it to
+  // FLAGS_chassis_config_file. Only the latest config is saved if several
+  // configs are handed over while a save is in progress.
+  void PersistChassisConfig(std::shared_ptr<const ChassisConfig> config)
+      LOCKS_EXCLUDED(persist_lock_);
+
+  // Blocks until the config handed over to the config persistence thread, if
+  // any, has been saved.
+  void WaitForChassisConfigPersisted() LOCKS_EXCLUDED(persist_lock_);
+
+  // Saves the config to FLAGS_chassis_config_file.
+  static ::util::Status SaveChassisConfig(const ChassisConfig& config);
+
+  // The function executed by the config persistence thread.
+  static void* PersistChassisConfigThread(void* arg);
+
   // Mutex lock for protecting the internal chassis config pushed to the switch.
   mutable absl::Mutex config_lock_;
 
-  // Hold the ChassisConfig which is currently running on the switch.
-  std::unique_ptr<ChassisConfig> running_chassis_config_
+  // Hold the ChassisConfig which is currently running on the switch. The
+  // config is never modified once pushed, and it is shared with the config
+  // persistence thread rather than copied.
+  std::shared_ptr<const ChassisConfig> running_chassis_config_
       GUARDED_BY(config_lock_);
 
+  // The batch the SetRequests join until it is committed. nullptr if there is
+  // no SetRequest waiting for a commit.
+  std::shared_ptr<SetBatch> open_set_batch_ GUARDED_BY(config_lock_);
+
+  // Signaled when a batch has been committed.
+  absl::CondVar set_batch_committed_;
+
+  // Mutex lock for protecting the state of the config persistence thread.
+  absl::Mutex persist_lock_;
+
+  // Signaled when a config has been handed over to the config persistence
+  // thread, when a save is over and when the thread has to exit.
+  absl::CondVar persist_cond_;
+
+  // The latest config handed over to the config persistence thread and not
+  // saved yet.
+  std::shared_ptr<const ChassisConfig> config_to_persist_
+      GUARDED_BY(persist_lock_);
+
+  // True while the config persistence thread saves a config.
+  bool persist_in_progress_ GUARDED_BY(persist_lock_);
+
+  // Set to true to make the config persistence thread exit.
+  bool persist_thread_stopping_ GUARDED_BY(persist_lock_);
+
+  // The config persistence thread. 0 if it could not be created, in which case
+  // the configs are saved on the calling thread.
+  pthread_t persist_tid_;
+
   // Determines the mode of operation:
   // - OPERATION_MODE_STANDALONE: when Stratum stack runs independently and
   // therefore needs to do all the SDK initialization itself.
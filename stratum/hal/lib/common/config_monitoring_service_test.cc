@@ -17,6 +17,7 @@
 #include <grpcpp/grpcpp.h>
 #include <memory>
 #include <string>
+#include <thread>  // NOLINT
 
 #include "stratum/hal/lib/common/config_monitoring_service.h"
 #include "gflags/gflags.h"
@@ -37,9 +38,13 @@
 #include "absl/memory/memory.h"
 #include "absl/strings/substitute.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "openconfig/openconfig.pb.h"
 
+DECLARE_bool(chassis_config_file_binary);
 DECLARE_string(chassis_config_file);
+DECLARE_int32(gnmi_set_batch_window_ms);
 DECLARE_string(test_tmpdir);
 
 using ::testing::_;
@@ -118,6 +123,12 @@ class ConfigMonitoringServiceTest
     return config_monitoring_service_->DoSet(context, req, resp);
   }
 
+  // Returns true if a SetRequest is waiting for its batch to be committed.
+  bool HasOpenSetBatch() {
+    absl::ReaderMutexLock l(&config_monitoring_service_->config_lock_);
+    return config_monitoring_service_->open_set_batch_ != nullptr;
+  }
+
   // A proxy to private method of ConfigMonitoringService class.
   ::grpc::Status DoCapabilities(::grpc::ServerContext* context,
                                 const ::gnmi::CapabilityRequest* req,
@@ -995,6 +1006,91 @@ TEST_P(ConfigMonitoringServiceTest, GnmiSetRootReplace) {
   ASSERT_OK(config_monitoring_service_->Teardown());
 }
 
+// The config changes of SetRequests received within the batch window are
+// pushed together, and the config is saved in binary format.
+TEST_P(ConfigMonitoringServiceTest, GnmiSetBatchedCommit) {
+  if (mode_ == OPERATION_MODE_COUPLED) return;
+  // Reverts FLAGS_gnmi_set_batch_window_ms and
+  // FLAGS_chassis_config_file_binary, even if the test fails.
+  ::gflags::FlagSaver flag_saver;
+
+  // Prepare and push configuration. The method under test requires the
+  // configuration to be pushed.
+  ChassisConfig config;
+  FillTestChassisConfigAndSave(&config);
+  EXPECT_CALL(*switch_mock_, RegisterEventNotifyWriter(_))
+      .WillOnce(Return(::util::OkStatus()));
+  EXPECT_CALL(*switch_mock_, PushChassisConfig(_))
+      .WillOnce(Return(::util::OkStatus()));
+  ASSERT_OK(config_monitoring_service_->Setup(false));
+
+  // Prepare two SET requests, each disabling a different port.
+  ::gnmi::SetRequest req1, req2;
+  constexpr char kReqTemplate[] = R"PROTO(
+    update {
+      path {
+        elem { name: "interfaces" }
+        elem {
+          name: "interface"
+          key { key: "name" value: "$0" }
+        }
+        elem { name: "config" }
+        elem { name: "enabled" }
+      }
+      val { bool_val: false }
+    }
+  )PROTO";
+  ASSERT_OK(ParseProtoFromString(
+      absl::Substitute(kReqTemplate, "device1.domain.net.com:ce-1/1"), &req1));
+  ASSERT_OK(ParseProtoFromString(
+      absl::Substitute(kReqTemplate, "device1.domain.net.com:ce-1/2"), &req2));
+
+  // Both SetRequests are config-changing, but they are committed with one
+  // PushChassisConfig() call.
+  ChassisConfig pushed_config;
+  EXPECT_CALL(*switch_mock_, SetValue(_, _, _))
+      .Times(2)
+      .WillRepeatedly(Return(::util::OkStatus()));
+  EXPECT_CALL(*switch_mock_, PushChassisConfig(_))
+      .WillOnce(DoAll(SaveArg<0>(&pushed_config),
+                      Return(::util::OkStatus())));
+
+  FLAGS_gnmi_set_batch_window_ms = 500;
+  FLAGS_chassis_config_file_binary = true;
+  ::grpc::Status first_status;
+  std::thread first([this, &req1, &first_status]() {
+    ::grpc::ServerContext context;
+    ::gnmi::SetResponse resp;
+    first_status = DoSet(&context, &req1, &resp);
+  });
+  // Wait for the first SetRequest to open the batch.
+  while (!HasOpenSetBatch()) absl::SleepFor(absl::Milliseconds(1));
+  ::grpc::ServerContext context;
+  ::gnmi::SetResponse resp;
+  auto grpc_status = DoSet(&context, &req2, &resp);
+  first.join();
+  EXPECT_TRUE(first_status.ok()) << first_status.error_message();
+  EXPECT_TRUE(grpc_status.ok()) << grpc_status.error_message();
+  EXPECT_FALSE(HasOpenSetBatch());
+  CheckRunningChassisConfig(&pushed_config);
+
+  // The single pushed config has the changes of both SetRequests.
+  ASSERT_EQ(2, pushed_config.singleton_ports_size());
+  for (const auto& singleton_port : pushed_config.singleton_ports()) {
+    EXPECT_EQ(ADMIN_STATE_DISABLED,
+              singleton_port.config_params().admin_state())
+        << singleton_port.name();
+  }
+
+  // Clean-up. The config is saved by the time Teardown() returns.
+  EXPECT_CALL(*switch_mock_, UnregisterEventNotifyWriter())
+      .WillOnce(Return(::util::OkStatus()));
+  ASSERT_OK(config_monitoring_service_->Teardown());
+  ChassisConfig saved_config;
+  ASSERT_OK(ReadProtoFromBinFile(FLAGS_chassis_config_file, &saved_config));
+  EXPECT_THAT(saved_config, EqualsProto(pushed_config));
+}
+
 // FIXME(boc) google only
 // Unsuccessful DoSet() execution for simple leaf gNMI SET UPDATE message.
 // TEST_P(ConfigMonitoringServiceTest, GnmiSetRootUpdate) {
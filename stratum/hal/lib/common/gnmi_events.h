@@ -416,71 +416,67 @@ using GnmiEventHandler = std::function<::util::Status(
 // functionality - it makes a copy of the original chassis config only if a
 // mutable pointer is requested. It is used to avoid unnecessary copies of
 // ChassisConfig object when processing gNMI SET requests. Note that the class
-// does not take ownership of the pointer passed in the constructor, so, it will
-// not be deleted if a copy is made. Note also that it assusmes that the
-// ownership of the newly allocated memory will be taken over before the object
-// is destroyed.
+// does not take ownership of the pointer passed in the constructor and never
+// modifies the config it points to, so, the original config can be shared with
+// other readers while the request is processed. Note also that it assusmes
+// that the ownership of the newly allocated memory will be taken over before
+// the object is destroyed.
 class CopyOnWriteChassisConfig {
  public:
-  explicit CopyOnWriteChassisConfig(ChassisConfig* ptr)
-      : copied_(false), delete_active_(false), original_(ptr), active_(ptr) {
+  explicit CopyOnWriteChassisConfig(const ChassisConfig* ptr)
+      : copied_(false), original_(ptr), copy_(nullptr) {
     if (ptr == nullptr) {
-      // ative_ cannot be nullptr. If it is, allocate a new object.
-      active_ = new ChassisConfig();
-      delete_active_ = true;
+      // original_ cannot be nullptr. If it is, allocate a new object.
+      copy_ = new ChassisConfig();
+      original_ = copy_;
     }
   }
 
   virtual ~CopyOnWriteChassisConfig() {
-    if (delete_active_) {
-      // If this is the object that has been allocated by this class and its
-      // ownership has not been taken over - delete it to avoid memory leak.
-      delete active_;
-    }
+    // If the buffer has been allocated by this class and its ownership has not
+    // been taken over - delete it to avoid memory leak.
+    delete copy_;
   }
 
   bool HasBeenChanged() const { return copied_; }
 
   // Read operation. Do not make copy.
-  const ChassisConfig* operator->() const { return active_; }
+  const ChassisConfig* operator->() const { return active(); }
 
   // Read operation. Do not make copy.
-  const ChassisConfig& operator*() const { return *active_; }
+  const ChassisConfig& operator*() const { return *active(); }
 
   // The only way to get mutable/writable access.
   ChassisConfig* writable() {
     // If it has not been copied yet, make a copy.
     if (!copied_) copy();
-    return active_;
+    return copy_;
   }
 
   // Pass ownership of the allocated buffer and update the state.
   ChassisConfig* PassOwnership() {
-    auto result = active_;
-    delete_active_ = false;
-    active_ = nullptr;
+    auto result = copy_;
+    copy_ = nullptr;
+    original_ = nullptr;
     return result;
   }
 
  private:
+  // Returns the 'active' config. Can be a copy.
+  const ChassisConfig* active() const {
+    return copy_ != nullptr ? copy_ : original_;
+  }
+
   // Makes a copy of the original chassis config.
   void copy() {
-    if (original_ != nullptr) {
-      ChassisConfig* new_active = new ChassisConfig();
-      *new_active = *original_;
-      active_ = new_active;
-      delete_active_ = true;
-    }
+    if (copy_ == nullptr) copy_ = new ChassisConfig(*original_);
     copied_ = true;
   }
 
-  // Set to true if the ative_ pointer is pointing to a copy.
+  // Set to true if the active config is a copy.
   bool copied_;
-  // Set to true if the buffer pointed by active_ should be deleted by
-  // the destructor.
-  bool delete_active_;
-  ChassisConfig* original_;  // The pointer passed to the constructor.
-  ChassisConfig* active_;    // The 'active' pointer. Can be a copy.
+  const ChassisConfig* original_;  // The pointer passed to the constructor.
+  ChassisConfig* copy_;  // The copy owned by this object, if any.
 };
 
 using GnmiSetHandler = std::function<::util::Status(
@@ -16,22 +16,59 @@
 
 #include "stratum/hal/lib/common/gnmi_publisher.h"
 
+#include <algorithm>
 #include <list>
 #include <string>
 #include <utility>
 
+#include "gflags/gflags.h"
 #include "gnmi/gnmi.pb.h"
 #include "stratum/hal/lib/common/channel_writer_wrapper.h"
 #include "stratum/hal/lib/common/yang_parse_tree_paths.h"
+#include "absl/strings/str_cat.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "stratum/glue/gtl/map_util.h"
 
+DEFINE_int32(gnmi_sample_epoch_ms, 100,
+             "The granularity of the sample periods of the gNMI periodic "
+             "subscriptions. The periods are rounded to the closest multiple "
+             "of it (e.g. 1010ms is sampled every 1000ms with an epoch of "
+             "100ms), and the subscriptions to the same path sampled in the "
+             "same epoch share one data collection. 0 disables the rounding.");
+
 namespace stratum {
 namespace hal {
 
+namespace {
+
+// A stream that keeps the responses written to it. Used to collect the data of
+// a sample once before sending it to all the subscribers.
+class RecordingStream : public GnmiSubscribeStream {
+ public:
+  explicit RecordingStream(std::vector<::gnmi::SubscribeResponse>* responses)
+      : responses_(responses) {}
+
+  void SendInitialMetadata() override {}
+  bool Write(const ::gnmi::SubscribeResponse& resp,
+             ::grpc::WriteOptions options) override {
+    responses_->push_back(resp);
+    return true;
+  }
+  bool NextMessageSize(uint32_t* sz) override { return false; }
+  bool Read(::gnmi::SubscribeRequest* req) override { return false; }
+
+ private:
+  std::vector<::gnmi::SubscribeResponse>* responses_;  // not owned.
+};
+
+}  // namespace
+
 GnmiPublisher::GnmiPublisher(SwitchInterface* switch_interface)
     : switch_interface_(ABSL_DIE_IF_NULL(switch_interface)),
       parse_tree_(ABSL_DIE_IF_NULL(switch_interface)),
+      config_generation_(0),
       event_channel_(nullptr),
       on_config_pushed_(
           new EventHandlerRecord(on_config_pushed_func_, nullptr)) {
@@ -138,16 +175,145 @@ GnmiPublisher::~GnmiPublisher() {}
   if (status != ::util::OkStatus()) {
     return status;
   }
-  EventHandlerRecordPtr weak(*h);
-  if (TimerDaemon::RequestPeriodicTimer(
-          freq.delay_ms_, freq.period_ms_,
-          [weak, this]() { return this->HandleEvent(TimerEvent(), weak); },
-          (*h)->mutable_timer()) != ::util::OkStatus()) {
-    return MAKE_ERROR(ERR_INTERNAL) << "Cannot start timer.";
-  }
+  // The data is sampled by the timer of the group of subscriptions to this
+  // path with the same period.
+  RETURN_IF_ERROR(AddToSampleGroup(freq, path, stream, *h));
   // A handler has been successfully found and now it has to be registered in
   // the event handler list that handles timer events.
-  return Register<TimerEvent>(weak);
+  return Register<TimerEvent>(EventHandlerRecordPtr(*h));
+}
+
+uint64 GnmiPublisher::GetSamplePeriod(uint64 period_ms) {
+  if (FLAGS_gnmi_sample_epoch_ms <= 0) return std::max<uint64>(period_ms, 1);
+  const uint64 epoch_ms = FLAGS_gnmi_sample_epoch_ms;
+  return std::max(epoch_ms, (period_ms + epoch_ms / 2) / epoch_ms * epoch_ms);
+}
+
+::util::Status GnmiPublisher::AddToSampleGroup(const Frequency& freq,
+                                               const ::gnmi::Path& path,
+                                               GnmiSubscribeStream* stream,
+                                               const SubscriptionHandle& h) {
+  absl::WriterMutexLock l(&access_lock_);
+
+  const TreeNode* node = parse_tree_.FindNodeOrNull(path);
+  if (node == nullptr) {
+    return MAKE_ERROR(ERR_INVALID_PARAM)
+           << "The path (" << path.ShortDebugString() << ") is unsupported!";
+  }
+  const uint64 period_ms = GetSamplePeriod(freq.period_ms_);
+  const absl::Time start = absl::Now() + absl::Milliseconds(freq.delay_ms_);
+  std::string path_key =
+      absl::StrCat(config_generation_, ":", path.ShortDebugString());
+  std::string key = absl::StrCat(path_key, "@", period_ms);
+  std::shared_ptr<SampleGroup>& group = sample_groups_[key];
+  if (group == nullptr) {
+    group = std::make_shared<SampleGroup>();
+    group->key = key;
+    group->handler = node->GetOnTimerHandler();
+    std::weak_ptr<Sample>& sample = last_samples_[path_key];
+    group->last_sample = sample.lock();
+    if (group->last_sample == nullptr) {
+      group->last_sample = std::make_shared<Sample>();
+      sample = group->last_sample;
+    }
+    // The timers are aligned on the multiples of their period, so that the
+    // groups of the same path with different periods fire in the same epochs.
+    // The first sample is the first multiple after the requested delay.
+    uint64 start_ms = absl::ToUnixMillis(start);
+    uint64 delay_ms = freq.delay_ms_ + period_ms - start_ms % period_ms;
+    std::weak_ptr<SampleGroup> weak(group);
+    if (TimerDaemon::RequestPeriodicTimer(
+            delay_ms, period_ms,
+            [weak, this]() { return this->HandleSample(weak); },
+            &group->timer) != ::util::OkStatus()) {
+      sample_groups_.erase(key);
+      return MAKE_ERROR(ERR_INTERNAL) << "Cannot start timer.";
+    }
+  }
+  absl::MutexLock group_lock(&group->lock);
+  group->members.push_back({EventHandlerRecordPtr(h), stream, start});
+
+  return ::util::OkStatus();
+}
+
+::util::Status GnmiPublisher::HandleSample(
+    const std::weak_ptr<SampleGroup>& group) {
+  std::shared_ptr<SampleGroup> g = group.lock();
+  if (g == nullptr) return ::util::OkStatus();
+
+  // Keep the subscriptions alive while the data is sent, and drop the ones
+  // that have been cancelled. The members still in their initial delay are
+  // kept but not sent this sample. The timer may fire up to a tick late, so
+  // a member is due if it starts in the same sample epoch.
+  const int64 epoch_ms = std::max(FLAGS_gnmi_sample_epoch_ms, 1);
+  const absl::Time now = absl::Now();
+  const absl::Time due = now + absl::Milliseconds(epoch_ms / 2);
+  std::vector<std::pair<SubscriptionHandle, GnmiSubscribeStream*>> members;
+  bool drop_group = false;
+  ::util::Status status = ::util::OkStatus();
+  int failures = 0;
+  {
+    absl::ReaderMutexLock l(&access_lock_);
+    {
+      absl::MutexLock group_lock(&g->lock);
+      auto it = g->members.begin();
+      while (it != g->members.end()) {
+        if (auto record = it->record.lock()) {
+          if (it->start <= due) members.emplace_back(record, it->stream);
+          ++it;
+        } else {
+          it = g->members.erase(it);
+        }
+      }
+      drop_group = g->members.empty();
+    }
+    if (!members.empty()) {
+      // Collect the data, unless another group of this path already did it
+      // in this epoch.
+      std::vector<::gnmi::SubscribeResponse> responses;
+      const int64 epoch = (absl::ToUnixMillis(now) + epoch_ms / 2) / epoch_ms;
+      Sample* sample = g->last_sample.get();
+      {
+        absl::MutexLock sample_lock(&sample->lock);
+        if (sample->epoch != epoch) {
+          sample->responses.clear();
+          RecordingStream recorder(&sample->responses);
+          status = g->handler(TimerEvent(), &recorder);
+          sample->epoch = epoch;
+        }
+        responses = sample->responses;
+      }
+      absl::MutexLock write_lock(&sample_write_lock_);
+      for (const auto& member : members) {
+        for (const auto& resp : responses) {
+          if (!member.second->Write(resp, ::grpc::WriteOptions())) ++failures;
+        }
+      }
+    }
+  }
+
+  if (drop_group) {
+    // No subscriber left. Dropping the group cancels its timer. A member may
+    // have joined since the check above, so check again as a writer.
+    absl::WriterMutexLock l(&access_lock_);
+    absl::MutexLock group_lock(&g->lock);
+    if (!g->members.empty()) return ::util::OkStatus();
+    auto it = sample_groups_.find(g->key);
+    if (it != sample_groups_.end() && it->second == g) {
+      sample_groups_.erase(it);
+    }
+    std::string path_key = g->key.substr(0, g->key.rfind('@'));
+    g->last_sample.reset();
+    if (last_samples_[path_key].expired()) last_samples_.erase(path_key);
+    return ::util::OkStatus();
+  }
+
+  if (failures && status.ok()) {
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "Writing " << failures
+           << " sample response(s) to the streams failed.";
+  }
+  return status;
 }
 
 ::util::Status GnmiPublisher::SubscribePoll(const ::gnmi::Path& path,
@@ -215,6 +381,15 @@ GnmiPublisher::~GnmiPublisher() {}
   // Therefore we have to try removing it from every list we register events
   // on. Currently this is just TimerEvent.
   // FIXME: Add UnRegister calls for other EventHandlerLists in use.
+  for (auto& entry : sample_groups_) {
+    absl::MutexLock group_lock(&entry.second->lock);
+    auto& members = entry.second->members;
+    members.erase(std::remove_if(members.begin(), members.end(),
+                                 [&h](const SampleGroup::Member& member) {
+                                   return member.record.lock() == h;
+                                 }),
+                  members.end());
+  }
   return EventHandlerList<TimerEvent>::GetInstance()->UnRegister(h);
 }
 
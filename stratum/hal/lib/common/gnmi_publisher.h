@@ -26,6 +26,7 @@
 #include <string>
 #include <algorithm>
 #include <map>
+#include <vector>
 
 #include "gnmi/gnmi.grpc.pb.h"
 // FIXME(boc) is this required?
@@ -37,6 +38,7 @@
 #include "stratum/lib/timer_daemon.h"
 #include "stratum/public/lib/error.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
 #include "absl/container/flat_hash_map.h"
 #include "stratum/glue/gtl/map_util.h"
 
@@ -113,6 +115,12 @@ class GnmiPublisher {
   virtual ::util::Status HandlePoll(const SubscriptionHandle& handle)
       LOCKS_EXCLUDED(access_lock_);
 
+  // Subscribes to samples of 'path' every 'freq.period_ms_', starting
+  // 'freq.delay_ms_' from now. The period is rounded to the closest multiple
+  // of --gnmi_sample_epoch_ms (e.g. 1010ms is sampled every 1000ms with the
+  // default 100ms epoch), so that the subscriptions to the same path share
+  // the data collected. The samples are aligned on the multiples of the
+  // period.
   virtual ::util::Status SubscribePeriodic(const Frequency& freq,
                                            const ::gnmi::Path& path,
                                            GnmiSubscribeStream* stream,
@@ -161,6 +169,63 @@ class GnmiPublisher {
     std::unique_ptr<ChannelReader<T>> reader;
   };
 
+  // The last sample collected for a path. It is shared by the SampleGroups of
+  // the path, so that the groups due in the same sample epoch share one
+  // collection.
+  struct Sample {
+    // Serializes the collection of the groups of the path due in one epoch.
+    absl::Mutex lock;
+    // The sample epoch the responses have been collected in. -1 if none.
+    int64 epoch GUARDED_BY(lock) = -1;
+    std::vector<::gnmi::SubscribeResponse> responses GUARDED_BY(lock);
+  };
+
+  // A group of periodic subscriptions to the same path with the same (rounded)
+  // period. The data of the path is collected once per period by one timer and
+  // sent to the streams of all the members.
+  struct SampleGroup {
+    // A member of the group. The subscription handle owns the stream.
+    struct Member {
+      EventHandlerRecordPtr record;
+      GnmiSubscribeStream* stream;
+      // The member is not sent the samples taken before this time, i.e.
+      // before the delay it subscribed with has elapsed.
+      absl::Time start;
+    };
+    std::string key;
+    // The on-timer handler of the node the path points to.
+    GnmiEventHandler handler;
+    // Guards the members, which HandleSample() prunes while only holding
+    // access_lock_ as a reader.
+    absl::Mutex lock;
+    std::vector<Member> members GUARDED_BY(lock);
+    std::shared_ptr<Sample> last_sample;
+    TimerDaemon::DescriptorPtr timer;
+  };
+
+  // Returns the sample period (in ms) periodic subscriptions requesting
+  // 'period_ms' are grouped under. Periods are rounded to the closest multiple
+  // of FLAGS_gnmi_sample_epoch_ms.
+  static uint64 GetSamplePeriod(uint64 period_ms);
+
+  // Adds the subscription 'h' to the SampleGroup of 'path' sampled every
+  // 'freq.period_ms_', starting 'freq.delay_ms_' from now. Creates the group
+  // and starts its timer if needed.
+  ::util::Status AddToSampleGroup(const Frequency& freq,
+                                  const ::gnmi::Path& path,
+                                  GnmiSubscribeStream* stream,
+                                  const SubscriptionHandle& h)
+      LOCKS_EXCLUDED(access_lock_);
+
+  // Executed by the timer of a SampleGroup. Collects the data (unless it has
+  // already been collected in this sample epoch) and sends it to all the
+  // members of the group. Drops the group if it has no members left. Only
+  // holds access_lock_ as a reader while collecting the data, so that the
+  // groups due at the same time are sampled in parallel by the TimerDaemon
+  // workers.
+  ::util::Status HandleSample(const std::weak_ptr<SampleGroup>& group)
+      LOCKS_EXCLUDED(access_lock_, sample_write_lock_);
+
   // A family of helper methods that simplify registration of event handlers
   // with correct event handler list.
   template <typename E>
@@ -199,10 +264,29 @@ class GnmiPublisher {
   // A Mutex used to guard access to the list of pointers to handlers.
   mutable absl::Mutex access_lock_;
 
+  // Serializes the writes of the samples to the streams. A stream can be a
+  // member of several SampleGroups, which HandleSample() may run for at the
+  // same time, and gRPC streams do not support concurrent writes. The other
+  // handlers write to the streams while holding access_lock_ as a writer.
+  absl::Mutex sample_write_lock_;
+
   // A tree that is used to map a YAML tree path into a functor that handles
   // that node.
   YangParseTree parse_tree_ GUARDED_BY(access_lock_);
 
+  // The groups of periodic subscriptions, keyed by the config generation, the
+  // path and the sample period. See SampleGroup.
+  std::map<std::string, std::shared_ptr<SampleGroup>> sample_groups_
+      GUARDED_BY(access_lock_);
+
+  // The last samples collected, keyed by the config generation and the path.
+  std::map<std::string, std::weak_ptr<Sample>> last_samples_
+      GUARDED_BY(access_lock_);
+
+  // Incremented every time a config is pushed. The parse tree is rebuilt on
+  // every push, so the SampleGroups created before are not joined anymore.
+  uint64 config_generation_ GUARDED_BY(access_lock_);
+
   // Channel for receiving transceiver events from the SwitchInterface.
   std::shared_ptr<Channel<GnmiEventPtr>> event_channel_
       GUARDED_BY(access_lock_);
@@ -220,6 +304,7 @@ class GnmiPublisher {
                 if (FLAGS_v >= 1) LOG(INFO) << "Configuration has changed.";
                 if (auto* event = dynamic_cast<const ConfigHasBeenPushedEvent*>(
                         &event_base)) {
+                  ++config_generation_;
                   return parse_tree_.ProcessPushedConfig(*event);
                 }
                 return ::util::OkStatus();
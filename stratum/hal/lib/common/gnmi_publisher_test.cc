@@ -16,6 +16,10 @@
 
 #include "stratum/hal/lib/common/gnmi_publisher.h"
 
+#include <memory>
+#include <vector>
+
+#include "gflags/gflags.h"
 #include "gnmi/gnmi.pb.h"
 #include "stratum/glue/status/status_test_util.h"
 #include "stratum/hal/lib/common/subscribe_reader_writer_mock.h"
@@ -35,6 +39,8 @@ using ::testing::SaveArg;
 using ::testing::WithArgs;
 using ::testing::DoAll;
 
+DECLARE_int32(gnmi_sample_epoch_ms);
+
 namespace stratum {
 namespace hal {
 
@@ -132,6 +138,41 @@ class SubscriptionTestBase {
     LOG(INFO) << path.ShortDebugString();
   }
 
+  // Returns the number of groups of periodic subscriptions.
+  size_t NumSampleGroups() {
+    absl::WriterMutexLock l(&gnmi_publisher_->access_lock_);
+    return gnmi_publisher_->sample_groups_.size();
+  }
+
+  // Executes the timer actions of all the groups of periodic subscriptions.
+  void HandleSamples() {
+    std::vector<std::weak_ptr<GnmiPublisher::SampleGroup>> groups;
+    {
+      absl::WriterMutexLock l(&gnmi_publisher_->access_lock_);
+      for (const auto& entry : gnmi_publisher_->sample_groups_) {
+        groups.push_back(entry.second);
+      }
+    }
+    for (const auto& group : groups) {
+      EXPECT_OK(gnmi_publisher_->HandleSample(group));
+    }
+  }
+
+  // Mock implementation of RetrieveValue() that sends a response set to
+  // ADMIN_STATE_ENABLED.
+  void ExpectAdminStatusRetrieved(int times) {
+    EXPECT_CALL(switch_mock_, RetrieveValue(_, _, _, _))
+        .Times(times)
+        .WillRepeatedly(
+            DoAll(WithArgs<2>(Invoke([](WriterInterface<DataResponse>* w) {
+                    DataResponse resp;
+                    resp.mutable_admin_status()->set_state(
+                        ADMIN_STATE_ENABLED);
+                    w->Write(resp);
+                  })),
+                  Return(::util::OkStatus())));
+  }
+
   ChassisConfig hal_config_;
   SwitchMock switch_mock_;
   std::unique_ptr<GnmiPublisher> gnmi_publisher_;
@@ -245,6 +286,98 @@ TEST_F(SubscriptionTest, HandleTimer) {
   EXPECT_OK(gnmi_publisher_->HandleChange(TimerEvent()));
 }
 
+TEST_F(SubscriptionTest, PeriodicSubscriptionsToSamePathShareOneSample) {
+  SubscribeReaderWriterMock stream1, stream2;
+  SubscriptionHandle h1, h2;
+  ::gnmi::Path path =
+      GetPath("interfaces")("interface", "device1.domain.net.com:ce-1/1")(
+          "state")("admin-status")();
+  // Both periods are rounded to the same sample period.
+  ASSERT_OK(
+      gnmi_publisher_->SubscribePeriodic(Periodic(1000), path, &stream1, &h1));
+  ASSERT_OK(
+      gnmi_publisher_->SubscribePeriodic(Periodic(1010), path, &stream2, &h2));
+  EXPECT_EQ(1, NumSampleGroups());
+
+  // The data is retrieved once and sent to both streams.
+  ExpectAdminStatusRetrieved(1);
+  EXPECT_CALL(stream1, Write(_, _)).WillOnce(Return(true));
+  EXPECT_CALL(stream2, Write(_, _)).WillOnce(Return(true));
+  HandleSamples();
+}
+
+TEST_F(SubscriptionTest, SampleGroupsOfSamePathShareOneSampleEpoch) {
+  ::gflags::FlagSaver flag_saver;  // Reverts FLAGS_gnmi_sample_epoch_ms.
+  FLAGS_gnmi_sample_epoch_ms = 1000;
+  SubscribeReaderWriterMock stream1, stream2;
+  SubscriptionHandle h1, h2;
+  ::gnmi::Path path =
+      GetPath("interfaces")("interface", "device1.domain.net.com:ce-1/1")(
+          "state")("admin-status")();
+  ASSERT_OK(
+      gnmi_publisher_->SubscribePeriodic(Periodic(1000), path, &stream1, &h1));
+  ASSERT_OK(
+      gnmi_publisher_->SubscribePeriodic(Periodic(2000), path, &stream2, &h2));
+  EXPECT_EQ(2, NumSampleGroups());
+
+  // Both groups are due in the same epoch and share the data retrieved.
+  ExpectAdminStatusRetrieved(1);
+  EXPECT_CALL(stream1, Write(_, _)).WillOnce(Return(true));
+  EXPECT_CALL(stream2, Write(_, _)).WillOnce(Return(true));
+  HandleSamples();
+}
+
+TEST_F(SubscriptionTest, DelayedMemberOfSampleGroupNotSentEarlySamples) {
+  // A periodic subscription starting after a delay.
+  class DelayedPeriodic : public Frequency {
+   public:
+    DelayedPeriodic(uint64 delay_ms, uint64 period_ms)
+        : Frequency(delay_ms, period_ms, 0) {}
+  };
+  SubscribeReaderWriterMock stream1, stream2;
+  SubscriptionHandle h1, h2;
+  ::gnmi::Path path =
+      GetPath("interfaces")("interface", "device1.domain.net.com:ce-1/1")(
+          "state")("admin-status")();
+  ASSERT_OK(
+      gnmi_publisher_->SubscribePeriodic(Periodic(1000), path, &stream1, &h1));
+  ASSERT_OK(gnmi_publisher_->SubscribePeriodic(
+      DelayedPeriodic(3600 * 1000, 1000), path, &stream2, &h2));
+  EXPECT_EQ(1, NumSampleGroups());
+
+  // Only the member without a delay is sent the sample.
+  ExpectAdminStatusRetrieved(1);
+  EXPECT_CALL(stream1, Write(_, _)).WillOnce(Return(true));
+  EXPECT_CALL(stream2, Write(_, _)).Times(0);
+  HandleSamples();
+}
+
+TEST_F(SubscriptionTest, SampleGroupDroppedWithLastSubscription) {
+  SubscribeReaderWriterMock stream1, stream2;
+  SubscriptionHandle h1, h2;
+  ::gnmi::Path path =
+      GetPath("interfaces")("interface", "device1.domain.net.com:ce-1/1")(
+          "state")("admin-status")();
+  ASSERT_OK(
+      gnmi_publisher_->SubscribePeriodic(Periodic(1000), path, &stream1, &h1));
+  ASSERT_OK(
+      gnmi_publisher_->SubscribePeriodic(Periodic(1000), path, &stream2, &h2));
+
+  // An unsubscribed stream does not receive the samples anymore.
+  EXPECT_OK(gnmi_publisher_->UnSubscribe(h1));
+  h1.reset();
+  ExpectAdminStatusRetrieved(1);
+  EXPECT_CALL(stream1, Write(_, _)).Times(0);
+  EXPECT_CALL(stream2, Write(_, _)).WillOnce(Return(true));
+  HandleSamples();
+  EXPECT_EQ(1, NumSampleGroups());
+
+  // The group is dropped once its last subscription is gone.
+  h2.reset();
+  HandleSamples();
+  EXPECT_EQ(0, NumSampleGroups());
+}
+
 TEST_F(SubscriptionTest, OnUpdateUnSupportedPath) {
   // Configure the device - the model will reconfigure itself to reflect the
   // configuration.
@@ -16,6 +16,7 @@
 
 #include "stratum/hal/lib/common/p4_service.h"
 
+#include <algorithm>
 #include <functional>
 #include <sstream>  // IWYU pragma: keep
 #include <utility>
@@ -55,6 +56,17 @@ DEFINE_int32(max_num_controllers_per_node, 5,
 DEFINE_int32(max_num_controller_connections, 20,
              "Max number of active/inactive streaming connections from outside "
              "controllers (for all of the nodes combined).");
+DEFINE_int32(packet_in_max_batch_size, 64,
+             "Max number of packets read from the packet-in Channel of a node "
+             "and written to the master controller stream at once.");
+DEFINE_int32(packet_in_max_batch_latency_us, 0,
+             "Max time (in usecs) the first packet of a packet-in batch waits "
+             "for more packets to arrive before the batch is sent. With 0, "
+             "only the packets already pending are batched and no packet is "
+             "ever delayed.");
+DEFINE_int32(packet_in_batch_stats_log_interval_secs, 300,
+             "Interval (in secs) at which the packet-in thread of a node logs "
+             "the packet-in batch stats of the node. 0 disables the logging.");
 
 namespace stratum {
 namespace hal {
@@ -799,10 +811,22 @@ void* P4Service::PacketReceiveThreadFunc(void* arg) {
 
 void* P4Service::ReceivePackets(
     uint64 node_id, std::unique_ptr<ChannelReader<::p4::v1::PacketIn>> reader) {
+  const size_t max_batch_size = std::max(FLAGS_packet_in_max_batch_size, 1);
+  const absl::Duration max_batch_latency =
+      absl::Microseconds(FLAGS_packet_in_max_batch_latency_us);
+  // The responses sent to the controller for a batch of packets. The packets
+  // are moved from the Channel straight into them, so that the payload is
+  // never copied on its way to the stream. Reusing the same responses also
+  // saves the allocation of a response and its PacketIn per packet.
+  std::vector<::p4::v1::StreamMessageResponse> resps(max_batch_size);
+  const absl::Duration stats_log_interval =
+      absl::Seconds(FLAGS_packet_in_batch_stats_log_interval_secs);
+  absl::Time next_stats_log = absl::Now() + stats_log_interval;
   do {
-    ::p4::v1::PacketIn packet_in;
     // Block on next packet RX from Channel.
-    int code = reader->Read(&packet_in, absl::InfiniteDuration()).error_code();
+    int code =
+        reader->Read(resps[0].mutable_packet(), absl::InfiniteDuration())
+            .error_code();
     // Exit if the Channel is closed.
     if (code == ERR_CANCELLED) break;
     // Read should never timeout.
@@ -810,21 +834,91 @@ void* P4Service::ReceivePackets(
       LOG(ERROR) << "Read with infinite timeout failed with ENTRY_NOT_FOUND.";
       continue;
     }
-    // Handle PacketIn.
-    PacketReceiveHandler(node_id, packet_in);
+    // Add the packets which are already pending (or arrive within the latency
+    // bound) to the batch.
+    size_t num_resps = 1;
+    absl::Time deadline = absl::InfinitePast();
+    if (max_batch_latency > absl::ZeroDuration()) {
+      deadline = absl::Now() + max_batch_latency;
+    }
+    while (num_resps < max_batch_size) {
+      ::p4::v1::PacketIn* packet = resps[num_resps].mutable_packet();
+      code = reader->TryRead(packet).error_code();
+      if (code == ERR_ENTRY_NOT_FOUND && deadline > absl::InfinitePast()) {
+        absl::Duration timeout = deadline - absl::Now();
+        if (timeout <= absl::ZeroDuration()) break;
+        code = reader->Read(packet, timeout).error_code();
+      }
+      if (code != ERR_SUCCESS) break;
+      ++num_resps;
+    }
+    // Handle the batch of PacketIns.
+    PacketReceiveHandler(node_id, resps, num_resps);
+    if (stats_log_interval > absl::ZeroDuration() &&
+        absl::Now() >= next_stats_log) {
+      absl::ReaderMutexLock l(&packet_in_stats_lock_);
+      LOG(INFO) << "Packet-in batch stats for node " << node_id << ": "
+                << node_id_to_packet_in_batch_stats_[node_id].ToString();
+      next_stats_log = absl::Now() + stats_log_interval;
+    }
+    if (code == ERR_CANCELLED) break;
   } while (true);
   return nullptr;
 }
 
-void P4Service::PacketReceiveHandler(uint64 node_id,
-                                     const ::p4::v1::PacketIn& packet) {
-  // We send the packets only to the master controller stream for this node.
-  absl::ReaderMutexLock l(&controller_lock_);
-  auto it = node_id_to_controllers_.find(node_id);
-  if (it == node_id_to_controllers_.end() || it->second.empty()) return;
-  ::p4::v1::StreamMessageResponse resp;
-  *resp.mutable_packet() = packet;
-  it->second.begin()->stream()->Write(resp);
+void P4Service::PacketReceiveHandler(
+    uint64 node_id, const std::vector<::p4::v1::StreamMessageResponse>& resps,
+    size_t num_resps) {
+  num_resps = std::min(num_resps, resps.size());
+  if (num_resps == 0) return;
+  bool sent = false;
+  {
+    // We send the packets only to the master controller stream for this node.
+    absl::ReaderMutexLock l(&controller_lock_);
+    auto it = node_id_to_controllers_.find(node_id);
+    if (it != node_id_to_controllers_.end() && !it->second.empty()) {
+      ServerStreamChannelReaderWriter* stream = it->second.begin()->stream();
+      for (size_t i = 0; i < num_resps; ++i) {
+        // Let gRPC buffer all the packets but the last one, so that the whole
+        // batch is flushed to the controller at once.
+        ::grpc::WriteOptions options;
+        if (i + 1 < num_resps) options.set_buffer_hint();
+        stream->Write(resps[i], options);
+      }
+      sent = true;
+    }
+  }
+
+  absl::WriterMutexLock l(&packet_in_stats_lock_);
+  PacketInBatchStats& stats = node_id_to_packet_in_batch_stats_[node_id];
+  if (!sent) {
+    stats.num_dropped_packets += num_resps;
+    return;
+  }
+  stats.num_batches++;
+  stats.num_packets += num_resps;
+  stats.max_batch_size =
+      std::max(stats.max_batch_size, static_cast<uint64>(num_resps));
+  int bucket = 0;
+  while (bucket < PacketInBatchStats::kNumBatchSizeBuckets - 1 &&
+         (num_resps >> (bucket + 1)) > 0) {
+    ++bucket;
+  }
+  stats.batch_size_buckets[bucket]++;
+}
+
+std::string P4Service::DumpPacketInBatchStats() const {
+  std::string msg = "";
+  {
+    absl::ReaderMutexLock l(&packet_in_stats_lock_);
+    for (const auto& e : node_id_to_packet_in_batch_stats_) {
+      absl::StrAppend(&msg, "\nPacket-in batch stats for node ", e.first, ": ",
+                      e.second.ToString());
+    }
+  }
+
+  LOG(INFO) << msg;
+  return msg;
 }
 
 }  // namespace hal
@@ -22,6 +22,7 @@
 #include <grpcpp/grpcpp.h>
 #include <pthread.h>
 
+#include <array>
 #include <memory>
 #include <sstream>
 #include <string>
@@ -40,6 +41,7 @@
 #include "stratum/glue/integral_types.h"
 #include "absl/base/thread_annotations.h"
 #include "absl/numeric/int128.h"
+#include "absl/strings/str_cat.h"
 #include "absl/synchronization/mutex.h"
 #include "p4/v1/p4runtime.grpc.pb.h"
 
@@ -51,6 +53,36 @@ typedef ::grpc::ServerReaderWriter<::p4::v1::StreamMessageResponse,
                                    ::p4::v1::StreamMessageRequest>
     ServerStreamChannelReaderWriter;
 
+// Stats for the batches of packets sent to the master controller of a node.
+struct PacketInBatchStats {
+  // Num of buckets in the batch size distribution.
+  static constexpr int kNumBatchSizeBuckets = 12;
+  // Num of batches and num of packets in them.
+  uint64 num_batches;
+  uint64 num_packets;
+  // Num of packets dropped as the node had no master controller.
+  uint64 num_dropped_packets;
+  // Size of the largest batch.
+  uint64 max_batch_size;
+  // Distribution of the batch sizes. batch_size_buckets[i] counts the batches
+  // of [2^i, 2^(i+1)) packets. The last bucket counts all the larger batches.
+  std::array<uint64, kNumBatchSizeBuckets> batch_size_buckets;
+  PacketInBatchStats()
+      : num_batches(0), num_packets(0), num_dropped_packets(0),
+        max_batch_size(0), batch_size_buckets() {}
+  std::string ToString() const {
+    std::string buckets = "";
+    for (int i = 0; i < kNumBatchSizeBuckets; ++i) {
+      absl::StrAppend(&buckets, i ? ", " : "", batch_size_buckets[i]);
+    }
+    return absl::StrCat("(num_batches:", num_batches,
+                        ", num_packets:", num_packets,
+                        ", num_dropped_packets:", num_dropped_packets,
+                        ", max_batch_size:", max_batch_size,
+                        ", batch_size_buckets:[", buckets, "])");
+  }
+};
+
 // The "P4Service" class implements P4Runtime::Service. It handles all
 // the RPCs that are part of the P4-based PI API.
 class P4Service final : public ::p4::v1::P4Runtime::Service {
@@ -161,6 +193,12 @@ class P4Service final : public ::p4::v1::P4Runtime::Service {
       const ::p4::v1::CapabilitiesRequest* request,
       ::p4::v1::CapabilitiesResponse* response) override;
 
+  // Returns a human-readable dump of the packet-in batch stats of all the
+  // nodes. Also logs it. The packet-in thread of each node also logs the
+  // stats of its node every --packet_in_batch_stats_log_interval_secs.
+  std::string DumpPacketInBatchStats() const
+      LOCKS_EXCLUDED(packet_in_stats_lock_);
+
   // P4Service is neither copyable nor movable.
   P4Service(const P4Service&) = delete;
   P4Service& operator=(const P4Service&) = delete;
@@ -220,15 +258,22 @@ class P4Service final : public ::p4::v1::P4Runtime::Service {
       LOCKS_EXCLUDED(controller_lock_);
 
   // Blocks on the Channel registered with SwitchInterface to read received
-  // packets.
+  // packets. Every time a packet arrives, drains the packets pending in the
+  // Channel (up to --packet_in_max_batch_size of them, waiting at most
+  // --packet_in_max_batch_latency_us for more to arrive) and sends them to
+  // the controller as one batch.
   void* ReceivePackets(
       uint64 node_id, std::unique_ptr<ChannelReader<::p4::v1::PacketIn>> reader)
       LOCKS_EXCLUDED(controller_lock_);
 
-  // Callback to be called whenever we receive a packet on the specified node
-  // which is destined to controller.
-  void PacketReceiveHandler(uint64 node_id, const ::p4::v1::PacketIn& packet)
-      LOCKS_EXCLUDED(controller_lock_);
+  // Callback to be called whenever we receive a batch of packets on the
+  // specified node which are destined to controller. The first 'num_resps'
+  // elements of 'resps' hold the received packets. The whole batch is written
+  // to the stream of the master controller under one lock, and flushed once.
+  void PacketReceiveHandler(
+      uint64 node_id,
+      const std::vector<::p4::v1::StreamMessageResponse>& resps,
+      size_t num_resps) LOCKS_EXCLUDED(controller_lock_, packet_in_stats_lock_);
 
   // Mutex lock used to protect node_id_to_controllers_ which is updated
   // every time mastership for any of the controllers connected to each node is
@@ -243,6 +288,9 @@ class P4Service final : public ::p4::v1::P4Runtime::Service {
   // Channels and threads.
   mutable absl::Mutex packet_in_thread_lock_;
 
+  // Mutex lock for protecting the packet-in batch stats.
+  mutable absl::Mutex packet_in_stats_lock_;
+
   // Map from node ID to the set of Controller instances corresponding to the
   // external controller clients connected to that node. The Controller
   // instances for each node are sorted such that the master (Controller
@@ -254,6 +302,11 @@ class P4Service final : public ::p4::v1::P4Runtime::Service {
   std::vector<pthread_t> packet_in_reader_tids_
       GUARDED_BY(packet_in_thread_lock_);
 
+  // Map from node ID to the stats of the packet-in batches sent to the master
+  // controller of the node.
+  std::map<uint64, PacketInBatchStats> node_id_to_packet_in_batch_stats_
+      GUARDED_BY(packet_in_stats_lock_);
+
   // Map of per-node Channels which are used to forward received packets to
   // P4Service.
   std::map<uint64, std::shared_ptr<Channel<::p4::v1::PacketIn>>>
@@ -0,0 +1,214 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Measures the packet-in path of P4Service, from the switch writing PacketIns
+// into the RX writer registered by P4Service to the master controller reading
+// them from its stream. The switch either copies or moves the packets into the
+// writer. Reports packets/sec and heap allocations per packet.
+//
+// The allocations are counted by replacing the global operator new, which is
+// why the benchmark lives in its own binary. Only the allocations made while
+// the packets are in flight are counted, by any thread of the process, gRPC
+// included.
+//
+// Example:
+//   p4_service_benchmark --p4_service_benchmark_num_packets=1000000
+//       --packet_in_max_batch_size=128
+
+#include <grpcpp/grpcpp.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "gmock/gmock.h"
+#include "google/rpc/code.pb.h"
+#include "stratum/glue/init_google.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/logging.h"
+#include "stratum/glue/net_util/ports.h"
+#include "stratum/hal/lib/common/error_buffer.h"
+#include "stratum/hal/lib/common/p4_service.h"
+#include "stratum/hal/lib/common/switch_mock.h"
+#include "stratum/lib/security/auth_policy_checker_mock.h"
+#include "absl/memory/memory.h"
+#include "absl/numeric/int128.h"
+#include "absl/strings/str_format.h"
+#include "absl/time/clock.h"
+
+DEFINE_int32(p4_service_benchmark_num_packets, 100000,
+             "Num of PacketIns sent to the controller in each run.");
+DEFINE_int32(p4_service_benchmark_payload_size, 1500,
+             "Payload size of the PacketIns in bytes.");
+
+namespace {
+
+// Heap allocations are only counted while counting is enabled, i.e. while a
+// ScopedHeapAllocCounter is alive.
+std::atomic<bool> count_heap_allocs(false);
+std::atomic<uint64> num_heap_allocs(0);
+
+}  // namespace
+
+void* operator new(size_t size) {
+  if (count_heap_allocs.load(std::memory_order_relaxed)) {
+    num_heap_allocs.fetch_add(1, std::memory_order_relaxed);
+  }
+  void* ptr = malloc(size);
+  if (ptr == nullptr) throw std::bad_alloc();
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept { free(ptr); }
+
+void operator delete(void* ptr, size_t size) noexcept { free(ptr); }
+
+namespace stratum {
+namespace hal {
+namespace {
+
+typedef ::grpc::ClientReaderWriter<::p4::v1::StreamMessageRequest,
+                                   ::p4::v1::StreamMessageResponse>
+    ClientStreamChannelReaderWriter;
+
+constexpr uint64 kNodeId = 123123123;
+constexpr uint64 kElectionId = 1111;
+
+// Counts the heap allocations made by the process during its lifetime. At
+// most one instance may exist at a time.
+class ScopedHeapAllocCounter {
+ public:
+  ScopedHeapAllocCounter() {
+    num_heap_allocs = 0;
+    count_heap_allocs = true;
+  }
+  ~ScopedHeapAllocCounter() { count_heap_allocs = false; }
+
+  uint64 count() const { return num_heap_allocs; }
+
+  // Disallow copy and assign.
+  ScopedHeapAllocCounter(const ScopedHeapAllocCounter&) = delete;
+  ScopedHeapAllocCounter& operator=(const ScopedHeapAllocCounter&) = delete;
+};
+
+}  // namespace
+
+int Main(int argc, char** argv) {
+  InitGoogle(argv[0], &argc, &argv, true);
+  const int num_packets = std::max(FLAGS_p4_service_benchmark_num_packets, 1);
+  const int payload_size = FLAGS_p4_service_benchmark_payload_size;
+
+  ::testing::NiceMock<SwitchMock> switch_mock;
+  ::testing::NiceMock<AuthPolicyCheckerMock> auth_policy_checker_mock;
+  ErrorBuffer error_buffer;
+  std::shared_ptr<WriterInterface<::p4::v1::PacketIn>> writer;
+  ON_CALL(auth_policy_checker_mock, Authorize(::testing::_, ::testing::_,
+                                              ::testing::_))
+      .WillByDefault(::testing::Return(::util::OkStatus()));
+  ON_CALL(switch_mock, RegisterPacketReceiveWriter(kNodeId, ::testing::_))
+      .WillByDefault(::testing::DoAll(::testing::SaveArg<1>(&writer),
+                                      ::testing::Return(::util::OkStatus())));
+
+  auto p4_service = absl::make_unique<P4Service>(
+      OPERATION_MODE_STANDALONE, &switch_mock, &auth_policy_checker_mock,
+      &error_buffer);
+  std::string url = "localhost:" + std::to_string(PickUnusedPortOrDie());
+  ::grpc::ServerBuilder builder;
+  builder.AddListeningPort(url, ::grpc::InsecureServerCredentials());
+  builder.RegisterService(p4_service.get());
+  std::unique_ptr<::grpc::Server> server = builder.BuildAndStart();
+  CHECK(server != nullptr);
+  std::unique_ptr<::p4::v1::P4Runtime::Stub> stub =
+      ::p4::v1::P4Runtime::NewStub(
+          ::grpc::CreateChannel(url, ::grpc::InsecureChannelCredentials()));
+
+  // Become the master controller of the node.
+  ::grpc::ClientContext context;
+  std::unique_ptr<ClientStreamChannelReaderWriter> stream =
+      stub->StreamChannel(&context);
+  ::p4::v1::StreamMessageRequest req;
+  ::p4::v1::StreamMessageResponse resp;
+  req.mutable_arbitration()->set_device_id(kNodeId);
+  req.mutable_arbitration()->mutable_election_id()->set_high(
+      absl::Uint128High64(kElectionId));
+  req.mutable_arbitration()->mutable_election_id()->set_low(
+      absl::Uint128Low64(kElectionId));
+  CHECK(stream->Write(req));
+  CHECK(stream->Read(&resp));
+  CHECK_EQ(::google::rpc::OK, resp.arbitration().status().code());
+  CHECK(writer != nullptr);
+
+  ::p4::v1::PacketIn packet;
+  auto* metadata = packet.add_metadata();
+  metadata->set_metadata_id(123456);
+  metadata->set_value(std::string("\x00\x01", 2));
+  packet.set_payload(std::string(payload_size, 'x'));
+  std::cout << num_packets << " packet-ins with " << payload_size
+            << " byte payloads." << std::endl;
+  for (bool move : {false, true}) {
+    // The packets are built beforehand, as the RX thread of the switch does
+    // before it writes them.
+    std::vector<::p4::v1::PacketIn> packets(num_packets, packet);
+    uint64 allocs = 0;
+    absl::Time start = absl::Now();
+    {
+      ScopedHeapAllocCounter alloc_counter;
+      std::thread producer([&packets, &writer, move]() {
+        for (auto& p : packets) {
+          if (move) {
+            writer->Write(std::move(p));
+          } else {
+            writer->Write(p);
+          }
+        }
+      });
+      for (int i = 0; i < num_packets; ++i) {
+        CHECK(stream->Read(&resp));
+        CHECK_EQ(static_cast<size_t>(payload_size),
+                 resp.packet().payload().size());
+      }
+      producer.join();
+      allocs = alloc_counter.count();
+    }
+    absl::Duration elapsed = absl::Now() - start;
+
+    std::cout << absl::StrFormat(
+                     "%-8s %12.0f packets/s  %6.2f heap allocations/packet",
+                     move ? "moved" : "copied",
+                     num_packets / absl::ToDoubleSeconds(elapsed),
+                     static_cast<double>(allocs) / num_packets)
+              << std::endl;
+  }
+
+  stream->WritesDone();
+  CHECK(stream->Finish().ok());
+  CHECK(p4_service->Teardown().ok());
+  server->Shutdown();
+
+  return 0;
+}
+
+}  // namespace hal
+}  // namespace stratum
+
+int main(int argc, char** argv) { return stratum::hal::Main(argc, argv); }
@@ -17,7 +17,10 @@
 #include "stratum/hal/lib/common/p4_service.h"
 
 #include <grpcpp/grpcpp.h>
+
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "gflags/gflags.h"
 #include "google/rpc/code.pb.h"
@@ -37,9 +40,12 @@
 #include "absl/numeric/int128.h"
 #include "absl/strings/substitute.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
 
 DECLARE_int32(max_num_controllers_per_node);
 DECLARE_int32(max_num_controller_connections);
+DECLARE_int32(packet_in_max_batch_size);
+DECLARE_int32(packet_in_max_batch_latency_us);
 DECLARE_string(forwarding_pipeline_configs_file);
 DECLARE_string(write_req_log_file);
 DECLARE_string(test_tmpdir);
@@ -52,6 +58,7 @@ using ::testing::DoAll;
 using ::testing::HasSubstr;
 using ::testing::Invoke;
 using ::testing::Return;
+using ::testing::SaveArg;
 using ::testing::SetArgPointee;
 using ::testing::WithArgs;
 
@@ -83,6 +90,8 @@ class P4ServiceTest : public ::testing::TestWithParam<OperationMode> {
     ASSERT_NE(stub_, nullptr);
     FLAGS_max_num_controllers_per_node = 5;
     FLAGS_max_num_controller_connections = 20;
+    FLAGS_packet_in_max_batch_size = 64;
+    FLAGS_packet_in_max_batch_latency_us = 0;
     FLAGS_forwarding_pipeline_configs_file =
         FLAGS_test_tmpdir + "/forwarding_pipeline_configs_file.pb.txt";
     FLAGS_write_req_log_file = FLAGS_test_tmpdir + "/write_req_log_fil.csv";
@@ -95,7 +104,18 @@ class P4ServiceTest : public ::testing::TestWithParam<OperationMode> {
   void TearDown() override { server_->Shutdown(); }
 
   void OnPacketReceive(const ::p4::v1::PacketIn& packet) {
-    p4_service_->PacketReceiveHandler(kNodeId1, packet);
+    std::vector<::p4::v1::StreamMessageResponse> resps(1);
+    *resps[0].mutable_packet() = packet;
+    p4_service_->PacketReceiveHandler(kNodeId1, resps, resps.size());
+  }
+
+  PacketInBatchStats GetPacketInBatchStats(uint64 node_id) {
+    absl::ReaderMutexLock l(&p4_service_->packet_in_stats_lock_);
+    auto it = p4_service_->node_id_to_packet_in_batch_stats_.find(node_id);
+    if (it == p4_service_->node_id_to_packet_in_batch_stats_.end()) {
+      return PacketInBatchStats();
+    }
+    return it->second;
   }
 
   void FillTestForwardingPipelineConfigsAndSave(
@@ -1087,6 +1107,82 @@ TEST_P(P4ServiceTest, StreamChannelSuccess) {
   ASSERT_TRUE(stream3->Finish().ok());
 }
 
+TEST_P(P4ServiceTest, StreamChannelSendsPacketInsInBatches) {
+  // With a large latency bound, the packets are sent in batches of max size.
+  FLAGS_packet_in_max_batch_size = 5;
+  FLAGS_packet_in_max_batch_latency_us = 5000000;
+  constexpr int kNumPackets = 10;
+  ::grpc::ClientContext context;
+  ::p4::v1::StreamMessageRequest req;
+  ::p4::v1::StreamMessageResponse resp;
+  std::shared_ptr<WriterInterface<::p4::v1::PacketIn>> writer;
+
+  EXPECT_CALL(*auth_policy_checker_mock_,
+              Authorize("P4Service", "StreamChannel", _))
+      .WillRepeatedly(Return(::util::OkStatus()));
+  EXPECT_CALL(*switch_mock_, RegisterPacketReceiveWriter(kNodeId1, _))
+      .WillOnce(DoAll(SaveArg<1>(&writer), Return(::util::OkStatus())));
+
+  // Controller connects and becomes master.
+  std::unique_ptr<ClientStreamChannelReaderWriter> stream =
+      stub_->StreamChannel(&context);
+  req.mutable_arbitration()->set_device_id(kNodeId1);
+  req.mutable_arbitration()->mutable_election_id()->set_high(
+      absl::Uint128High64(kElectionId1));
+  req.mutable_arbitration()->mutable_election_id()->set_low(
+      absl::Uint128Low64(kElectionId1));
+  ASSERT_TRUE(stream->Write(req));
+  ASSERT_TRUE(stream->Read(&resp));
+  ASSERT_EQ(::google::rpc::OK, resp.arbitration().status().code());
+  ASSERT_NE(nullptr, writer);
+
+  // The switch receives a burst of packets.
+  for (int i = 0; i < kNumPackets; ++i) {
+    ::p4::v1::PacketIn packet;
+    packet.set_payload("packet " + std::to_string(i));
+    ASSERT_TRUE(writer->Write(std::move(packet)));
+  }
+
+  // They all reach the controller, in order.
+  for (int i = 0; i < kNumPackets; ++i) {
+    ASSERT_TRUE(stream->Read(&resp));
+    EXPECT_EQ("packet " + std::to_string(i), resp.packet().payload());
+  }
+
+  // The stats are updated right after the batch is written.
+  PacketInBatchStats stats;
+  absl::Time deadline = absl::Now() + absl::Seconds(5);
+  do {
+    stats = GetPacketInBatchStats(kNodeId1);
+  } while (stats.num_packets < 10U && absl::Now() < deadline);
+  EXPECT_EQ(2U, stats.num_batches);
+  EXPECT_EQ(10U, stats.num_packets);
+  EXPECT_EQ(5U, stats.max_batch_size);
+  // Two batches of 5 packets, in the [4, 8) bucket.
+  EXPECT_EQ(2U, stats.batch_size_buckets[2]);
+  EXPECT_THAT(p4_service_->DumpPacketInBatchStats(),
+              HasSubstr("num_batches:2, num_packets:10, "
+                        "num_dropped_packets:0"));
+
+  stream->WritesDone();
+  ASSERT_TRUE(stream->Finish().ok());
+}
+
+TEST_P(P4ServiceTest, PacketInDroppedWithNoMasterIsCounted) {
+  // No controller is connected, so there is no master for the node.
+  ::p4::v1::PacketIn packet;
+  packet.set_payload("packet");
+  OnPacketReceive(packet);
+  OnPacketReceive(packet);
+
+  PacketInBatchStats stats = GetPacketInBatchStats(kNodeId1);
+  EXPECT_EQ(0U, stats.num_batches);
+  EXPECT_EQ(0U, stats.num_packets);
+  EXPECT_EQ(2U, stats.num_dropped_packets);
+  EXPECT_THAT(p4_service_->DumpPacketInBatchStats(),
+              HasSubstr("num_dropped_packets:2"));
+}
+
 TEST_P(P4ServiceTest, StreamChannelFailureForTooManyConnections) {
   FLAGS_max_num_controller_connections = 2;  // max two connections
   ::grpc::ClientContext context1;
@@ -31,6 +31,7 @@ class ServerWriterWrapper : public WriterInterface<T> {
  public:
   explicit ServerWriterWrapper(::grpc::ServerWriter<T>* writer)
       : writer_(writer) {}
+  using WriterInterface<T>::Write;
   bool Write(const T& msg) override {
     if (writer_) return writer_->Write(msg);
     return false;
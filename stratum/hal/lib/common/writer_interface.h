@@ -33,6 +33,11 @@ class WriterInterface {
   // Blocking Write() operation which passes a message of type T into the
   // underlying transfer mechanism.
   virtual bool Write(const T& msg) = 0;
+  // Same as above, but lets the implementations that can take ownership of
+  // the message (e.g. a Channel) avoid copying it. Falls back to the copying
+  // Write() by default. Subclasses which override only one of the two need
+  // a "using WriterInterface<T>::Write;" so the other one is not hidden.
+  virtual bool Write(T&& msg) { return Write(static_cast<const T&>(msg)); }
 
  protected:
   // Default constructor. To be called by the Mock class instance only.
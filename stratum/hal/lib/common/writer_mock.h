@@ -29,6 +29,8 @@ namespace hal {
 template <typename T>
 class WriterMock : public WriterInterface<T> {
  public:
+  // Write(T&&) of the base class forwards to the mocked Write(const T&).
+  using WriterInterface<T>::Write;
   MOCK_METHOD1_T(Write, bool(const T& msg));
 };
 
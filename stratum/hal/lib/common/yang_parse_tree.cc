@@ -20,18 +20,73 @@
 #include <list>
 #include <string>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "gflags/gflags.h"
 #include "stratum/glue/status/status_macros.h"
 #include "stratum/hal/lib/common/gnmi_publisher.h"
 #include "stratum/hal/lib/common/yang_parse_tree_paths.h"
 
+DEFINE_int32(gnmi_port_counters_max_age_ms, 100,
+             "The maximum age of the port counters snapshot that gNMI counter "
+             "leaves are served from. All counter leaves read within this "
+             "window share one counter retrieval per port.");
+
 namespace stratum {
 namespace hal {
 
+namespace {
+
+// Ports whose counters have not been read for this long are no longer
+// retrieved when the port counters snapshot is refreshed.
+constexpr absl::Duration kPortCountersIdleTimeout = absl::Seconds(30);
+
+// The separators of the path index keys. The key of a path is the
+// concatenation of its element names, each preceded by kPathIndexElemSeparator,
+// and of the values of their 'name' keys, each preceded by
+// kPathIndexKeySeparator. The key of the root is the empty string. Control
+// characters are used so that names like "xe-1/1/1" cannot be confused with
+// the structure of the path.
+constexpr char kPathIndexElemSeparator = '\x1e';
+constexpr char kPathIndexKeySeparator = '\x1f';
+
+// Returns the path index key of 'path'.
+std::string GetPathIndexKey(const ::gnmi::Path& path) {
+  std::string key;
+  for (const auto& elem : path.elem()) {
+    key.push_back(kPathIndexElemSeparator);
+    key.append(elem.name());
+    auto* search = gtl::FindOrNull(elem.key(), "name");
+    if (search != nullptr) {
+      key.push_back(kPathIndexKeySeparator);
+      key.append(*search);
+    }
+  }
+  return key;
+}
+
+// Adds 'node', whose path index key is 'key', and all its descendants to
+// 'index'.
+void AddToPathIndex(const TreeNode& node, const std::string& key,
+                    absl::flat_hash_map<std::string, const TreeNode*>* index) {
+  (*index)[key] = &node;
+  for (const auto& entry : node.children_) {
+    std::string child_key = key;
+    child_key.push_back(entry.second.is_name_a_key() ? kPathIndexKeySeparator
+                                                     : kPathIndexElemSeparator);
+    child_key.append(entry.first);
+    AddToPathIndex(entry.second, child_key, index);
+  }
+}
+
+}  // namespace
+
 TreeNode::TreeNode(const TreeNode& src) {
   name_ = src.name_;
   // Deep-copy children.
@@ -202,6 +257,7 @@ void YangParseTree::SendNotification(const GnmiEventPtr& event) {
     node_names.insert(node.name());
   }
   AddRoot();
+  BuildPathIndex();
   return ::util::OkStatus();
 }
 
@@ -214,15 +270,33 @@ bool YangParseTree::IsWildcard(const std::string& name) const {
 ::util::Status YangParseTree::PerformActionForAllNonWildcardNodes(
     const gnmi::Path& path, const gnmi::Path& subpath,
     const std::function<::util::Status(const TreeNode& leaf)>& action) const {
-  const auto* root = root_.FindNodeOrNull(path);
-  ::util::Status ret = ::util::OkStatus();
-  for (const auto& entry : root->children_) {
-    if (IsWildcard(entry.first)) {
-      // Skip this one!
-      continue;
+  std::vector<const TreeNode*> leaves;
+  {
+    // The actions may take root_access_lock_, so it is only held while the
+    // matches are resolved.
+    absl::ReaderMutexLock r(&root_access_lock_);
+    absl::MutexLock l(&wildcard_matches_lock_);
+    const auto key =
+        std::make_pair(GetPathIndexKey(path), GetPathIndexKey(subpath));
+    auto* matches = gtl::FindOrNull(wildcard_matches_, key);
+    if (matches == nullptr) {
+      // First expansion since the tree has changed. Walk the tree.
+      matches = &wildcard_matches_[key];
+      const auto* root = root_.FindNodeOrNull(path);
+      for (const auto& entry : root->children_) {
+        if (IsWildcard(entry.first)) {
+          // Skip this one!
+          continue;
+        }
+        matches->push_back(subpath.elem_size()
+                               ? entry.second.FindNodeOrNull(subpath)
+                               : &entry.second);
+      }
     }
-    auto* leaf = subpath.elem_size() ? entry.second.FindNodeOrNull(subpath)
-                                     : &entry.second;
+    leaves = *matches;
+  }
+  ::util::Status ret = ::util::OkStatus();
+  for (const auto* leaf : leaves) {
     if (leaf == nullptr) {
       // Should not happen!
       ::util::Status status = MAKE_ERROR(ERR_INTERNAL)
@@ -237,7 +311,8 @@ bool YangParseTree::IsWildcard(const std::string& name) const {
 }
 
 YangParseTree::YangParseTree(SwitchInterface* switch_interface)
-    : switch_interface_(ABSL_DIE_IF_NULL(switch_interface)) {
+    : switch_interface_(ABSL_DIE_IF_NULL(switch_interface)),
+      path_index_valid_(false) {
   // Add the minimum nodes:
   //   /interfaces/interface[name=*]/state/ifindex
   //   /interfaces/interface[name=*]/state/name
@@ -247,6 +322,7 @@ YangParseTree::YangParseTree(SwitchInterface* switch_interface)
   absl::WriterMutexLock l(&root_access_lock_);
   AddSubtreeAllInterfaces();
   AddRoot();
+  BuildPathIndex();
 }
 
 TreeNode* YangParseTree::AddNode(const ::gnmi::Path& path) {
@@ -257,6 +333,7 @@ TreeNode* YangParseTree::AddNode(const ::gnmi::Path& path) {
     if (child == nullptr) {
       // This path is not supported yet. Let's add a node with default
       // processing.
+      InvalidatePathIndex();
       node->children_.emplace(element.name(), TreeNode(*node, element.name()));
       child = gtl::FindOrNull(node->children_, element.name());
     }
@@ -271,6 +348,7 @@ TreeNode* YangParseTree::AddNode(const ::gnmi::Path& path) {
     if (child == nullptr) {
       // This path is not supported yet. Let's add a node with default
       // processing.
+      InvalidatePathIndex();
       node->children_.emplace(
           *search, TreeNode(*node, *search, true /* mark as a key */));
       child = gtl::FindOrNull(node->children_, *search);
@@ -296,17 +374,41 @@ TreeNode* YangParseTree::AddNode(const ::gnmi::Path& path) {
   // Now 'node' points to the insertion point of the new subtree.
 
   // Deep-copy the source subtree.
+  InvalidatePathIndex();
   node->CopySubtree(*source);
 
   return ::util::OkStatus();
 }
 
+void YangParseTree::BuildPathIndex() {
+  path_index_.clear();
+  AddToPathIndex(root_, "", &path_index_);
+  path_index_valid_ = true;
+  VLOG(1) << "Indexed " << path_index_.size() << " gNMI paths.";
+  absl::MutexLock l(&wildcard_matches_lock_);
+  wildcard_matches_.clear();
+}
+
+void YangParseTree::InvalidatePathIndex() {
+  if (path_index_valid_) {
+    path_index_valid_ = false;
+    path_index_.clear();
+  }
+  absl::MutexLock l(&wildcard_matches_lock_);
+  wildcard_matches_.clear();
+}
+
 const TreeNode* YangParseTree::FindNodeOrNull(const ::gnmi::Path& path) const {
-  absl::WriterMutexLock l(&root_access_lock_);
+  absl::ReaderMutexLock l(&root_access_lock_);
 
-  // Map the input path to the supported one - walk the tree of known elements
-  // element by element starting from the root and if the element is found the
-  // move to the next one. If not found, return an error (nullptr).
+  if (path_index_valid_) {
+    auto* node = gtl::FindOrNull(path_index_, GetPathIndexKey(path));
+    if (node != nullptr) return *node;
+  }
+  // Not in the index, e.g. a path going past a leaf, which is resolved to the
+  // leaf. Map the input path to the supported one - walk the tree of known
+  // elements element by element starting from the root and if the element is
+  // found the move to the next one. If not found, return an error (nullptr).
   return root_.FindNodeOrNull(path);
 }
 
@@ -316,6 +418,97 @@ const TreeNode* YangParseTree::GetRoot() const {
   return &root_;
 }
 
+::util::Status YangParseTree::GetPortCounters(uint64 node_id, uint32 port_id,
+                                              PortCounters* counters) {
+  // Taken before port_counters_lock_ as it acquires root_access_lock_.
+  SwitchInterface* switch_interface = GetSwitchInterface();
+  absl::MutexLock l(&port_counters_lock_);
+
+  const absl::Time now = absl::Now();
+  const absl::Time stale_before =
+      now - absl::Milliseconds(FLAGS_gnmi_port_counters_max_age_ms);
+  auto& snapshot = port_counters_[std::make_pair(node_id, port_id)];
+  snapshot.last_read = now;
+  if (snapshot.timestamp < stale_before) {
+    // Refresh all stale ports that are still being read, not just this one.
+    // The other counter leaves of this tick will then find them fresh.
+    std::map<uint64, std::vector<uint32>> stale_ports;
+    for (auto it = port_counters_.begin(); it != port_counters_.end();) {
+      if (it->second.last_read < now - kPortCountersIdleTimeout) {
+        port_counters_.erase(it++);
+        continue;
+      }
+      if (it->second.timestamp < stale_before) {
+        stale_ports[it->first.first].push_back(it->first.second);
+      }
+      ++it;
+    }
+    for (const auto& e : stale_ports) {
+      RefreshPortCounters(switch_interface, e.first, e.second, now);
+    }
+  }
+  // The snapshot entry of the port is still valid, the loop above only
+  // erases idle ports.
+  if (snapshot.timestamp < stale_before) {
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "Failed to retrieve counters of port " << port_id
+           << " on node " << node_id << ".";
+  }
+  *counters = snapshot.counters;
+  return ::util::OkStatus();
+}
+
+void YangParseTree::RefreshPortCounters(SwitchInterface* switch_interface,
+                                        uint64 node_id,
+                                        const std::vector<uint32>& ports,
+                                        absl::Time timestamp) {
+  DataRequest req;
+  for (uint32 port_id : ports) {
+    auto* request = req.add_requests()->mutable_port_counters();
+    request->set_node_id(node_id);
+    request->set_port_id(port_id);
+  }
+  std::vector<PortCounters> resps;
+  DataResponseWriter writer([&resps](const DataResponse& in) -> bool {
+    if (!in.has_port_counters()) return false;
+    resps.push_back(in.port_counters());
+    return true;
+  });
+  std::vector<::util::Status> details;
+  auto status =
+      switch_interface->RetrieveValue(node_id, req, &writer, &details);
+  if (!status.ok()) {
+    LOG(ERROR) << "Failed to retrieve counters of " << ports.size()
+               << " ports on node " << node_id << ": " << status;
+    return;
+  }
+  // The responses do not identify the port, but they are written in request
+  // order and only for the requests that succeeded.
+  std::vector<const PortCounters*> port_resps(ports.size(), nullptr);
+  if (details.size() == ports.size()) {
+    size_t next = 0;
+    for (size_t i = 0; i < ports.size() && next < resps.size(); ++i) {
+      if (details[i].ok()) port_resps[i] = &resps[next++];
+    }
+  } else if (resps.size() == ports.size()) {
+    for (size_t i = 0; i < ports.size(); ++i) port_resps[i] = &resps[i];
+  } else if (ports.size() > 1) {
+    // The switch does not report per-request status and some of the requests
+    // failed, so the responses cannot be matched to the ports. Fall back to
+    // one request per port.
+    for (uint32 port_id : ports) {
+      RefreshPortCounters(switch_interface, node_id, {port_id}, timestamp);
+    }
+    return;
+  }
+  for (size_t i = 0; i < ports.size(); ++i) {
+    if (port_resps[i] == nullptr) continue;
+    auto& snapshot = port_counters_[std::make_pair(node_id, ports[i])];
+    snapshot.counters = *port_resps[i];
+    snapshot.timestamp = timestamp;
+  }
+}
+
 void YangParseTree::AddSubtreeInterfaceFromTrunk(
     const std::string& name, uint64 node_id, uint32 port_id,
     const NodeConfigParams& node_config) {
@@ -23,7 +23,10 @@
 #include <memory>
 #include <string>
 #include <map>
+#include <vector>
 
+#include "absl/container/flat_hash_map.h"
+#include "absl/time/time.h"
 #include "stratum/lib/macros.h"
 #include "stratum/glue/status/status.h"
 #include "gnmi/gnmi.grpc.pb.h"
@@ -284,6 +287,7 @@ class TreeNode {
 
   const TreeNode& parent() const { return *parent_; }
   const std::string& name() const { return name_; }
+  bool is_name_a_key() const { return is_name_a_key_; }
 
   // Returns path from root to this node.
   ::gnmi::Path GetPath() const;
@@ -434,7 +438,9 @@ class YangParseTree {
   // Configure the root element.
   void AddRoot() EXCLUSIVE_LOCKS_REQUIRED(root_access_lock_);
 
-  // Returns a node that handles the YANG path.
+  // Returns a node that handles the YANG path. The path is looked up in the
+  // path index built after each config push, and the tree is walked only for
+  // paths that are not indexed.
   const TreeNode* FindNodeOrNull(const ::gnmi::Path& path) const
       LOCKS_EXCLUDED(root_access_lock_);
 
@@ -463,6 +469,17 @@ class YangParseTree {
   ::util::Status ProcessPushedConfig(const ConfigHasBeenPushedEvent& change)
       LOCKS_EXCLUDED(root_access_lock_);
 
+  // Returns the counters of port 'port_id' on node 'node_id' from the port
+  // counters snapshot. Counter leaves of one port are read one by one, so the
+  // snapshot is refreshed at most once every FLAGS_gnmi_port_counters_max_age_ms
+  // and the refresh retrieves the counters of all ports that have been read
+  // recently in one batched RetrieveValue() call per node. This way a SAMPLE
+  // subscription to the counters of all interfaces costs one counter
+  // retrieval per port per sample interval.
+  virtual ::util::Status GetPortCounters(uint64 node_id, uint32 port_id,
+                                         PortCounters* counters)
+      LOCKS_EXCLUDED(root_access_lock_, port_counters_lock_);
+
  protected:
   using Action = std::function<void()>;
 
@@ -474,6 +491,17 @@ class YangParseTree {
   ::util::Status CopySubtree(const ::gnmi::Path& from, const ::gnmi::Path& to)
       EXCLUSIVE_LOCKS_REQUIRED(root_access_lock_);
 
+  // Rebuilds the path index from the current tree and drops the cached
+  // wildcard matches. It is called once the tree is complete, i.e. after the
+  // pushed config has been processed.
+  void BuildPathIndex() EXCLUSIVE_LOCKS_REQUIRED(root_access_lock_)
+      LOCKS_EXCLUDED(wildcard_matches_lock_);
+
+  // Drops the path index and the cached wildcard matches. The paths are
+  // resolved by walking the tree until the index is rebuilt.
+  void InvalidatePathIndex() EXCLUSIVE_LOCKS_REQUIRED(root_access_lock_)
+      LOCKS_EXCLUDED(wildcard_matches_lock_);
+
   // A helper method for checking if the name of a TreeNode is a wildcard.
   // It is used while processing requests for multiple children to skip nodes
   // whose processing would create an infinite loop as the wildcard nodes are
@@ -482,11 +510,18 @@ class YangParseTree {
 
   // A helper function. Finds a node specified by 'path' and then for all
   // non-wildcard children finds leaf specified by 'subpath' and executes
-  // 'action' on that leaf.
+  // 'action' on that leaf. Takes root_access_lock_ as a reader while finding
+  // the leaves, not while executing 'action'.
   ::util::Status PerformActionForAllNonWildcardNodes(
       const gnmi::Path& path, const gnmi::Path& subpath,
       const std::function<::util::Status(const TreeNode& leaf)>& action) const
-      EXCLUSIVE_LOCKS_REQUIRED(root_access_lock_);
+      LOCKS_EXCLUDED(root_access_lock_, wildcard_matches_lock_);
+
+  // Retrieves the counters of the 'ports' of node 'node_id' in one
+  // RetrieveValue() call and updates their snapshots with 'timestamp'.
+  void RefreshPortCounters(SwitchInterface* switch_interface, uint64 node_id,
+                           const std::vector<uint32>& ports, absl::Time timestamp)
+      EXCLUSIVE_LOCKS_REQUIRED(port_counters_lock_);
 
   SwitchInterface* switch_interface_ GUARDED_BY(root_access_lock_);
 
@@ -499,6 +534,47 @@ class YangParseTree {
   // A Mutex used to guard access to the root.
   mutable absl::Mutex root_access_lock_;
 
+  // The path index. Maps the index key of every path of the tree (the names
+  // of its elements and 'name' keys, see the .cc file) to its node, so that
+  // FindNodeOrNull() resolves a path with a single hash lookup instead of one
+  // std::map lookup per element. The nodes are owned by root_ and are never
+  // removed, so the pointers stay valid.
+  absl::flat_hash_map<std::string, const TreeNode*> path_index_
+      GUARDED_BY(root_access_lock_);
+  // False if nodes have been added since the index was built.
+  bool path_index_valid_ GUARDED_BY(root_access_lock_);
+
+  // The nodes PerformActionForAllNonWildcardNodes() acts on, by the index keys
+  // of its 'path' and 'subpath'. A subscription to a wildcard path like
+  // /interfaces/interface[name=*]/state/name expands to the same leaves until
+  // the tree changes, so the expansion is computed once. nullptr stands for a
+  // node missing the 'subpath' leaf. Filled while holding root_access_lock_,
+  // and cleared by InvalidatePathIndex() and BuildPathIndex().
+  mutable absl::flat_hash_map<std::pair<std::string, std::string>,
+                              std::vector<const TreeNode*>>
+      wildcard_matches_ GUARDED_BY(wildcard_matches_lock_);
+  // A Mutex used to guard access to the cached wildcard matches. Taken after
+  // root_access_lock_ if both are needed.
+  mutable absl::Mutex wildcard_matches_lock_;
+
+  // The last retrieved counters of a port.
+  struct PortCountersSnapshot {
+    PortCounters counters;
+    // When 'counters' were retrieved. absl::InfinitePast() if never.
+    absl::Time timestamp = absl::InfinitePast();
+    // When the counters of the port were last read by a leaf handler. Ports
+    // that have not been read for a while are dropped from the snapshot.
+    absl::Time last_read = absl::InfinitePast();
+  };
+
+  // The port counters snapshot, keyed by (node ID, port ID).
+  absl::flat_hash_map<std::pair<uint64, uint32>, PortCountersSnapshot>
+      port_counters_ GUARDED_BY(port_counters_lock_);
+  // A Mutex used to guard access to the port counters snapshot. It is held
+  // while the snapshot is refreshed, so that concurrent readers wait for the
+  // refresh instead of retrieving the same counters again.
+  absl::Mutex port_counters_lock_;
+
   // In most cases the TARGET_DEFINED mode is ON_CHANGE mode as this mode
   // is the least resource-hungry. But to make the gNMI demo more realistic it
   // is changed to SAMPLE with the period of 1s.
@@ -530,6 +606,7 @@ class DataResponseWriter : public WriterInterface<DataResponse> {
 
   // The only work method defined by the interface - it is called every time
   // there is a data to be processed.
+  using WriterInterface<DataResponse>::Write;
   bool Write(const DataResponse& resp) override { return worker_(resp); }
 
  private:
@@ -0,0 +1,189 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Measures how long it takes to resolve gNMI paths and to set up gNMI
+// subscriptions with a chassis config of many ports. Every path of the parse
+// tree is resolved both through the path index of the YangParseTree and by
+// walking the tree, and ON_CHANGE and POLL subscriptions are set up for a leaf
+// of every interface and for the wildcard paths.
+//
+// Example:
+//   yang_parse_tree_benchmark --yang_parse_tree_benchmark_num_ports=128
+
+#include <functional>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "gnmi/gnmi.pb.h"
+#include "stratum/glue/init_google.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/logging.h"
+#include "stratum/hal/lib/common/common.pb.h"
+#include "stratum/hal/lib/common/gnmi_publisher.h"
+#include "stratum/hal/lib/common/subscribe_reader_writer_mock.h"
+#include "stratum/hal/lib/common/switch_mock.h"
+#include "stratum/hal/lib/common/yang_parse_tree.h"
+#include "stratum/lib/constants.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+DEFINE_int32(yang_parse_tree_benchmark_num_ports, 128,
+             "Num of singleton ports in the chassis config.");
+DEFINE_int32(yang_parse_tree_benchmark_num_iterations, 100,
+             "Num of times every path of the tree is resolved.");
+
+namespace stratum {
+namespace hal {
+namespace {
+
+constexpr uint64 kNodeId = 1;
+
+ChassisConfig CreateChassisConfig(int num_ports) {
+  ChassisConfig config;
+  config.mutable_chassis()->set_name("chassis-1");
+  auto* node = config.add_nodes();
+  node->set_id(kNodeId);
+  node->set_name("node-1");
+  for (int i = 1; i <= num_ports; ++i) {
+    auto* singleton = config.add_singleton_ports();
+    singleton->set_id(i);
+    singleton->set_name(absl::StrCat("xe-1/", i, "/1"));
+    singleton->set_slot(1);
+    singleton->set_port(i);
+    singleton->set_node(kNodeId);
+    singleton->set_speed_bps(kTwentyFiveGigBps);
+  }
+  return config;
+}
+
+// Returns the paths of all the nodes of the subtree of 'root'.
+std::vector<::gnmi::Path> GetAllPaths(const TreeNode& root) {
+  std::vector<::gnmi::Path> paths;
+  std::function<void(const TreeNode&)> add = [&](const TreeNode& node) {
+    paths.push_back(node.GetPath());
+    for (const auto& entry : node.children_) add(entry.second);
+  };
+  add(root);
+  return paths;
+}
+
+// Resolves every path 'num_iterations' times and returns the average time of
+// a resolution.
+absl::Duration MeasureResolution(
+    const std::vector<::gnmi::Path>& paths, int num_iterations,
+    const std::function<const TreeNode*(const ::gnmi::Path&)>& find) {
+  absl::Time start = absl::Now();
+  for (int i = 0; i < num_iterations; ++i) {
+    for (const auto& path : paths) CHECK(find(path) != nullptr);
+  }
+  return (absl::Now() - start) /
+         static_cast<int64>(paths.size() * num_iterations);
+}
+
+void PrintResult(const std::string& name, absl::Duration duration) {
+  std::cout << absl::StrFormat("%-45s %10.3f us", name,
+                               absl::ToDoubleMicroseconds(duration))
+            << std::endl;
+}
+
+}  // namespace
+
+int Main(int argc, char** argv) {
+  InitGoogle(argv[0], &argc, &argv, true);
+  const int num_ports = FLAGS_yang_parse_tree_benchmark_num_ports;
+  const int num_iterations = FLAGS_yang_parse_tree_benchmark_num_iterations;
+  const ChassisConfig config = CreateChassisConfig(num_ports);
+  ::testing::NiceMock<SwitchMock> switch_mock;
+
+  // Path resolution.
+  YangParseTree tree(&switch_mock);
+  absl::Time start = absl::Now();
+  CHECK(tree.ProcessPushedConfig(ConfigHasBeenPushedEvent(config)).ok());
+  absl::Duration push = absl::Now() - start;
+  const std::vector<::gnmi::Path> paths = GetAllPaths(*tree.GetRoot());
+  std::cout << num_ports << " ports, " << paths.size() << " paths."
+            << std::endl;
+  PrintResult("config push", push);
+  PrintResult("path resolution (index)",
+              MeasureResolution(paths, num_iterations,
+                                [&tree](const ::gnmi::Path& path) {
+                                  return tree.FindNodeOrNull(path);
+                                }));
+  const TreeNode* root = tree.GetRoot();
+  PrintResult("path resolution (tree walk)",
+              MeasureResolution(paths, num_iterations,
+                                [root](const ::gnmi::Path& path) {
+                                  return root->FindNodeOrNull(path);
+                                }));
+
+  // Subscription setup.
+  GnmiPublisher publisher(&switch_mock);
+  CHECK(publisher.HandleChange(ConfigHasBeenPushedEvent(config)).ok());
+  SubscribeReaderWriterMock stream;
+  std::vector<SubscriptionHandle> handles;
+  start = absl::Now();
+  for (int i = 1; i <= num_ports; ++i) {
+    SubscriptionHandle h;
+    CHECK(publisher
+              .SubscribeOnChange(GetPath("interfaces")(
+                                     "interface", absl::StrCat("xe-1/", i,
+                                                               "/1"))(
+                                     "state")("oper-status")(),
+                                 &stream, &h)
+              .ok());
+    handles.push_back(h);
+  }
+  PrintResult("ON_CHANGE subscription to one leaf",
+              (absl::Now() - start) / num_ports);
+  const std::vector<std::pair<std::string, ::gnmi::Path>> wildcards = {
+      {"[name=*]/state/name",
+       GetPath("interfaces")("interface", "*")("state")("name")()},
+      {"[name=*]/state/ifindex",
+       GetPath("interfaces")("interface", "*")("state")("ifindex")()},
+      {"/...", GetPath("interfaces")("interface")("...")()},
+  };
+  for (const auto& entry : wildcards) {
+    start = absl::Now();
+    for (int i = 0; i < num_iterations; ++i) {
+      SubscriptionHandle h;
+      CHECK(publisher.SubscribeOnChange(entry.second, &stream, &h).ok());
+      handles.push_back(h);
+    }
+    PrintResult(
+        absl::StrCat("ON_CHANGE subscription to interface", entry.first),
+        (absl::Now() - start) / num_iterations);
+    start = absl::Now();
+    for (int i = 0; i < num_iterations; ++i) {
+      SubscriptionHandle h;
+      CHECK(publisher.SubscribePoll(entry.second, &stream, &h).ok());
+      handles.push_back(h);
+    }
+    PrintResult(absl::StrCat("POLL subscription to interface", entry.first),
+                (absl::Now() - start) / num_iterations);
+  }
+  for (const auto& h : handles) CHECK(publisher.UnSubscribe(h).ok());
+
+  return 0;
+}
+
+}  // namespace hal
+}  // namespace stratum
+
+int main(int argc, char** argv) { return stratum::hal::Main(argc, argv); }
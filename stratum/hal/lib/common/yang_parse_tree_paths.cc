@@ -1400,6 +1400,9 @@ void SetUpInterfacesInterfaceEthernetStateAutoNegotiate(
 // data from the DataResponse proto received from SwitchInterface, i.e.,
 // "&DataResponse::PortCounters::message", where message field in
 // DataResponse::Counters.
+// The counters are read from the port counters snapshot kept by the tree, so
+// all counter leaves of all ports handled within one sample interval share one
+// batched counter retrieval.
 TreeNodeEventHandler GetPollCounterFunctor(
     uint64 node_id, uint32 port_id,
     ::google::protobuf::uint64 (PortCounters::*func_ptr)() const,
@@ -1407,26 +1410,14 @@ TreeNodeEventHandler GetPollCounterFunctor(
   return [tree, node_id, port_id, func_ptr](const GnmiEvent& event,
                                             const ::gnmi::Path& path,
                                             GnmiSubscribeStream* stream) {
-    // Create a data retrieval request.
-    DataRequest req;
-    auto* request = req.add_requests()->mutable_port_counters();
-    request->set_node_id(node_id);
-    request->set_port_id(port_id);
-
-    // In-place definition of method retrieving data from generic response
-    // and saving into 'resp' local variable.
-    uint64 resp = 0;
-    DataResponseWriter writer(
-        [&resp, func_ptr](const DataResponse& in) -> bool {
-          if (!in.has_port_counters()) return false;
-          resp = (in.port_counters().*func_ptr)();
-          return true;
-        });
-    // Query the switch. The returned status is ignored as there is no way to
+    // Query the snapshot. The returned status is ignored as there is no way to
     // notify the controller that something went wrong. The error is logged when
     // it is created.
-    auto status = tree->GetSwitchInterface()->RetrieveValue(
-        node_id, req, &writer, /* details= */ nullptr);
+    PortCounters counters;
+    uint64 resp = 0;
+    if (tree->GetPortCounters(node_id, port_id, &counters).ok()) {
+      resp = (counters.*func_ptr)();
+    }
     return SendResponse(GetResponse(path, resp), stream);
   };
 }
@@ -2629,7 +2620,7 @@ void YangParseTreePaths::AddSubtreeAllInterfaces(YangParseTree* tree) {
   tree->AddNode(GetPath("interfaces")("interface", "*")("state")("ifindex")())
       ->SetOnChangeRegistration(
           [tree](const EventHandlerRecordPtr& record)
-              EXCLUSIVE_LOCKS_REQUIRED(tree->root_access_lock_) {
+              LOCKS_EXCLUDED(tree->root_access_lock_) {
                 // Subscribing to a wildcard node means that all matching nodes
                 // have to be registered for received events.
                 auto status = tree->PerformActionForAllNonWildcardNodes(
@@ -2646,7 +2637,7 @@ void YangParseTreePaths::AddSubtreeAllInterfaces(YangParseTree* tree) {
       ->SetOnPollHandler(
           [tree](const GnmiEvent& event, const ::gnmi::Path& path,
                  GnmiSubscribeStream* stream)
-              EXCLUSIVE_LOCKS_REQUIRED(tree->root_access_lock_) {
+              LOCKS_EXCLUDED(tree->root_access_lock_) {
                 // Polling a wildcard node means that all matching nodes have to
                 // be polled.
                 auto status = tree->PerformActionForAllNonWildcardNodes(
@@ -2664,7 +2655,7 @@ void YangParseTreePaths::AddSubtreeAllInterfaces(YangParseTree* tree) {
   tree->AddNode(GetPath("interfaces")("interface", "*")("state")("name")())
       ->SetOnChangeRegistration(
           [tree](const EventHandlerRecordPtr& record)
-              EXCLUSIVE_LOCKS_REQUIRED(tree->root_access_lock_) {
+              LOCKS_EXCLUDED(tree->root_access_lock_) {
                 // Subscribing to a wildcard node means that all matching nodes
                 // have to be registered for received events.
                 auto status = tree->PerformActionForAllNonWildcardNodes(
@@ -2681,7 +2672,7 @@ void YangParseTreePaths::AddSubtreeAllInterfaces(YangParseTree* tree) {
       ->SetOnPollHandler(
           [tree](const GnmiEvent& event, const ::gnmi::Path& path,
                  GnmiSubscribeStream* stream)
-              EXCLUSIVE_LOCKS_REQUIRED(tree->root_access_lock_) {
+              LOCKS_EXCLUDED(tree->root_access_lock_) {
                 // Polling a wildcard node means that all matching nodes have to
                 // be polled.
                 auto status = tree->PerformActionForAllNonWildcardNodes(
@@ -2697,7 +2688,7 @@ void YangParseTreePaths::AddSubtreeAllInterfaces(YangParseTree* tree) {
               });
 
   auto interfaces_on_chage_reg = [tree](const EventHandlerRecordPtr& record)
-  EXCLUSIVE_LOCKS_REQUIRED(tree->root_access_lock_) {
+  LOCKS_EXCLUDED(tree->root_access_lock_) {
     // Subscribing to a wildcard node means that all matching nodes
     // have to be registered for received events.
     auto status = tree->PerformActionForAllNonWildcardNodes(
@@ -2710,7 +2701,7 @@ void YangParseTreePaths::AddSubtreeAllInterfaces(YangParseTree* tree) {
 
   auto interfaces_on_poll = [tree](const GnmiEvent& event, const ::gnmi::Path& path,
                                    GnmiSubscribeStream* stream)
-  EXCLUSIVE_LOCKS_REQUIRED(tree->root_access_lock_) {
+  LOCKS_EXCLUDED(tree->root_access_lock_) {
     // Polling a wildcard node means that all matching nodes have to
     // be polled.
     auto status = tree->PerformActionForAllNonWildcardNodes(
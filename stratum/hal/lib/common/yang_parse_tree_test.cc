@@ -96,8 +96,6 @@ class YangParseTreeTest : public ::testing::Test {
   ::util::Status PerformActionForAllNonWildcardNodes(
       const gnmi::Path& path, const gnmi::Path& subpath,
       const std::function<::util::Status(const TreeNode& leaf)>& action) const {
-    absl::WriterMutexLock l(&parse_tree_.root_access_lock_);
-
     return parse_tree_.PerformActionForAllNonWildcardNodes(path, subpath,
                                                            action);
   }
@@ -417,6 +415,34 @@ class YangParseTreeTest : public ::testing::Test {
                         notification);
   }
 
+  // Ages all port counters snapshots, as if the next sample interval started.
+  void ExpirePortCounters() {
+    absl::MutexLock l(&parse_tree_.port_counters_lock_);
+
+    for (auto& e : parse_tree_.port_counters_) {
+      e.second.timestamp = absl::InfinitePast();
+    }
+  }
+
+  // Calls the OnPoll handler of the leaf specified by 'path' and returns the
+  // uint value sent to the controller.
+  uint64 PollUintLeaf(const ::gnmi::Path& path) {
+    ::gnmi::SubscribeResponse resp;
+    SubscribeReaderWriterMock stream;
+    EXPECT_CALL(stream, Write(_, _))
+        .WillOnce(DoAll(
+            WithArgs<0>(Invoke(
+                [&resp](const ::gnmi::SubscribeResponse& r) { resp = r; })),
+            Return(true)));
+    auto* node = GetRoot().FindNodeOrNull(path);
+    EXPECT_NE(node, nullptr);
+    if (node == nullptr) return 0;
+    EXPECT_OK(node->GetOnPollHandler()(PollEvent(), &stream));
+    EXPECT_EQ(resp.update().update_size(), 1);
+    if (resp.update().update_size() != 1) return 0;
+    return resp.update().update(0).val().uint_val();
+  }
+
   // A mock of a switch that implements the switch interface.
   SwitchMock switch_;
   // The implementation under test.
@@ -597,6 +623,70 @@ TEST_F(YangParseTreeTest, PerformActionForAllNodesOnePresent) {
       GetPath("interfaces")("interface", "interface-1")("state")("ifindex")()));
 }
 
+// Check if the wildcard expansion is refreshed when the tree changes.
+TEST_F(YangParseTreeTest, PerformActionForAllNodesAfterNodeAdded) {
+  AddSubtreeInterface("interface-1");
+
+  int counter = 0;
+  const auto& action = [&counter](const TreeNode& leaf) {
+    ++counter;
+    return ::util::OkStatus();
+  };
+
+  EXPECT_OK(PerformActionForAllNonWildcardNodes(
+      GetPath("interfaces")("interface")(), GetPath("state")("ifindex")(),
+      action));
+  EXPECT_EQ(1, counter);
+
+  // The expansion of the first call must not hide the new interface.
+  AddSubtreeInterface("interface-2");
+  counter = 0;
+  EXPECT_OK(PerformActionForAllNonWildcardNodes(
+      GetPath("interfaces")("interface")(), GetPath("state")("ifindex")(),
+      action));
+  EXPECT_EQ(2, counter);
+}
+
+// Check if the path index resolves every path the same way the tree walk does.
+TEST_F(YangParseTreeTest, FindNodeOrNullAfterConfigPushed) {
+  ChassisConfig config;
+  config.mutable_chassis()->set_name("chassis-1");
+  auto* node = config.add_nodes();
+  node->set_id(kInterface1NodeId);
+  node->set_name("node-1");
+  for (const auto& name : {"xe-1/1/1", "xe-1/1/2"}) {
+    auto* singleton = config.add_singleton_ports();
+    singleton->set_id(config.singleton_ports_size());
+    singleton->set_name(name);
+    singleton->set_node(kInterface1NodeId);
+    singleton->set_speed_bps(kTwentyFiveGigBps);
+  }
+  EXPECT_OK(parse_tree_.ProcessPushedConfig(ConfigHasBeenPushedEvent(config)));
+
+  // Every node of the tree is found by its path.
+  std::function<void(const TreeNode&)> check = [&](const TreeNode& node) {
+    EXPECT_EQ(&node, parse_tree_.FindNodeOrNull(node.GetPath()))
+        << node.GetPath().ShortDebugString();
+    for (const auto& entry : node.children_) check(entry.second);
+  };
+  check(GetRoot());
+
+  // A path going past a leaf is resolved to the leaf.
+  const TreeNode* leaf = parse_tree_.FindNodeOrNull(
+      GetPath("interfaces")("interface", "xe-1/1/1")("state")("oper-status")());
+  ASSERT_NE(nullptr, leaf);
+  EXPECT_EQ(leaf, parse_tree_.FindNodeOrNull(GetPath("interfaces")(
+                      "interface", "xe-1/1/1")("state")("oper-status")("x")()));
+  EXPECT_EQ(nullptr, parse_tree_.FindNodeOrNull(
+                         GetPath("interfaces")("interface", "xe-1/1/3")()));
+
+  // Nodes added after the index was built are found too.
+  const TreeNode* added = AddNode(
+      GetPath("interfaces")("interface", "xe-1/1/3")("state")("name")());
+  EXPECT_EQ(added, parse_tree_.FindNodeOrNull(GetPath("interfaces")(
+                       "interface", "xe-1/1/3")("state")("name")()));
+}
+
 // Check if RetrieveValue is called.
 TEST_F(YangParseTreeTest, GetDataFromSwitchInterfaceCalled) {
   // Create a fake switch interface object.
@@ -651,6 +741,7 @@ class GnmiEventWriterMock : public WriterInterface<GnmiEventPtr> {
 
   // The only work method defined by the interface - it is called every time
   // there is a data to be processed.
+  using WriterInterface<GnmiEventPtr>::Write;
   MOCK_METHOD1(Write, bool(const GnmiEventPtr& resp));
 };
 
@@ -1265,6 +1356,70 @@ TEST_F(YangParseTreeTest,
   EXPECT_EQ(resp.update().update(0).val().uint_val(), kInOctets);
 }
 
+// Check that the counter leaves of all ports read within one sample interval
+// are served from one batched counter retrieval.
+TEST_F(YangParseTreeTest, InterfacesInterfaceStateCountersBatchedOnPoll) {
+  constexpr uint64 kNodeId = kInterface1NodeId;
+  constexpr uint64 kPort1Id = kInterface1PortId;
+  constexpr uint64 kPort2Id = kInterface1PortId + 1;
+  AddSubtreeInterface("interface-1");
+  {
+    absl::WriterMutexLock l(&parse_tree_.root_access_lock_);
+    SingletonPort singleton;
+    singleton.set_name("interface-2");
+    singleton.set_node(kNodeId);
+    singleton.set_id(kPort2Id);
+    singleton.set_speed_bps(kTwentyFiveGigBps);
+    parse_tree_.AddSubtreeInterfaceFromSingleton(singleton,
+                                                 NodeConfigParams());
+  }
+  auto counters_path = [](const std::string& name, const std::string& leaf) {
+    return GetPath("interfaces")("interface", name)("state")("counters")(
+        leaf)();
+  };
+  // Mock implementation of RetrieveValue() that sets in-octets to the port ID
+  // and out-octets to twice the port ID.
+  auto retrieve = [](const DataRequest& req, WriterInterface<DataResponse>* w,
+                     std::vector<::util::Status>* details) {
+    for (const auto& request : req.requests()) {
+      uint32 port_id = request.port_counters().port_id();
+      DataResponse resp;
+      resp.mutable_port_counters()->set_in_octets(port_id);
+      resp.mutable_port_counters()->set_out_octets(2 * port_id);
+      w->Write(resp);
+      details->push_back(::util::OkStatus());
+    }
+  };
+
+  // The first reads discover the ports, one retrieval for each.
+  EXPECT_CALL(switch_, RetrieveValue(kNodeId, _, _, _))
+      .Times(2)
+      .WillRepeatedly(DoAll(WithArgs<1, 2, 3>(Invoke(retrieve)),
+                            Return(::util::OkStatus())));
+  EXPECT_EQ(PollUintLeaf(counters_path("interface-1", "in-octets")),
+            kPort1Id);
+  EXPECT_EQ(PollUintLeaf(counters_path("interface-2", "in-octets")),
+            kPort2Id);
+  ::testing::Mock::VerifyAndClearExpectations(&switch_);
+
+  // In the next interval all counters of both ports come from one retrieval.
+  ExpirePortCounters();
+  EXPECT_CALL(switch_, RetrieveValue(kNodeId, _, _, _))
+      .WillOnce(DoAll(WithArg<1>(Invoke([](const DataRequest& req) {
+                        EXPECT_THAT(req.requests(), SizeIs(2));
+                      })),
+                      WithArgs<1, 2, 3>(Invoke(retrieve)),
+                      Return(::util::OkStatus())));
+  EXPECT_EQ(PollUintLeaf(counters_path("interface-1", "in-octets")),
+            kPort1Id);
+  EXPECT_EQ(PollUintLeaf(counters_path("interface-1", "out-octets")),
+            2 * kPort1Id);
+  EXPECT_EQ(PollUintLeaf(counters_path("interface-2", "in-octets")),
+            kPort2Id);
+  EXPECT_EQ(PollUintLeaf(counters_path("interface-2", "out-octets")),
+            2 * kPort2Id);
+}
+
 // Check if the 'counters/in-octets' OnChange action works correctly.
 TEST_F(YangParseTreeTest,
        InterfacesInterfaceStateCountersInOctetsOnChangeSuccess) {
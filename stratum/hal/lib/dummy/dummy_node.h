@@ -197,6 +197,7 @@ class DummyNodeEventWriter : public WriterInterface<DummyNodeEventPtr> {
       const std::shared_ptr<WriterInterface<GnmiEventPtr>>& writer)
       : dummy_node_(dummy_node),
         writer_(writer) {}
+  using WriterInterface<DummyNodeEventPtr>::Write;
   bool Write(const DummyNodeEventPtr& msg) override;
 
  private:
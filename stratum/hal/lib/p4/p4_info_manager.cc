@@ -90,61 +90,107 @@ P4InfoManager::~P4InfoManager() {}
 
 ::util::StatusOr<const ::p4::config::v1::Table> P4InfoManager::FindTableByID(
     uint32 table_id) const {
-  return table_map_.FindByID(table_id);
+  ASSIGN_OR_RETURN(const auto* resource, table_map_.FindByID(table_id));
+  return *resource;
 }
 
 ::util::StatusOr<const ::p4::config::v1::Table> P4InfoManager::FindTableByName(
     const std::string& table_name) const {
-  return table_map_.FindByName(table_name);
+  ASSIGN_OR_RETURN(const auto* resource, table_map_.FindByName(table_name));
+  return *resource;
 }
 
 ::util::StatusOr<const ::p4::config::v1::Action> P4InfoManager::FindActionByID(
     uint32 action_id) const {
-  return action_map_.FindByID(action_id);
+  ASSIGN_OR_RETURN(const auto* resource, action_map_.FindByID(action_id));
+  return *resource;
 }
 
 ::util::StatusOr<const ::p4::config::v1::Action>
 P4InfoManager::FindActionByName(const std::string& action_name) const {
-  return action_map_.FindByName(action_name);
+  ASSIGN_OR_RETURN(const auto* resource, action_map_.FindByName(action_name));
+  return *resource;
 }
 
 ::util::StatusOr<const ::p4::config::v1::ActionProfile>
 P4InfoManager::FindActionProfileByID(uint32 profile_id) const {
-  return action_profile_map_.FindByID(profile_id);
+  ASSIGN_OR_RETURN(const auto* resource,
+                   action_profile_map_.FindByID(profile_id));
+  return *resource;
 }
 
 ::util::StatusOr<const ::p4::config::v1::ActionProfile>
 P4InfoManager::FindActionProfileByName(const std::string& profile_name) const {
-  return action_profile_map_.FindByName(profile_name);
+  ASSIGN_OR_RETURN(const auto* resource,
+                   action_profile_map_.FindByName(profile_name));
+  return *resource;
 }
 
 ::util::StatusOr<const ::p4::config::v1::Counter>
 P4InfoManager::FindCounterByID(uint32 counter_id) const {
-  return counter_map_.FindByID(counter_id);
+  ASSIGN_OR_RETURN(const auto* resource, counter_map_.FindByID(counter_id));
+  return *resource;
 }
 
 ::util::StatusOr<const ::p4::config::v1::Counter>
 P4InfoManager::FindCounterByName(const std::string& counter_name) const {
-  return counter_map_.FindByName(counter_name);
+  ASSIGN_OR_RETURN(const auto* resource, counter_map_.FindByName(counter_name));
+  return *resource;
 }
 
 ::util::StatusOr<const ::p4::config::v1::Meter> P4InfoManager::FindMeterByID(
     uint32 meter_id) const {
-  return meter_map_.FindByID(meter_id);
+  ASSIGN_OR_RETURN(const auto* resource, meter_map_.FindByID(meter_id));
+  return *resource;
 }
 
 ::util::StatusOr<const ::p4::config::v1::Meter> P4InfoManager::FindMeterByName(
     const std::string& meter_name) const {
-  return meter_map_.FindByName(meter_name);
+  ASSIGN_OR_RETURN(const auto* resource, meter_map_.FindByName(meter_name));
+  return *resource;
 }
+
 ::util::StatusOr<const ::p4::config::v1::ValueSet>
 P4InfoManager::FindValueSetByID(uint32 value_set_id) const {
-  return value_set_map_.FindByID(value_set_id);
+  ASSIGN_OR_RETURN(const auto* resource, value_set_map_.FindByID(value_set_id));
+  return *resource;
 }
 
 ::util::StatusOr<const ::p4::config::v1::ValueSet>
 P4InfoManager::FindValueSetByName(const std::string& value_set_name) const {
-  return value_set_map_.FindByName(value_set_name);
+  ASSIGN_OR_RETURN(const auto* resource,
+                   value_set_map_.FindByName(value_set_name));
+  return *resource;
+}
+
+::util::StatusOr<const ::p4::config::v1::Table*>
+P4InfoManager::FindTablePtrByID(uint32 table_id) const {
+  return table_map_.FindByID(table_id);
+}
+
+::util::StatusOr<const ::p4::config::v1::Action*>
+P4InfoManager::FindActionPtrByID(uint32 action_id) const {
+  return action_map_.FindByID(action_id);
+}
+
+::util::StatusOr<const ::p4::config::v1::ActionProfile*>
+P4InfoManager::FindActionProfilePtrByID(uint32 profile_id) const {
+  return action_profile_map_.FindByID(profile_id);
+}
+
+::util::StatusOr<const ::p4::config::v1::Counter*>
+P4InfoManager::FindCounterPtrByID(uint32 counter_id) const {
+  return counter_map_.FindByID(counter_id);
+}
+
+::util::StatusOr<const ::p4::config::v1::Meter*>
+P4InfoManager::FindMeterPtrByID(uint32 meter_id) const {
+  return meter_map_.FindByID(meter_id);
+}
+
+::util::StatusOr<const ::p4::config::v1::ValueSet*>
+P4InfoManager::FindValueSetPtrByID(uint32 value_set_id) const {
+  return value_set_map_.FindByID(value_set_id);
 }
 
 ::util::StatusOr<P4Annotation> P4InfoManager::GetSwitchStackAnnotations(
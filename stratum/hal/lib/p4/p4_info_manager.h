@@ -106,6 +106,23 @@ class P4InfoManager {
   virtual ::util::StatusOr<const ::p4::config::v1::ValueSet> FindValueSetByName(
       const std::string& value_set_name) const;
 
+  // These methods are similar to the ID lookups above, but a successful lookup
+  // returns a pointer to the resource data in the P4Info instead of a copy.
+  // The pointer remains valid for the life of this P4InfoManager, which makes
+  // these methods the preferred choice for lookups done per flow update.
+  virtual ::util::StatusOr<const ::p4::config::v1::Table*> FindTablePtrByID(
+      uint32 table_id) const;
+  virtual ::util::StatusOr<const ::p4::config::v1::Action*> FindActionPtrByID(
+      uint32 action_id) const;
+  virtual ::util::StatusOr<const ::p4::config::v1::ActionProfile*>
+  FindActionProfilePtrByID(uint32 profile_id) const;
+  virtual ::util::StatusOr<const ::p4::config::v1::Counter*>
+  FindCounterPtrByID(uint32 counter_id) const;
+  virtual ::util::StatusOr<const ::p4::config::v1::Meter*> FindMeterPtrByID(
+      uint32 meter_id) const;
+  virtual ::util::StatusOr<const ::p4::config::v1::ValueSet*>
+  FindValueSetPtrByID(uint32 value_set_id) const;
+
   // GetSwitchStackAnnotations attempts to parse any @switchstack annotations
   // in the input object's P4Info Preamble.  If the P4 object has multiple
   // @switchstack annotations, GetSwitchStackAnnotations merges them into
@@ -179,26 +196,28 @@ class P4InfoManager {
       return status;
     }
 
-    // Attempts to find the P4 resource matching the input ID.
-    ::util::StatusOr<const T> FindByID(uint32 id) const {
+    // Attempts to find the P4 resource matching the input ID.  The returned
+    // pointer refers to the resource in the P4Info given to BuildMaps.
+    ::util::StatusOr<const T*> FindByID(uint32 id) const {
       auto iter = id_to_resource_map_.find(id);
       if (iter == id_to_resource_map_.end()) {
         return MAKE_ERROR(ERR_INVALID_P4_INFO)
                << "P4Info " << resource_type_ << " ID " << PrintP4ObjectID(id)
                << " is not found";
       }
-      return *iter->second;
+      return iter->second;
     }
 
-    // Attempts to find the P4 resource matching the input name.
-    ::util::StatusOr<const T> FindByName(const std::string& name) const {
+    // Attempts to find the P4 resource matching the input name.  The returned
+    // pointer refers to the resource in the P4Info given to BuildMaps.
+    ::util::StatusOr<const T*> FindByName(const std::string& name) const {
       auto iter = name_to_resource_map_.find(name);
       if (iter == name_to_resource_map_.end()) {
         return MAKE_ERROR(ERR_INVALID_P4_INFO)
                << "P4Info " << resource_type_ << " name " << name
                << " is not found";
       }
-      return *iter->second;
+      return iter->second;
     }
 
     // Outputs LOG messages with name to ID translations for all members of
@@ -68,6 +68,24 @@ class P4InfoManagerMock : public P4InfoManager {
   MOCK_CONST_METHOD1(FindValueSetByName,
                      ::util::StatusOr<const ::p4::config::v1::ValueSet>(
                          const std::string& value_set_name));
+  MOCK_CONST_METHOD1(
+      FindTablePtrByID,
+      ::util::StatusOr<const ::p4::config::v1::Table*>(uint32 table_id));
+  MOCK_CONST_METHOD1(
+      FindActionPtrByID,
+      ::util::StatusOr<const ::p4::config::v1::Action*>(uint32 action_id));
+  MOCK_CONST_METHOD1(FindActionProfilePtrByID,
+                     ::util::StatusOr<const ::p4::config::v1::ActionProfile*>(
+                         uint32 profile_id));
+  MOCK_CONST_METHOD1(
+      FindCounterPtrByID,
+      ::util::StatusOr<const ::p4::config::v1::Counter*>(uint32 counter_id));
+  MOCK_CONST_METHOD1(
+      FindMeterPtrByID,
+      ::util::StatusOr<const ::p4::config::v1::Meter*>(uint32 meter_id));
+  MOCK_CONST_METHOD1(FindValueSetPtrByID,
+                     ::util::StatusOr<const ::p4::config::v1::ValueSet*>(
+                         uint32 value_set_id));
   MOCK_CONST_METHOD1(
       GetSwitchStackAnnotations,
       ::util::StatusOr<P4Annotation>(const std::string& p4_object_name));
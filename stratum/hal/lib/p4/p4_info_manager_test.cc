@@ -457,6 +457,39 @@ TEST_F(P4InfoManagerTest, TestFindTableUnknownName) {
   EXPECT_THAT(status.status().error_message(), HasSubstr("not found"));
 }
 
+// Pointer lookups by ID should refer to the tables in the manager's P4Info,
+// without any copy.
+TEST_F(P4InfoManagerTest, TestFindTablePtr) {
+  SetUpTestP4Tables(false);
+  ASSERT_TRUE(p4_test_manager_->InitializeAndVerify().ok());
+  for (const auto& table : p4_test_manager_->p4_info().tables()) {
+    auto id_status = p4_test_manager_->FindTablePtrByID(table.preamble().id());
+    ASSERT_TRUE(id_status.ok());
+    EXPECT_EQ(&table, id_status.ValueOrDie());
+  }
+  auto status = p4_test_manager_->FindTablePtrByID(123456);
+  EXPECT_FALSE(status.ok());
+  EXPECT_EQ(ERR_INVALID_P4_INFO, status.status().error_code());
+  EXPECT_THAT(status.status().error_message(), HasSubstr("not found"));
+}
+
+// Pointer lookups by ID should refer to the actions in the manager's P4Info,
+// without any copy.
+TEST_F(P4InfoManagerTest, TestFindActionPtr) {
+  SetUpTestP4Actions();
+  ASSERT_TRUE(p4_test_manager_->InitializeAndVerify().ok());
+  for (const auto& action : p4_test_manager_->p4_info().actions()) {
+    auto id_status =
+        p4_test_manager_->FindActionPtrByID(action.preamble().id());
+    ASSERT_TRUE(id_status.ok());
+    EXPECT_EQ(&action, id_status.ValueOrDie());
+  }
+  auto status = p4_test_manager_->FindActionPtrByID(123456);
+  EXPECT_FALSE(status.ok());
+  EXPECT_EQ(ERR_INVALID_P4_INFO, status.status().error_code());
+  EXPECT_THAT(status.status().error_message(), HasSubstr("not found"));
+}
+
 // All valid actions in p4_test_info_ should have successful name/ID lookups,
 // and the returned data should match the action's original p4_test_info_ entry.
 TEST_F(P4InfoManagerTest, TestFindAction) {
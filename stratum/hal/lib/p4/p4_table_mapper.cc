@@ -16,7 +16,8 @@
 
 #include "stratum/hal/lib/p4/p4_table_mapper.h"
 
-#include <set>
+#include <utility>
+#include <vector>
 
 #include "gflags/gflags.h"
 #include "stratum/glue/logging.h"
@@ -190,6 +191,8 @@ P4TableMapper::~P4TableMapper() { Shutdown().IgnoreError(); }
     }
   }
 
+  BuildTableMappingPlans();
+
   // Parse controller metadata and populate the internal tables. We try our
   // best to parse metadata and skip invalid/unknown data.
   for (const auto& controller_packet_metadata :
@@ -329,22 +332,27 @@ P4TableMapper::~P4TableMapper() { Shutdown().IgnoreError(); }
   // The table should be recognized in the P4Info, and it must contain a
   // valid set of match fields and one action.
   int p4_table_id = table_entry.table_id();
-  ASSIGN_OR_RETURN(::p4::config::v1::Table table_p4_info,
-                   p4_info_manager_->FindTableByID(p4_table_id));
-  std::vector<::p4::v1::FieldMatch> all_match_fields;
+  const P4TableMappingPlan* table_plan =
+      gtl::FindOrNull(table_mapping_plans_, p4_table_id);
+  if (table_plan == nullptr) {
+    // P4InfoManager reports the error for unknown tables.
+    return p4_info_manager_->FindTablePtrByID(p4_table_id).status();
+  }
+  const ::p4::config::v1::Table& table_p4_info = *table_plan->table_p4_info;
+  P4MatchFieldConversions all_match_fields;
   RETURN_IF_ERROR(
-      PrepareMatchFields(table_p4_info, table_entry, &all_match_fields));
+      PrepareMatchFields(*table_plan, table_entry, &all_match_fields));
   if (update_type == ::p4::v1::Update::INSERT && !table_entry.has_action()) {
     return MAKE_ERROR(ERR_INVALID_PARAM)
            << "P4 TableEntry update has no action";
   }
 
-  APPEND_STATUS_IF_ERROR(
-      status, ProcessTableID(table_p4_info, p4_table_id, flow_entry));
+  APPEND_STATUS_IF_ERROR(status, ProcessTableID(*table_plan, flow_entry));
 
   for (const auto& match_field : all_match_fields) {
     APPEND_STATUS_IF_ERROR(
-        status, ProcessMatchField(table_p4_info, match_field, flow_entry));
+        status, ProcessMatchField(table_p4_info, *match_field.first,
+                                  match_field.second, flow_entry));
   }
 
   if (table_entry.has_action()) {
@@ -371,10 +379,10 @@ P4TableMapper::~P4TableMapper() { Shutdown().IgnoreError(); }
                                     << "without valid P4 configuration";
   }
   ASSIGN_OR_RETURN(
-      const ::p4::config::v1::ActionProfile& profile_p4_info,
-      p4_info_manager_->FindActionProfileByID(member.action_profile_id()));
+      const ::p4::config::v1::ActionProfile* profile_p4_info,
+      p4_info_manager_->FindActionProfilePtrByID(member.action_profile_id()));
 
-  return ProcessProfileActionFunction(profile_p4_info, member.action(),
+  return ProcessProfileActionFunction(*profile_p4_info, member.action(),
                                       mapped_action);
 }
 
@@ -390,13 +398,10 @@ P4TableMapper::~P4TableMapper() { Shutdown().IgnoreError(); }
     return MAKE_ERROR(ERR_INTERNAL)
            << "Unable to map ActionProfileGroup without valid P4 configuration";
   }
-  ASSIGN_OR_RETURN(
-      const ::p4::config::v1::ActionProfile& unused_profile_p4_info,
-      p4_info_manager_->FindActionProfileByID(group.action_profile_id()));
+  RETURN_IF_ERROR(
+      p4_info_manager_->FindActionProfilePtrByID(group.action_profile_id())
+          .status());
   mapped_action->set_type(P4_ACTION_TYPE_PROFILE_GROUP_ID);
-  // TODO(unknown): Refactor the code in P4InfoManager so that you do not
-  // need to do tricks like this to work around the "unused var" error.
-  VLOG(4) << unused_profile_p4_info.ShortDebugString();
 
   return ::util::OkStatus();
 }
@@ -561,10 +566,21 @@ std::string Uint32ToByteStream(uint32 val) {
 
 ::util::Status P4TableMapper::LookupTable(
     int table_id, ::p4::config::v1::Table* table) const {
-  ASSIGN_OR_RETURN(*table, p4_info_manager_->FindTableByID(table_id));
+  ASSIGN_OR_RETURN(const ::p4::config::v1::Table* table_p4_info,
+                   FindTable(table_id));
+  *table = *table_p4_info;
   return ::util::OkStatus();
 }
 
+::util::StatusOr<const ::p4::config::v1::Table*> P4TableMapper::FindTable(
+    int table_id) const {
+  if (p4_info_manager_ == nullptr) {
+    return MAKE_ERROR(ERR_INTERNAL)
+           << "Unable to lookup table without valid P4 configuration";
+  }
+  return p4_info_manager_->FindTablePtrByID(table_id);
+}
+
 void P4TableMapper::EnableStaticTableUpdates() {
   static_table_updates_enabled_ = true;
 }
@@ -638,10 +654,31 @@ std::string P4TableMapper::GetMapperNameKey(
   return preamble.name();
 }
 
+void P4TableMapper::BuildTableMappingPlans() {
+  for (const auto& table : p4_info_manager_->p4_info().tables()) {
+    P4TableMappingPlan& table_plan =
+        table_mapping_plans_[table.preamble().id()];
+    table_plan.table_p4_info = &table;
+    table_plan.table_map_value =
+        gtl::FindPtrOrNull(global_id_table_map_, table.preamble().id());
+    table_plan.match_fields.resize(table.match_fields_size());
+    for (int i = 0; i < table.match_fields_size(); ++i) {
+      const auto& match_field = table.match_fields(i);
+      P4MatchFieldPlan& field_plan = table_plan.match_fields[i];
+      field_plan.dont_care_match.set_field_id(match_field.id());
+      field_plan.field_convert = gtl::FindOrNull(
+          field_convert_by_table_, MakeP4FieldConvertKey(table, match_field));
+      table_plan.match_field_index.emplace(match_field.id(), i);
+    }
+  }
+}
+
 ::util::Status P4TableMapper::PrepareMatchFields(
-    const ::p4::config::v1::Table& table_p4_info,
+    const P4TableMappingPlan& table_plan,
     const ::p4::v1::TableEntry& table_entry,
-    std::vector<::p4::v1::FieldMatch>* all_match_fields) const {
+    P4MatchFieldConversions* all_match_fields) const {
+  const ::p4::config::v1::Table& table_p4_info = *table_plan.table_p4_info;
+
   // An empty set of match fields changes the default action for tables
   // that were not defined with a const default action in the P4 program.
   if (table_entry.match_size() == 0) {
@@ -657,32 +694,51 @@ std::string P4TableMapper::GetMapperNameKey(
   // Per field validations:
   //  - Every field_id must be non-zero.
   //  - A field_id can appear in a match field at most once.
-  std::set<uint32> requested_field_ids;
+  // Fields unknown to the table have no entry in requested_fields, so they
+  // are checked for duplicates by scanning the previous fields.  This only
+  // happens for requests which fail mapping anyway.
+  std::vector<bool> requested_fields(table_plan.match_fields.size(), false);
+  all_match_fields->reserve(table_entry.match_size() +
+                            table_plan.match_fields.size());
   for (const auto& match_field : table_entry.match()) {
     if (match_field.field_id() == 0) {
       return MAKE_ERROR(ERR_INVALID_PARAM)
              << "P4 TableEntry match field has no field_id. "
              << table_entry.ShortDebugString();
     }
-    if (!requested_field_ids.insert(match_field.field_id()).second) {
+    const P4FieldConvertValue* field_convert = nullptr;
+    bool duplicate = false;
+    auto index_iter = table_plan.match_field_index.find(match_field.field_id());
+    if (index_iter != table_plan.match_field_index.end()) {
+      duplicate = requested_fields[index_iter->second];
+      requested_fields[index_iter->second] = true;
+      field_convert = table_plan.match_fields[index_iter->second].field_convert;
+    } else {
+      for (const auto& prev_match_field : *all_match_fields) {
+        if (prev_match_field.first->field_id() == match_field.field_id()) {
+          duplicate = true;
+          break;
+        }
+      }
+    }
+    if (duplicate) {
       return MAKE_ERROR(ERR_INVALID_PARAM)
              << "P4 TableEntry update of table "
              << table_p4_info.preamble().name() << " has multiple match field "
              << "entries for field_id " << match_field.field_id() << ". "
              << table_entry.ShortDebugString();
     }
-    all_match_fields->push_back(match_field);
+    all_match_fields->emplace_back(&match_field, field_convert);
   }
 
   // Any missing fields in the request are added with don't care values below.
   // The P4MatchKey instance in ProcessMatchField ultimately determines whether
   // don't-care/default usage is permissible for each field.
-  for (const auto& p4info_match_field : table_p4_info.match_fields()) {
-    if (requested_field_ids.find(p4info_match_field.id()) ==
-        requested_field_ids.end()) {
-      ::p4::v1::FieldMatch dont_care_match;
-      dont_care_match.set_field_id(p4info_match_field.id());
-      all_match_fields->push_back(dont_care_match);
+  for (size_t i = 0; i < table_plan.match_fields.size(); ++i) {
+    if (!requested_fields[i]) {
+      const P4MatchFieldPlan& field_plan = table_plan.match_fields[i];
+      all_match_fields->emplace_back(&field_plan.dont_care_match,
+                                     field_plan.field_convert);
     }
   }
 
@@ -690,21 +746,22 @@ std::string P4TableMapper::GetMapperNameKey(
 }
 
 ::util::Status P4TableMapper::ProcessTableID(
-    const ::p4::config::v1::Table& table_p4_info, int table_id,
-    CommonFlowEntry* flow_entry) const {
+    const P4TableMappingPlan& table_plan, CommonFlowEntry* flow_entry) const {
+  const ::p4::config::v1::Table& table_p4_info = *table_plan.table_p4_info;
+  int table_id = table_p4_info.preamble().id();
   flow_entry->mutable_table_info()->set_id(table_id);
   flow_entry->mutable_table_info()->set_name(table_p4_info.preamble().name());
   *flow_entry->mutable_table_info()->mutable_annotations() =
       table_p4_info.preamble().annotations();
 
-  auto desc_iter = global_id_table_map_.find(table_id);
-  if (desc_iter == global_id_table_map_.end()) {
+  if (table_plan.table_map_value == nullptr) {
     flow_entry->mutable_table_info()->set_type(P4_TABLE_UNKNOWN);
     return MAKE_ERROR(ERR_OPER_NOT_SUPPORTED)
            << "P4 table ID " << table_id << " is missing a table descriptor.";
   }
 
-  const auto& table_descriptor = desc_iter->second->table_descriptor();
+  const auto& table_descriptor =
+      table_plan.table_map_value->table_descriptor();
   RETURN_IF_ERROR(IsTableUpdateAllowed(table_p4_info, table_descriptor));
   // Information from the table descriptor includes the mapped type, mapped
   // pipeline stage, and any internal match fields.
@@ -722,15 +779,14 @@ std::string P4TableMapper::GetMapperNameKey(
 ::util::Status P4TableMapper::ProcessMatchField(
     const ::p4::config::v1::Table& table_p4_info,
     const ::p4::v1::FieldMatch& match_field,
+    const P4FieldConvertValue* field_convert,
     CommonFlowEntry* flow_entry) const {
   ::util::Status status = ::util::OkStatus();
 
-  // This lookup in field_convert_by_table_ accomplishes two things:
+  // The field_convert from the table's mapping plan accomplishes two things:
   //  1) It confirms that the field is allowed in the table.
   //  2) It indicates how to map the field into the flow_entry output.
-  P4FieldConvertKey key = MakeP4FieldConvertKey(table_p4_info, match_field);
-  auto convert_iter = field_convert_by_table_.find(key);
-  if (convert_iter == field_convert_by_table_.end()) {
+  if (field_convert == nullptr) {
     ::util::Status field_error = MAKE_ERROR(ERR_OPER_NOT_SUPPORTED)
                                  << "P4 TableEntry match field ID "
                                  << PrintP4ObjectID(match_field.field_id())
@@ -740,9 +796,8 @@ std::string P4TableMapper::GetMapperNameKey(
     return status;  // No way to decode fields that don't go with the table.
   }
 
-  const auto& conversion_value = convert_iter->second;
-  const auto& conversion_entry = conversion_value.conversion_entry;
-  const auto& conversion_field = conversion_value.mapped_field;
+  const auto& conversion_entry = field_convert->conversion_entry;
+  const auto& conversion_field = field_convert->mapped_field;
 
   std::unique_ptr<P4MatchKey> match_key =
       P4MatchKey::CreateInstance(match_field);
@@ -939,6 +994,7 @@ std::string P4TableMapper::GetMapperNameKey(
 
 void P4TableMapper::ClearMaps() {
   global_id_table_map_.clear();
+  table_mapping_plans_.clear();
   field_convert_by_table_.clear();
   packetin_metadata_type_to_id_bitwidth_pair_.clear();
   packetin_metadata_id_to_type_bitwidth_pair_.clear();
@@ -959,8 +1015,8 @@ P4TableMapper::P4ActionParamMapper::P4ActionParamMapper(
 ::util::Status P4TableMapper::P4ActionParamMapper::AddAction(int table_id,
                                                              int action_id) {
   // The action_id should have P4Info and a p4_global_table_map_ entry.
-  ::p4::config::v1::Action action_info;
-  ASSIGN_OR_RETURN(action_info, p4_info_manager_.FindActionByID(action_id));
+  ASSIGN_OR_RETURN(const ::p4::config::v1::Action* action_info,
+                   p4_info_manager_.FindActionPtrByID(action_id));
   auto iter = p4_global_table_map_.find(action_id);
   if (iter == p4_global_table_map_.end()) {
     return MAKE_ERROR(ERR_OPER_NOT_SUPPORTED)
@@ -974,7 +1030,7 @@ P4TableMapper::P4ActionParamMapper::P4ActionParamMapper(
   // parameter when it is referenced by a table or action profile update.
   // The data comes from the action parameter's P4Info and the field descriptor
   // for any header fields affected by modify_field primitives.
-  for (const auto& param_info : action_info.params()) {
+  for (const auto& param_info : action_info->params()) {
     auto desc_status =
         FindParameterDescriptor(param_info.name(), action_descriptor);
     if (!desc_status.ok()) continue;  // TODO(unknown): Append an error.
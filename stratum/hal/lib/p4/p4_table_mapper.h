@@ -28,7 +28,9 @@
 #include <utility>
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "stratum/glue/status/status.h"
+#include "stratum/glue/status/statusor.h"
 #include "stratum/hal/lib/common/common.pb.h"
 #include "stratum/hal/lib/p4/common_flow_entry.pb.h"
 #include "stratum/hal/lib/p4/p4_info_manager.h"
@@ -174,6 +176,12 @@ class P4TableMapper {
   virtual ::util::Status LookupTable(int table_id,
                                      ::p4::config::v1::Table* table) const;
 
+  // Similar to LookupTable, but returns a pointer to the P4 config Table
+  // instead of a copy.  The pointer is valid until the next successful
+  // PushForwardingPipelineConfig.
+  virtual ::util::StatusOr<const ::p4::config::v1::Table*> FindTable(
+      int table_id) const;
+
   // These methods control updates to P4 tables with static entries, i.e.
   // tables that contain "const entries" in the P4 program.  By default,
   // table mapping is disabled for P4 Runtime write requests that refer to
@@ -288,6 +296,47 @@ class P4TableMapper {
   typedef std::map<P4FieldConvertKey, P4FieldConvertValue>
       P4FieldConvertByTable;
 
+  // These types support the per-table mapping plans that
+  // PushForwardingPipelineConfig compiles from the P4Info and the table map,
+  // so that MapFlowEntry needs neither a copy of the table's P4Info nor a
+  // field_convert_by_table_ lookup per match field:
+  // P4MatchFieldPlan - Describes one P4Info match field of a table.  The
+  //     dont_care_match contains only the field ID, for use when a TableEntry
+  //     omits the field.  The field_convert points to the field's entry in
+  //     field_convert_by_table_, or it is nullptr if the field has no known
+  //     conversion.
+  // P4TableMappingPlan - Describes one P4Info table.  The table_p4_info points
+  //     into the P4Info of p4_info_manager_, and the table_map_value points to
+  //     the table's descriptor, if any.  The match_fields are in P4Info order,
+  //     and match_field_index gives the position of each field ID in
+  //     match_fields.
+  // P4TableMappingPlans - This is the map of plans by P4 table ID.
+  struct P4MatchFieldPlan {
+    P4MatchFieldPlan() : dont_care_match(), field_convert(nullptr) {}
+
+    ::p4::v1::FieldMatch dont_care_match;
+    const P4FieldConvertValue* field_convert;
+  };
+  struct P4TableMappingPlan {
+    P4TableMappingPlan()
+        : table_p4_info(nullptr),
+          table_map_value(nullptr),
+          match_fields(),
+          match_field_index() {}
+
+    const ::p4::config::v1::Table* table_p4_info;
+    const P4TableMapValue* table_map_value;
+    std::vector<P4MatchFieldPlan> match_fields;
+    absl::flat_hash_map<uint32, int> match_field_index;
+  };
+  typedef absl::flat_hash_map<int, P4TableMappingPlan> P4TableMappingPlans;
+
+  // Each mapped match field of a TableEntry is paired with its conversion,
+  // which may be nullptr for fields that are not recognized in the table.
+  typedef std::vector<std::pair<const ::p4::v1::FieldMatch*,
+                                const P4FieldConvertValue*>>
+      P4MatchFieldConversions;
+
   // P4FieldConvertKey generators.
   inline static P4FieldConvertKey MakeP4FieldConvertKey(int table_id,
                                                         uint32 match_field_id) {
@@ -371,7 +420,8 @@ class P4TableMapper {
     // is a combination of the action ID and the action parameter ID.  The
     // action ID is globally unique, but the parameter ID is unique only
     // within the scope of its action.
-    typedef std::map<std::pair<int, int>, P4ActionParamEntry> P4ActionParamMap;
+    typedef absl::flat_hash_map<std::pair<int, int>, P4ActionParamEntry>
+        P4ActionParamMap;
 
     // The P4ActionConstantMap supports actions that use constants to assign
     // fields or pass to other actions.  The action ID is the key, and the
@@ -421,7 +471,7 @@ class P4TableMapper {
     // pairs, i.e. the action ID is defined in P4Info as one of the table's
     // possible actions.  The first pair member is the table ID, and the second
     // member is the action ID.
-    std::set<std::pair<int, int>> valid_table_actions_;
+    absl::flat_hash_set<std::pair<int, int>> valid_table_actions_;
   };
 
   // Creates the global_id_table_map_ entry for the object represented by the
@@ -434,32 +484,39 @@ class P4TableMapper {
   // return string is empty.
   std::string GetMapperNameKey(const ::p4::config::v1::Preamble& preamble);
 
+  // Compiles table_mapping_plans_ from the P4Info in p4_info_manager_, the
+  // global_id_table_map_, and the field_convert_by_table_.  It must run after
+  // these have been set up by PushForwardingPipelineConfig.
+  void BuildTableMappingPlans();
+
   // Validates all of the match fields in the table_entry from a P4Runtime
-  // WriteRequest message.  The input table_p4_info provides information
+  // WriteRequest message.  The input table_plan provides information
   // about the expected match fields for the applicable table.  If the
   // P4Runtime request omits some match fields as "don't care" values,
   // PrepareMatchFields appends them to the all_match_fields output vector.
   // Upon successful return, all_match_fields combines the match fields
   // in the original WriteRequest with any additional don't care fields,
-  // yielding the full set of match fields as specified by table_p4_info.
+  // yielding the full set of match fields as specified by the table's P4Info.
+  // The output points into table_entry and table_plan, which must outlive it.
   ::util::Status PrepareMatchFields(
-      const ::p4::config::v1::Table& table_p4_info,
+      const P4TableMappingPlan& table_plan,
       const ::p4::v1::TableEntry& table_entry,
-      std::vector<::p4::v1::FieldMatch>* all_match_fields) const;
+      P4MatchFieldConversions* all_match_fields) const;
 
   // Processes the identified table and updates table-level flow_entry output.
   // Output always includes table_info with id, name, and type.  If the table's
   // P4Info contains annotations, they are also included in the output.  The
   // output may include internal match fields if they have been defined
   // in the P4PipelineConfig table map.
-  ::util::Status ProcessTableID(const ::p4::config::v1::Table& table_p4_info,
-                                int table_id,
+  ::util::Status ProcessTableID(const P4TableMappingPlan& table_plan,
                                 CommonFlowEntry* flow_entry) const;
 
-  // Processes one match_field from a table entry.  If successful, a new
-  // MappedField will be added to flow_entry.
+  // Processes one match_field from a table entry, using the given
+  // field_convert, which is nullptr if the field is not recognized in the
+  // table.  If successful, a new MappedField will be added to flow_entry.
   ::util::Status ProcessMatchField(const ::p4::config::v1::Table& table_p4_info,
                                    const ::p4::v1::FieldMatch& match_field,
+                                   const P4FieldConvertValue* field_convert,
                                    CommonFlowEntry* flow_entry) const;
 
   // Processes the action from a table entry.  If successful, the
@@ -507,6 +564,10 @@ class P4TableMapper {
   // This map facilitates table-dependent match field conversions.
   P4FieldConvertByTable field_convert_by_table_;
 
+  // Holds the mapping plan of each table in the P4Info.  The plans refer to
+  // data in p4_info_manager_, p4_pipeline_config_, and field_convert_by_table_.
+  P4TableMappingPlans table_mapping_plans_;
+
   // Map from packet in (out) metadata ID to the corresponding (type, bitwidth)
   // pair used for parsing the packet in (out) metadata. The ID and bitwidth of
   // metadata are available from P4Info and the type (P4FieldType) is found from
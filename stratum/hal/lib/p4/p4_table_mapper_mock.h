@@ -29,6 +29,13 @@ namespace hal {
 
 class P4TableMapperMock : public P4TableMapper {
  public:
+  P4TableMapperMock() {
+    // Same as the default of LookupTable(): an empty table.
+    ON_CALL(*this, FindTable(::testing::_))
+        .WillByDefault(
+            ::testing::Return(&::p4::config::v1::Table::default_instance()));
+  }
+
   MOCK_METHOD2(PushChassisConfig,
                ::util::Status(const ChassisConfig& config, uint64 node_id));
   MOCK_METHOD2(VerifyChassisConfig,
@@ -72,6 +79,9 @@ class P4TableMapperMock : public P4TableMapper {
   MOCK_CONST_METHOD2(LookupTable,
                      ::util::Status(int table_id,
                                     ::p4::config::v1::Table* table));
+  MOCK_CONST_METHOD1(
+      FindTable,
+      ::util::StatusOr<const ::p4::config::v1::Table*>(int table_id));
   MOCK_METHOD0(EnableStaticTableUpdates, void());
   MOCK_METHOD0(DisableStaticTableUpdates, void());
   MOCK_METHOD2(HandlePrePushStaticEntryChanges,
@@ -30,6 +30,8 @@
 #include "gtest/gtest.h"
 #include "stratum/glue/integral_types.h"
 #include "absl/memory/memory.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 
 using ::testing::_;
 using ::testing::HasSubstr;
@@ -1091,6 +1093,24 @@ TEST_F(P4TableMapperTest, TestTableMapDuplicateFieldID) {
   EXPECT_THAT(map_status.error_message(), HasSubstr(table_.preamble().name()));
 }
 
+// Tests mapping of duplicate field IDs which are unknown to the table.
+TEST_F(P4TableMapperTest, TestTableMapDuplicateUnknownFieldID) {
+  ASSERT_OK(p4_table_mapper_->PushForwardingPipelineConfig(
+      forwarding_pipeline_config_));
+  SetUpMultiMatchFieldTest("test-multi-match-table");
+  ASSERT_EQ(3, table_.match_fields_size());
+  const uint32 kUnknownFieldID = 0xfffff;
+  table_entry_.mutable_match(1)->set_field_id(kUnknownFieldID);
+  table_entry_.mutable_match(2)->set_field_id(kUnknownFieldID);
+
+  CommonFlowEntry flow_entry;
+  auto map_status = p4_table_mapper_->MapFlowEntry(
+      table_entry_, ::p4::v1::Update::INSERT, &flow_entry);
+  EXPECT_FALSE(map_status.ok());
+  EXPECT_EQ(ERR_INVALID_PARAM, map_status.error_code());
+  EXPECT_THAT(map_status.error_message(), HasSubstr("multiple match field"));
+}
+
 // Tests mapping of multiple field IDs with a don't-care LPM field.
 TEST_F(P4TableMapperTest, TestTableMapMultipleFieldsDontCareLPM) {
   ASSERT_OK(p4_table_mapper_->PushForwardingPipelineConfig(
@@ -1530,6 +1550,19 @@ TEST_F(P4TableMapperTest, TestLookupTableFailure) {
   EXPECT_THAT(lookup_status.error_message(), HasSubstr("0x999"));
 }
 
+// Tests lookup for a table pointer by ID.
+TEST_F(P4TableMapperTest, TestFindTable) {
+  // The lookup fails before any pipeline config push.
+  EXPECT_FALSE(p4_table_mapper_->FindTable(1).ok());
+  ASSERT_OK(p4_table_mapper_->PushForwardingPipelineConfig(
+      forwarding_pipeline_config_));
+  ASSERT_NO_FATAL_FAILURE(SetUpTableID("exact-match-32-table"));
+  auto lookup = p4_table_mapper_->FindTable(table_.preamble().id());
+  ASSERT_OK(lookup.status());
+  EXPECT_THAT(*lookup.ValueOrDie(), EqualsProto(table_));
+  EXPECT_FALSE(p4_table_mapper_->FindTable(0x999).ok());
+}
+
 // Tests mapping of hidden static table update for expected failure.
 TEST_F(P4TableMapperTest, TestHiddenStaticTableUpdateFails) {
   ASSERT_OK(p4_table_mapper_->PushForwardingPipelineConfig(
@@ -1765,5 +1798,30 @@ TEST_F(P4TableMapperTest,
               HasSubstr("Null mapped_action!"));
 }
 
+// Measures the rate of MapFlowEntry for a TableEntry with multiple match
+// fields, one of them omitted as a don't care.  This is a benchmark rather
+// than a test, it only logs the result.
+TEST_F(P4TableMapperTest, MapFlowEntryRate) {
+  ASSERT_OK(p4_table_mapper_->PushForwardingPipelineConfig(
+      forwarding_pipeline_config_));
+  SetUpMultiMatchFieldTest("test-multi-match-table");
+  table_entry_.mutable_match()->RemoveLast();  // ternary don't care
+  CommonFlowEntry flow_entry;
+  ASSERT_OK(p4_table_mapper_->MapFlowEntry(
+      table_entry_, ::p4::v1::Update::INSERT, &flow_entry));
+
+  const int kIterations = 100000;
+  absl::Time start = absl::Now();
+  for (int i = 0; i < kIterations; ++i) {
+    p4_table_mapper_->MapFlowEntry(table_entry_, ::p4::v1::Update::INSERT,
+                                   &flow_entry)
+        .IgnoreError();
+  }
+  double seconds = absl::ToDoubleSeconds(absl::Now() - start);
+  LOG(INFO) << "Mapped " << kIterations << " entries in " << seconds
+            << " seconds (" << kIterations / seconds << " entries/sec).";
+  EXPECT_EQ(3, flow_entry.fields_size());
+}
+
 }  // namespace hal
 }  // namespace stratum
@@ -24,6 +24,7 @@
 #include "google/protobuf/util/message_differencer.h"
 #include "stratum/glue/status/status_macros.h"
 #include "stratum/hal/lib/phal/dummy_threadpool.h"
+#include "stratum/hal/lib/phal/work_stealing_threadpool.h"
 // #include "stratum/hal/lib/phal/google_platform/google_switch_configurator.h"
 #include "stratum/lib/macros.h"
 #include "stratum/lib/utils.h"
@@ -33,6 +34,9 @@
 
 DEFINE_string(phal_config_path, "",
               "The path to read the PhalInitConfig proto file from.");
+DEFINE_int32(phal_threadpool_num_workers, 8,
+             "The number of threads that update PHAL datasources in parallel "
+             "during a query. 0 updates them serially in the querying thread.");
 
 namespace stratum {
 namespace hal {
@@ -223,9 +227,15 @@ AttributeDatabase::MakePhalDB(
   // Now load the config into the attribute database
   RETURN_IF_ERROR(configurator->ConfigurePhalDB(phal_config, root_group.get()));
 
-  ASSIGN_OR_RETURN(
-      std::unique_ptr<AttributeDatabase> database,
-      Make(std::move(root_group), absl::make_unique<DummyThreadpool>()));
+  std::unique_ptr<ThreadpoolInterface> threadpool;
+  if (FLAGS_phal_threadpool_num_workers > 0) {
+    threadpool = absl::make_unique<WorkStealingThreadpool>(
+        FLAGS_phal_threadpool_num_workers);
+  } else {
+    threadpool = absl::make_unique<DummyThreadpool>();
+  }
+  ASSIGN_OR_RETURN(std::unique_ptr<AttributeDatabase> database,
+                   Make(std::move(root_group), std::move(threadpool)));
 
   database->switch_configurator_ = std::move(configurator);
   return std::move(database);
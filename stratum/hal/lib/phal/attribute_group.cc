@@ -418,17 +418,22 @@ void AttributeGroupQueryNode::RemoveAllFields() {
   // We can now execute our query in a threadpool.
   ::util::Status output_status;
   absl::Mutex output_status_lock;
+  // The setters all write into query_result_, so only the datasource updates
+  // run in parallel and the setters are applied one task at a time.
+  absl::Mutex setter_lock;
   {
     // We acquire our query lock to avoid messy interleaving with other calls to
     // Get().
     absl::MutexLock l(&query_lock_);
     threadpool_->Start();
-    std::vector<TaskId> task_ids(datasources.size());
+    std::vector<TaskId> task_ids;
+    task_ids.reserve(datasources.size());
     for (auto& datasource_and_attributes : datasources) {
       task_ids.push_back(threadpool_->Schedule([&]() {
         ::util::Status update_status =
             datasource_and_attributes.first->UpdateValuesAndLock();
         if (update_status.ok()) {
+          absl::MutexLock setter_l(&setter_lock);
           for (auto& attribute_and_setter : datasource_and_attributes.second) {
             update_status = (*attribute_and_setter.second)(
                 attribute_and_setter.first->GetValue());
@@ -0,0 +1,169 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "stratum/hal/lib/phal/work_stealing_threadpool.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "stratum/glue/logging.h"
+#include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
+
+namespace stratum {
+namespace hal {
+namespace phal {
+
+WorkStealingThreadpool::WorkStealingThreadpool(int num_workers)
+    : num_queued_(0),
+      id_counter_(0),
+      next_worker_(0),
+      started_(false),
+      stopping_(false) {
+  num_workers = std::max(num_workers, 1);
+  for (int i = 0; i < num_workers; ++i) {
+    auto worker = absl::make_unique<Worker>();
+    worker->pool = this;
+    worker->index = i;
+    worker->running = false;
+    workers_.push_back(std::move(worker));
+  }
+}
+
+WorkStealingThreadpool::~WorkStealingThreadpool() {
+  std::vector<pthread_t> threads;
+  {
+    absl::MutexLock l(&lock_);
+    stopping_ = true;
+    work_available_.SignalAll();
+    for (const auto& worker : workers_) {
+      if (worker->running) threads.push_back(worker->tid);
+    }
+  }
+  // The workers drain the queues before they exit.
+  for (pthread_t tid : threads) pthread_join(tid, nullptr);
+  // Run whatever is left if the pool was never started.
+  while (RunOneTask(-1)) {
+  }
+}
+
+void WorkStealingThreadpool::Start() {
+  absl::MutexLock l(&lock_);
+  if (started_ || stopping_) return;
+  started_ = true;
+  for (const auto& worker : workers_) {
+    int ret = pthread_create(&worker->tid, nullptr, WorkerThreadFunc,
+                             worker.get());
+    if (ret != 0) {
+      // The tasks of this worker are stolen by the others.
+      LOG(ERROR) << "Failed to create threadpool worker " << worker->index
+                 << ". Err: " << ret << ".";
+      continue;
+    }
+    worker->running = true;
+  }
+}
+
+TaskId WorkStealingThreadpool::Schedule(std::function<void()> closure) {
+  absl::MutexLock l(&lock_);
+  // Skip IDs of tasks that are still pending in case id_counter_ wrapped.
+  TaskId id = id_counter_++;
+  while (pending_.count(id)) id = id_counter_++;
+  pending_.insert(id);
+  Worker* worker = workers_[next_worker_].get();
+  next_worker_ = (next_worker_ + 1) % workers_.size();
+  {
+    absl::MutexLock worker_lock(&worker->lock);
+    worker->tasks.push_back(Task{id, std::move(closure)});
+  }
+  ++num_queued_;
+  work_available_.Signal();
+  return id;
+}
+
+void WorkStealingThreadpool::WaitAll(const std::vector<TaskId>& tasks) {
+  while (true) {
+    {
+      absl::MutexLock l(&lock_);
+      if (!AnyPending(tasks)) return;
+      if (num_queued_ <= 0) {
+        // Everything we wait for is running on the workers.
+        task_done_.Wait(&lock_);
+        continue;
+      }
+    }
+    // Help with the queued tasks rather than wait for the workers.
+    RunOneTask(-1);
+  }
+}
+
+void* WorkStealingThreadpool::WorkerThreadFunc(void* arg) {
+  auto* worker = static_cast<Worker*>(arg);
+  WorkStealingThreadpool* pool = worker->pool;
+  while (true) {
+    if (pool->RunOneTask(worker->index)) continue;
+    absl::MutexLock l(&pool->lock_);
+    while (!pool->stopping_ && pool->num_queued_ <= 0) {
+      pool->work_available_.Wait(&pool->lock_);
+    }
+    if (pool->stopping_ && pool->num_queued_ <= 0) break;
+  }
+  return nullptr;
+}
+
+bool WorkStealingThreadpool::RunOneTask(int index) {
+  Task task;
+  bool found = false;
+  const int num_workers = workers_.size();
+  const int first = std::max(index, 0);
+  for (int i = 0; i < num_workers && !found; ++i) {
+    Worker* worker = workers_[(first + i) % num_workers].get();
+    absl::MutexLock l(&worker->lock);
+    if (worker->tasks.empty()) continue;
+    if (worker->index == index) {
+      // Own queue: the newest task, whose data is most likely still cached.
+      task = std::move(worker->tasks.back());
+      worker->tasks.pop_back();
+    } else {
+      // Someone else's queue: the oldest task, which its owner gets to last.
+      task = std::move(worker->tasks.front());
+      worker->tasks.pop_front();
+    }
+    found = true;
+  }
+  if (!found) return false;
+  {
+    absl::MutexLock l(&lock_);
+    --num_queued_;
+  }
+  task.closure();
+  {
+    absl::MutexLock l(&lock_);
+    pending_.erase(task.id);
+    task_done_.SignalAll();
+  }
+  return true;
+}
+
+bool WorkStealingThreadpool::AnyPending(
+    const std::vector<TaskId>& tasks) const {
+  for (TaskId task : tasks) {
+    if (pending_.count(task)) return true;
+  }
+  return false;
+}
+
+}  // namespace phal
+}  // namespace hal
+}  // namespace stratum
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef STRATUM_HAL_LIB_PHAL_WORK_STEALING_THREADPOOL_H_
+#define STRATUM_HAL_LIB_PHAL_WORK_STEALING_THREADPOOL_H_
+
+#include <pthread.h>
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "stratum/hal/lib/phal/threadpool_interface.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/synchronization/mutex.h"
+
+namespace stratum {
+namespace hal {
+namespace phal {
+
+// A threadpool that executes tasks on a fixed number of worker threads. Each
+// worker has its own task queue. Scheduled tasks are distributed round-robin
+// between the queues, a worker runs the newest task of its own queue first
+// and steals the oldest task of another queue when its own queue is empty.
+// A thread blocked in WaitAll() also runs queued tasks instead of idling, so
+// tasks scheduled before Start() still complete.
+class WorkStealingThreadpool : public ThreadpoolInterface {
+ public:
+  explicit WorkStealingThreadpool(int num_workers);
+  // Runs all queued tasks and then stops the worker threads.
+  ~WorkStealingThreadpool() override;
+
+  // Starts the worker threads. Calling Start() again has no effect.
+  void Start() override LOCKS_EXCLUDED(lock_);
+  TaskId Schedule(std::function<void()> closure) override LOCKS_EXCLUDED(lock_);
+  void WaitAll(const std::vector<TaskId>& tasks) override LOCKS_EXCLUDED(lock_);
+
+  // WorkStealingThreadpool is neither copyable nor movable.
+  WorkStealingThreadpool(const WorkStealingThreadpool&) = delete;
+  WorkStealingThreadpool& operator=(const WorkStealingThreadpool&) = delete;
+
+ private:
+  struct Task {
+    TaskId id;
+    std::function<void()> closure;
+  };
+
+  // The task queue and the thread of one worker.
+  struct Worker {
+    WorkStealingThreadpool* pool;
+    int index;
+    pthread_t tid;
+    // Whether the thread was started and needs to be joined.
+    bool running;
+    absl::Mutex lock;
+    std::deque<Task> tasks GUARDED_BY(lock);
+  };
+
+  // Thread function of a worker. Invoked with the Worker as the argument in
+  // pthread_create.
+  static void* WorkerThreadFunc(void* arg) LOCKS_EXCLUDED(lock_);
+
+  // Takes one task, from the queue of worker 'index' if possible, otherwise
+  // from the queue of another worker, and runs it. 'index' of -1 only steals.
+  // Returns false if all queues are empty.
+  bool RunOneTask(int index) LOCKS_EXCLUDED(lock_);
+
+  // Returns true if any of the 'tasks' has not completed yet.
+  bool AnyPending(const std::vector<TaskId>& tasks) const
+      SHARED_LOCKS_REQUIRED(lock_);
+
+  // Protects the pool state below. The task queues have their own locks.
+  mutable absl::Mutex lock_;
+
+  // Signalled when a task is scheduled or the pool is stopped.
+  absl::CondVar work_available_;
+
+  // Signalled when a task completes.
+  absl::CondVar task_done_;
+
+  // The IDs of the tasks that were scheduled but have not completed yet.
+  absl::flat_hash_set<TaskId> pending_ GUARDED_BY(lock_);
+
+  // The number of tasks waiting in the queues.
+  int num_queued_ GUARDED_BY(lock_);
+
+  TaskId id_counter_ GUARDED_BY(lock_);
+
+  // The worker whose queue the next task goes to.
+  int next_worker_ GUARDED_BY(lock_);
+
+  bool started_ GUARDED_BY(lock_);
+  bool stopping_ GUARDED_BY(lock_);
+
+  // The workers. Fixed at construction.
+  std::vector<std::unique_ptr<Worker>> workers_;
+};
+
+}  // namespace phal
+}  // namespace hal
+}  // namespace stratum
+
+#endif  // STRATUM_HAL_LIB_PHAL_WORK_STEALING_THREADPOOL_H_
@@ -0,0 +1,102 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "stratum/hal/lib/phal/work_stealing_threadpool.h"
+
+#include <atomic>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+
+namespace stratum {
+namespace hal {
+namespace phal {
+namespace {
+
+TEST(WorkStealingThreadpoolTest, WaitAllWaitsForAllTasks) {
+  WorkStealingThreadpool threadpool(4);
+  threadpool.Start();
+  std::atomic<int> count(0);
+  std::vector<TaskId> tasks;
+  for (int i = 0; i < 100; ++i) {
+    tasks.push_back(threadpool.Schedule([&count]() { count++; }));
+  }
+  threadpool.WaitAll(tasks);
+  EXPECT_EQ(100, count);
+}
+
+TEST(WorkStealingThreadpoolTest, TasksRunInParallel) {
+  constexpr int kNumTasks = 4;
+  WorkStealingThreadpool threadpool(kNumTasks);
+  threadpool.Start();
+  // Every task waits for all the others to start, which can only succeed if
+  // they all run at the same time.
+  absl::Mutex lock;
+  int started = 0;
+  int all_started = 0;
+  std::vector<TaskId> tasks;
+  for (int i = 0; i < kNumTasks; ++i) {
+    tasks.push_back(threadpool.Schedule([&]() {
+      absl::MutexLock l(&lock);
+      ++started;
+      auto all = [&started]() { return started == kNumTasks; };
+      if (lock.AwaitWithTimeout(absl::Condition(&all), absl::Seconds(10))) {
+        ++all_started;
+      }
+    }));
+  }
+  threadpool.WaitAll(tasks);
+  EXPECT_EQ(kNumTasks, all_started);
+}
+
+TEST(WorkStealingThreadpoolTest, WaitAllRunsTasksWithoutStart) {
+  WorkStealingThreadpool threadpool(2);
+  int count = 0;
+  std::vector<TaskId> tasks;
+  for (int i = 0; i < 10; ++i) {
+    tasks.push_back(threadpool.Schedule([&count]() { count++; }));
+  }
+  threadpool.WaitAll(tasks);
+  EXPECT_EQ(10, count);
+}
+
+TEST(WorkStealingThreadpoolTest, WaitAllIgnoresUnknownTasks) {
+  WorkStealingThreadpool threadpool(2);
+  threadpool.Start();
+  threadpool.WaitAll({12345});
+  TaskId task = threadpool.Schedule([]() {});
+  threadpool.WaitAll({task});
+  // Already completed.
+  threadpool.WaitAll({task});
+}
+
+TEST(WorkStealingThreadpoolTest, DestructorRunsQueuedTasks) {
+  std::atomic<int> count(0);
+  {
+    WorkStealingThreadpool threadpool(2);
+    threadpool.Start();
+    for (int i = 0; i < 10; ++i) {
+      threadpool.Schedule([&count]() { count++; });
+    }
+  }
+  EXPECT_EQ(10, count);
+}
+
+}  // namespace
+}  // namespace phal
+}  // namespace hal
+}  // namespace stratum
@@ -19,7 +19,9 @@
 #ifndef STRATUM_LIB_CHANNEL_CHANNEL_H_
 #define STRATUM_LIB_CHANNEL_CHANNEL_H_
 
+#include <algorithm>
 #include <deque>
+#include <iterator>
 #include <list>
 #include <memory>
 #include <unordered_map>
@@ -262,6 +264,13 @@ class Channel : public channel_internal::ChannelBase {
   virtual ::util::Status TryWrite(const T& t) LOCKS_EXCLUDED(queue_lock_);
   virtual ::util::Status TryWrite(T&& t) LOCKS_EXCLUDED(queue_lock_);
 
+  // Moves as many elements of ts as fit in the queue into the Channel, in
+  // order, and erases them from ts. Returns ERR_NO_RESOURCE immediately if
+  // some elements did not fit, which are left in ts. Returns ERR_CANCELLED if
+  // the Channel is closed.
+  virtual ::util::Status WriteAll(std::vector<T>* t_s)
+      LOCKS_EXCLUDED(queue_lock_);
+
   // Reads and pops the first element of the queue into t. Returns ERR_SUCCESS
   // on successful dequeue. Blocks if the queue is empty until the timeout, then
   // returns ERR_ENTRY_NOT_FOUND. Returns ERR_CANCELED if Channel is closed and
@@ -394,6 +403,9 @@ class ChannelWriter {
   virtual ::util::Status TryWrite(T&& t) {
     return channel_->TryWrite(std::move(t));
   }
+  virtual ::util::Status WriteAll(std::vector<T>* t_s) {
+    return channel_->WriteAll(t_s);
+  }
   virtual bool IsClosed() { return channel_->IsClosed(); }
 
   // Disallow copy and assign.
@@ -517,6 +529,29 @@ template <typename T>
   return ::util::OkStatus();
 }
 
+template <typename T>
+::util::Status Channel<T>::WriteAll(std::vector<T>* t_s) {
+  absl::MutexLock l(&queue_lock_);
+  // Check for Channel closure.
+  if (closed_) return MAKE_ERROR(ERR_CANCELLED) << "Channel is closed.";
+  // Enqueue as many messages as there is space for.
+  size_t num_written = 0;
+  if (queue_.size() < max_depth_) {
+    num_written = std::min(t_s->size(), max_depth_ - queue_.size());
+  }
+  std::move(t_s->begin(), t_s->begin() + num_written,
+            std::back_inserter(queue_));
+  t_s->erase(t_s->begin(), t_s->begin() + num_written);
+  if (num_written > 0) {
+    // Signal next blocked ChannelReader.
+    cond_not_empty_.Signal();
+    // Signal any Select()-ing threads..
+    ClearSelectList(true);
+  }
+  if (!t_s->empty()) return MAKE_ERROR(ERR_NO_RESOURCE) << "Channel is full.";
+  return ::util::OkStatus();
+}
+
 template <typename T>
 ::util::Status Channel<T>::CheckWriteState() {
   // Check for Channel closure.
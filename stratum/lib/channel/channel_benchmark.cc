@@ -0,0 +1,144 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Compares the throughput and the latency of Channel and RingChannel. Each
+// writer thread writes timestamped messages as fast as it can, a single reader
+// thread reads them and records how long each message stayed in the Channel.
+//
+// Example:
+//   channel_benchmark --channel_benchmark_num_writers=4 \
+//       --channel_benchmark_batch_size=16
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "stratum/glue/init_google.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/logging.h"
+#include "stratum/lib/channel/channel.h"
+#include "stratum/lib/channel/ring_channel.h"
+#include "absl/strings/str_format.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+DEFINE_int32(channel_benchmark_num_msgs, 1000000,
+             "Num of messages written by each writer thread.");
+DEFINE_int32(channel_benchmark_num_writers, 1, "Num of writer threads.");
+DEFINE_int32(channel_benchmark_max_depth, 1024, "Max depth of the Channels.");
+DEFINE_int32(channel_benchmark_batch_size, 1,
+             "Num of messages written with each WriteAll() call. 1 means the "
+             "messages are written one by one with Write().");
+
+namespace stratum {
+namespace {
+
+// Writes and reads the messages through the given Channel and prints the
+// results.
+void RunBenchmark(const std::string& name,
+                  std::shared_ptr<Channel<int64>> channel) {
+  const int num_writers = FLAGS_channel_benchmark_num_writers;
+  const int num_msgs = FLAGS_channel_benchmark_num_msgs;
+  const size_t batch_size = std::max(FLAGS_channel_benchmark_batch_size, 1);
+  auto reader = ChannelReader<int64>::Create(channel);
+  const size_t total_num_msgs = static_cast<size_t>(num_writers) * num_msgs;
+  std::vector<int64> latencies_ns;
+  latencies_ns.reserve(total_num_msgs);
+
+  absl::Time start = absl::Now();
+  std::vector<std::thread> writers;
+  for (int i = 0; i < num_writers; ++i) {
+    writers.emplace_back([channel, num_msgs, batch_size]() {
+      auto writer = ChannelWriter<int64>::Create(channel);
+      std::vector<int64> batch;
+      for (int j = 0; j < num_msgs;) {
+        if (batch_size == 1) {
+          CHECK(writer->Write(absl::GetCurrentTimeNanos(),
+                              absl::InfiniteDuration())
+                    .ok());
+          ++j;
+          continue;
+        }
+        while (batch.size() < batch_size && j < num_msgs) {
+          batch.push_back(absl::GetCurrentTimeNanos());
+          ++j;
+        }
+        // WriteAll() does not block. Retry until the whole batch is written.
+        while (!batch.empty()) {
+          ::util::Status status = writer->WriteAll(&batch);
+          CHECK(status.ok() || status.error_code() == ERR_NO_RESOURCE);
+          if (!batch.empty()) std::this_thread::yield();
+        }
+      }
+    });
+  }
+  std::vector<int64> msgs;
+  while (latencies_ns.size() < total_num_msgs) {
+    int64 msg = 0;
+    CHECK(reader->Read(&msg, absl::InfiniteDuration()).ok());
+    msgs.clear();
+    CHECK(reader->ReadAll(&msgs).ok());
+    int64 now = absl::GetCurrentTimeNanos();
+    latencies_ns.push_back(now - msg);
+    for (int64 m : msgs) latencies_ns.push_back(now - m);
+  }
+  absl::Duration elapsed = absl::Now() - start;
+  for (auto& writer : writers) writer.join();
+
+  std::sort(latencies_ns.begin(), latencies_ns.end());
+  auto percentile = [&latencies_ns](double p) {
+    size_t i = static_cast<size_t>(p * (latencies_ns.size() - 1));
+    return latencies_ns[i] / 1000.0;
+  };
+  std::cout << absl::StrFormat(
+                   "%-22s %10.0f msgs/s   latency (us) p50 %8.1f  p99 %8.1f  "
+                   "p99.9 %8.1f  max %8.1f",
+                   name, latencies_ns.size() / absl::ToDoubleSeconds(elapsed),
+                   percentile(0.5), percentile(0.99), percentile(0.999),
+                   percentile(1.0))
+            << std::endl;
+}
+
+}  // namespace
+
+int Main(int argc, char** argv) {
+  InitGoogle(argv[0], &argc, &argv, true);
+  const size_t max_depth = FLAGS_channel_benchmark_max_depth;
+
+  std::cout << FLAGS_channel_benchmark_num_writers << " writer(s), "
+            << FLAGS_channel_benchmark_num_msgs << " msgs per writer, "
+            << "max depth " << max_depth << ", batch size "
+            << FLAGS_channel_benchmark_batch_size << "." << std::endl;
+  RunBenchmark("Channel", Channel<int64>::Create(max_depth));
+  // The single producer ring is only correct with a single writer.
+  if (FLAGS_channel_benchmark_num_writers == 1) {
+    RunBenchmark("RingChannel (SPSC)",
+                 RingChannel<int64>::Create(
+                     max_depth, RingChannel<int64>::kSingleProducer));
+  }
+  RunBenchmark("RingChannel (MPSC)",
+               RingChannel<int64>::Create(max_depth,
+                                          RingChannel<int64>::kMultiProducer));
+
+  return 0;
+}
+
+}  // namespace stratum
+
+int main(int argc, char** argv) { return stratum::Main(argc, argv); }
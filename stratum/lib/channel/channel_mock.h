@@ -40,6 +40,7 @@ class ChannelMock : public Channel<T> {
   MOCK_METHOD2_T(Write, ::util::Status(T&& t, absl::Duration timeout));
   MOCK_METHOD1_T(TryWrite, ::util::Status(const T& t));
   MOCK_METHOD1_T(TryWrite, ::util::Status(T&& t));
+  MOCK_METHOD1_T(WriteAll, ::util::Status(std::vector<T>* t_s));
   MOCK_METHOD2_T(
       SelectRegister,
       void(const std::shared_ptr<channel_internal::SelectData>& select_data,
@@ -62,6 +63,7 @@ class ChannelWriterMock : public ChannelWriter<T> {
   MOCK_METHOD2_T(Write, ::util::Status(T&& t, absl::Duration timeout));
   MOCK_METHOD1_T(TryWrite, ::util::Status(const T& t));
   MOCK_METHOD1_T(TryWrite, ::util::Status(T&& t));
+  MOCK_METHOD1_T(WriteAll, ::util::Status(std::vector<T>* t_s));
   MOCK_METHOD0_T(IsClosed, bool());
 };
 
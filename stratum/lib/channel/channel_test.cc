@@ -110,6 +110,27 @@ TEST(ChannelTest, TestReadWriteClose) {
   EXPECT_EQ(ERR_CANCELLED, reader->Read(&msg, timeout).error_code());
 }
 
+// Test WriteAll() writes as many messages as fit and leaves the others.
+TEST(ChannelTest, TestWriteAll) {
+  std::shared_ptr<Channel<int>> channel = Channel<int>::Create(3);
+  auto reader = ChannelReader<int>::Create(channel);
+  auto writer = ChannelWriter<int>::Create(channel);
+
+  std::vector<int> msgs = {1, 2};
+  EXPECT_OK(writer->WriteAll(&msgs));
+  EXPECT_TRUE(msgs.empty());
+  msgs = {3, 4, 5};
+  EXPECT_EQ(ERR_NO_RESOURCE, writer->WriteAll(&msgs).error_code());
+  EXPECT_EQ(std::vector<int>({4, 5}), msgs);
+  EXPECT_OK(reader->ReadAll(&msgs));
+  EXPECT_EQ(std::vector<int>({1, 2, 3}), msgs);
+
+  EXPECT_TRUE(channel->Close());
+  msgs = {6};
+  EXPECT_EQ(ERR_CANCELLED, writer->WriteAll(&msgs).error_code());
+  EXPECT_EQ(1, msgs.size());
+}
+
 namespace {
 
 void* TestCloseReadFunc(void* arg) {
@@ -0,0 +1,535 @@
+/*
+ * Copyright 2018-present Open Networking Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef STRATUM_LIB_CHANNEL_RING_CHANNEL_H_
+#define STRATUM_LIB_CHANNEL_RING_CHANNEL_H_
+
+#include <sched.h>
+
+#include <algorithm>
+#include <atomic>
+#include <list>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "stratum/lib/channel/channel.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+namespace stratum {
+
+// A Channel<T> backed by a bounded lock-free ring instead of a mutex-guarded
+// deque. It is used exactly like a Channel<T>, through the same
+// ChannelReader<T>, ChannelWriter<T> and Select(), and is meant for the hot
+// paths (e.g. packet I/O) where the Channel lock shows up in profiles.
+//
+// Messages are written to and read from the ring without taking any lock. A
+// ChannelReader blocked on an empty ring (or a ChannelWriter blocked on a full
+// one) first spins for a while, then parks on a condition variable. The
+// number of spins adapts to how often spinning was enough for the ring to
+// become ready. The lock is only taken by the writers and readers when the
+// other side is parked or when a Select() is pending.
+//
+// The ring comes in two variants:
+//
+//   kSingleProducer: At most one thread writes to the Channel at a time. The
+//   write path is a plain store.
+//
+//   kMultiProducer: Any number of threads write to the Channel concurrently.
+//   The write path claims a slot with a compare-and-swap.
+//
+// In both variants, at most one thread reads from the Channel at a time, as
+// already recommended for any Channel. Unlike Channel<T>, T must also be
+// default-constructible, as the ring preallocates all of its slots.
+//
+// Example:
+//
+//   std::shared_ptr<Channel<T>> channel = RingChannel<T>::Create(
+//       1024, RingChannel<T>::kMultiProducer);
+//   auto reader = ChannelReader<T>::Create(channel);
+//   auto writer = ChannelWriter<T>::Create(channel);
+template <typename T>
+class RingChannel : public Channel<T> {
+  static_assert(std::is_default_constructible<T>::value,
+                "RingChannel<T> requires T to be DefaultConstructible.");
+
+ public:
+  enum Producers {
+    kSingleProducer,
+    kMultiProducer,
+  };
+
+  ~RingChannel() override {}
+
+  // Creates a RingChannel with the given maximum queue depth.
+  static std::unique_ptr<Channel<T>> Create(size_t max_depth,
+                                            Producers producers) {
+    return absl::WrapUnique(new RingChannel<T>(max_depth, producers));
+  }
+
+  bool Close() LOCKS_EXCLUDED(park_lock_) override;
+  bool IsClosed() override {
+    return closed_.load(std::memory_order_acquire);
+  }
+
+  // Disallow copy and assign.
+  RingChannel(const RingChannel&) = delete;
+  RingChannel& operator=(const RingChannel&) = delete;
+
+ protected:
+  RingChannel(size_t max_depth, Producers producers);
+
+  // See Channel<T> for the semantics of the following.
+  ::util::Status Write(const T& t, absl::Duration timeout) override;
+  ::util::Status Write(T&& t, absl::Duration timeout) override;
+  ::util::Status TryWrite(const T& t) override;
+  ::util::Status TryWrite(T&& t) override;
+  ::util::Status WriteAll(std::vector<T>* t_s) override;
+  ::util::Status Read(T* t, absl::Duration timeout) override;
+  ::util::Status TryRead(T* t) override;
+  ::util::Status ReadAll(std::vector<T>* t_s) override;
+  void SelectRegister(
+      const std::shared_ptr<channel_internal::SelectData>& select_data,
+      bool* ready) LOCKS_EXCLUDED(park_lock_) override;
+
+ private:
+  // A slot of the ring. 'seq' tells who owns the slot at ring position 'pos'
+  // mapped to it: the writers if seq == 2 * pos, the reader if
+  // seq == 2 * pos + 1. The factor 2 keeps the two states apart even when the
+  // ring has a single slot.
+  struct Slot {
+    std::atomic<size_t> seq;
+    T value;
+  };
+
+  // The size of a cache line, used to keep the ring positions apart.
+  static constexpr size_t kCacheLineSize = 64;
+
+  // The spin counts used by the adaptive waiting.
+  static constexpr int kMinSpins = 16;
+  static constexpr int kMaxSpins = 4096;
+  static constexpr int kInitialSpins = 256;
+
+  // Claims a slot for writing. Returns nullptr if the ring is full.
+  Slot* ClaimWriteSlot();
+
+  // Publishes the value written to a slot claimed by ClaimWriteSlot() and
+  // wakes up the reader if needed.
+  void PublishWriteSlot(Slot* slot);
+
+  // Returns the slot at the head of the ring or nullptr if the ring is empty.
+  Slot* HeadSlot();
+
+  // Releases the slot at the head of the ring to the writers after its value
+  // was moved out.
+  void ReleaseHeadSlot(Slot* slot);
+
+  // Moves t into the ring, if it is not full. Only moves from t on success.
+  template <typename U>
+  ::util::Status Push(U&& t);
+
+  // Same as Push(), blocking with timeout if the ring is full.
+  template <typename U>
+  ::util::Status PushWithTimeout(U&& t, absl::Duration timeout);
+
+  // Spins, then parks, until ready() returns true, the Channel is closed or
+  // the deadline expires. Returns false in the latter case only.
+  template <typename Pred>
+  bool Wait(Pred ready, absl::CondVar* cond, std::atomic<int>* num_waiters,
+            std::atomic<int>* spins, absl::Time deadline)
+      LOCKS_EXCLUDED(park_lock_);
+
+  // Wakes up a parked thread on the other side after a write or a read.
+  void WakeUpReaders() LOCKS_EXCLUDED(park_lock_);
+  void WakeUpWriters(bool all) LOCKS_EXCLUDED(park_lock_);
+
+  // Pops each element on the select list, setting the corresponding done and
+  // ready flags to the given value and signaling their condition variables.
+  void ClearSelectList(bool ready) EXCLUSIVE_LOCKS_REQUIRED(park_lock_);
+
+  const size_t capacity_;
+  const Producers producers_;
+  std::unique_ptr<Slot[]> slots_;
+
+  // Ring positions of the next slot to write and to read. Kept on separate
+  // cache lines, as they are updated by different threads. Explicit padding
+  // is used instead of alignas(), as RingChannel is allocated with plain new,
+  // which does not honor over-aligned types before C++17.
+  char pad0_[kCacheLineSize];
+  std::atomic<size_t> tail_;
+  char pad1_[kCacheLineSize - sizeof(std::atomic<size_t>)];
+  std::atomic<size_t> head_;
+  char pad2_[kCacheLineSize - sizeof(std::atomic<size_t>)];
+
+  std::atomic<bool> closed_;
+
+  // Num of threads parked in Read() and Write(), and of pending Select()s.
+  // Checked by the other side after each operation to avoid taking the lock
+  // when nobody is waiting.
+  std::atomic<int> num_parked_readers_;
+  std::atomic<int> num_parked_writers_;
+  std::atomic<int> num_selects_;
+
+  // Current spin counts of the readers and the writers.
+  std::atomic<int> reader_spins_;
+  std::atomic<int> writer_spins_;
+
+  // Protects the parking of the readers and writers, and the select list.
+  mutable absl::Mutex park_lock_;
+  absl::CondVar cond_not_empty_;
+  absl::CondVar cond_not_full_;
+  std::list<std::pair<std::shared_ptr<channel_internal::SelectData>, bool>>
+      select_list_ GUARDED_BY(park_lock_);
+};
+
+template <typename T>
+constexpr size_t RingChannel<T>::kCacheLineSize;
+template <typename T>
+constexpr int RingChannel<T>::kMinSpins;
+template <typename T>
+constexpr int RingChannel<T>::kMaxSpins;
+template <typename T>
+constexpr int RingChannel<T>::kInitialSpins;
+
+template <typename T>
+RingChannel<T>::RingChannel(size_t max_depth, Producers producers)
+    : Channel<T>(max_depth),
+      capacity_(max_depth),
+      producers_(producers),
+      slots_(new Slot[std::max(max_depth, size_t{1})]),
+      tail_(0),
+      head_(0),
+      closed_(false),
+      num_parked_readers_(0),
+      num_parked_writers_(0),
+      num_selects_(0),
+      reader_spins_(kInitialSpins),
+      writer_spins_(kInitialSpins) {
+  for (size_t i = 0; i < capacity_; ++i) {
+    slots_[i].seq.store(2 * i, std::memory_order_relaxed);
+  }
+}
+
+template <typename T>
+bool RingChannel<T>::Close() {
+  absl::MutexLock l(&park_lock_);
+  if (closed_.exchange(true, std::memory_order_acq_rel)) return false;
+  // Signal all parked ChannelWriters and ChannelReaders.
+  cond_not_full_.SignalAll();
+  cond_not_empty_.SignalAll();
+  // Signal any Select()-ing threads.
+  ClearSelectList(false);
+  return true;
+}
+
+template <typename T>
+typename RingChannel<T>::Slot* RingChannel<T>::ClaimWriteSlot() {
+  if (capacity_ == 0) return nullptr;
+  size_t pos = tail_.load(std::memory_order_relaxed);
+  while (true) {
+    Slot* slot = &slots_[pos % capacity_];
+    size_t seq = slot->seq.load(std::memory_order_acquire);
+    if (seq == 2 * pos) {
+      if (producers_ == kSingleProducer) {
+        tail_.store(pos + 1, std::memory_order_relaxed);
+        return slot;
+      }
+      if (tail_.compare_exchange_weak(pos, pos + 1,
+                                      std::memory_order_relaxed)) {
+        return slot;
+      }
+      // Another writer claimed the slot. pos was reloaded by the CAS.
+    } else if (seq < 2 * pos) {
+      // The slot still holds the message written a lap ago.
+      return nullptr;
+    } else {
+      pos = tail_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+template <typename T>
+void RingChannel<T>::PublishWriteSlot(Slot* slot) {
+  slot->seq.fetch_add(1, std::memory_order_release);
+  WakeUpReaders();
+}
+
+template <typename T>
+typename RingChannel<T>::Slot* RingChannel<T>::HeadSlot() {
+  if (capacity_ == 0) return nullptr;
+  size_t pos = head_.load(std::memory_order_relaxed);
+  Slot* slot = &slots_[pos % capacity_];
+  if (slot->seq.load(std::memory_order_acquire) != 2 * pos + 1) {
+    return nullptr;
+  }
+  return slot;
+}
+
+template <typename T>
+void RingChannel<T>::ReleaseHeadSlot(Slot* slot) {
+  size_t pos = head_.load(std::memory_order_relaxed);
+  head_.store(pos + 1, std::memory_order_relaxed);
+  slot->seq.store(2 * (pos + capacity_), std::memory_order_release);
+}
+
+template <typename T>
+template <typename U>
+::util::Status RingChannel<T>::Push(U&& t) {
+  if (IsClosed()) return MAKE_ERROR(ERR_CANCELLED) << "Channel is closed.";
+  Slot* slot = ClaimWriteSlot();
+  if (slot == nullptr) return MAKE_ERROR(ERR_NO_RESOURCE) << "Channel is full.";
+  slot->value = std::forward<U>(t);
+  PublishWriteSlot(slot);
+  return ::util::OkStatus();
+}
+
+template <typename T>
+template <typename U>
+::util::Status RingChannel<T>::PushWithTimeout(U&& t, absl::Duration timeout) {
+  absl::Time deadline = absl::Now() + timeout;
+  while (true) {
+    if (IsClosed()) return MAKE_ERROR(ERR_CANCELLED) << "Channel is closed.";
+    Slot* slot = ClaimWriteSlot();
+    if (slot != nullptr) {
+      slot->value = std::forward<U>(t);
+      PublishWriteSlot(slot);
+      return ::util::OkStatus();
+    }
+    // With several writers, the slot freed by the reader may be taken by
+    // another writer before this one gets to it, hence the loop.
+    size_t pos = tail_.load(std::memory_order_relaxed);
+    Slot* next = capacity_ > 0 ? &slots_[pos % capacity_] : nullptr;
+    bool not_full = Wait(
+        [next, pos]() {
+          return next != nullptr &&
+                 next->seq.load(std::memory_order_acquire) >= 2 * pos;
+        },
+        &cond_not_full_, &num_parked_writers_, &writer_spins_, deadline);
+    if (IsClosed()) return MAKE_ERROR(ERR_CANCELLED) << "Channel is closed.";
+    if (!not_full) {
+      return MAKE_ERROR(ERR_NO_RESOURCE)
+             << "Write did not succeed within timeout due to full Channel.";
+    }
+  }
+}
+
+template <typename T>
+template <typename Pred>
+bool RingChannel<T>::Wait(Pred ready, absl::CondVar* cond,
+                          std::atomic<int>* num_waiters,
+                          std::atomic<int>* spins, absl::Time deadline) {
+  // Spin first, as the other side is usually quick to catch up on a busy
+  // Channel and parking costs two context switches.
+  int max_spins = spins->load(std::memory_order_relaxed);
+  for (int i = 0; i < max_spins; ++i) {
+    if (ready()) {
+      spins->store(std::min(max_spins * 2, kMaxSpins),
+                   std::memory_order_relaxed);
+      return true;
+    }
+    if (IsClosed()) return true;
+    if (i % 64 == 63) {
+      if (absl::Now() >= deadline) return false;
+      sched_yield();
+    }
+  }
+  spins->store(std::max(max_spins / 2, kMinSpins), std::memory_order_relaxed);
+
+  // Then park. The other side checks num_waiters after each operation, so
+  // either it sees this thread parked or this thread sees the ring ready.
+  absl::MutexLock l(&park_lock_);
+  num_waiters->fetch_add(1, std::memory_order_seq_cst);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  bool result = true;
+  while (!ready() && !IsClosed()) {
+    bool expired = cond->WaitWithDeadline(&park_lock_, deadline);
+    // Could have been signalled even if timeout has expired.
+    if (expired && !ready() && !IsClosed()) {
+      result = false;
+      break;
+    }
+  }
+  num_waiters->fetch_sub(1, std::memory_order_relaxed);
+  return result;
+}
+
+template <typename T>
+void RingChannel<T>::WakeUpReaders() {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (num_parked_readers_.load(std::memory_order_relaxed) == 0 &&
+      num_selects_.load(std::memory_order_relaxed) == 0) {
+    return;
+  }
+  absl::MutexLock l(&park_lock_);
+  cond_not_empty_.Signal();
+  ClearSelectList(true);
+}
+
+template <typename T>
+void RingChannel<T>::WakeUpWriters(bool all) {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (num_parked_writers_.load(std::memory_order_relaxed) == 0) return;
+  absl::MutexLock l(&park_lock_);
+  if (all) {
+    cond_not_full_.SignalAll();
+  } else {
+    cond_not_full_.Signal();
+  }
+}
+
+template <typename T>
+::util::Status RingChannel<T>::Write(const T& t, absl::Duration timeout) {
+  return PushWithTimeout(t, timeout);
+}
+
+template <typename T>
+::util::Status RingChannel<T>::Write(T&& t, absl::Duration timeout) {
+  return PushWithTimeout(std::move(t), timeout);
+}
+
+template <typename T>
+::util::Status RingChannel<T>::TryWrite(const T& t) {
+  return Push(t);
+}
+
+template <typename T>
+::util::Status RingChannel<T>::TryWrite(T&& t) {
+  return Push(std::move(t));
+}
+
+template <typename T>
+::util::Status RingChannel<T>::WriteAll(std::vector<T>* t_s) {
+  if (IsClosed()) return MAKE_ERROR(ERR_CANCELLED) << "Channel is closed.";
+  size_t num_written = 0;
+  Slot* slot = nullptr;
+  while (num_written < t_s->size() && (slot = ClaimWriteSlot()) != nullptr) {
+    slot->value = std::move((*t_s)[num_written++]);
+    // Published one by one, as the slots of several writers may interleave.
+    slot->seq.fetch_add(1, std::memory_order_release);
+  }
+  // A single wake up for the whole batch.
+  if (num_written > 0) WakeUpReaders();
+  t_s->erase(t_s->begin(), t_s->begin() + num_written);
+  if (!t_s->empty()) return MAKE_ERROR(ERR_NO_RESOURCE) << "Channel is full.";
+  return ::util::OkStatus();
+}
+
+template <typename T>
+::util::Status RingChannel<T>::Read(T* t, absl::Duration timeout) {
+  if (IsClosed()) {
+    return MAKE_ERROR(ERR_CANCELLED).without_logging() << "Channel is closed.";
+  }
+  Slot* slot = HeadSlot();
+  if (slot == nullptr) {
+    absl::Time deadline = absl::Now() + timeout;
+    bool not_empty =
+        Wait([this]() { return HeadSlot() != nullptr; }, &cond_not_empty_,
+             &num_parked_readers_, &reader_spins_, deadline);
+    // Could have been woken up because Channel is now closed.
+    if (IsClosed()) {
+      return MAKE_ERROR(ERR_CANCELLED).without_logging()
+             << "Channel is closed.";
+    }
+    if (!not_empty) {
+      return MAKE_ERROR(ERR_ENTRY_NOT_FOUND)
+             << "Read did not succeed within timeout due to empty Channel.";
+    }
+    slot = HeadSlot();
+  }
+  *t = std::move(slot->value);
+  ReleaseHeadSlot(slot);
+  WakeUpWriters(false);
+  return ::util::OkStatus();
+}
+
+template <typename T>
+::util::Status RingChannel<T>::TryRead(T* t) {
+  if (IsClosed()) return MAKE_ERROR(ERR_CANCELLED) << "Channel is closed.";
+  Slot* slot = HeadSlot();
+  if (slot == nullptr) {
+    return MAKE_ERROR(ERR_ENTRY_NOT_FOUND) << "Channel is empty.";
+  }
+  *t = std::move(slot->value);
+  ReleaseHeadSlot(slot);
+  WakeUpWriters(false);
+  return ::util::OkStatus();
+}
+
+template <typename T>
+::util::Status RingChannel<T>::ReadAll(std::vector<T>* t_s) {
+  if (IsClosed()) return MAKE_ERROR(ERR_CANCELLED) << "Channel is closed.";
+  t_s->clear();
+  Slot* slot = nullptr;
+  while ((slot = HeadSlot()) != nullptr) {
+    t_s->push_back(std::move(slot->value));
+    ReleaseHeadSlot(slot);
+  }
+  // A single wake up for the whole batch.
+  if (!t_s->empty()) WakeUpWriters(true);
+  return ::util::OkStatus();
+}
+
+template <typename T>
+void RingChannel<T>::SelectRegister(
+    const std::shared_ptr<channel_internal::SelectData>& select_data,
+    bool* ready) {
+  absl::MutexLock l(&park_lock_);
+  // Check for Channel closure.
+  if (IsClosed()) return;
+  {
+    absl::MutexLock sel_lock(&select_data->lock);
+    if (HeadSlot() != nullptr) {
+      *ready = true;
+      select_data->done = true;
+      return;
+    }
+    // Only enqueue a copy of select_data if the operation is not done.
+    if (select_data->done) return;
+    select_list_.push_back(std::make_pair(select_data, ready));
+    num_selects_.store(select_list_.size(), std::memory_order_seq_cst);
+  }
+  // A writer may have missed the registration above. Check again, now that
+  // all the writers to come will see it.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (HeadSlot() != nullptr) ClearSelectList(true);
+}
+
+template <typename T>
+void RingChannel<T>::ClearSelectList(bool ready) {
+  while (!select_list_.empty()) {
+    auto& pair = select_list_.front();
+    {
+      // Set select done flag and Channel ready flag and signal Select()-ing
+      // thread.
+      pair.second = ready;
+      absl::MutexLock sel_lock(&pair.first->lock);
+      pair.first->done = ready;
+      pair.first->cond.Signal();
+    }
+    select_list_.pop_front();
+  }
+  num_selects_.store(0, std::memory_order_relaxed);
+}
+
+}  // namespace stratum
+
+#endif  // STRATUM_LIB_CHANNEL_RING_CHANNEL_H_
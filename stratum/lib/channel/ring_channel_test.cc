@@ -0,0 +1,243 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "stratum/lib/channel/ring_channel.h"
+
+#include <set>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "stratum/glue/status/status_test_util.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+namespace stratum {
+namespace {
+
+using channel_internal::ChannelBase;
+
+class RingChannelTest
+    : public ::testing::TestWithParam<RingChannel<int>::Producers> {
+ protected:
+  std::shared_ptr<Channel<int>> CreateChannel(size_t max_depth) {
+    return RingChannel<int>::Create(max_depth, GetParam());
+  }
+};
+
+TEST_P(RingChannelTest, ReadWriteClose) {
+  std::shared_ptr<Channel<int>> channel = CreateChannel(2);
+  auto reader = ChannelReader<int>::Create(channel);
+  auto writer = ChannelWriter<int>::Create(channel);
+  ASSERT_NE(nullptr, reader);
+  ASSERT_NE(nullptr, writer);
+  absl::Duration timeout = absl::InfiniteDuration();
+
+  EXPECT_OK(writer->TryWrite(1));
+  EXPECT_OK(writer->Write(2, timeout));  // Should not block.
+  EXPECT_EQ(ERR_NO_RESOURCE, writer->TryWrite(3).error_code());
+  EXPECT_EQ(ERR_NO_RESOURCE,
+            writer->Write(3, absl::Milliseconds(10)).error_code());
+
+  int msg = 0;
+  EXPECT_OK(reader->TryRead(&msg));
+  EXPECT_EQ(1, msg);
+  EXPECT_OK(reader->Read(&msg, timeout));  // Should not block.
+  EXPECT_EQ(2, msg);
+  EXPECT_EQ(ERR_ENTRY_NOT_FOUND, reader->TryRead(&msg).error_code());
+  EXPECT_EQ(ERR_ENTRY_NOT_FOUND,
+            reader->Read(&msg, absl::Milliseconds(10)).error_code());
+
+  // The ring wraps around.
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_OK(writer->TryWrite(i));
+    EXPECT_OK(reader->TryRead(&msg));
+    EXPECT_EQ(i, msg);
+  }
+
+  EXPECT_OK(writer->TryWrite(1));
+  EXPECT_TRUE(channel->Close());
+  EXPECT_FALSE(channel->Close());
+  EXPECT_TRUE(writer->IsClosed());
+  EXPECT_TRUE(reader->IsClosed());
+  std::vector<int> msgs;
+  EXPECT_EQ(ERR_CANCELLED, writer->TryWrite(2).error_code());
+  EXPECT_EQ(ERR_CANCELLED, writer->Write(3, timeout).error_code());
+  EXPECT_EQ(ERR_CANCELLED, writer->WriteAll(&msgs).error_code());
+  EXPECT_EQ(ERR_CANCELLED, reader->TryRead(&msg).error_code());
+  EXPECT_EQ(ERR_CANCELLED, reader->ReadAll(&msgs).error_code());
+  EXPECT_EQ(ERR_CANCELLED, reader->Read(&msg, timeout).error_code());
+  EXPECT_EQ(nullptr, ChannelReader<int>::Create(channel));
+}
+
+TEST_P(RingChannelTest, WriteAllReadAll) {
+  std::shared_ptr<Channel<std::string>> channel =
+      RingChannel<std::string>::Create(
+          3, static_cast<RingChannel<std::string>::Producers>(GetParam()));
+  auto reader = ChannelReader<std::string>::Create(channel);
+  auto writer = ChannelWriter<std::string>::Create(channel);
+
+  std::vector<std::string> msgs = {"1", "2"};
+  EXPECT_OK(writer->WriteAll(&msgs));
+  EXPECT_TRUE(msgs.empty());
+  msgs = {"3", "4", "5"};
+  EXPECT_EQ(ERR_NO_RESOURCE, writer->WriteAll(&msgs).error_code());
+  EXPECT_THAT(msgs, ::testing::ElementsAre("4", "5"));
+  EXPECT_OK(reader->ReadAll(&msgs));
+  EXPECT_THAT(msgs, ::testing::ElementsAre("1", "2", "3"));
+  EXPECT_OK(reader->ReadAll(&msgs));
+  EXPECT_TRUE(msgs.empty());
+}
+
+TEST_P(RingChannelTest, ZeroDepthChannel) {
+  std::shared_ptr<Channel<int>> channel = CreateChannel(0);
+  auto reader = ChannelReader<int>::Create(channel);
+  auto writer = ChannelWriter<int>::Create(channel);
+  EXPECT_EQ(ERR_NO_RESOURCE, writer->TryWrite(1).error_code());
+  EXPECT_EQ(ERR_NO_RESOURCE,
+            writer->Write(1, absl::Milliseconds(10)).error_code());
+  int msg = 0;
+  EXPECT_EQ(ERR_ENTRY_NOT_FOUND, reader->TryRead(&msg).error_code());
+}
+
+TEST_P(RingChannelTest, CloseWakesUpBlockedReaderAndWriter) {
+  std::shared_ptr<Channel<int>> channel = CreateChannel(0);
+  auto reader = ChannelReader<int>::Create(channel);
+  auto writer = ChannelWriter<int>::Create(channel);
+  std::thread read_thread([&reader]() {
+    int msg = 0;
+    EXPECT_EQ(ERR_CANCELLED,
+              reader->Read(&msg, absl::InfiniteDuration()).error_code());
+  });
+  std::thread write_thread([&writer]() {
+    EXPECT_EQ(ERR_CANCELLED,
+              writer->Write(0, absl::InfiniteDuration()).error_code());
+  });
+  // Give the threads the time to park.
+  absl::SleepFor(absl::Milliseconds(50));
+  EXPECT_TRUE(channel->Close());
+  read_thread.join();
+  write_thread.join();
+}
+
+TEST_P(RingChannelTest, BlockingReadAndWrite) {
+  std::shared_ptr<Channel<int>> channel = CreateChannel(1);
+  auto reader = ChannelReader<int>::Create(channel);
+  auto writer = ChannelWriter<int>::Create(channel);
+  EXPECT_OK(writer->TryWrite(1));
+  std::thread write_thread([&writer]() {
+    // Blocks until the reader frees the slot.
+    EXPECT_OK(writer->Write(2, absl::InfiniteDuration()));
+  });
+  absl::SleepFor(absl::Milliseconds(50));
+  int msg = 0;
+  EXPECT_OK(reader->Read(&msg, absl::InfiniteDuration()));
+  EXPECT_EQ(1, msg);
+  EXPECT_OK(reader->Read(&msg, absl::InfiniteDuration()));
+  EXPECT_EQ(2, msg);
+  write_thread.join();
+}
+
+TEST_P(RingChannelTest, BasicSelect) {
+  std::shared_ptr<Channel<int>> channel = CreateChannel(2);
+  auto writer = ChannelWriter<int>::Create(channel);
+  auto reader = ChannelReader<int>::Create(channel);
+
+  auto status_or_ready = Select({channel.get()}, absl::Milliseconds(10));
+  EXPECT_EQ(ERR_ENTRY_NOT_FOUND, status_or_ready.status().error_code());
+
+  EXPECT_OK(writer->TryWrite(1));
+  status_or_ready = Select({channel.get()}, absl::InfiniteDuration());
+  ASSERT_TRUE(status_or_ready.ok());
+  EXPECT_TRUE(status_or_ready.ValueOrDie()(channel.get()));
+  int msg = 0;
+  EXPECT_OK(reader->TryRead(&msg));
+
+  // A write wakes up a pending Select().
+  std::thread write_thread([&writer]() {
+    absl::SleepFor(absl::Milliseconds(50));
+    EXPECT_OK(writer->TryWrite(2));
+  });
+  EXPECT_OK(Select({channel.get()}, absl::InfiniteDuration()).status());
+  write_thread.join();
+
+  EXPECT_TRUE(channel->Close());
+  status_or_ready = Select({channel.get()}, absl::InfiniteDuration());
+  EXPECT_EQ(ERR_CANCELLED, status_or_ready.status().error_code());
+}
+
+// Copies a range of ints from the writer threads to the reader thread through
+// a small ring, so that both sides keep blocking on each other. The single
+// producer ring gets a single writer thread.
+TEST_P(RingChannelTest, StressTest) {
+  constexpr int kNumMsgsPerWriter = 100000;
+  const int num_writers =
+      GetParam() == RingChannel<int>::kMultiProducer ? 4 : 1;
+  std::shared_ptr<Channel<int>> channel = CreateChannel(8);
+  auto reader = ChannelReader<int>::Create(channel);
+  std::vector<std::thread> write_threads;
+  for (int w = 0; w < num_writers; ++w) {
+    write_threads.emplace_back([&channel, w]() {
+      auto writer = ChannelWriter<int>::Create(channel);
+      std::vector<int> batch;
+      for (int i = 0; i < kNumMsgsPerWriter; ++i) {
+        int msg = w * kNumMsgsPerWriter + i;
+        // Mix the single and the batched writes.
+        if (i % 3 == 0) {
+          batch.push_back(msg);
+          if (writer->WriteAll(&batch).ok()) continue;
+          for (int m : batch) {
+            ASSERT_OK(writer->Write(m, absl::InfiniteDuration()));
+          }
+          batch.clear();
+        } else {
+          ASSERT_OK(writer->Write(msg, absl::InfiniteDuration()));
+        }
+      }
+    });
+  }
+  // The messages of each writer are received in the order they were sent.
+  std::vector<int> last(num_writers, -1);
+  std::set<int> received;
+  std::vector<int> msgs;
+  while (received.size() < static_cast<size_t>(num_writers) *
+                               kNumMsgsPerWriter) {
+    int msg = 0;
+    ASSERT_OK(reader->Read(&msg, absl::Seconds(10)));
+    msgs = {msg};
+    if (msg % 2 == 0) {
+      std::vector<int> more;
+      ASSERT_OK(reader->ReadAll(&more));
+      msgs.insert(msgs.end(), more.begin(), more.end());
+    }
+    for (int m : msgs) {
+      int w = m / kNumMsgsPerWriter;
+      ASSERT_LT(last[w], m);
+      last[w] = m;
+      ASSERT_TRUE(received.insert(m).second);
+    }
+  }
+  for (auto& t : write_threads) t.join();
+}
+
+INSTANTIATE_TEST_SUITE_P(RingChannelTestWithProducers, RingChannelTest,
+                         ::testing::Values(RingChannel<int>::kSingleProducer,
+                                           RingChannel<int>::kMultiProducer));
+
+}  // namespace
+}  // namespace stratum
@@ -47,10 +47,22 @@ ssize_t sendmsg(int sockfd, const struct msghdr* msg, int flags) {
   return stratum::LibcWrapper::GetLibcProxy()->sendmsg(sockfd, msg, flags);
 }
 
+int sendmmsg(int sockfd, struct mmsghdr* msgvec, unsigned int vlen,
+             int flags) {
+  return stratum::LibcWrapper::GetLibcProxy()->sendmmsg(sockfd, msgvec, vlen,
+                                                        flags);
+}
+
 ssize_t recvmsg(int sockfd, struct msghdr* msg, int flags) {
   return stratum::LibcWrapper::GetLibcProxy()->recvmsg(sockfd, msg, flags);
 }
 
+int recvmmsg(int sockfd, struct mmsghdr* msgvec, unsigned int vlen, int flags,
+             struct timespec* timeout) {
+  return stratum::LibcWrapper::GetLibcProxy()->recvmmsg(sockfd, msgvec, vlen,
+                                                        flags, timeout);
+}
+
 int epoll_create1(int flags) {
   return stratum::LibcWrapper::GetLibcProxy()->epoll_create1(flags);
 }
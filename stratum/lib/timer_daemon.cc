@@ -15,11 +15,25 @@
 
 
 #include "stratum/lib/timer_daemon.h"
+
+#include "gflags/gflags.h"
+#include "stratum/glue/logging.h"
+#include "absl/strings/str_cat.h"
 #include "absl/synchronization/mutex.h"
 
+DEFINE_int32(timer_daemon_num_workers, 4,
+             "Num of threads executing the actions of the timers. If 0, the "
+             "actions are executed on the timer thread.");
+
 namespace stratum {
 namespace hal {
 
+constexpr int TimerDaemon::kNumLevels;
+constexpr int TimerDaemon::kSlotBits;
+constexpr int TimerDaemon::kNumSlots;
+constexpr uint64 TimerDaemon::kSlotMask;
+constexpr absl::Duration TimerDaemon::kTick;
+
 namespace {
 // A function that is executed by the thread created by TimerDaemon::Start().
 // It provides a timer resolution of 1ms.
@@ -35,37 +49,173 @@ static void* Timer(void* arg) {
   }
   return nullptr;
 }
+
+// Returns the first tick at or after 'due_time', counting from 'start_time'.
+uint64 TickOf(absl::Time due_time, absl::Time start_time, absl::Duration tick) {
+  if (due_time <= start_time) return 0;
+  return absl::ToInt64Milliseconds(absl::Ceil(due_time - start_time, tick));
+}
 }  // namespace
 
+std::string TimerDaemon::TimerStats::ToString() const {
+  return absl::StrCat(
+      "executions: ", executions, ", failures: ", failures,
+      ", overruns: ", overruns,
+      ", max jitter: ", absl::FormatDuration(max_jitter), ", avg jitter: ",
+      absl::FormatDuration(executions
+                               ? total_jitter / static_cast<int64>(executions)
+                               : absl::ZeroDuration()));
+}
+
 bool TimerDaemon::IsStopped() {
   absl::WriterMutexLock l(&access_lock_);
   return !started_;
 }
 
-TimerDaemon::DescriptorPtr TimerDaemon::GetAction() {
-  // Once woken up check if the timer at the top of the heap is due.
+void TimerDaemon::Insert(const DescriptorPtr& desc) {
+  uint64 expiry = std::max(TickOf(desc->due_time_, start_time_, kTick),
+                           current_tick_);
+  // Level 0 holds the timers due before the wheel completes its current turn.
+  // A timer is put on the upper level L if it is due within the next
+  // kNumSlots slots of that level, so that its slot is cascaded down exactly
+  // when the wheel reaches the range of the slot.
+  int level = 0;
+  if ((expiry >> kSlotBits) != (current_tick_ >> kSlotBits)) {
+    for (level = 1; level < kNumLevels; ++level) {
+      if ((expiry >> (kSlotBits * level)) -
+              (current_tick_ >> (kSlotBits * level)) <=
+          kNumSlots) {
+        break;
+      }
+    }
+    if (level == kNumLevels) {
+      // Too far away. Park the timer in the last slot the top level can
+      // address. It gets re-inserted from there.
+      level = kNumLevels - 1;
+      expiry = ((current_tick_ >> (kSlotBits * level)) + kNumSlots)
+               << (kSlotBits * level);
+    }
+  }
+  wheel_[level][(expiry >> (kSlotBits * level)) & kSlotMask].push_back(desc);
+}
+
+void TimerDaemon::Cascade() {
+  for (int level = 1; level < kNumLevels; ++level) {
+    uint64 slot = (current_tick_ >> (kSlotBits * level)) & kSlotMask;
+    std::vector<DescriptorWeakPtr> timers;
+    timers.swap(wheel_[level][slot]);
+    for (const auto& timer : timers) {
+      auto desc = timer.lock();
+      // The timer has been cancelled.
+      if (desc == nullptr) continue;
+      Insert(desc);
+    }
+    // The upper level only turns when this one wraps around.
+    if (slot != 0) break;
+  }
+}
+
+void TimerDaemon::Rebase(absl::Time start_time) {
+  std::vector<DescriptorPtr> timers;
+  for (auto& level : wheel_) {
+    for (auto& slot : level) {
+      for (const auto& timer : slot) {
+        auto desc = timer.lock();
+        if (desc != nullptr) timers.push_back(desc);
+      }
+      slot.clear();
+    }
+  }
+  start_time_ = start_time;
+  current_tick_ = 0;
+  for (const auto& desc : timers) Insert(desc);
+}
+
+void TimerDaemon::GetDueActions(absl::Time now, std::vector<Task>* tasks) {
   absl::WriterMutexLock l(&access_lock_);
 
-  if (timers_.empty()) {
-    return nullptr;
+  if (now < start_time_) return;
+  uint64 now_tick =
+      absl::ToInt64Milliseconds(absl::Floor(now - start_time_, kTick));
+  while (current_tick_ <= now_tick) {
+    uint64 tick = current_tick_;
+    if ((tick & kSlotMask) == 0) Cascade();
+    std::vector<DescriptorWeakPtr> timers;
+    timers.swap(wheel_[0][tick & kSlotMask]);
+    // The timers re-inserted below must not land in the slot being processed.
+    ++current_tick_;
+    for (const auto& timer : timers) {
+      auto desc = timer.lock();
+      // The timer has been cancelled.
+      if (desc == nullptr) continue;
+      if (TickOf(desc->due_time_, start_time_, kTick) > tick) {
+        // A parked timer which is not due yet.
+        Insert(desc);
+        continue;
+      }
+      absl::Time due_time = desc->due_time_;
+      if (desc->Repeat()) {
+        // Periodic timer. Insert it in the wheel again.
+        desc->due_time_ += desc->Period();
+        Insert(desc);
+      }
+      if (desc->busy_.exchange(true)) {
+        // The previous execution has not completed yet.
+        absl::MutexLock stats_lock(&desc->stats_lock_);
+        ++desc->stats_.overruns;
+        continue;
+      }
+      tasks->push_back({desc, due_time});
+    }
+  }
+}
+
+void TimerDaemon::RunTask(const Task& task) {
+  absl::Duration jitter =
+      std::max(absl::Now() - task.due_time, absl::ZeroDuration());
+  ::util::Status status = task.desc->ExecuteAction();
+  if (!status.ok()) {
+    LOG(ERROR) << "Timer action failed: " << status;
+  } else {
+    VLOG(1) << "Timer has been triggered!";
   }
-  if (timers_.front().expired()) {
-    pop_heap(timers_.begin(), timers_.end(), TimerDescriptorComparator());
-    timers_.pop_back();
-    return nullptr;
+  {
+    absl::MutexLock l(&task.desc->stats_lock_);
+    TimerStats& stats = task.desc->stats_;
+    ++stats.executions;
+    if (!status.ok()) ++stats.failures;
+    stats.total_jitter += jitter;
+    stats.max_jitter = std::max(stats.max_jitter, jitter);
   }
-  TimerDaemon::DescriptorPtr front = DescriptorPtr(timers_.front());
-  absl::Time now = absl::Now();
-  if (front->due_time_ <= now) {
-    pop_heap(timers_.begin(), timers_.end(), TimerDescriptorComparator());
-    timers_.pop_back();
-    if (front->Repeat()) {
-      // Periodic timer. Insert it in the queue again.
-      front->due_time_ += front->Period();
-      timers_.push_back(front);
-      push_heap(timers_.begin(), timers_.end(), TimerDescriptorComparator());
+  task.desc->busy_ = false;
+}
+
+void TimerDaemon::Dispatch(std::vector<Task>* tasks) {
+  if (tasks->empty()) return;
+  if (worker_tids_.empty()) {
+    for (const auto& task : *tasks) RunTask(task);
+  } else {
+    absl::MutexLock l(&task_lock_);
+    tasks_.insert(tasks_.end(), tasks->begin(), tasks->end());
+    task_cond_.SignalAll();
+  }
+  tasks->clear();
+}
+
+void* TimerDaemon::Worker(void* arg) {
+  TimerDaemon* daemon = static_cast<TimerDaemon*>(arg);
+  while (true) {
+    Task task;
+    {
+      absl::MutexLock l(&daemon->task_lock_);
+      while (daemon->tasks_.empty() && !daemon->workers_stopping_) {
+        daemon->task_cond_.Wait(&daemon->task_lock_);
+      }
+      if (daemon->workers_stopping_) break;
+      task = std::move(daemon->tasks_.front());
+      daemon->tasks_.pop_front();
     }
-    return front;
+    RunTask(task);
   }
   return nullptr;
 }
@@ -75,50 +225,82 @@ bool TimerDaemon::Execute() {
 
   if (daemon->IsStopped()) return false;
 
-  auto front = daemon->GetAction();
-  if (front != nullptr) {
-    // Execute the timer's action!
-    if (front->ExecuteAction() != ::util::OkStatus()) {
-      LOG(ERROR) << "something went wrong";
-    } else {
-      LOG(INFO) << "Timer has been triggered!";
-    }
-  }
+  std::vector<Task> tasks;
+  daemon->GetDueActions(absl::Now(), &tasks);
+  daemon->Dispatch(&tasks);
   return true;
 }
 
 ::util::Status TimerDaemon::Start() {
-  absl::WriterMutexLock l(&GetInstance()->access_lock_);
-  if (GetInstance()->started_ == true) {
+  TimerDaemon* daemon = GetInstance();
+  absl::WriterMutexLock l(&daemon->access_lock_);
+  if (daemon->started_ == true) {
     return ::util::OkStatus();
   }
 
-  GetInstance()->started_ = true;
+  // The wheel starts turning from now on. The timers requested while the
+  // daemon was stopped are moved to the slots matching their due time.
+  daemon->Rebase(absl::Now());
+  for (int i = 0; i < FLAGS_timer_daemon_num_workers; ++i) {
+    pthread_t tid;
+    if (pthread_create(&tid, nullptr, &Worker, daemon) != 0) {
+      LOG(ERROR) << "Failed to create a timer worker thread.";
+      break;
+    }
+    daemon->worker_tids_.push_back(tid);
+  }
 
-  if (pthread_create(&GetInstance()->tid_, nullptr, &Timer, nullptr) != 0) {
+  daemon->started_ = true;
+
+  if (pthread_create(&daemon->tid_, nullptr, &Timer, nullptr) != 0) {
     return MAKE_ERROR(ERR_INTERNAL) << "Failed to create the timer thread.";
   } else {
-    LOG(INFO) << "The timer daemon has been started.";
+    LOG(INFO) << "The timer daemon has been started with "
+              << daemon->worker_tids_.size() << " worker(s).";
     return ::util::OkStatus();
   }
 }
 
 ::util::Status TimerDaemon::Stop() {
+  TimerDaemon* daemon = GetInstance();
   {
-    absl::WriterMutexLock l(&GetInstance()->access_lock_);
-    GetInstance()->started_ = false;
+    absl::WriterMutexLock l(&daemon->access_lock_);
+    if (!daemon->started_) return ::util::OkStatus();
+    daemon->started_ = false;
   }
 
-  if (pthread_join(GetInstance()->tid_, nullptr) != 0) {
+  if (pthread_join(daemon->tid_, nullptr) != 0) {
     return MAKE_ERROR(ERR_INTERNAL) << "Failed to join the timer thread.";
-  } else {
-    absl::WriterMutexLock l(&GetInstance()->access_lock_);
-    GetInstance()->timers_.clear();
-    GetInstance()->tid_ = 0;
+  }
+  daemon->tid_ = 0;
 
-    LOG(INFO) << "The timer daemon has been stopped.";
-    return ::util::OkStatus();
+  // The tasks still queued are dropped.
+  {
+    absl::MutexLock l(&daemon->task_lock_);
+    daemon->workers_stopping_ = true;
+    daemon->task_cond_.SignalAll();
+  }
+  for (pthread_t tid : daemon->worker_tids_) {
+    if (pthread_join(tid, nullptr) != 0) {
+      return MAKE_ERROR(ERR_INTERNAL)
+             << "Failed to join a timer worker thread.";
+    }
+  }
+  daemon->worker_tids_.clear();
+  {
+    absl::MutexLock l(&daemon->task_lock_);
+    for (const auto& task : daemon->tasks_) task.desc->busy_ = false;
+    daemon->tasks_.clear();
+    daemon->workers_stopping_ = false;
   }
+
+  absl::WriterMutexLock l(&daemon->access_lock_);
+  for (auto& level : daemon->wheel_) {
+    for (auto& slot : level) slot.clear();
+  }
+
+  LOG(INFO) << "The timer daemon has been stopped.";
+  return ::util::OkStatus();
 }
 
 ::util::Status TimerDaemon::RequestOneShotTimer(uint64 delay_ms,
@@ -136,19 +318,25 @@ bool TimerDaemon::Execute() {
   return GetInstance()->RequestTimer(true, delay_ms, period_ms, action, desc);
 }
 
+::util::StatusOr<TimerDaemon::TimerStats> TimerDaemon::GetTimerStats(
+    const DescriptorPtr& desc) {
+  CHECK_RETURN_IF_FALSE(desc != nullptr) << "Null timer descriptor.";
+  absl::MutexLock l(&desc->stats_lock_);
+  return desc->stats_;
+}
+
 ::util::Status TimerDaemon::RequestTimer(bool repeat, uint64 delay_ms,
                                           uint64 period_ms, Action action,
                                           DescriptorPtr* desc) {
   absl::WriterMutexLock l(&access_lock_);
 
-  LOG(INFO) << "Registered timer.";
+  VLOG(1) << "Registered timer.";
 
   absl::Time now = absl::Now();
   *desc = std::make_shared<Descriptor>(repeat, action);
   (*desc)->due_time_ = now + absl::Milliseconds(delay_ms);
   (*desc)->period_ = absl::Milliseconds(period_ms);
-  timers_.push_back(DescriptorWeakPtr(*desc));
-  push_heap(timers_.begin(), timers_.end(), TimerDescriptorComparator());
+  Insert(*desc);
 
   return ::util::OkStatus();
 }
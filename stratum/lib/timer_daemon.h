@@ -21,13 +21,17 @@
 
 #include <pthread.h>
 #include <algorithm>
+#include <atomic>
+#include <deque>
 #include <functional>
+#include <string>
 #include <vector>
 #include <memory>
 
 #include "stratum/glue/integral_types.h"
 #include "stratum/glue/status/status.h"
 #include "stratum/glue/status/status_macros.h"
+#include "stratum/glue/status/statusor.h"
 #include "stratum/lib/macros.h"
 #include "stratum/public/lib/error.h"
 #include "absl/synchronization/mutex.h"
@@ -37,16 +41,52 @@
 namespace stratum {
 namespace hal {
 
+// The timer service. The timers are kept in a hierarchical timing wheel with a
+// resolution of 1ms: kNumLevels wheels of kNumSlots slots each, where a slot
+// of a level covers a full turn of the level below. A timer is inserted into
+// the slot of the lowest level whose range covers its due time, and moves
+// down one level each time the wheels below complete a turn, until it fires
+// from the lowest level. Inserting and cancelling a timer are O(1).
+//
+// The actions of the timers due are executed on a pool of worker threads, so
+// that a slow action does not delay the others. A periodic timer whose action
+// is still queued or running when it is due again skips that execution, which
+// is counted as an overrun in its TimerStats.
 class TimerDaemon final {
+ public:
+  // The execution statistics of a timer.
+  struct TimerStats {
+    // Num of times the action was executed.
+    uint64 executions;
+    // Num of times the action returned an error.
+    uint64 failures;
+    // Num of times the timer was due while its action was still queued or
+    // running. The action is not executed on these occasions.
+    uint64 overruns;
+    // Max and total delay between the time the timer was due and the time its
+    // action was started.
+    absl::Duration max_jitter;
+    absl::Duration total_jitter;
+    TimerStats()
+        : executions(0),
+          failures(0),
+          overruns(0),
+          max_jitter(absl::ZeroDuration()),
+          total_jitter(absl::ZeroDuration()) {}
+    std::string ToString() const;
+  };
+
  private:
   using Action = std::function<::util::Status()>;
 
   class Descriptor {
    public:
     explicit Descriptor(const Action& action)
-        : repeat_(true), period_(absl::Seconds(1)), action_(action) {}
+        : repeat_(true), period_(absl::Seconds(1)), action_(action),
+          busy_(false) {}
     explicit Descriptor(bool repeat, const Action& action)
-        : repeat_(repeat), period_(absl::Seconds(1)), action_(action) {}
+        : repeat_(repeat), period_(absl::Seconds(1)), action_(action),
+          busy_(false) {}
     ~Descriptor() {}
     bool Repeat() { return repeat_; }
     absl::Duration Period() { return period_; }
@@ -61,55 +101,36 @@ class TimerDaemon final {
       ::util::Status error = MAKE_ERROR(ERR_INTERNAL) << "Noop timer action!";
       return error;
     };
+    // True while the action is queued or running on a worker.
+    std::atomic<bool> busy_;
+    absl::Mutex stats_lock_;
+    TimerStats stats_ GUARDED_BY(stats_lock_);
+
+    friend class TimerDaemon;
   };
 
   using DescriptorWeakPtr = std::weak_ptr<Descriptor>;
 
-  // In order to use TimerDaemon::Descriptor as a key in heap operations a
-  // comparator functor has to be defined.
-  struct TimerDescriptorComparator {
-    bool operator()(const TimerDaemon::DescriptorWeakPtr& lhs,
-                    const TimerDaemon::DescriptorWeakPtr& rhs) const {
-      // The goal of this method is to find which timer descriptor describes a
-      // timer that should be executed earlier: lhs or rhs?
-      // If a timer is canceled then the weak pointer pointing to it will
-      // 'expire' and there is no point in keeping such pointer on the heap. As
-      // the most effective way of removing an element from a heap is to move it
-      // to the top and then delete it, expired pointers should be theated as
-      // ones that are to be executed 'now'. This approach makes them to
-      // 'bubbled up' to the top as quickly as possible and then they can be
-      // removed.
-      if (lhs.expired() && !rhs.expired()) {
-        // rhs is expired, so, it is the lowest number.
-        return true;
-      }
-      if (rhs.expired() && !lhs.expired()) {
-        // lhs is expired, so, it is the lowest number.
-        return false;
-      }
-      if (rhs.expired() && lhs.expired()) {
-        // Both are expired, so, it really does not matter what we return.
-        return false;
-      }
-      // Both elements are still valid. Compare them!
-      return std::shared_ptr<Descriptor>(lhs)->due_time_ >
-             std::shared_ptr<Descriptor>(rhs)->due_time_;
-    }
+  // An action due, waiting for a worker.
+  struct Task {
+    std::shared_ptr<Descriptor> desc;
+    // The time the timer was due, for the jitter stats.
+    absl::Time due_time;
   };
 
  public:
   using DescriptorPtr = std::shared_ptr<Descriptor>;
 
-  // Starts the timer service. Creates a thread that calls Execute() every 1ms.
+  // Starts the timer service. Creates a thread that calls Execute() every 1ms,
+  // and the worker threads executing the actions.
   static ::util::Status Start() LOCKS_EXCLUDED(access_lock_);
-  // Stops the timer service. Notifies the timer thread to exit and waits until
-  // it joins.
+  // Stops the timer service. Notifies the timer and worker threads to exit and
+  // waits until they join. All the timers are dropped.
   static ::util::Status Stop() LOCKS_EXCLUDED(access_lock_);
-  // The 'worker' of the timer service. Is called every 1ms and checks if the
-  // first timer to be executed should be executed. If so, the action is
-  // executed and then if the timer is periodic the timer is updated and
-  // re-inserted into the heap with timers. It also takes care of all expired
-  // timers.
+  // The 'worker' of the timer service. Is called every 1ms and advances the
+  // timing wheel to the current time. The actions of the timers due are
+  // handed over to the worker threads, and the periodic timers are re-inserted
+  // into the wheel. It also takes care of all expired timers.
   static bool Execute() LOCKS_EXCLUDED(access_lock_);
 
   // Creates a one-shot timer that will execute 'action' 'delay_ms' milliseconds
@@ -124,12 +145,49 @@ class TimerDaemon final {
                                              const Action& action,
                                              DescriptorPtr* desc);
 
+  // Returns the execution statistics of the given timer.
+  static ::util::StatusOr<TimerStats> GetTimerStats(const DescriptorPtr& desc);
+
  private:
-  TimerDaemon() : started_(false) {}
+  // The geometry of the timing wheel. With 1ms ticks, the levels cover
+  // 256ms, ~65s, ~4.7h and ~49.7 days. Timers due further away are parked in
+  // the last level and re-inserted when it turns.
+  static constexpr int kNumLevels = 4;
+  static constexpr int kSlotBits = 8;
+  static constexpr int kNumSlots = 1 << kSlotBits;
+  static constexpr uint64 kSlotMask = kNumSlots - 1;
+  static constexpr absl::Duration kTick = absl::Milliseconds(1);
+
+  TimerDaemon()
+      : current_tick_(0),
+        start_time_(absl::Now()),
+        started_(false),
+        workers_stopping_(false) {}
+
+  // Advances the wheel up to 'now'. Adds the actions due to 'tasks' and
+  // re-inserts the periodic timers.
+  void GetDueActions(absl::Time now, std::vector<Task>* tasks)
+      LOCKS_EXCLUDED(access_lock_);
+
+  // Inserts the timer into the slot covering its due time.
+  void Insert(const DescriptorPtr& desc) EXCLUSIVE_LOCKS_REQUIRED(access_lock_);
 
-  // If there is an action to be executed at this moment of time a non-null
-  // pointer is returned.
-  DescriptorPtr GetAction();
+  // Moves the timers of the slots of the upper levels that the wheel just
+  // reached down to the lower levels.
+  void Cascade() EXCLUSIVE_LOCKS_REQUIRED(access_lock_);
+
+  // Re-inserts all the timers relative to a new start time.
+  void Rebase(absl::Time start_time) EXCLUSIVE_LOCKS_REQUIRED(access_lock_);
+
+  // Hands over the tasks to the workers, or executes them inline if there is
+  // no worker.
+  void Dispatch(std::vector<Task>* tasks) LOCKS_EXCLUDED(task_lock_);
+
+  // Executes the action of a task and updates the stats of its timer.
+  static void RunTask(const Task& task);
+
+  // The function executed by the worker threads.
+  static void* Worker(void* arg);
 
   // Returns true if the timer daemon is stopped.
   bool IsStopped();
@@ -144,16 +202,30 @@ class TimerDaemon final {
                               Action action, DescriptorPtr* desc)
       LOCKS_EXCLUDED(access_lock_);
 
-  // A Mutex used to guard access to the list of pointers to timer requests and
-  // the started_ flag.
+  // A Mutex used to guard access to the timing wheel and the started_ flag.
   mutable absl::Mutex access_lock_;
 
-  std::vector<DescriptorWeakPtr> timers_ GUARDED_BY(access_lock_);
+  // The slots of the timing wheel, by level. A slot holds the timers due
+  // within its range. A cancelled timer is left in its slot and dropped when
+  // the slot is reached.
+  std::vector<DescriptorWeakPtr> wheel_[kNumLevels][kNumSlots]
+      GUARDED_BY(access_lock_);
+
+  // The last tick processed, counted from start_time_.
+  uint64 current_tick_ GUARDED_BY(access_lock_);
+  absl::Time start_time_ GUARDED_BY(access_lock_);
 
   pthread_t tid_ = 0;  // will not be destroyed before the thread is joined.
 
   bool started_ GUARDED_BY(access_lock_);
 
+  // A Mutex used to guard access to the queue of tasks for the workers.
+  mutable absl::Mutex task_lock_;
+  absl::CondVar task_cond_;
+  std::deque<Task> tasks_ GUARDED_BY(task_lock_);
+  bool workers_stopping_ GUARDED_BY(task_lock_);
+  std::vector<pthread_t> worker_tids_;
+
   friend class TimerDaemonTest;
 };
 
@@ -0,0 +1,113 @@
+// Copyright 2018-present Open Networking Foundation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Measures how accurately the TimerDaemon fires a large number of periodic
+// timers. The timers are spread evenly over their period, and each execution
+// records how late it started compared to its due time.
+//
+// Example:
+//   timer_daemon_benchmark --timer_daemon_benchmark_num_timers=100000 \
+//       --timer_daemon_num_workers=4
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "stratum/glue/init_google.h"
+#include "stratum/glue/integral_types.h"
+#include "stratum/glue/logging.h"
+#include "stratum/lib/timer_daemon.h"
+#include "absl/strings/str_format.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+DEFINE_int32(timer_daemon_benchmark_num_timers, 100000,
+             "Num of periodic timers.");
+DEFINE_int32(timer_daemon_benchmark_period_ms, 1000,
+             "Period of the timers in milliseconds.");
+DEFINE_int32(timer_daemon_benchmark_duration_s, 10,
+             "Duration of the benchmark in seconds.");
+
+namespace stratum {
+
+int Main(int argc, char** argv) {
+  InitGoogle(argv[0], &argc, &argv, true);
+  const int num_timers = FLAGS_timer_daemon_benchmark_num_timers;
+  const int period_ms = std::max(FLAGS_timer_daemon_benchmark_period_ms, 1);
+  const absl::Duration duration =
+      absl::Seconds(FLAGS_timer_daemon_benchmark_duration_s);
+
+  CHECK(hal::TimerDaemon::Start().ok());
+  std::vector<hal::TimerDaemon::DescriptorPtr> timers(num_timers);
+  absl::Time start = absl::Now();
+  for (int i = 0; i < num_timers; ++i) {
+    CHECK(hal::TimerDaemon::RequestPeriodicTimer(
+              1 + (static_cast<uint64>(i) * period_ms) / num_timers,
+              period_ms,
+              []() { return ::util::OkStatus(); },
+              &timers[i])
+              .ok());
+  }
+  absl::Duration setup = absl::Now() - start;
+  absl::SleepFor(duration);
+  // Dropping the descriptors cancels the timers.
+  std::vector<hal::TimerDaemon::TimerStats> stats;
+  stats.reserve(num_timers);
+  for (auto& timer : timers) {
+    auto stats_or = hal::TimerDaemon::GetTimerStats(timer);
+    CHECK(stats_or.ok());
+    stats.push_back(stats_or.ValueOrDie());
+    timer.reset();
+  }
+  CHECK(hal::TimerDaemon::Stop().ok());
+
+  uint64 total_executions = 0, total_overruns = 0, total_failures = 0;
+  absl::Duration max_jitter = absl::ZeroDuration();
+  absl::Duration total_jitter = absl::ZeroDuration();
+  for (const auto& s : stats) {
+    total_executions += s.executions;
+    total_overruns += s.overruns;
+    total_failures += s.failures;
+    max_jitter = std::max(max_jitter, s.max_jitter);
+    total_jitter += s.total_jitter;
+  }
+  const double expected = static_cast<double>(num_timers) *
+                          absl::ToDoubleMilliseconds(duration) / period_ms;
+  std::cout << absl::StrFormat(
+                   "%d timers, period %dms, %s run, %s to request the timers.",
+                   num_timers, period_ms, absl::FormatDuration(duration),
+                   absl::FormatDuration(setup))
+            << std::endl;
+  std::cout << absl::StrFormat(
+                   "executions %d (%.1f%% of expected), failures %d, "
+                   "overruns %d",
+                   total_executions, 100.0 * total_executions / expected,
+                   total_failures, total_overruns)
+            << std::endl;
+  absl::Duration avg_jitter =
+      total_executions ? total_jitter / static_cast<int64>(total_executions)
+                       : absl::ZeroDuration();
+  std::cout << absl::StrFormat("jitter (ms) avg %.3f  max %.3f",
+                               absl::ToDoubleMilliseconds(avg_jitter),
+                               absl::ToDoubleMilliseconds(max_jitter))
+            << std::endl;
+
+  return 0;
+}
+
+}  // namespace stratum
+
+int main(int argc, char** argv) { return stratum::Main(argc, argv); }
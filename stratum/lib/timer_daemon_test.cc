@@ -16,9 +16,14 @@
 
 #include "stratum/lib/timer_daemon.h"
 
+#include <functional>
+#include <vector>
+
 #include "stratum/glue/status/status_test_util.h"
 #include "gtest/gtest.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 
 namespace stratum {
 namespace hal {
@@ -50,19 +55,39 @@ class TimerDaemonTest : public ::testing::Test {
 
   void TearDown() override { ASSERT_OK(TimerDaemon::Stop()); }
 
-  TimerDaemon::DescriptorPtr GetTimerDescriptorPtr(const absl::Time when) {
-    TimerDaemon::DescriptorPtr desc =
-        std::make_shared<TimerDaemon::Descriptor>(
-            /* repeat = */ false, []() { return ::util::OkStatus(); });
-    desc->due_time_ = when;
+  // Stops the daemon and restarts its wheel from 'start', so that the test
+  // can drive it with a fake time through AdvanceTo().
+  void StopAndRebase(absl::Time start) {
+    ASSERT_OK(TimerDaemon::Stop());
+    TimerDaemon* daemon = TimerDaemon::GetInstance();
+    absl::WriterMutexLock l(&daemon->access_lock_);
+    daemon->Rebase(start);
+    start_ = start;
+  }
+
+  // Inserts a timer due 'delay' after the start of the wheel.
+  TimerDaemon::DescriptorPtr Schedule(
+      bool repeat, absl::Duration delay, absl::Duration period,
+      const std::function<::util::Status()>& action) {
+    auto desc = std::make_shared<TimerDaemon::Descriptor>(repeat, action);
+    desc->due_time_ = start_ + delay;
+    desc->period_ = period;
+    TimerDaemon* daemon = TimerDaemon::GetInstance();
+    absl::WriterMutexLock l(&daemon->access_lock_);
+    daemon->Insert(desc);
     return desc;
   }
 
-  TimerDaemon::DescriptorWeakPtr GetTimerDescriptorWeakPtr(
-      const TimerDaemon::DescriptorPtr &desc) {
-    return TimerDaemon::DescriptorWeakPtr(desc);
+  // Advances the wheel to 'delay' after its start and executes the actions
+  // due on the calling thread.
+  void AdvanceTo(absl::Duration delay) {
+    std::vector<TimerDaemon::Task> tasks;
+    TimerDaemon::GetInstance()->GetDueActions(start_ + delay, &tasks);
+    for (const auto& task : tasks) TimerDaemon::RunTask(task);
   }
 
+  absl::Time start_;
+
   // A counter used to check if timers are executed in correct order. Each timer
   // checks if the 'count_' has expected value and then increments it.
   // This simple mechanism allows for checking if all timers are handled as
@@ -71,62 +96,8 @@ class TimerDaemonTest : public ::testing::Test {
   // A Mutex used to guard access to the 'count_'.
   mutable absl::Mutex access_lock_;
 
-  // A comparator used internally by the TimerSevice to compare timestamps.
-  // This class is private, so, it is instantiated here to allow access by
-  // relevant tests.
-  TimerDaemon::TimerDescriptorComparator cmp_;
 };
 
-TEST_F(TimerDaemonTest, CompareSmallerBigger) {
-  absl::Time now = absl::Now();
-  auto desc1 = GetTimerDescriptorPtr(now);
-  auto desc2 = GetTimerDescriptorPtr(now + absl::Milliseconds(10));
-
-  auto weak1 = GetTimerDescriptorWeakPtr(desc1);
-  auto weak2 = GetTimerDescriptorWeakPtr(desc2);
-
-  // 0 > 10
-  EXPECT_FALSE(cmp_(weak1, weak2));
-
-  desc2.reset();
-  // 0 > expired 10
-  EXPECT_FALSE(cmp_(weak1, weak2));
-
-  desc1.reset();
-  // expired 0 > expired 10
-  EXPECT_FALSE(cmp_(weak1, weak2));
-
-  desc2 = GetTimerDescriptorPtr(now + absl::Milliseconds(10));
-  weak2 = GetTimerDescriptorWeakPtr(desc2);
-  // expired 0 > 10
-  EXPECT_TRUE(cmp_(weak1, weak2));
-}
-
-TEST_F(TimerDaemonTest, CompareBiggerSmaller) {
-  absl::Time now = absl::Now();
-  auto desc1 = GetTimerDescriptorPtr(now + absl::Milliseconds(10));
-  auto desc2 = GetTimerDescriptorPtr(now);
-
-  auto weak1 = GetTimerDescriptorWeakPtr(desc1);
-  auto weak2 = GetTimerDescriptorWeakPtr(desc2);
-
-  // 10 > 0
-  EXPECT_TRUE(cmp_(weak1, weak2));
-
-  desc2.reset();
-  // 10 > expired 0
-  EXPECT_FALSE(cmp_(weak1, weak2));
-
-  desc1.reset();
-  // expired 10 > expired 0
-  EXPECT_FALSE(cmp_(weak1, weak2));
-
-  desc2 = GetTimerDescriptorPtr(now);
-  weak2 = GetTimerDescriptorWeakPtr(desc2);
-  // expired 10 > 0
-  EXPECT_TRUE(cmp_(weak1, weak2));
-}
-
 TEST_F(TimerDaemonTest, CreateOneShot) {
   // This test verifies that TimerDaemon does create one-shot timer.
   TimerDaemon::DescriptorPtr desc;
@@ -165,6 +136,139 @@ TEST_F(TimerDaemonTest, CreateTwoOneShots) {
 
 TEST_F(TimerDaemonTest, CreatePeriodic) {
   // This test verifies that TimerDaemon does create periodic timer.
+  TimerDaemon::DescriptorPtr desc;
+  ASSERT_OK(TimerDaemon::RequestPeriodicTimer(10, 10,
+                                              [&]() {
+                                                absl::WriterMutexLock l(
+                                                    &access_lock_);
+                                                count_++;
+                                                return ::util::OkStatus();
+                                              },
+                                              &desc));
+  usleep(200000);
+  desc.reset();
+  absl::WriterMutexLock l(&access_lock_);
+  EXPECT_GE(count_, 5);
+}
+
+TEST_F(TimerDaemonTest, SlowActionDoesNotDelayOtherTimers) {
+  // A periodic timer whose action takes longer than its period does not block
+  // the other timers, and the executions it misses are counted as overruns.
+  TimerDaemon::DescriptorPtr slow, fast;
+  ASSERT_OK(TimerDaemon::RequestPeriodicTimer(1, 10,
+                                              []() {
+                                                usleep(100000);
+                                                return ::util::OkStatus();
+                                              },
+                                              &slow));
+  ASSERT_OK(TimerDaemon::RequestOneShotTimer(20,
+                                             [&]() {
+                                               absl::WriterMutexLock l(
+                                                   &access_lock_);
+                                               count_++;
+                                               return ::util::OkStatus();
+                                             },
+                                             &fast));
+  usleep(60000);
+  {
+    absl::WriterMutexLock l(&access_lock_);
+    EXPECT_EQ(1, count_);
+  }
+  usleep(100000);
+  TimerDaemon::TimerStats stats;
+  ASSERT_OK_AND_ASSIGN(stats, TimerDaemon::GetTimerStats(slow));
+  EXPECT_GE(stats.executions, 1);
+  EXPECT_GE(stats.overruns, 1);
+  slow.reset();
+}
+
+TEST_F(TimerDaemonTest, GetTimerStatsNullDescriptor) {
+  EXPECT_EQ(ERR_INVALID_PARAM,
+            TimerDaemon::GetTimerStats(nullptr).status().error_code());
+}
+
+TEST_F(TimerDaemonTest, WheelOneShotsOnAllLevels) {
+  // The timers due after the first turn of the lowest levels are cascaded
+  // down and fire on time.
+  StopAndRebase(absl::Now());
+  std::vector<int> fired;
+  auto fire = [&fired](int id) {
+    return [&fired, id]() {
+      fired.push_back(id);
+      return ::util::OkStatus();
+    };
+  };
+  const std::vector<absl::Duration> delays = {
+      absl::Milliseconds(5), absl::Milliseconds(300), absl::Seconds(70),
+      absl::Hours(5)};
+  std::vector<TimerDaemon::DescriptorPtr> descs;
+  // Requested in reverse order, they must fire in the order of their delays.
+  for (int i = delays.size() - 1; i >= 0; --i) {
+    descs.push_back(Schedule(false, delays[i], absl::ZeroDuration(), fire(i)));
+  }
+  for (size_t i = 0; i < delays.size(); ++i) {
+    AdvanceTo(delays[i] - absl::Milliseconds(1));
+    EXPECT_EQ(i, fired.size());
+    AdvanceTo(delays[i]);
+    ASSERT_EQ(i + 1, fired.size());
+    EXPECT_EQ(i, fired.back());
+  }
+  AdvanceTo(absl::Hours(6));
+  EXPECT_EQ(delays.size(), fired.size());
+}
+
+TEST_F(TimerDaemonTest, WheelPeriodic) {
+  StopAndRebase(absl::Now());
+  int count = 0;
+  auto desc = Schedule(true, absl::Milliseconds(10), absl::Milliseconds(10),
+                       [&count]() {
+                         count++;
+                         return ::util::OkStatus();
+                       });
+  for (int ms = 1; ms <= 1000; ++ms) AdvanceTo(absl::Milliseconds(ms));
+  EXPECT_EQ(100, count);
+  TimerDaemon::TimerStats stats;
+  ASSERT_OK_AND_ASSIGN(stats, TimerDaemon::GetTimerStats(desc));
+  EXPECT_EQ(100, stats.executions);
+  EXPECT_EQ(0, stats.failures);
+  EXPECT_EQ(0, stats.overruns);
+}
+
+TEST_F(TimerDaemonTest, WheelPeriodicOverrunsAndFailures) {
+  // The executions due while the previous one is pending are skipped.
+  StopAndRebase(absl::Now());
+  auto desc = Schedule(true, absl::Milliseconds(10), absl::Milliseconds(10),
+                       []() {
+                         ::util::Status error = MAKE_ERROR(ERR_INTERNAL)
+                                                << "Failed.";
+                         return error;
+                       });
+  AdvanceTo(absl::Milliseconds(100));
+  TimerDaemon::TimerStats stats;
+  ASSERT_OK_AND_ASSIGN(stats, TimerDaemon::GetTimerStats(desc));
+  EXPECT_EQ(1, stats.executions);
+  EXPECT_EQ(1, stats.failures);
+  EXPECT_EQ(9, stats.overruns);
+}
+
+TEST_F(TimerDaemonTest, WheelCancel) {
+  // A timer is cancelled by dropping its descriptor.
+  StopAndRebase(absl::Now());
+  int count = 0;
+  auto action = [&count]() {
+    count++;
+    return ::util::OkStatus();
+  };
+  auto one_shot =
+      Schedule(false, absl::Milliseconds(500), absl::ZeroDuration(), action);
+  auto periodic =
+      Schedule(true, absl::Milliseconds(1), absl::Milliseconds(1), action);
+  AdvanceTo(absl::Milliseconds(1));
+  EXPECT_EQ(1, count);
+  one_shot.reset();
+  periodic.reset();
+  for (int ms = 2; ms <= 1000; ++ms) AdvanceTo(absl::Milliseconds(ms));
+  EXPECT_EQ(1, count);
 }
 
 }  // namespace hal
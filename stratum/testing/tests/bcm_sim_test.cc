@@ -13,6 +13,12 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
 #include "stratum/glue/logging.h"
 #include "stratum/hal/lib/common/writer_interface.h"
 #include "stratum/lib/macros.h"
@@ -21,8 +27,11 @@
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
 #include "p4/v1/p4runtime.pb.h"
 
+DECLARE_int32(max_l3_flow_batch_size);
+
 namespace stratum {
 
 namespace hal {
@@ -37,6 +46,7 @@ class BcmSimTest : public BcmSimTestFixture {
         : responses_(ABSL_DIE_IF_NULL(responses)) {
       responses_->clear();
     }
+    using WriterInterface<::p4::v1::ReadResponse>::Write;
     bool Write(const ::p4::v1::ReadResponse& response) override {
       if (responses_) {
         responses_->push_back(response);
@@ -51,6 +61,118 @@ class BcmSimTest : public BcmSimTestFixture {
 
   BcmSimTest() {}
   ~BcmSimTest() override {}
+
+  // Finds an IPv4 LPM table entry in write_request_ and uses it as a template
+  // to build a WriteRequest inserting num_routes /32 routes, starting from
+  // base_addr. Returns false if no such template exists.
+  bool BuildIpv4LpmWriteRequest(uint32 base_addr, int num_routes,
+                                ::p4::v1::WriteRequest* req) {
+    const ::p4::v1::TableEntry* tmpl = nullptr;
+    int lpm_idx = -1;
+    for (const auto& update : write_request_.updates()) {
+      if (!update.entity().has_table_entry()) continue;
+      const auto& entry = update.entity().table_entry();
+      for (int i = 0; i < entry.match_size(); ++i) {
+        if (entry.match(i).has_lpm() &&
+            entry.match(i).lpm().value().size() == 4) {
+          tmpl = &entry;
+          lpm_idx = i;
+          break;
+        }
+      }
+      if (tmpl != nullptr) break;
+    }
+    if (tmpl == nullptr) return false;
+    req->Clear();
+    req->set_device_id(kNodeId);
+    for (int i = 0; i < num_routes; ++i) {
+      uint32 addr = base_addr + i;
+      std::string value = {static_cast<char>((addr >> 24) & 0xff),
+                           static_cast<char>((addr >> 16) & 0xff),
+                           static_cast<char>((addr >> 8) & 0xff),
+                           static_cast<char>(addr & 0xff)};
+      auto* update = req->add_updates();
+      update->set_type(::p4::v1::Update::INSERT);
+      auto* entry = update->mutable_entity()->mutable_table_entry();
+      *entry = *tmpl;
+      entry->mutable_match(lpm_idx)->mutable_lpm()->set_value(value);
+      entry->mutable_match(lpm_idx)->mutable_lpm()->set_prefix_len(32);
+    }
+    return true;
+  }
+
+  // Finds an ACL table entry in write_request_ which does not point to an
+  // action profile and uses it as a template to build num_entries ACL entries
+  // with different priorities, starting from base_priority, split into
+  // requests of at most chunk_size entries. Returns false if no such template
+  // exists or the ACL table has no room for the entries.
+  bool BuildAclWriteRequests(int base_priority, int num_entries,
+                             int chunk_size,
+                             std::vector<::p4::v1::WriteRequest>* reqs) {
+    const ::p4::v1::TableEntry* tmpl = nullptr;
+    for (const auto& update : write_request_.updates()) {
+      if (!update.entity().has_table_entry()) continue;
+      const auto& entry = update.entity().table_entry();
+      if (bcm_table_manager_->IsAclTable(entry.table_id()) &&
+          entry.action().action_profile_member_id() == 0 &&
+          entry.action().action_profile_group_id() == 0) {
+        tmpl = &entry;
+        break;
+      }
+    }
+    if (tmpl == nullptr) return false;
+    auto table = bcm_table_manager_->GetReadOnlyAclTable(tmpl->table_id());
+    if (!table.ok() || table.ValueOrDie()->Size() -
+                               table.ValueOrDie()->EntryCount() <
+                           num_entries) {
+      return false;
+    }
+    for (int i = 0; i < num_entries; ++i) {
+      if (i % chunk_size == 0) {
+        reqs->emplace_back();
+        reqs->back().set_device_id(kNodeId);
+      }
+      auto* update = reqs->back().add_updates();
+      update->set_type(::p4::v1::Update::INSERT);
+      auto* entry = update->mutable_entity()->mutable_table_entry();
+      *entry = *tmpl;
+      entry->set_priority(base_priority + i);
+    }
+    return true;
+  }
+
+  // Writes the given requests using num_threads threads, each thread picking
+  // the next request not written yet. Returns the achieved updates/sec.
+  double ConcurrentWriteAndMeasureRate(
+      const std::vector<::p4::v1::WriteRequest>& reqs, int num_threads) {
+    std::atomic<size_t> next_req(0);
+    std::atomic<int> num_updates(0);
+    std::vector<std::thread> threads;
+    uint64 start = absl::GetCurrentTimeNanos();
+    for (int i = 0; i < num_threads; ++i) {
+      threads.emplace_back([this, &reqs, &next_req, &num_updates]() {
+        for (size_t j = next_req++; j < reqs.size(); j = next_req++) {
+          std::vector<::util::Status> results;
+          EXPECT_OK(bcm_switch_->WriteForwardingEntries(reqs[j], &results));
+          num_updates += reqs[j].updates_size();
+        }
+      });
+    }
+    for (auto& thread : threads) thread.join();
+    uint64 end = absl::GetCurrentTimeNanos();
+    return num_updates * 1e9 / std::max<uint64>(end - start, 1);
+  }
+
+  // Writes the given request and returns the achieved routes/sec.
+  double WriteAndMeasureRate(const ::p4::v1::WriteRequest& req) {
+    std::vector<::util::Status> results;
+    uint64 start = absl::GetCurrentTimeNanos();
+    ::util::Status status = bcm_switch_->WriteForwardingEntries(req, &results);
+    uint64 end = absl::GetCurrentTimeNanos();
+    EXPECT_OK(status);
+    EXPECT_EQ(static_cast<size_t>(req.updates_size()), results.size());
+    return req.updates_size() * 1e9 / std::max<uint64>(end - start, 1);
+  }
 };
 
 TEST_F(BcmSimTest, TestBasicFunctionality) {
@@ -102,6 +224,71 @@ TEST_F(BcmSimTest, TestBasicFunctionality) {
   }
 }
 
+TEST_F(BcmSimTest, BatchedL3RouteProgrammingRate) {
+  constexpr int kNumRoutes = 4096;
+  ASSERT_OK(bcm_switch_->PushForwardingPipelineConfig(
+      kNodeId, forwarding_pipeline_config_));
+  std::vector<::util::Status> results;
+  ASSERT_OK(bcm_switch_->WriteForwardingEntries(write_request_, &results));
+
+  ::p4::v1::WriteRequest unbatched_req, batched_req;
+  if (!BuildIpv4LpmWriteRequest(0x0b000000, kNumRoutes, &unbatched_req) ||
+      !BuildIpv4LpmWriteRequest(0x0c000000, kNumRoutes, &batched_req)) {
+    LOG(WARNING) << "No IPv4 LPM entry found in the test write request.";
+    return;
+  }
+
+  int32 saved_batch_size = FLAGS_max_l3_flow_batch_size;
+  FLAGS_max_l3_flow_batch_size = 0;
+  double unbatched_rate = WriteAndMeasureRate(unbatched_req);
+  FLAGS_max_l3_flow_batch_size = saved_batch_size;
+  double batched_rate = WriteAndMeasureRate(batched_req);
+  LOG(INFO) << "Programmed " << kNumRoutes << " IPv4 routes: "
+            << unbatched_rate << " routes/sec one by one, " << batched_rate
+            << " routes/sec in batches of " << FLAGS_max_l3_flow_batch_size
+            << ".";
+}
+
+TEST_F(BcmSimTest, ConcurrentWritesToDisjointTables) {
+  constexpr int kNumRequests = 4;  // of each kind
+  constexpr int kRoutesPerRequest = 512;
+  constexpr int kAclEntriesPerRequest = 16;
+  ASSERT_OK(bcm_switch_->PushForwardingPipelineConfig(
+      kNodeId, forwarding_pipeline_config_));
+  std::vector<::util::Status> results;
+  ASSERT_OK(bcm_switch_->WriteForwardingEntries(write_request_, &results));
+
+  // Each round uses fresh routes and ACL entries. Route and ACL requests are
+  // interleaved, so that concurrent writers have disjoint tables to program.
+  int round = 0;
+  for (int num_threads : {1, 2, 4}) {
+    std::vector<::p4::v1::WriteRequest> acl_reqs, reqs;
+    if (!BuildAclWriteRequests(1000 + round * kNumRequests *
+                                          kAclEntriesPerRequest,
+                               kNumRequests * kAclEntriesPerRequest,
+                               kAclEntriesPerRequest, &acl_reqs)) {
+      LOG(WARNING) << "No usable ACL entry found in the test write request.";
+      return;
+    }
+    for (int i = 0; i < kNumRequests; ++i) {
+      ::p4::v1::WriteRequest route_req;
+      if (!BuildIpv4LpmWriteRequest(
+              0x0d000000 + (round << 16) + i * kRoutesPerRequest,
+              kRoutesPerRequest, &route_req)) {
+        LOG(WARNING) << "No IPv4 LPM entry found in the test write request.";
+        return;
+      }
+      reqs.push_back(route_req);
+      reqs.push_back(acl_reqs[i]);
+    }
+    double rate = ConcurrentWriteAndMeasureRate(reqs, num_threads);
+    LOG(INFO) << "Wrote " << kNumRequests * kRoutesPerRequest << " routes and "
+              << kNumRequests * kAclEntriesPerRequest << " ACL entries with "
+              << num_threads << " thread(s): " << rate << " updates/sec.";
+    ++round;
+  }
+}
+
 }  // namespace bcm
 }  // namespace hal
 